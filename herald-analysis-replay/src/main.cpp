@@ -0,0 +1,272 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+/*
+ * The main executable of the herald-analysis-replay process
+ *
+ * Streams a recorded RSSI log through an AnalysisRunner using the log's own
+ * timestamps as a simulated clock, as fast as the log can be read.
+ *
+ * CSV format: one sample per line, an optional header line is skipped
+ *   secondsSinceEpoch,sampledID,rssi
+ * Binary format: packed little endian records of 20 bytes each
+ *   uint64 secondsSinceEpoch, uint64 sampledID, int32 rssi
+ */
+#include "herald/herald.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace herald::analysis;
+using namespace herald::analysis::algorithms::distance;
+using namespace herald::analysis::algorithms::risk;
+using namespace herald::analysis::sampling;
+using namespace herald::datatype;
+
+/// \brief Writes each estimated distance as CSV, and counts them
+struct ReplayDistanceDelegate {
+  using value_type = Distance;
+
+  ReplayDistanceDelegate() : out(nullptr), count(0) {}
+  ReplayDistanceDelegate(std::FILE* out) : out(out), count(0) {}
+  ~ReplayDistanceDelegate() = default;
+
+  void newSample(SampledID sampled, Sample<Distance> sample) {
+    ++count;
+    if (nullptr == out) return;
+    std::fprintf(out, "%llu,%zu,%.4f\n",
+      (unsigned long long)sample.taken.secondsSinceUnixEpoch(), (std::size_t)sampled, sample.value.value);
+  }
+
+  std::FILE* out;
+  std::uint64_t count;
+};
+
+struct ReplayOptions {
+  std::string input;
+  bool binary = false;
+  bool quiet = false;
+  std::string distanceOutput = "-";
+  std::string riskOutput;
+  long runInterval = 10; // simulated seconds between AnalysisRunner::run() calls
+  long analyserInterval = 30;
+  double intercept = -50;
+  double coefficient = -24;
+  long riskMaximumGap = 300;
+};
+
+/// \brief Pull based reader for either log format. Returns false at end of input.
+struct RSSILogReader {
+  RSSILogReader(const ReplayOptions& options)
+    : binary(options.binary), in(), buffer(1 << 20), line(), lineNumber(0), malformed(0)
+  {
+    in.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    in.open(options.input, binary ? std::ios::in | std::ios::binary : std::ios::in);
+  }
+  ~RSSILogReader() = default;
+
+  bool isOpen() const {
+    return in.is_open();
+  }
+
+  bool next(std::uint64_t& when, std::uint64_t& sampled, int& rssi) {
+    if (binary) {
+      char record[20];
+      if (!in.read(record, sizeof(record))) return false;
+      std::int32_t value;
+      std::memcpy(&when, record, 8);
+      std::memcpy(&sampled, record + 8, 8);
+      std::memcpy(&value, record + 16, 4);
+      rssi = value;
+      return true;
+    }
+    while (std::getline(in, line)) {
+      ++lineNumber;
+      const char* pos = line.c_str();
+      char* end = nullptr;
+      when = std::strtoull(pos, &end, 10);
+      if (end == pos || ',' != *end) {
+        if (lineNumber > 1) ++malformed; // first line may be a header
+        continue;
+      }
+      pos = end + 1;
+      sampled = std::strtoull(pos, &end, 10);
+      if (end == pos || ',' != *end) {
+        ++malformed;
+        continue;
+      }
+      pos = end + 1;
+      rssi = (int)std::strtol(pos, &end, 10);
+      if (end == pos) {
+        ++malformed;
+        continue;
+      }
+      return true;
+    }
+    return false;
+  }
+
+  std::uint64_t malformedLines() const {
+    return malformed;
+  }
+
+private:
+  bool binary;
+  std::ifstream in;
+  std::vector<char> buffer;
+  std::string line;
+  std::uint64_t lineNumber;
+  std::uint64_t malformed;
+};
+
+void usage(const char* name) {
+  std::cerr << "Usage: " << name << " [options] <rssi-log>" << std::endl
+            << "  --binary                 Input is packed binary records, not CSV" << std::endl
+            << "  --quiet                  Do not write distances (throughput testing)" << std::endl
+            << "  --distances <file>       Write distances CSV to file (default stdout)" << std::endl
+            << "  --risk <file>            Write per contact risk CSV to file at the end" << std::endl
+            << "  --run-interval <s>       Simulated seconds between analysis runs (default 10)" << std::endl
+            << "  --analyser-interval <s>  FowlerBasicAnalyser interval (default 30)" << std::endl
+            << "  --intercept <v>          FowlerBasic intercept (default -50)" << std::endl
+            << "  --coefficient <v>        FowlerBasic coefficient (default -24)" << std::endl
+            << "  --risk-gap <s>           Longest gap integrated as one contact (default 300)" << std::endl;
+}
+
+bool parseOptions(int argc, char* argv[], ReplayOptions& options) {
+  for (int i = 1;i < argc;++i) {
+    std::string arg(argv[i]);
+    bool hasValue = i + 1 < argc;
+    if ("--binary" == arg) {
+      options.binary = true;
+    } else if ("--quiet" == arg) {
+      options.quiet = true;
+    } else if ("--distances" == arg && hasValue) {
+      options.distanceOutput = argv[++i];
+    } else if ("--risk" == arg && hasValue) {
+      options.riskOutput = argv[++i];
+    } else if ("--run-interval" == arg && hasValue) {
+      options.runInterval = std::atol(argv[++i]);
+    } else if ("--analyser-interval" == arg && hasValue) {
+      options.analyserInterval = std::atol(argv[++i]);
+    } else if ("--intercept" == arg && hasValue) {
+      options.intercept = std::atof(argv[++i]);
+    } else if ("--coefficient" == arg && hasValue) {
+      options.coefficient = std::atof(argv[++i]);
+    } else if ("--risk-gap" == arg && hasValue) {
+      options.riskMaximumGap = std::atol(argv[++i]);
+    } else if ('-' != arg[0] && options.input.empty()) {
+      options.input = arg;
+    } else {
+      return false;
+    }
+  }
+  return !options.input.empty() && options.runInterval > 0;
+}
+
+int main(int argc, char* argv[]) {
+  ReplayOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  RSSILogReader reader(options);
+  if (!reader.isOpen()) {
+    std::cerr << "Could not open " << options.input << std::endl;
+    return 1;
+  }
+
+  std::FILE* distanceOut = nullptr;
+  if (!options.quiet) {
+    distanceOut = ("-" == options.distanceOutput) ? stdout : std::fopen(options.distanceOutput.c_str(), "w");
+    if (nullptr == distanceOut) {
+      std::cerr << "Could not open " << options.distanceOutput << std::endl;
+      return 1;
+    }
+    std::fprintf(distanceOut, "time,sampledid,distance\n");
+  }
+
+  using DelegatesT = AnalysisDelegateManager<ReplayDistanceDelegate,RiskAccumulator<>>;
+  using ProvidersT = AnalysisProviderManager<FowlerBasicAnalyser>;
+
+  DelegatesT adm(ReplayDistanceDelegate(distanceOut),
+    RiskAccumulator<>(RiskSliceBasic(), TimeInterval::seconds(options.riskMaximumGap)));
+  ProvidersT apm(FowlerBasicAnalyser(options.analyserInterval, options.intercept, options.coefficient));
+  AnalysisRunner<DelegatesT,ProvidersT,RSSI,Distance> runner(adm, apm);
+
+  auto started = std::chrono::steady_clock::now();
+
+  std::uint64_t when = 0;
+  std::uint64_t sampled = 0;
+  int rssi = 0;
+  std::uint64_t samples = 0;
+  std::uint64_t runs = 0;
+  std::uint64_t nextRun = 0;
+  std::uint64_t firstTime = 0;
+  std::uint64_t lastTime = 0;
+  while (reader.next(when, sampled, rssi)) {
+    if (0 == samples) {
+      firstTime = when;
+      nextRun = when + options.runInterval;
+    }
+    ++samples;
+    // Run for all time points passed before this sample, using the simulated clock
+    if (when >= nextRun) {
+      runner.run(Date(lastTime));
+      ++runs;
+      nextRun = when + options.runInterval;
+    }
+    runner.newSample(sampled, Sample<RSSI>(Date(when), RSSI(rssi)));
+    if (when > lastTime) {
+      lastTime = when;
+    }
+  }
+  if (samples > 0) {
+    runner.run(Date(lastTime));
+    ++runs;
+  }
+
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  if (nullptr != distanceOut && stdout != distanceOut) {
+    std::fclose(distanceOut);
+  }
+
+  auto& accumulator = adm.get<RiskAccumulator<>>();
+  if (!options.riskOutput.empty()) {
+    std::FILE* riskOut = std::fopen(options.riskOutput.c_str(), "w");
+    if (nullptr == riskOut) {
+      std::cerr << "Could not open " << options.riskOutput << std::endl;
+      return 1;
+    }
+    std::fprintf(riskOut, "sampledid,total,last24h,last14d\n");
+    Date now(lastTime);
+    accumulator.each([riskOut, &now](SampledID id, const ContactExposure<14>& exposure) {
+      std::fprintf(riskOut, "%zu,%.4f,%.4f,%.4f\n", (std::size_t)id, exposure.total(),
+        exposure.lastHours(now, 24), exposure.lastDays(now, 14));
+    });
+    std::fclose(riskOut);
+  }
+
+  double simulated = (double)(lastTime - firstTime);
+  std::cerr << "Samples read:        " << samples << std::endl
+            << "Malformed lines:     " << reader.malformedLines() << std::endl
+            << "Analysis runs:       " << runs << std::endl
+            << "Distances generated: " << adm.get<ReplayDistanceDelegate>().count << std::endl
+            << "Contacts with risk:  " << accumulator.size() << std::endl
+            << "Risk last 24h:       " << accumulator.lastDay(Date(lastTime)) << std::endl
+            << "Risk last 14d:       " << accumulator.lastDays(Date(lastTime)) << std::endl
+            << "Simulated seconds:   " << simulated << std::endl
+            << "Wall clock seconds:  " << elapsed << std::endl
+            << "Samples per second:  " << (elapsed > 0 ? samples / elapsed : 0) << std::endl
+            << "Speed up:            " << (elapsed > 0 ? simulated / elapsed : 0) << "x" << std::endl;
+  return 0;
+}
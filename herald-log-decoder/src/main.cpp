@@ -0,0 +1,377 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+/*
+ * The main executable of the herald-log-decoder process
+ *
+ * Converts a log written by herald::data::BinaryLoggingSink back to text, one line per
+ * message in the same format as StdOutLoggingSink, prefixed with the time:
+ *   secondsSinceEpoch.micros,subsystem,category,level,message
+ *
+ * Binary logs identify each message's format string by a hash (its site ID). This tool also
+ * generates the dictionary of site IDs, by scanning source files for HTDBG, HTLOG, HTERR,
+ * HDBG, HLOG and HERR calls. The build runs this over the Herald sources to produce
+ * herald-log-sites.txt. Dictionary format: one site per line
+ *   siteIdHex<TAB>file:line<TAB>format
+ * with backslash, tab and newline in the format escaped as \\, \t and \n.
+ */
+#include "herald/herald.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace herald::data;
+
+struct LogSite {
+  std::string location;
+  std::string format;
+};
+
+using SiteDictionary = std::map<std::uint32_t,LogSite>;
+
+/// \brief Reads a C string literal starting at pos (the opening quote), concatenating adjacent literals
+bool parseLiteral(const std::string& source, std::size_t& pos, std::string& literal) {
+  literal.clear();
+  bool found = false;
+  while (pos < source.size() && '"' == source[pos]) {
+    found = true;
+    ++pos;
+    while (pos < source.size() && '"' != source[pos]) {
+      char c = source[pos++];
+      if ('\\' != c) {
+        literal.push_back(c);
+        continue;
+      }
+      if (pos >= source.size()) {
+        return false;
+      }
+      char e = source[pos++];
+      switch (e) {
+        case 'n': literal.push_back('\n'); break;
+        case 't': literal.push_back('\t'); break;
+        case 'r': literal.push_back('\r'); break;
+        case '0': literal.push_back('\0'); break;
+        case 'x': {
+          unsigned int value = 0;
+          auto result = std::from_chars(source.data() + pos, source.data() + std::min(pos + 2, source.size()), value, 16);
+          if (std::errc() != result.ec) {
+            literal.push_back(e); // Not valid C++, but keeps scanning the rest of the file
+            break;
+          }
+          literal.push_back((char)value);
+          pos = result.ptr - source.data();
+          break;
+        }
+        default: literal.push_back(e); break; // \\ \" \'
+      }
+    }
+    if (pos >= source.size()) {
+      return false;
+    }
+    ++pos; // closing quote
+    std::size_t next = source.find_first_not_of(" \t\r\n", pos);
+    if (std::string::npos != next && '"' == source[next]) {
+      pos = next;
+    }
+  }
+  return found;
+}
+
+/// \brief Adds every log call site with a literal format in a source file to the dictionary
+std::size_t scanSource(const std::filesystem::path& file, const std::string& name, SiteDictionary& sites,
+  std::size_t& collisions) {
+  std::ifstream in(file, std::ios::in | std::ios::binary);
+  std::stringstream contents;
+  contents << in.rdbuf();
+  const std::string source = contents.str();
+
+  static const std::vector<std::string> macros{"HTDBG","HTLOG","HTERR","HDBG","HLOG","HERR"};
+  std::size_t found = 0;
+  std::size_t line = 1;
+  bool lineStart = true;
+  for (std::size_t pos = 0;pos < source.size();++pos) {
+    char c = source[pos];
+    if ('\n' == c) {
+      ++line;
+      lineStart = true;
+      continue;
+    }
+    if (' ' == c || '\t' == c || '\r' == c) {
+      continue;
+    }
+    bool wasLineStart = lineStart;
+    lineStart = false;
+    if ('#' == c && wasLineStart) {
+      // Preprocessor directive (including the macro definitions), to the end of the line
+      while (pos + 1 < source.size() && '\n' != source[pos + 1]) {
+        ++pos;
+      }
+      continue;
+    }
+    if ('/' == c && pos + 1 < source.size() && '/' == source[pos + 1]) {
+      while (pos + 1 < source.size() && '\n' != source[pos + 1]) {
+        ++pos;
+      }
+      continue;
+    }
+    if ('/' == c && pos + 1 < source.size() && '*' == source[pos + 1]) {
+      std::size_t end = source.find("*/", pos + 2);
+      end = (std::string::npos == end) ? source.size() : end + 1;
+      for (;pos < end;++pos) {
+        if ('\n' == source[pos]) {
+          ++line;
+        }
+      }
+      continue;
+    }
+    if ('"' == c) {
+      std::string ignored;
+      std::size_t start = pos;
+      if (!parseLiteral(source, pos, ignored)) {
+        break;
+      }
+      for (std::size_t i = start;i < pos;++i) {
+        if ('\n' == source[i]) {
+          ++line;
+        }
+      }
+      --pos;
+      continue;
+    }
+    if ('\'' == c) {
+      // Character literal, which may be a quote
+      pos += ('\\' == source[pos + 1]) ? 3 : 2;
+      continue;
+    }
+    if (!std::isalpha((unsigned char)c) && '_' != c) {
+      continue;
+    }
+    std::size_t end = pos;
+    while (end < source.size() && (std::isalnum((unsigned char)source[end]) || '_' == source[end])) {
+      ++end;
+    }
+    std::string identifier = source.substr(pos, end - pos);
+    pos = end - 1;
+    if (std::find(macros.begin(), macros.end(), identifier) == macros.end()) {
+      continue;
+    }
+    std::size_t open = source.find_first_not_of(" \t", end);
+    if (std::string::npos == open || '(' != source[open]) {
+      continue;
+    }
+    std::size_t literalStart = source.find_first_not_of(" \t\r\n", open + 1);
+    std::string format;
+    std::size_t literalEnd = literalStart;
+    if (std::string::npos == literalStart || !parseLiteral(source, literalEnd, format)) {
+      continue;
+    }
+    std::uint32_t id = logFormatId(format.data(), format.size());
+    auto existing = sites.find(id);
+    if (sites.end() != existing && existing->second.format != format) {
+      std::cerr << "Site ID collision: " << name << ":" << line << " and " << existing->second.location << std::endl;
+      ++collisions;
+      continue;
+    }
+    if (sites.end() == existing) {
+      sites.emplace(id, LogSite{name + ":" + std::to_string(line), format});
+    }
+    ++found;
+  }
+  return found;
+}
+
+std::string escape(const std::string& text) {
+  std::string result;
+  for (char c : text) {
+    switch (c) {
+      case '\\': result += "\\\\"; break;
+      case '\t': result += "\\t"; break;
+      case '\n': result += "\\n"; break;
+      default: result.push_back(c); break;
+    }
+  }
+  return result;
+}
+
+std::string unescape(const std::string& text) {
+  std::string result;
+  for (std::size_t i = 0;i < text.size();++i) {
+    if ('\\' != text[i] || i + 1 >= text.size()) {
+      result.push_back(text[i]);
+      continue;
+    }
+    char e = text[++i];
+    result.push_back('t' == e ? '\t' : ('n' == e ? '\n' : e));
+  }
+  return result;
+}
+
+int generateSites(const std::string& output, const std::vector<std::string>& roots) {
+  SiteDictionary sites;
+  std::size_t calls = 0;
+  std::size_t collisions = 0;
+  for (auto& root : roots) {
+    std::filesystem::path base(root);
+    if (!std::filesystem::exists(base)) {
+      std::cerr << "No such source directory: " << root << std::endl;
+      return 1;
+    }
+    for (auto& entry : std::filesystem::recursive_directory_iterator(base)) {
+      auto extension = entry.path().extension();
+      if (!entry.is_regular_file() || (".h" != extension && ".cpp" != extension)) {
+        continue;
+      }
+      calls += scanSource(entry.path(), entry.path().lexically_relative(base.parent_path()).generic_string(),
+        sites, collisions);
+    }
+  }
+  std::ofstream out(output, std::ios::out | std::ios::binary);
+  if (!out) {
+    std::cerr << "Could not open " << output << std::endl;
+    return 1;
+  }
+  char id[9];
+  for (auto& site : sites) {
+    std::snprintf(id, sizeof(id), "%08" PRIx32, site.first);
+    out << id << "\t" << site.second.location << "\t" << escape(site.second.format) << "\n";
+  }
+  std::cerr << "Log call sites: " << calls << ", distinct formats: " << sites.size()
+            << ", collisions: " << collisions << std::endl;
+  return 0 == collisions ? 0 : 1;
+}
+
+bool loadSites(const std::string& file, SiteDictionary& sites) {
+  std::ifstream in(file);
+  if (!in) {
+    return false;
+  }
+  std::string line;
+  std::size_t lineNumber = 0;
+  std::size_t malformed = 0;
+  while (std::getline(in, line)) {
+    ++lineNumber;
+    auto first = line.find('\t');
+    auto second = std::string::npos == first ? first : line.find('\t', first + 1);
+    std::uint32_t id = 0;
+    auto result = std::from_chars(line.data(), line.data() + std::min(first, line.size()), id, 16);
+    if (std::string::npos == second || std::errc() != result.ec || line.data() + first != result.ptr) {
+      // Skipped rather than failing, so the rest of the dictionary is still used
+      if (0 == malformed++) {
+        std::cerr << "Malformed site dictionary line " << file << ":" << lineNumber << std::endl;
+      }
+      continue;
+    }
+    sites[id] = LogSite{line.substr(first + 1, second - first - 1), unescape(line.substr(second + 1))};
+  }
+  if (malformed > 1) {
+    std::cerr << "Skipped " << malformed << " malformed site dictionary lines" << std::endl;
+  }
+  return true;
+}
+
+int decode(const std::string& input, const SiteDictionary& sites) {
+  std::ifstream in(input, std::ios::in | std::ios::binary);
+  if (!in) {
+    std::cerr << "Could not open " << input << std::endl;
+    return 1;
+  }
+  BinaryLogReader reader(in);
+  if (!reader.valid()) {
+    std::cerr << input << " is not a Herald binary log" << std::endl;
+    return 1;
+  }
+  static const char* levels[] = {"debug","info","fault"};
+  BinaryLogRecord record;
+  std::uint64_t messages = 0;
+  std::uint64_t unknown = 0;
+  char time[32];
+  while (reader.next(record)) {
+    ++messages;
+    std::string message;
+    if (record.hasSite) {
+      auto site = sites.find(record.site);
+      if (sites.end() == site) {
+        // Still show the arguments, so the message is not lost entirely
+        ++unknown;
+        char id[9];
+        std::snprintf(id, sizeof(id), "%08" PRIx32, record.site);
+        std::string format = std::string("<unknown site ") + id + ">";
+        for (std::size_t i = 0;i < record.arguments.size();++i) {
+          format += " {}";
+        }
+        message = formatBinaryLogMessage(format, record);
+      } else {
+        message = formatBinaryLogMessage(site->second.format, record);
+      }
+    } else {
+      message = record.text;
+    }
+    std::snprintf(time, sizeof(time), "%" PRIu64 ".%06" PRIu64, record.micros / 1000000, record.micros % 1000000);
+    std::cout << time << "," << record.subsystem << "," << record.category << ","
+              << levels[(int)record.level] << "," << message << "\n";
+  }
+  std::cout.flush();
+  std::cerr << "Messages: " << messages << ", unknown sites: " << unknown << std::endl;
+  if (reader.corrupt()) {
+    std::cerr << "Log is truncated or corrupt after message " << messages << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+void usage(const char* name) {
+  std::cerr << "Usage: " << name << " [--sites <dictionary>] <binary-log>" << std::endl
+            << "       " << name << " --generate-sites <dictionary> <source-dir>..." << std::endl
+            << "  --sites <file>           Site ID dictionary (default herald-log-sites.txt)" << std::endl
+            << "  --generate-sites <file>  Scan source directories and write the dictionary" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  std::string sitesFile = "herald-log-sites.txt";
+  std::string generate;
+  std::vector<std::string> inputs;
+  for (int i = 1;i < argc;++i) {
+    std::string arg(argv[i]);
+    bool hasValue = i + 1 < argc;
+    if ("--sites" == arg && hasValue) {
+      sitesFile = argv[++i];
+    } else if ("--generate-sites" == arg && hasValue) {
+      generate = argv[++i];
+    } else if ('-' != arg[0]) {
+      inputs.push_back(arg);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (!generate.empty()) {
+    if (inputs.empty()) {
+      usage(argv[0]);
+      return 1;
+    }
+    return generateSites(generate, inputs);
+  }
+
+  if (1 != inputs.size()) {
+    usage(argv[0]);
+    return 1;
+  }
+  SiteDictionary sites;
+  if (!loadSites(sitesFile, sites)) {
+    std::cerr << "Could not read site dictionary " << sitesFile << ", messages will be shown as site IDs" << std::endl;
+  }
+  return decode(inputs.front(), sites);
+}
@@ -2,6 +2,8 @@
 //  SPDX-License-Identifier: Apache-2.0
 //
 
+#include <vector>
+
 #include "catch.hpp"
 
 #include "herald/herald.h"
@@ -43,4 +45,27 @@ TEST_CASE("referencearray-single", "[referencearray][ctor][single]") {
     REQUIRE(da.begin() != da.end());
     REQUIRE(da.cbegin() != da.cend());
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("referencearray-iterate", "[referencearray][iterate]") {
+  SECTION("referencearray-iterate") {
+    herald::datatype::ReferenceArray<herald::datatype::Data> da;
+    herald::datatype::Data d1(std::byte(0x01),6);
+    herald::datatype::Data d2(std::byte(0x02),6);
+    herald::datatype::Data d3(std::byte(0x03),6);
+    da.add(d1);
+    da.add(d2);
+    da.add(d3);
+    REQUIRE(3 == da.size());
+    // Each member is visited once, in order
+    std::vector<herald::datatype::Data*> visited;
+    for (auto& member : da) {
+      visited.push_back(&member.value().get());
+    }
+    REQUIRE(visited.size() == 3);
+    REQUIRE(visited[0] == &d1);
+    REQUIRE(visited[1] == &d2);
+    REQUIRE(visited[2] == &d3);
+    REQUIRE(&da[0].value().get() == &d1);
+  }
+}
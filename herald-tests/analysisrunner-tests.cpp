@@ -6,8 +6,10 @@
 
 #include "herald/herald.h"
 
+#include <algorithm>
 #include <utility>
 #include <iostream>
+#include <vector>
 
 using namespace herald::analysis::sampling;
 using namespace herald::datatype;
@@ -344,3 +346,75 @@ TEST_CASE("analysisrunner-nonewdata", "[analysisrunner][nonewdata]") {
 }
 
 
+
+
+/// \brief Records which sampled ID each distance was produced for
+struct PerIDDistanceDelegate {
+  using value_type = Distance;
+
+  PerIDDistanceDelegate() : distances() {};
+  PerIDDistanceDelegate(const PerIDDistanceDelegate&) = delete;
+  PerIDDistanceDelegate(PerIDDistanceDelegate&& other) noexcept : distances(std::move(other.distances)) {}
+  ~PerIDDistanceDelegate() {};
+
+  PerIDDistanceDelegate& operator=(PerIDDistanceDelegate&& other) noexcept {
+    std::swap(distances,other.distances);
+    return *this;
+  }
+
+  void newSample(SampledID sampled, Sample<Distance> sample) {
+    distances.emplace_back(sampled,sample.taken.secondsSinceUnixEpoch());
+  }
+
+  std::size_t count(SampledID sampled) const {
+    return (std::size_t)std::count_if(distances.begin(),distances.end(),
+      [sampled](const std::pair<SampledID,std::uint64_t>& d) { return d.first == sampled; });
+  }
+
+  std::vector<std::pair<SampledID,std::uint64_t>> distances; // sampled ID, time
+};
+
+/// [Who]   As a DCT app developer
+/// [What]  I want a distance for every device in range, not just the first one analysed
+/// [Value] So that exposure to every nearby device is recorded
+TEST_CASE("analysisrunner-multipleids", "[analysisrunner][multipleids]") {
+  SECTION("analysisrunner-multipleids") {
+    herald::analysis::algorithms::distance::FowlerBasicAnalyser distanceAnalyser(30, -50, -24);
+
+    PerIDDistanceDelegate myDelegate;
+    herald::analysis::AnalysisDelegateManager adm(std::move(myDelegate));
+    herald::analysis::AnalysisProviderManager apm(std::move(distanceAnalyser));
+
+    herald::analysis::AnalysisRunner<
+      herald::analysis::AnalysisDelegateManager<PerIDDistanceDelegate>,
+      herald::analysis::AnalysisProviderManager<herald::analysis::algorithms::distance::FowlerBasicAnalyser>,
+      RSSI,Distance
+    > runner(adm, apm);
+
+    // Two devices' samples arriving interleaved, as from a live sensor
+    for (int t = 10;t <= 40;t += 10) {
+      runner.newSample<RSSI>(1111,Sample<RSSI>(t,-55));
+      runner.newSample<RSSI>(2222,Sample<RSSI>(t + 1,-65));
+    }
+    runner.run(Date(45));
+
+    auto& delegateRef = adm.get<PerIDDistanceDelegate>();
+    REQUIRE(delegateRef.distances.size() == 2);
+    REQUIRE(delegateRef.count(1111) == 1);
+    REQUIRE(delegateRef.count(2222) == 1);
+
+    // New data within each ID's interval produces nothing new
+    runner.newSample<RSSI>(1111,Sample<RSSI>(50,-55));
+    runner.newSample<RSSI>(2222,Sample<RSSI>(51,-65));
+    runner.run(Date(55));
+    REQUIRE(delegateRef.distances.size() == 2);
+
+    // Once the interval has passed, both are analysed again
+    runner.newSample<RSSI>(1111,Sample<RSSI>(80,-55));
+    runner.newSample<RSSI>(2222,Sample<RSSI>(81,-65));
+    runner.run(Date(85));
+    REQUIRE(delegateRef.distances.size() == 4);
+    REQUIRE(delegateRef.count(1111) == 2);
+    REQUIRE(delegateRef.count(2222) == 2);
+  }
+}
@@ -0,0 +1,275 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test-templates.h"
+
+#include "catch.hpp"
+
+#include "herald/herald.h"
+
+using namespace herald::data;
+
+using AsyncContext = herald::Context<herald::DefaultPlatformType,AsyncLoggingSink,DummyBluetoothStateManager>;
+
+static std::vector<std::string> lines(const std::string& text) {
+  std::vector<std::string> result;
+  std::istringstream is(text);
+  std::string line;
+  while (std::getline(is, line)) {
+    result.push_back(line);
+  }
+  return result;
+}
+
+/// \brief Stream buffer that blocks the first write until released, to hold up the writer thread
+class GatedStreamBuf : public std::stringbuf {
+public:
+  GatedStreamBuf() : std::stringbuf(), lock(), changed(), entered(false), open(false) {}
+
+  void waitUntilEntered() {
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [this] { return entered; });
+  }
+
+  void release() {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      open = true;
+    }
+    changed.notify_all();
+  }
+
+protected:
+  std::streamsize xsputn(const char* s, std::streamsize n) override {
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      entered = true;
+      changed.notify_all();
+      changed.wait(guard, [this] { return open; });
+    }
+    return std::stringbuf::xsputn(s, n);
+  }
+
+private:
+  std::mutex lock;
+  std::condition_variable changed;
+  bool entered;
+  bool open;
+};
+
+TEST_CASE("asyncloggingsink-format", "[asyncloggingsink][format]") {
+  std::ostringstream os;
+  AsyncLoggingSink sink(os, 64);
+  DummyBluetoothStateManager dbsm;
+  herald::DefaultPlatformType dpt;
+  AsyncContext ctx(dpt,sink,dbsm);
+  herald::data::SensorLogger logger(ctx.getLoggingSink(),"testout","mytest");
+
+  HTDBG("Simple string");
+  HTDBG("There are {} strings","two");
+  HTLOG("There are {} strings",std::string("two"));
+  HTERR("There are two params 1: {} and 2: {} and some more text {} <- but this is blank", 15, 45);
+  HTDBG("Too few {} parameters",15,45);
+  std::int8_t i8 = -39;
+  std::uint8_t ui8 = 39;
+  std::uint64_t ui64 = 3737373737;
+  HTDBG("Intrinsic {} {} {} {} types",i8,ui8,ui64,'c');
+  HTDBG("Floating {} point",2.5);
+  // Streamable types are formatted on the calling thread
+  herald::datatype::Data d(std::byte(0x0f), 2);
+  HTDBG("Data {} streamed",d);
+  HTDBG("Lone { brace {}",1,2);
+  const char* none = nullptr;
+  HTDBG("Null {} pointer",none);
+  sink.flush();
+
+  auto written = lines(os.str());
+  REQUIRE(written.size() == 10);
+  REQUIRE(written[0] == "testout,mytest,debug,Simple string");
+  REQUIRE(written[1] == "testout,mytest,debug,There are two strings");
+  REQUIRE(written[2] == "testout,mytest,info,There are two strings");
+  REQUIRE(written[3] == "testout,mytest,fault,There are two params 1: 15 and 2: 45 and some more text  <- but this is blank");
+  REQUIRE(written[4] == "testout,mytest,debug,Too few 15 parameters");
+  REQUIRE(written[5] == "testout,mytest,debug,Intrinsic -39 39 3737373737 c types");
+  REQUIRE(written[6] == "testout,mytest,debug,Floating 2.5 point");
+  REQUIRE(written[7] == "testout,mytest,debug,Data 0f0f streamed");
+  REQUIRE(written[8] == "testout,mytest,debug,Lone 1 brace 2");
+  REQUIRE(written[9] == "testout,mytest,debug,Null  pointer");
+  REQUIRE(sink.written() == 10);
+  REQUIRE(sink.dropped() == 0);
+}
+
+TEST_CASE("asyncloggingsink-matches-tprintf", "[asyncloggingsink][format]") {
+  // The writer thread must format exactly as SensorLogger does for synchronous sinks
+  std::ostringstream os;
+  AsyncLoggingSink sink(os, 64);
+  DummyLoggingSink dls;
+  DummyBluetoothStateManager dbsm;
+  herald::DefaultPlatformType dpt;
+  AsyncContext actx(dpt,sink,dbsm);
+  herald::Context dctx(dpt,dls,dbsm);
+  herald::data::SensorLogger asyncLogger(actx.getLoggingSink(),"s","c");
+  herald::data::SensorLogger dummyLogger(dctx.getLoggingSink(),"s","c");
+
+  std::vector<std::string> expected;
+  auto both = [&](const std::string& fmt, auto... args) {
+    asyncLogger.info(fmt, args...);
+    dummyLogger.info(fmt, args...);
+    // DummyLoggingSink writes subsystem,category,message and keeps tprintf's trailing std::ends
+    std::string message = dls.value.substr(4);
+    if (!message.empty() && '\0' == message.back()) {
+      message.pop_back();
+    }
+    expected.push_back("s,c,info," + message);
+  };
+  both("{}{}{}", 1, 2, 3);
+  both("{} at start", -1);
+  both("at end {}", 7u);
+  both("}{ odd {", 1, 2);
+  both("{}", std::string(300, 'x')); // truncated by the async sink, checked below
+  sink.flush();
+
+  auto written = lines(os.str());
+  REQUIRE(written.size() == expected.size());
+  for (std::size_t i = 0;i < expected.size() - 1;++i) {
+    REQUIRE(written[i] == expected[i]);
+  }
+  // Subsystem, category and format take 4 bytes of the text area
+  REQUIRE(written.back() == "s,c,info," + std::string(AsyncLogRecord::TextSize - 4, 'x'));
+}
+
+TEST_CASE("asyncloggingsink-drops-when-full", "[asyncloggingsink][drop]") {
+  GatedStreamBuf buf;
+  std::ostream os(&buf);
+  AsyncLoggingSink sink(os, 8);
+  REQUIRE(sink.capacity() == 8);
+
+  sink.log("s","c",SensorLoggerLevel::info,"first",1);
+  // The writer has taken the first record and is stuck writing it, so the ring buffer is empty
+  buf.waitUntilEntered();
+  for (int i = 0;i < 11;++i) {
+    sink.log("s","c",SensorLoggerLevel::info,"next {}",i);
+  }
+  REQUIRE(sink.dropped() == 3);
+
+  buf.release();
+  sink.flush();
+  REQUIRE(sink.written() == 9);
+  auto written = lines(buf.str());
+  REQUIRE(written.size() == 9);
+  REQUIRE(written[0] == "s,c,info,first");
+  REQUIRE(written[8] == "s,c,info,next 7");
+}
+
+TEST_CASE("asyncloggingsink-flush-on-destruction", "[asyncloggingsink][shutdown]") {
+  std::ostringstream os;
+  {
+    AsyncLoggingSink sink(os, 1024);
+    for (int i = 0;i < 1000;++i) {
+      sink.log("s","c",SensorLoggerLevel::debug,"line {}",i);
+    }
+  }
+  auto written = lines(os.str());
+  REQUIRE(written.size() == 1000);
+  REQUIRE(written.back() == "s,c,debug,line 999");
+}
+
+TEST_CASE("asyncloggingsink-multiple-producers", "[asyncloggingsink][threads]") {
+  std::ostringstream os;
+  AsyncLoggingSink sink(os, 16384);
+  const int threads = 4;
+  const int perThread = 2000;
+  std::vector<std::thread> producers;
+  for (int t = 0;t < threads;++t) {
+    producers.emplace_back([&sink, t] {
+      for (int i = 0;i < perThread;++i) {
+        sink.log("s","c",SensorLoggerLevel::debug,"{} {}",t,i);
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  sink.flush();
+  REQUIRE(sink.dropped() == 0);
+  REQUIRE(sink.written() == threads * perThread);
+  REQUIRE(sink.batches() <= sink.written());
+
+  // Each producer's records are written in the order it logged them
+  std::vector<int> nextExpected(threads, 0);
+  for (auto& line : lines(os.str())) {
+    std::istringstream is(line.substr(std::string("s,c,debug,").size()));
+    int t, i;
+    is >> t >> i;
+    REQUIRE(i == nextExpected[t]);
+    ++nextExpected[t];
+  }
+  for (int t = 0;t < threads;++t) {
+    REQUIRE(nextExpected[t] == perThread);
+  }
+}
+
+/// \brief As StdOutLoggingSink, but to any stream, so the benchmark does not flood the console
+struct SyncStreamLoggingSink {
+  SyncStreamLoggingSink(std::ostream& out) : out(out) {}
+
+  void log(const std::string& subsystem, const std::string& category, SensorLoggerLevel level, std::string message) {
+    out << subsystem << "," << category << "," << (int)level << "," << message << std::endl;
+  }
+
+  std::ostream& out;
+};
+
+template <typename SinkT>
+static double callerMicrosPerLog(SinkT& sink, int count) {
+  DummyBluetoothStateManager dbsm;
+  herald::DefaultPlatformType dpt;
+  herald::Context<herald::DefaultPlatformType,SinkT,DummyBluetoothStateManager> ctx(dpt,sink,dbsm);
+  herald::data::SensorLogger logger(ctx.getLoggingSink(),"Sensor","BLE.ConcreteBLEDatabase");
+  std::string mac("4c:1f:73:28:91:aa");
+  auto started = std::chrono::steady_clock::now();
+  for (int i = 0;i < count;++i) {
+    HTDBG("New address FROM DATABASE: {} with rssi {} at {}", mac, -60 - (i % 30), i);
+  }
+  return std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now() - started).count() / count;
+}
+
+TEST_CASE("asyncloggingsink-benchmark", "[.][benchmark][asyncloggingsink]") {
+  const int count = 100000;
+  std::ofstream devnull("/dev/null");
+  SyncStreamLoggingSink sync(devnull);
+  double syncMicros = callerMicrosPerLog(sync, count);
+
+  double asyncMicros;
+  std::uint64_t dropped, batches;
+  auto started = std::chrono::steady_clock::now();
+  {
+    AsyncLoggingSink async(devnull, 1 << 17);
+    asyncMicros = callerMicrosPerLog(async, count);
+    async.flush();
+    dropped = async.dropped();
+    batches = async.batches();
+  }
+  double asyncTotalMicros = std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now() - started).count() / count;
+
+  std::cout << "Logging " << count << " debug messages to /dev/null" << std::endl;
+  std::cout << std::fixed << std::setprecision(3)
+            << "synchronous:  " << syncMicros << " us per call on the caller" << std::endl
+            << "asynchronous: " << asyncMicros << " us per call on the caller, "
+            << asyncTotalMicros << " us per message until written, "
+            << batches << " batches, " << dropped << " dropped" << std::endl;
+}
@@ -0,0 +1,172 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "test-templates.h"
+
+#include "catch.hpp"
+
+#include "herald/herald.h"
+
+using namespace herald::data;
+
+using BinaryContext = herald::Context<herald::DefaultPlatformType,BinaryLoggingSink,DummyBluetoothStateManager>;
+
+/// \brief Decodes a binary log to StdOutLoggingSink style lines, given the formats used
+static std::vector<std::string> decode(const std::string& log, const std::map<std::uint32_t,std::string>& formats) {
+  std::istringstream in(log);
+  BinaryLogReader reader(in);
+  REQUIRE(reader.valid());
+  std::vector<std::string> lines;
+  BinaryLogRecord record;
+  static const char* levels[] = {"debug","info","fault"};
+  while (reader.next(record)) {
+    std::string message = record.text;
+    if (record.hasSite) {
+      REQUIRE(formats.count(record.site) == 1);
+      message = formatBinaryLogMessage(formats.at(record.site), record);
+    }
+    lines.push_back(record.subsystem + "," + record.category + "," + levels[(int)record.level] + "," + message);
+  }
+  REQUIRE(!reader.corrupt());
+  return lines;
+}
+
+#define FORMAT(_msg) formats[HLOGFORMAT(_msg).id] = _msg
+
+TEST_CASE("binaryloggingsink-roundtrip", "[binaryloggingsink][roundtrip]") {
+  std::ostringstream os(std::ios::out | std::ios::binary);
+  std::map<std::uint32_t,std::string> formats;
+  {
+    BinaryLoggingSink sink(os);
+    DummyBluetoothStateManager dbsm;
+    herald::DefaultPlatformType dpt;
+    BinaryContext ctx(dpt,sink,dbsm);
+    herald::data::SensorLogger logger(ctx.getLoggingSink(),"testout","mytest");
+    herald::data::SensorLogger other(ctx.getLoggingSink(),"testout","other");
+
+    HTDBG("Simple string");
+    FORMAT("Simple string");
+    HTLOG("There are {} strings","two");
+    FORMAT("There are {} strings");
+    HTERR("Params {} and {} and blank {} here", -15, 45u);
+    FORMAT("Params {} and {} and blank {} here");
+    std::int8_t i8 = -39;
+    std::uint64_t ui64 = 3737373737373737ULL;
+    HTDBG("Types {} {} {} {} {} {}", i8, ui64, 'c', 2.5, true, std::string("str"));
+    FORMAT("Types {} {} {} {} {} {}");
+    herald::datatype::Data d(std::byte(0x0f), 2);
+    HTDBG("Streamed {}", d);
+    FORMAT("Streamed {}");
+    other.info(std::string("Runtime {} format"), 7);
+  }
+  REQUIRE(os.str().substr(0, 4) == "HLOG");
+
+  auto lines = decode(os.str(), formats);
+  REQUIRE(lines.size() == 6);
+  REQUIRE(lines[0] == "testout,mytest,debug,Simple string");
+  REQUIRE(lines[1] == "testout,mytest,info,There are two strings");
+  REQUIRE(lines[2] == "testout,mytest,fault,Params -15 and 45 and blank  here");
+  REQUIRE(lines[3] == "testout,mytest,debug,Types -39 3737373737373737 c 2.5 1 str");
+  REQUIRE(lines[4] == "testout,mytest,debug,Streamed 0f0f");
+  REQUIRE(lines[5] == "testout,other,info,Runtime 7 format");
+}
+
+TEST_CASE("binaryloggingsink-logger-once", "[binaryloggingsink][size]") {
+  std::ostringstream os(std::ios::out | std::ios::binary);
+  BinaryLoggingSink sink(os);
+  const std::size_t header = sink.bytes();
+  sink.log("subsystem","category",SensorLoggerLevel::debug,HLOGFORMAT("Value {}"),1);
+  const std::size_t first = sink.bytes() - header;
+  sink.log("subsystem","category",SensorLoggerLevel::debug,HLOGFORMAT("Value {}"),2);
+  const std::size_t second = sink.bytes() - header - first;
+  // Later messages refer to the subsystem and category by ID: type, time delta, site ID,
+  // logger ID, level, count and the argument (type and value)
+  REQUIRE(second < first);
+  REQUIRE(second <= 1 + 3 + 4 + 1 + 1 + 1 + 2);
+  REQUIRE(sink.records() == 2);
+  // As cached by SensorLogger. Registering again writes nothing.
+  const std::size_t before = sink.bytes();
+  REQUIRE(sink.loggerId("subsystem","category") == 0);
+  REQUIRE(sink.loggerId("other","category") == 1);
+  const std::size_t registered = sink.bytes();
+  REQUIRE(registered > before);
+  REQUIRE(sink.loggerId("other","category") == 1);
+  REQUIRE(sink.bytes() == registered);
+}
+
+TEST_CASE("binaryloggingsink-truncated", "[binaryloggingsink][corrupt]") {
+  std::ostringstream os(std::ios::out | std::ios::binary);
+  {
+    BinaryLoggingSink sink(os);
+    for (int i = 0;i < 10;++i) {
+      sink.log("s","c",SensorLoggerLevel::info,HLOGFORMAT("Message {} of {}"),i,std::string("ten"));
+    }
+  }
+  std::string log = os.str();
+  std::istringstream in(log.substr(0, log.size() - 3));
+  BinaryLogReader reader(in);
+  BinaryLogRecord record;
+  int read = 0;
+  while (reader.next(record)) {
+    ++read;
+  }
+  REQUIRE(read == 9);
+  REQUIRE(reader.corrupt());
+
+  std::istringstream notLog("Not a log");
+  BinaryLogReader invalid(notLog);
+  REQUIRE(!invalid.valid());
+  REQUIRE(!invalid.next(record));
+}
+
+/// \brief As StdOutLoggingSink, but to any stream
+struct TextStreamLoggingSink {
+  TextStreamLoggingSink(std::ostream& out) : out(out) {}
+
+  void log(const std::string& subsystem, const std::string& category, SensorLoggerLevel level, std::string message) {
+    out << subsystem << "," << category << "," << (int)level << "," << message << std::endl;
+  }
+
+  std::ostream& out;
+};
+
+template <typename SinkT>
+static double nanosPerLog(SinkT& sink, int count) {
+  DummyBluetoothStateManager dbsm;
+  herald::DefaultPlatformType dpt;
+  herald::Context<herald::DefaultPlatformType,SinkT,DummyBluetoothStateManager> ctx(dpt,sink,dbsm);
+  herald::data::SensorLogger logger(ctx.getLoggingSink(),"Sensor","BLE.ConcreteBLEDatabase");
+  std::string mac("4c1f732891aa");
+  auto started = std::chrono::steady_clock::now();
+  for (int i = 0;i < count;++i) {
+    HTDBG("New address FROM DATABASE: {} with rssi {} at {}", mac, -60 - (i % 30), i);
+  }
+  return std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now() - started).count() / count;
+}
+
+TEST_CASE("binaryloggingsink-benchmark", "[.][benchmark][binaryloggingsink]") {
+  const int count = 1000000;
+  std::ostringstream text;
+  TextStreamLoggingSink textSink(text);
+  double textNanos = nanosPerLog(textSink, count);
+
+  std::ostringstream binary(std::ios::out | std::ios::binary);
+  BinaryLoggingSink binarySink(binary);
+  double binaryNanos = nanosPerLog(binarySink, count);
+  binarySink.flush();
+
+  std::cout << "Logging " << count << " debug messages to memory" << std::endl
+            << std::fixed << std::setprecision(1)
+            << "text:   " << textNanos << " ns per call, " << ((double)text.str().size() / count) << " bytes per message" << std::endl
+            << "binary: " << binaryNanos << " ns per call, " << ((double)binary.str().size() / count) << " bytes per message" << std::endl;
+}
@@ -0,0 +1,226 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "herald/herald.h"
+
+using namespace herald::ble;
+using namespace herald::datatype;
+
+static const TargetIdentifier schedulerTargets[] = {
+  TargetIdentifier(Data(std::byte(0),6)),
+  TargetIdentifier(Data(std::byte(1),6)),
+  TargetIdentifier(Data(std::byte(2),6)),
+  TargetIdentifier(Data(std::byte(3),6))
+};
+
+const TargetIdentifier& schedulerTarget(std::uint8_t id) {
+  return schedulerTargets[id];
+}
+
+TEST_CASE("bleconnectionscheduler-score", "[ble][connectionscheduler][score]") {
+  BLEConnectionScheduler scheduler;
+  scheduler.begin(Date(1000));
+  double weak = scheduler.score(BLEConnectionCandidate{schedulerTarget(1),-95,false});
+  double strong = scheduler.score(BLEConnectionCandidate{schedulerTarget(1),-50,false});
+  double strongKnown = scheduler.score(BLEConnectionCandidate{schedulerTarget(1),-50,true});
+  double unknownRSSI = scheduler.score(BLEConnectionCandidate{schedulerTarget(1),0,false});
+  REQUIRE(strong > weak);
+  REQUIRE(strongKnown > strong);
+  REQUIRE(unknownRSSI == 0.0);
+
+  // iOS devices, only readable by connecting, are favoured
+  double strongIOS = scheduler.score(BLEConnectionCandidate{schedulerTarget(1),-50,false,BLEDeviceOperatingSystem::ios});
+  double strongIOSTBC = scheduler.score(BLEConnectionCandidate{schedulerTarget(1),-50,false,BLEDeviceOperatingSystem::ios_tbc});
+  double strongAndroid = scheduler.score(BLEConnectionCandidate{schedulerTarget(1),-50,false,BLEDeviceOperatingSystem::android});
+  REQUIRE(strongIOS > strong);
+  REQUIRE(strongIOSTBC == strongIOS);
+  REQUIRE(strongAndroid == strong);
+
+  // Waiting longer raises the score
+  scheduler.add(BLEConnectionCandidate{schedulerTarget(1),-95,false});
+  scheduler.choose(1);
+  scheduler.begin(Date(1060));
+  REQUIRE(scheduler.score(BLEConnectionCandidate{schedulerTarget(1),-95,false}) > weak);
+
+  // Failures lower it
+  scheduler.connectionResult(schedulerTarget(2),false,Date(1060));
+  REQUIRE(scheduler.score(BLEConnectionCandidate{schedulerTarget(2),-50,false}) < strong);
+}
+
+TEST_CASE("bleconnectionscheduler-choose", "[ble][connectionscheduler][choose]") {
+  BLEConnectionScheduler scheduler;
+
+  SECTION("bleconnectionscheduler-choose-bounded-ordered") {
+    scheduler.begin(Date(1000));
+    scheduler.add(BLEConnectionCandidate{schedulerTarget(1),-90,false});
+    scheduler.add(BLEConnectionCandidate{schedulerTarget(2),-50,false});
+    scheduler.add(BLEConnectionCandidate{schedulerTarget(3),-70,false});
+    auto& chosen = scheduler.choose(2);
+    REQUIRE(chosen.size() == 2);
+    REQUIRE(chosen[0].get() == schedulerTarget(2));
+    REQUIRE(chosen[1].get() == schedulerTarget(3));
+  }
+
+  SECTION("bleconnectionscheduler-choose-backoff") {
+    scheduler.begin(Date(1000));
+    scheduler.add(BLEConnectionCandidate{schedulerTarget(1),-50,true});
+    scheduler.add(BLEConnectionCandidate{schedulerTarget(2),-90,false});
+    REQUIRE(scheduler.choose(1)[0].get() == schedulerTarget(1));
+    scheduler.connectionResult(schedulerTarget(1),false,Date(1000)); // backs off 4 seconds
+    REQUIRE(scheduler.backingOff(schedulerTarget(1),Date(1003)));
+    REQUIRE(!scheduler.backingOff(schedulerTarget(1),Date(1004)));
+
+    scheduler.begin(Date(1001));
+    scheduler.add(BLEConnectionCandidate{schedulerTarget(1),-50,true});
+    scheduler.add(BLEConnectionCandidate{schedulerTarget(2),-90,false});
+    REQUIRE(scheduler.choose(1)[0].get() == schedulerTarget(2));
+
+    // Second failure doubles the backoff
+    scheduler.connectionResult(schedulerTarget(1),false,Date(1004));
+    REQUIRE(scheduler.backingOff(schedulerTarget(1),Date(1011)));
+    REQUIRE(!scheduler.backingOff(schedulerTarget(1),Date(1012)));
+
+    // Success clears it
+    scheduler.connectionResult(schedulerTarget(1),true,Date(1005));
+    REQUIRE(!scheduler.backingOff(schedulerTarget(1),Date(1005)));
+  }
+
+  SECTION("bleconnectionscheduler-choose-forgets") {
+    scheduler.begin(Date(1000));
+    scheduler.add(BLEConnectionCandidate{schedulerTarget(1),-50,true});
+    scheduler.add(BLEConnectionCandidate{schedulerTarget(2),-50,true});
+    scheduler.choose(2);
+    REQUIRE(scheduler.tracked() == 2);
+    scheduler.connectionResult(schedulerTarget(2),false,Date(1000));
+    // Neither wants a connection any more, but 2 is still backing off
+    scheduler.begin(Date(1001));
+    scheduler.choose(2);
+    REQUIRE(scheduler.tracked() == 1);
+    scheduler.begin(Date(1010));
+    scheduler.choose(2);
+    REQUIRE(scheduler.tracked() == 0);
+  }
+}
+
+/// \brief A crowd of simulated devices, each needing service discovery then a payload read
+struct SimulatedCrowd {
+  struct Member {
+    TargetIdentifier target;
+    int rssi;
+    double connectProbability;
+    bool serviceKnown;
+    bool hasPayload;
+  };
+
+  SimulatedCrowd(std::size_t size, std::uint32_t seed) : members(), rng(seed) {
+    std::uniform_int_distribution<int> rssi(-98,-45);
+    std::uniform_real_distribution<double> unit(0.0,1.0);
+    for (std::size_t i = 0;i < size;++i) {
+      Data mac(std::byte(0),6);
+      mac.append(std::uint32_t(i + 1));
+      int r = rssi(rng);
+      // One in five never accept connections (e.g. out of range, or background restricted)
+      double p = unit(rng) < 0.2 ? 0.0 : std::max(0.05, std::min(0.95, (r + 100) / 50.0));
+      members.push_back(Member{TargetIdentifier(mac),r,p,false,false});
+    }
+  }
+
+  /// \brief Attempts a connection, returning simulated seconds spent
+  double attempt(Member& m, bool& success) {
+    std::uniform_real_distribution<double> unit(0.0,1.0);
+    success = unit(rng) < m.connectProbability;
+    if (!success) {
+      return 2.0; // connection timeout
+    }
+    if (!m.serviceKnown) {
+      m.serviceKnown = true;
+      return 1.0; // service discovery
+    }
+    m.hasPayload = true;
+    return 0.5; // payload read
+  }
+
+  std::size_t payloads() const {
+    std::size_t count = 0;
+    for (auto& m : members) {
+      count += m.hasPayload ? 1 : 0;
+    }
+    return count;
+  }
+
+  std::vector<Member> members;
+  std::mt19937 rng;
+};
+
+/// \brief Distinct payloads read after 60 and 300 simulated seconds
+template <typename IterationFn>
+std::pair<std::size_t,std::size_t> simulateCoverage(SimulatedCrowd& crowd, IterationFn iteration) {
+  double clock = 0;
+  std::size_t at60 = 0;
+  while (clock < 300) {
+    double spent = std::max(1.0, iteration(clock)); // coordinator iterates at most once a second
+    if (clock < 60 && clock + spent >= 60) {
+      at60 = crowd.payloads();
+    }
+    clock += spent;
+  }
+  return {at60,crowd.payloads()};
+}
+
+TEST_CASE("bleconnectionscheduler-coverage-benchmark", "[.][benchmark][ble][connectionscheduler]") {
+  std::cout << "crowd, fifo payloads@60s, scheduled payloads@60s, fifo payloads@300s, scheduled payloads@300s" << std::endl;
+  for (std::size_t size : {10, 25, 50, 100, 200}) {
+    // Previous behaviour: every device wanting a connection is attempted, in database order, each iteration
+    std::pair<std::size_t,std::size_t> fifo;
+    {
+      SimulatedCrowd fifoCrowd(size,42); // Scoped, as crowd identifiers share the Data memory arena
+      fifo = simulateCoverage(fifoCrowd,[&fifoCrowd](double) {
+        double spent = 0;
+        bool success;
+        for (auto& m : fifoCrowd.members) {
+          if (!m.hasPayload) {
+            spent += fifoCrowd.attempt(m,success);
+          }
+        }
+        return spent;
+      });
+    }
+
+    SimulatedCrowd scheduledCrowd(size,42);
+    BLEConnectionScheduler scheduler;
+    auto scheduled = simulateCoverage(scheduledCrowd,[&scheduledCrowd,&scheduler](double clock) {
+      Date now(1000 + (std::uint64_t)clock);
+      scheduler.begin(now);
+      for (auto& m : scheduledCrowd.members) {
+        if (!m.hasPayload) {
+          scheduler.add(BLEConnectionCandidate{m.target,m.rssi,m.serviceKnown});
+        }
+      }
+      double spent = 0;
+      bool success;
+      for (auto& target : scheduler.choose(BLESensorConfiguration().maxConnectionsPerIteration)) {
+        for (auto& m : scheduledCrowd.members) {
+          if (&m.target == &target.get()) {
+            spent += scheduledCrowd.attempt(m,success);
+            scheduler.connectionResult(target.get(),success,now);
+            break;
+          }
+        }
+      }
+      return spent;
+    });
+
+    std::cout << size << ", " << fifo.first << ", " << scheduled.first << ", "
+              << fifo.second << ", " << scheduled.second << std::endl;
+    REQUIRE(scheduled.first >= fifo.first);
+  }
+}
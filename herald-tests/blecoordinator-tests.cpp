@@ -95,18 +95,22 @@ TEST_CASE("blecoordinator-ctor", "[coordinator][ctor][basic]") {
     herald::ble::ConcreteBLEDatabase<CT> db(ctx);
     NoOpHeraldV1ProtocolProvider pp(ctx,db);
     herald::ble::HeraldProtocolBLECoordinationProvider coord(ctx,db,pp);
+    herald::engine::FeatureRegistry features;
+    features.intern(herald::engine::Features::HeraldBluetoothProtocolConnection);
+    coord.featuresRegistered(features);
 
     std::vector<herald::engine::FeatureTag> provided = coord.connectionsProvided();
     REQUIRE(provided.size() == 1); // Herald BLE protocol
     auto prot = provided.front();
     REQUIRE(prot == herald::engine::Features::HeraldBluetoothProtocolConnection);
 
-    std::vector<std::tuple<herald::engine::FeatureTag,herald::engine::Priority,
-      std::optional<herald::datatype::TargetIdentifier>>> conns = 
-      coord.requiredConnections();
+    std::vector<std::tuple<herald::engine::FeatureId,herald::engine::Priority,
+      std::optional<herald::datatype::TargetIdentifier>>> conns;
+    coord.requiredConnections(conns);
     REQUIRE(conns.size() == 0);
 
-    std::vector<herald::engine::Activity> acts = coord.requiredActivities();
+    std::vector<herald::engine::Activity> acts;
+    coord.requiredActivities(acts);
     REQUIRE(acts.size() == 0);
   }
 }
@@ -122,22 +126,26 @@ TEST_CASE("blecoordinator-unseen-device", "[coordinator][unseen-device][basic]")
     herald::ble::ConcreteBLEDatabase<CT> db(ctx);
     NoOpHeraldV1ProtocolProvider pp(ctx,db);
     herald::ble::HeraldProtocolBLECoordinationProvider coord(ctx,db,pp);
+    herald::engine::FeatureRegistry features;
+    features.intern(herald::engine::Features::HeraldBluetoothProtocolConnection);
+    coord.featuresRegistered(features);
 
     herald::datatype::Data devMac1(std::byte(0x1d),6);
     herald::datatype::TargetIdentifier device1(devMac1);
     herald::ble::BLEDevice& devPtr1 = db.device(device1);
 
-    std::vector<std::tuple<herald::engine::FeatureTag,herald::engine::Priority,
-      std::optional<herald::datatype::TargetIdentifier>>> conns = 
-      coord.requiredConnections();
+    std::vector<std::tuple<herald::engine::FeatureId,herald::engine::Priority,
+      std::optional<herald::datatype::TargetIdentifier>>> conns;
+    coord.requiredConnections(conns);
     REQUIRE(conns.size() == 1);
     auto firstConn = conns.front();
-    REQUIRE(std::get<0>(firstConn) == herald::engine::Features::HeraldBluetoothProtocolConnection);
+    REQUIRE(std::get<0>(firstConn) == features.find(herald::engine::Features::HeraldBluetoothProtocolConnection));
     REQUIRE(std::get<1>(firstConn) > 0);
     REQUIRE(std::get<2>(firstConn).has_value());
     REQUIRE(std::get<2>(firstConn).value() == device1);
 
-    std::vector<herald::engine::Activity> acts = coord.requiredActivities();
+    std::vector<herald::engine::Activity> acts;
+    coord.requiredActivities(acts);
     REQUIRE(acts.size() == 1); // determine if herald only (read payload is at a later state)
     auto firstAct = acts.front();
     REQUIRE(firstAct.prerequisites.size() == 1);
@@ -155,6 +163,9 @@ TEST_CASE("blecoordinator-android-no-id", "[coordinator][android-no-id][basic]")
     herald::ble::ConcreteBLEDatabase<CT> db(ctx);
     NoOpHeraldV1ProtocolProvider pp(ctx,db);
     herald::ble::HeraldProtocolBLECoordinationProvider coord(ctx,db,pp);
+    herald::engine::FeatureRegistry features;
+    features.intern(herald::engine::Features::HeraldBluetoothProtocolConnection);
+    coord.featuresRegistered(features);
 
     herald::datatype::Data devMac1(std::byte(0x1d),6);
     herald::datatype::TargetIdentifier device1(devMac1);
@@ -166,17 +177,18 @@ TEST_CASE("blecoordinator-android-no-id", "[coordinator][android-no-id][basic]")
     devPtr1.services(heraldServiceList);
     devPtr1.operatingSystem(herald::ble::BLEDeviceOperatingSystem::android);
 
-    std::vector<std::tuple<herald::engine::FeatureTag,herald::engine::Priority,
-      std::optional<herald::datatype::TargetIdentifier>>> conns = 
-      coord.requiredConnections();
+    std::vector<std::tuple<herald::engine::FeatureId,herald::engine::Priority,
+      std::optional<herald::datatype::TargetIdentifier>>> conns;
+    coord.requiredConnections(conns);
     REQUIRE(conns.size() == 1);
     auto firstConn = conns.front();
-    REQUIRE(std::get<0>(firstConn) == herald::engine::Features::HeraldBluetoothProtocolConnection);
+    REQUIRE(std::get<0>(firstConn) == features.find(herald::engine::Features::HeraldBluetoothProtocolConnection));
     REQUIRE(std::get<1>(firstConn) > 0);
     REQUIRE(std::get<2>(firstConn).has_value());
     REQUIRE(std::get<2>(firstConn).value() == device1);
 
-    std::vector<herald::engine::Activity> acts = coord.requiredActivities();
+    std::vector<herald::engine::Activity> acts;
+    coord.requiredActivities(acts);
     REQUIRE(acts.size() == 1); // just read payload (ID)
     auto firstAct = acts.front();
     REQUIRE(firstAct.prerequisites.size() == 1);
@@ -193,6 +205,9 @@ TEST_CASE("blecoordinator-two-mixed-no-id", "[coordinator][two-mixed-no-id][basi
     herald::ble::ConcreteBLEDatabase<CT> db(ctx);
     NoOpHeraldV1ProtocolProvider pp(ctx,db);
     herald::ble::HeraldProtocolBLECoordinationProvider coord(ctx,db,pp);
+    herald::engine::FeatureRegistry features;
+    features.intern(herald::engine::Features::HeraldBluetoothProtocolConnection);
+    coord.featuresRegistered(features);
 
     herald::datatype::Data devMac1(std::byte(0x1d),6);
     herald::datatype::TargetIdentifier device1(devMac1);
@@ -210,17 +225,18 @@ TEST_CASE("blecoordinator-two-mixed-no-id", "[coordinator][two-mixed-no-id][basi
     devPtr2.services(heraldServiceList);
     devPtr2.operatingSystem(herald::ble::BLEDeviceOperatingSystem::ios);
 
-    std::vector<std::tuple<herald::engine::FeatureTag,herald::engine::Priority,
-      std::optional<herald::datatype::TargetIdentifier>>> conns = 
-      coord.requiredConnections();
+    std::vector<std::tuple<herald::engine::FeatureId,herald::engine::Priority,
+      std::optional<herald::datatype::TargetIdentifier>>> conns;
+    coord.requiredConnections(conns);
     REQUIRE(conns.size() == 2); // connections to BOTH devices
     auto firstConn = conns.front();
-    REQUIRE(std::get<0>(firstConn) == herald::engine::Features::HeraldBluetoothProtocolConnection);
+    REQUIRE(std::get<0>(firstConn) == features.find(herald::engine::Features::HeraldBluetoothProtocolConnection));
     REQUIRE(std::get<1>(firstConn) > 0);
     REQUIRE(std::get<2>(firstConn).has_value());
     REQUIRE((std::get<2>(firstConn).value() == device1) | (std::get<2>(firstConn).value() == device2)); // both introduced at same time point
 
-    std::vector<herald::engine::Activity> acts = coord.requiredActivities();
+    std::vector<herald::engine::Activity> acts;
+    coord.requiredActivities(acts);
     REQUIRE(acts.size() == 2); // just read payload (ID) for BOTH devices
     auto firstAct = acts.front();
     REQUIRE(firstAct.prerequisites.size() == 1);
@@ -237,6 +253,9 @@ TEST_CASE("blecoordinator-got-os-and-id", "[coordinator][got-os-and-id][basic]")
     herald::ble::ConcreteBLEDatabase<CT> db(ctx);
     NoOpHeraldV1ProtocolProvider pp(ctx,db);
     herald::ble::HeraldProtocolBLECoordinationProvider coord(ctx,db,pp);
+    herald::engine::FeatureRegistry features;
+    features.intern(herald::engine::Features::HeraldBluetoothProtocolConnection);
+    coord.featuresRegistered(features);
 
     herald::datatype::Data devMac1(std::byte(0x1d),6);
     herald::datatype::TargetIdentifier device1(devMac1);
@@ -249,12 +268,13 @@ TEST_CASE("blecoordinator-got-os-and-id", "[coordinator][got-os-and-id][basic]")
     devPtr1.operatingSystem(herald::ble::BLEDeviceOperatingSystem::android);
     devPtr1.payloadData(herald::datatype::PayloadData(std::byte(5),32));
 
-    std::vector<std::tuple<herald::engine::FeatureTag,herald::engine::Priority,
-      std::optional<herald::datatype::TargetIdentifier>>> conns = 
-      coord.requiredConnections();
+    std::vector<std::tuple<herald::engine::FeatureId,herald::engine::Priority,
+      std::optional<herald::datatype::TargetIdentifier>>> conns;
+    coord.requiredConnections(conns);
     REQUIRE(conns.size() == 0);
 
-    std::vector<herald::engine::Activity> acts = coord.requiredActivities();
+    std::vector<herald::engine::Activity> acts;
+    coord.requiredActivities(acts);
     REQUIRE(acts.size() == 0);
   }
 }
@@ -269,6 +289,9 @@ TEST_CASE("blecoordinator-got-two-at-different-states", "[coordinator][got-two-a
     herald::ble::ConcreteBLEDatabase<CT> db(ctx);
     NoOpHeraldV1ProtocolProvider pp(ctx,db);
     herald::ble::HeraldProtocolBLECoordinationProvider coord(ctx,db,pp);
+    herald::engine::FeatureRegistry features;
+    features.intern(herald::engine::Features::HeraldBluetoothProtocolConnection);
+    coord.featuresRegistered(features);
 
     herald::datatype::Data devMac1(std::byte(0x1d),6);
     herald::datatype::TargetIdentifier device1(devMac1);
@@ -285,17 +308,18 @@ TEST_CASE("blecoordinator-got-two-at-different-states", "[coordinator][got-two-a
     devPtr1.payloadData(herald::datatype::PayloadData(std::byte(5),32));
     devPtr2.services(heraldServiceList);
 
-    std::vector<std::tuple<herald::engine::FeatureTag,herald::engine::Priority,
-      std::optional<herald::datatype::TargetIdentifier>>> conns = 
-      coord.requiredConnections();
+    std::vector<std::tuple<herald::engine::FeatureId,herald::engine::Priority,
+      std::optional<herald::datatype::TargetIdentifier>>> conns;
+    coord.requiredConnections(conns);
     REQUIRE(conns.size() == 1); // just for ONE device
     auto firstConn = conns.front();
-    REQUIRE(std::get<0>(firstConn) == herald::engine::Features::HeraldBluetoothProtocolConnection);
+    REQUIRE(std::get<0>(firstConn) == features.find(herald::engine::Features::HeraldBluetoothProtocolConnection));
     REQUIRE(std::get<1>(firstConn) > 0);
     REQUIRE(std::get<2>(firstConn).has_value());
     REQUIRE(std::get<2>(firstConn).value() == device2); // device 2 only
 
-    std::vector<herald::engine::Activity> acts = coord.requiredActivities();
+    std::vector<herald::engine::Activity> acts;
+    coord.requiredActivities(acts);
     REQUIRE(acts.size() == 1); // just read payload (ID) for ONE device
     auto firstAct = acts.front();
     REQUIRE(firstAct.prerequisites.size() == 1);
@@ -347,6 +371,9 @@ TEST_CASE("blecoordinator-got-three-at-different-states", "[coordinator][got-thr
     herald::ble::ConcreteBLEDatabase<CT> db(ctx);
     NoOpHeraldV1ProtocolProvider pp(ctx,db);
     herald::ble::HeraldProtocolBLECoordinationProvider coord(ctx,db,pp);
+    herald::engine::FeatureRegistry features;
+    features.intern(herald::engine::Features::HeraldBluetoothProtocolConnection);
+    coord.featuresRegistered(features);
 
     herald::datatype::Data devMac1(std::byte(0x1d),6);
     herald::datatype::TargetIdentifier device1(devMac1);
@@ -374,12 +401,12 @@ TEST_CASE("blecoordinator-got-three-at-different-states", "[coordinator][got-thr
     // devPtr3.immediateSendData(herald::datatype::ImmediateSendData(
     //   herald::datatype::Data(std::byte(0x01),2)));
 
-    std::vector<std::tuple<herald::engine::FeatureTag,herald::engine::Priority,
-      std::optional<herald::datatype::TargetIdentifier>>> conns = 
-      coord.requiredConnections();
+    std::vector<std::tuple<herald::engine::FeatureId,herald::engine::Priority,
+      std::optional<herald::datatype::TargetIdentifier>>> conns;
+    coord.requiredConnections(conns);
     REQUIRE(conns.size() == 1); // 2 with immediateSend enabled
     auto firstConn = conns.front();
-    REQUIRE(std::get<0>(firstConn) == herald::engine::Features::HeraldBluetoothProtocolConnection);
+    REQUIRE(std::get<0>(firstConn) == features.find(herald::engine::Features::HeraldBluetoothProtocolConnection));
     REQUIRE(std::get<1>(firstConn) > 0);
     REQUIRE(std::get<2>(firstConn).has_value());
     REQUIRE(std::get<2>(firstConn).value() == device2);
@@ -388,7 +415,8 @@ TEST_CASE("blecoordinator-got-three-at-different-states", "[coordinator][got-thr
     // REQUIRE(std::get<2>(secondConn).has_value());
     // REQUIRE(std::get<2>(secondConn).value() == device3);
 
-    std::vector<herald::engine::Activity> acts = coord.requiredActivities();
+    std::vector<herald::engine::Activity> acts;
+    coord.requiredActivities(acts);
     REQUIRE(acts.size() == 1); // just read payload (ID) for ONE device, and immediate send for another
     auto firstAct = acts.front();
     REQUIRE(firstAct.prerequisites.size() == 1);
@@ -422,6 +450,9 @@ TEST_CASE("blecoordinator-remove-old", "[ble][coordinator][remove][old]") {
       
     NoOpHeraldV1ProtocolProvider pp(ctx,db);
     herald::ble::HeraldProtocolBLECoordinationProvider coord(ctx,db,pp);
+    herald::engine::FeatureRegistry features;
+    features.intern(herald::engine::Features::HeraldBluetoothProtocolConnection);
+    coord.featuresRegistered(features);
 
     DummyBLEDBDelegate delegate;
     db.add(delegate);
@@ -464,7 +495,8 @@ TEST_CASE("blecoordinator-remove-old", "[ble][coordinator][remove][old]") {
     dpt.seconds += 2; // 1 second past expiry
     
     // Force DB cache re-evaluation
-    std::vector<herald::engine::Activity> acts = coord.requiredActivities();
+    std::vector<herald::engine::Activity> acts;
+    coord.requiredActivities(acts);
     
     REQUIRE(db.size() == 1);
     REQUIRE(delegate.createCallbackCalled == true);
@@ -486,7 +518,8 @@ TEST_CASE("blecoordinator-remove-old", "[ble][coordinator][remove][old]") {
     dpt.seconds = secondDeviceAppearedAt + ctx.getSensorConfiguration().peripheralCleanInterval.seconds() - 1;
 
     // Force DB cache re-evaluation
-    acts = coord.requiredActivities();
+    acts.clear();
+    coord.requiredActivities(acts);
 
     REQUIRE(db.size() == 1);
     REQUIRE(delegate.createCallbackCalled == true);
@@ -499,7 +532,8 @@ TEST_CASE("blecoordinator-remove-old", "[ble][coordinator][remove][old]") {
     dpt.seconds += 2;
     
     // Force DB cache re-evaluation
-    acts = coord.requiredActivities();
+    acts.clear();
+    coord.requiredActivities(acts);
 
     REQUIRE(db.size() == 0);
     REQUIRE(delegate.createCallbackCalled == true);
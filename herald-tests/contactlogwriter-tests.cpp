@@ -0,0 +1,282 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include "test-templates.h"
+
+#include "catch.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "herald/herald.h"
+
+using namespace herald::data;
+
+/// \brief A log file path in the temporary directory, removed with its rotated files
+struct TemporaryContactLog {
+  TemporaryContactLog(const std::string& name)
+    : path((std::filesystem::temp_directory_path() / name).string())
+  {
+    clear();
+  }
+
+  ~TemporaryContactLog() {
+    clear();
+  }
+
+  void clear() {
+    std::filesystem::remove(path);
+    for (int i = 1;i <= 10;++i) {
+      std::filesystem::remove(path + "." + std::to_string(i));
+    }
+  }
+
+  std::string path;
+};
+
+static std::string readFile(const std::string& path) {
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+  std::stringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+static std::vector<std::string> readLines(const std::string& path) {
+  std::istringstream in(readFile(path));
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(in, line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+TEST_CASE("contactlogwriter-csv", "[contactlogwriter][csv]") {
+  TemporaryContactLog log("herald-contacts-csv-test.csv");
+  DummyLoggingSink dls;
+  DummyBluetoothStateManager dbsm;
+  herald::DefaultPlatformType dpt;
+  herald::Context ctx(dpt,dls,dbsm);
+  herald::data::ConcretePayloadDataFormatter pdf;
+  ContactLogWriter writer(log.path);
+  REQUIRE(writer.isOpen());
+  herald::data::FileContactLogger contacts(ctx, pdf, writer);
+
+  herald::datatype::TargetIdentifier target(herald::datatype::Data(std::byte(0x09),6));
+  herald::datatype::PayloadData payload(std::byte(0x0a),8);
+  contacts.sensor(herald::datatype::SensorType::BLE, target);
+  contacts.sensor(herald::datatype::SensorType::BLE, payload, target);
+  contacts.sensor(herald::datatype::SensorType::BLE,
+    herald::datatype::Proximity{herald::datatype::ProximityMeasurementUnit::RSSI, -55}, target);
+  contacts.sensor(herald::datatype::SensorType::BLE, std::vector<herald::datatype::PayloadData>{payload, payload}, target);
+  contacts.sensor(herald::datatype::SensorType::BLE, herald::datatype::SensorState::on);
+  writer.flush();
+  REQUIRE(writer.events() == 6);
+
+  auto lines = readLines(log.path);
+  REQUIRE(lines.size() == 7);
+  REQUIRE(lines[0] == "time,sensor,id,detect,read,measure,share,visit,receive,state,data");
+  auto withoutTime = [](const std::string& line) { return line.substr(line.find(',') + 1); };
+  REQUIRE(withoutTime(lines[1]) == "ble,090909090909,1,,,,,,,");
+  REQUIRE(withoutTime(lines[2]) == "ble,090909090909,,2,,,,,," + pdf.shortFormat(payload));
+  REQUIRE(withoutTime(lines[3]) == "ble,090909090909,,,3,,,,,0:-55");
+  REQUIRE(withoutTime(lines[4]) == "ble,090909090909,,,,4,,,," + pdf.shortFormat(payload));
+  REQUIRE(lines[5] == lines[4]);
+  REQUIRE(withoutTime(lines[6]) == "ble,,,,,,,,7,on");
+  REQUIRE(std::stoull(lines[1].substr(0, lines[1].find(','))) == herald::datatype::Date().secondsSinceUnixEpoch());
+}
+
+TEST_CASE("contactlogwriter-payload-format", "[contactlogwriter][formatter]") {
+  herald::data::ConcretePayloadDataFormatter pdf;
+  std::string reused;
+  for (std::size_t size = 0;size <= 12;++size) {
+    herald::datatype::PayloadData payload;
+    for (std::size_t i = 0;i < size;++i) {
+      payload.append(std::byte(0xf7 - 29 * i));
+    }
+    pdf.shortFormat(payload, reused);
+    REQUIRE(reused == payload.shortName());
+    REQUIRE(pdf.shortFormat(payload) == payload.shortName());
+  }
+}
+
+TEST_CASE("contactlogwriter-binary", "[contactlogwriter][binary]") {
+  TemporaryContactLog log("herald-contacts-binary-test.bin");
+  herald::datatype::Data target(std::byte(0x01),6);
+  herald::datatype::Data payload(std::byte(0x02),3);
+  {
+    ContactLogWriterOptions options;
+    options.format = ContactLogFormat::binary;
+    ContactLogWriter writer(log.path, options);
+    ContactLogEvent detect;
+    detect.time = 300;
+    detect.target = &target;
+    writer.append(detect);
+    ContactLogEvent read = detect;
+    read.type = ContactLogEventType::read;
+    read.payload = &payload;
+    writer.append(read);
+    ContactLogEvent measure = detect;
+    measure.type = ContactLogEventType::measure;
+    measure.proximity = herald::datatype::Proximity{herald::datatype::ProximityMeasurementUnit::RSSI, -2};
+    writer.append(measure);
+  } // written on destruction
+
+  std::string expected("HCON\x01", 5);
+  const std::string id("\x06\x01\x01\x01\x01\x01\x01", 7);
+  expected += std::string("\x01\xac\x02\x00", 4) + id;
+  expected += std::string("\x02\xac\x02\x00", 4) + id + std::string("\x03\x02\x02\x02", 4);
+  expected += std::string("\x03\xac\x02\x00", 4) + id + std::string("\x00\x03", 2);
+  REQUIRE(readFile(log.path) == expected);
+}
+
+TEST_CASE("contactlogwriter-reopen", "[contactlogwriter][csv]") {
+  TemporaryContactLog log("herald-contacts-reopen-test.csv");
+  herald::datatype::Data target(std::byte(0x01),6);
+  ContactLogEvent detect;
+  detect.target = &target;
+  for (int run = 0;run < 2;++run) {
+    ContactLogWriter writer(log.path);
+    writer.append(detect);
+  }
+  auto lines = readLines(log.path);
+  REQUIRE(lines.size() == 3); // one header
+  REQUIRE(lines[1] == lines[2]);
+}
+
+TEST_CASE("contactlogwriter-rotation", "[contactlogwriter][rotation]") {
+  TemporaryContactLog log("herald-contacts-rotation-test.csv");
+  herald::datatype::Data target(std::byte(0x01),6);
+  ContactLogEvent detect;
+  detect.target = &target;
+  ContactLogWriterOptions options;
+  options.maxFileBytes = 256;
+  options.maxFiles = 2;
+  options.bufferBytes = 1; // each event written separately
+  ContactLogWriter writer(log.path, options);
+  for (int i = 0;i < 50;++i) {
+    writer.append(detect);
+    writer.flush();
+  }
+  REQUIRE(writer.rotations() > 2);
+  REQUIRE(std::filesystem::exists(log.path + ".1"));
+  REQUIRE(std::filesystem::exists(log.path + ".2"));
+  REQUIRE(!std::filesystem::exists(log.path + ".3"));
+  for (auto& path : {log.path, log.path + ".1", log.path + ".2"}) {
+    REQUIRE(std::filesystem::file_size(path) <= options.maxFileBytes);
+    auto lines = readLines(path);
+    REQUIRE(lines.size() > 1);
+    REQUIRE(lines[0] == "time,sensor,id,detect,read,measure,share,visit,receive,state,data");
+  }
+}
+
+TEST_CASE("contactlogwriter-buffer-limit", "[contactlogwriter][csv]") {
+  TemporaryContactLog log("herald-contacts-buffer-limit-test.csv");
+  herald::datatype::Data target(std::byte(0x01),6);
+  ContactLogEvent detect;
+  detect.target = &target;
+  ContactLogWriterOptions options;
+  options.bufferBytes = 1024 * 1024;
+  options.maxBufferBytes = 1024;
+  options.syncInterval = std::chrono::hours(1); // writer thread only woken by flush()
+  ContactLogWriter writer(log.path, options);
+  for (int i = 0;i < 100;++i) {
+    writer.append(detect);
+  }
+  REQUIRE(writer.dropped() > 0);
+  REQUIRE(writer.events() + writer.dropped() == 100);
+  writer.flush();
+  REQUIRE(readLines(log.path).size() == writer.events() + 1);
+
+  // Space is freed once the buffer is written
+  const std::uint64_t dropped = writer.dropped();
+  writer.append(detect);
+  REQUIRE(writer.dropped() == dropped);
+}
+
+TEST_CASE("contactlogwriter-benchmark", "[.][benchmark][contactlogwriter]") {
+  DummyLoggingSink dls;
+  DummyBluetoothStateManager dbsm;
+  herald::DefaultPlatformType dpt;
+  herald::Context ctx(dpt,dls,dbsm);
+  herald::data::ConcretePayloadDataFormatter pdf;
+  const int threads = 4;
+  const int perThread = 250000;
+
+  auto report = [](const std::string& label, int events, double seconds, std::uint64_t bytes) {
+    std::cout << label << ": " << (std::uint64_t)(events / seconds) << " events/s, "
+              << ((double)bytes / events) << " bytes per event" << std::endl;
+  };
+
+  for (auto format : {ContactLogFormat::csv, ContactLogFormat::binary}) {
+    const char* name = ContactLogFormat::csv == format ? "csv" : "binary";
+    ContactLogWriterOptions options;
+    options.format = format;
+    options.maxFileBytes = 64 * 1024 * 1024;
+
+    // Sensor delegate calls, from the one thread (Data's memory arena is not thread safe)
+    {
+      TemporaryContactLog log("herald-contacts-benchmark-test");
+      double seconds = 0;
+      {
+        ContactLogWriter writer(log.path, options);
+        herald::data::FileContactLogger contacts(ctx, pdf, writer);
+        herald::datatype::TargetIdentifier target(herald::datatype::Data(std::byte(1),6));
+        herald::datatype::PayloadData payload(std::byte(2),16);
+        auto started = std::chrono::steady_clock::now();
+        for (int i = 0;i < threads * perThread;++i) {
+          if (0 == i % 4) {
+            contacts.sensor(herald::datatype::SensorType::BLE, payload, target);
+          } else {
+            contacts.sensor(herald::datatype::SensorType::BLE,
+              herald::datatype::Proximity{herald::datatype::ProximityMeasurementUnit::RSSI, (double)(-40 - i % 50)}, target);
+          }
+        }
+        writer.flush();
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+      }
+      report(std::string(name) + " FileContactLogger, 1 thread", threads * perThread, seconds, std::filesystem::file_size(log.path));
+    }
+
+    // Encoded events appended concurrently
+    {
+      TemporaryContactLog log("herald-contacts-benchmark-test");
+      double seconds = 0;
+      {
+        ContactLogWriter writer(log.path, options);
+        herald::datatype::Data target(std::byte(1),6);
+        herald::datatype::Data payload(std::byte(2),16);
+        auto started = std::chrono::steady_clock::now();
+        std::vector<std::thread> producers;
+        for (int t = 0;t < threads;++t) {
+          producers.emplace_back([&writer, &target, &payload, perThread] {
+            ContactLogEvent e;
+            e.time = 1600000000;
+            e.target = &target;
+            for (int i = 0;i < perThread;++i) {
+              e.type = (0 == i % 4) ? ContactLogEventType::read : ContactLogEventType::measure;
+              e.payload = &payload;
+              e.text = "payload";
+              e.proximity.value = -40 - i % 50;
+              writer.append(e);
+            }
+          });
+        }
+        for (auto& producer : producers) {
+          producer.join();
+        }
+        writer.flush();
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        REQUIRE(writer.events() == (std::uint64_t)threads * perThread);
+      }
+      report(std::string(name) + " ContactLogWriter::append, " + std::to_string(threads) + " threads", threads * perThread, seconds, std::filesystem::file_size(log.path));
+    }
+  }
+}
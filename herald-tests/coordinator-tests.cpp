@@ -328,3 +328,147 @@ TEST_CASE("coordinator-complex-iterations", "[coordinator][iterations][complex]"
 
   c.stop();
 }
+
+/// \brief Provides a single feature, and runs one activity per iteration that requires it for one target
+class LoopbackCoordinationProvider : public herald::engine::CoordinationProvider {
+public:
+  LoopbackCoordinationProvider(herald::datatype::TargetIdentifier target)
+    : target(target), feature(herald::engine::FeatureRegistry::Unknown), provisionTarget(true), provisionCalls(0), executed(0) {}
+  ~LoopbackCoordinationProvider() = default;
+
+  std::vector<herald::engine::FeatureTag> connectionsProvided() override {
+    return {herald::engine::Features::HeraldBluetoothProtocolConnection};
+  }
+
+  void featuresRegistered(const herald::engine::FeatureRegistry& features) override {
+    feature = features.find(herald::engine::Features::HeraldBluetoothProtocolConnection);
+  }
+
+  void provision(const std::vector<herald::engine::PrioritisedPrerequisite>& requested,
+    std::vector<herald::engine::PrioritisedPrerequisite>& provisioned) override {
+    ++provisionCalls;
+    if (provisionTarget) {
+      provisioned.insert(provisioned.end(),requested.begin(),requested.end());
+    }
+  }
+
+  void requiredConnections(std::vector<herald::engine::PrioritisedPrerequisite>& required) override {
+    required.emplace_back(
+      feature,
+      herald::engine::Priorities::Default,
+      target
+    );
+  }
+
+  void requiredActivities(std::vector<herald::engine::Activity>& required) override {
+    required.push_back(herald::engine::Activity{
+      .priority = herald::engine::Priorities::Default,
+      .name = "loopback",
+      .prerequisites = {herald::engine::Prerequisite(
+        feature,
+        target
+      )},
+      .executor = [this](const herald::engine::Activity) -> std::optional<herald::engine::Activity> {
+        ++executed;
+        return {};
+      }
+    });
+  }
+
+  herald::datatype::TargetIdentifier target;
+  herald::engine::FeatureId feature;
+  bool provisionTarget;
+  int provisionCalls;
+  int executed;
+};
+
+template <typename CoordProvT>
+class LoopbackSensor {
+public:
+  LoopbackSensor(CoordProvT& provider) : cp(provider) {}
+  ~LoopbackSensor() = default;
+
+  std::optional<std::reference_wrapper<herald::engine::CoordinationProvider>> coordinationProvider() {
+    return std::optional<std::reference_wrapper<herald::engine::CoordinationProvider>>(cp);
+  }
+
+  CoordProvT& cp;
+};
+
+TEST_CASE("coordinator-provisioned-lookup", "[coordinator][iterations][provisioned]") {
+  DummyLoggingSink dls;
+  DummyBluetoothStateManager dbsm;
+  herald::DefaultPlatformType dpt;
+  herald::Context ctx(dpt,dls,dbsm);
+  using CT = typename herald::Context<herald::DefaultPlatformType,DummyLoggingSink,DummyBluetoothStateManager>;
+
+  herald::datatype::TargetIdentifier device1(herald::datatype::Data(std::byte(0x1d),6));
+  LoopbackCoordinationProvider provider(device1);
+  LoopbackSensor<LoopbackCoordinationProvider> sensor(provider);
+
+  herald::engine::Coordinator<CT> c(ctx);
+  c.add(sensor);
+  c.iteration(); // not started
+  REQUIRE(provider.provisionCalls == 0);
+  REQUIRE(c.iterationLatency().count() == 0);
+
+  c.start();
+  for (int i = 0;i < 5;++i) {
+    c.iteration();
+  }
+  REQUIRE(provider.provisionCalls == 5);
+  REQUIRE(provider.executed == 5);
+  REQUIRE(c.iterationLatency().count() == 5);
+
+  // Activity must not run when its prerequisite was not provisioned
+  provider.provisionTarget = false;
+  c.iteration();
+  REQUIRE(provider.provisionCalls == 6);
+  REQUIRE(provider.executed == 5);
+  REQUIRE(c.iterationLatency().count() == 6);
+  c.stop();
+}
+
+TEST_CASE("latency-histogram-buckets", "[coordinator][metrics][histogram]") {
+  herald::engine::LatencyHistogram<8> hist;
+  REQUIRE(hist.count() == 0);
+  REQUIRE(hist.min() == 0);
+  REQUIRE(hist.max() == 0);
+  REQUIRE(hist.percentile(50) == 0);
+
+  hist.record(0);
+  hist.record(1);
+  hist.record(3);
+  hist.record(3);
+  hist.record(1000); // beyond last bounded bucket
+  REQUIRE(hist.count() == 5);
+  REQUIRE(hist.bucket(0) == 1);
+  REQUIRE(hist.bucket(1) == 1);
+  REQUIRE(hist.bucket(2) == 2);
+  REQUIRE(hist.bucket(7) == 1);
+  REQUIRE(hist.min() == 0);
+  REQUIRE(hist.max() == 1000);
+  REQUIRE(hist.mean() == Approx(201.4));
+  REQUIRE(hist.percentile(50) == 4); // upper bound of [2,4)
+  REQUIRE(hist.percentile(100) == 1000);
+
+  hist.reset();
+  REQUIRE(hist.count() == 0);
+  REQUIRE(hist.bucket(2) == 0);
+}
+
+TEST_CASE("feature-registry-intern", "[coordinator][features][registry]") {
+  herald::engine::FeatureRegistry registry;
+  herald::engine::FeatureTag other(std::byte(0x02),1);
+  REQUIRE(registry.size() == 0);
+  REQUIRE(registry.find(herald::engine::Features::HeraldBluetoothProtocolConnection) == herald::engine::FeatureRegistry::Unknown);
+
+  auto first = registry.intern(herald::engine::Features::HeraldBluetoothProtocolConnection);
+  auto second = registry.intern(other);
+  REQUIRE(first == 0);
+  REQUIRE(second == 1);
+  REQUIRE(registry.intern(herald::engine::FeatureTag(std::byte(0x01),1)) == first); // equal tag, same id
+  REQUIRE(registry.size() == 2);
+  REQUIRE(registry.find(other) == second);
+  REQUIRE(registry.tag(second) == other);
+}
@@ -101,6 +101,22 @@ TEST_CASE("datatypes-data-assign-copy", "[datatypes][data][assign][copy]") {
   }
 }
 
+TEST_CASE("datatypes-data-assign-reuse", "[datatypes][data][assign][reuse]") {
+  SECTION("datatypes-data-assign-reuse") {
+    const uint8_t bytes[] = {0,1,2,3};
+    const herald::datatype::Data orig{bytes, 4};
+    herald::datatype::Data d{bytes, 2};
+    auto freeBefore = herald::datatype::Data::getArena().pagesFree();
+    for (int i = 0;i < 2000;++i) {
+      d = orig; // must release the previous allocation each time
+      d = herald::datatype::Data{bytes, 3};
+    }
+    REQUIRE(d.size() == 3);
+    REQUIRE(d.at(2) == std::byte(2));
+    REQUIRE(herald::datatype::Data::getArena().pagesFree() == freeBefore);
+  }
+}
+
 TEST_CASE("datatypes-data-from-bytearray", "[datatypes][data][ctor][from-bytearray]") {
   SECTION("datatypes-data-from-bytearray") {
     const std::byte bytes[] = {std::byte(0),std::byte(1),std::byte(2),std::byte(3)};
@@ -0,0 +1,237 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include "catch.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "herald/herald.h"
+
+// EncounterStore is POSIX only, as is its benchmark
+#if !defined(_WIN32)
+
+using namespace herald::data;
+using namespace herald::datatype;
+
+/// \brief A store directory in the temporary directory, removed afterwards
+struct TemporaryEncounterStore {
+  TemporaryEncounterStore(const std::string& name)
+    : path((std::filesystem::temp_directory_path() / name).string())
+  {
+    std::filesystem::remove_all(path);
+  }
+
+  ~TemporaryEncounterStore() {
+    std::filesystem::remove_all(path);
+  }
+
+  std::string path;
+};
+
+static Encounter encounterAt(std::uint64_t time, std::uint8_t payload, double rssi) {
+  return Encounter(Proximity{ProximityMeasurementUnit::RSSI, rssi}, PayloadData(std::byte(payload), 8), Date(time));
+}
+
+// 2021-01-01T00:00:00Z
+static constexpr std::uint64_t Start = 1609459200;
+
+TEST_CASE("encounterstore-query", "[encounterstore][query]") {
+  TemporaryEncounterStore dir("herald-encounterstore-query");
+  EncounterStore store(dir.path);
+  REQUIRE(store.isOpen());
+  REQUIRE(store.size() == 0);
+
+  // Two payloads, alternating, one encounter every 10 minutes for 3 hours (3 partitions)
+  for (std::uint64_t i = 0;i < 18;++i) {
+    REQUIRE(store.append(encounterAt(Start + i * 600, (std::uint8_t)(1 + i % 2), -50.0 - i)));
+  }
+  REQUIRE(store.size() == 18);
+  REQUIRE(store.segments() == 3);
+
+  std::vector<EncounterView> results;
+  PayloadData first(std::byte(1), 8);
+  REQUIRE(store.encounters(first, Date(Start), Date(Start + 3 * 3600), results) == 9);
+  for (std::size_t i = 0;i < results.size();++i) {
+    REQUIRE(results[i].time == Start + i * 1200);
+    REQUIRE(results[i].proximity.unit == ProximityMeasurementUnit::RSSI);
+    REQUIRE(results[i].proximity.value == -50.0 - i * 2);
+    REQUIRE(results[i].payloadLength == 8);
+    REQUIRE(results[i].payloadData() == first);
+  }
+  Encounter e = results[1].encounter();
+  REQUIRE(e.isValid());
+  REQUIRE(e.timestamp().secondsSinceUnixEpoch() == Start + 1200);
+  REQUIRE(e.payload() == first);
+
+  // Window within the second hour: 1h00 and 1h20 only (1h40 is for the other payload)
+  results.clear();
+  REQUIRE(store.encounters(first, Date(Start + 3600), Date(Start + 3600 + 1800), results) == 2);
+  REQUIRE(results[0].time == Start + 3600);
+  REQUIRE(results[1].time == Start + 4800);
+
+  results.clear();
+  REQUIRE(store.encounters(PayloadData(std::byte(3), 8), Date(Start), Date(Start + 3 * 3600), results) == 0);
+  REQUIRE(store.encounters(first, Date(Start + 4 * 3600), Date(Start + 5 * 3600), results) == 0);
+}
+
+TEST_CASE("encounterstore-exposure", "[encounterstore][exposure]") {
+  TemporaryEncounterStore dir("herald-encounterstore-exposure");
+  EncounterStore store(dir.path);
+  store.append(encounterAt(Start + 10, 1, -60));
+  store.append(encounterAt(Start + 20, 2, -70));
+  store.append(encounterAt(Start + 30, 1, -40));
+  store.append(encounterAt(Start + 40, 1, -50));
+  store.append(encounterAt(Start + 7200, 1, -10)); // outside the window
+
+  auto exposure = store.exposure(Date(Start), Date(Start + 3600));
+  REQUIRE(exposure.size() == 2);
+  REQUIRE(exposure[0].count == 3);
+  REQUIRE(PayloadData((const std::byte*)exposure[0].payload, exposure[0].payloadLength) == PayloadData(std::byte(1), 8));
+  REQUIRE(exposure[0].firstSeen == Start + 10);
+  REQUIRE(exposure[0].lastSeen == Start + 40);
+  REQUIRE(exposure[0].meanProximity == -50.0);
+  REQUIRE(exposure[0].maxProximity == -40.0);
+  REQUIRE(exposure[1].count == 1);
+  REQUIRE(exposure[1].meanProximity == -70.0);
+
+  REQUIRE(store.exposure(Date(Start), Date(Start + 8000))[0].count == 4);
+
+  // Values in different units are not combined
+  store.append(Encounter(Proximity{ProximityMeasurementUnit::RTT, 2.0}, PayloadData(std::byte(1), 8), Date(Start + 50)));
+  exposure = store.exposure(Date(Start), Date(Start + 3600));
+  REQUIRE(exposure.size() == 3);
+  REQUIRE(exposure[0].unit == ProximityMeasurementUnit::RSSI);
+  REQUIRE(exposure[0].count == 3);
+  REQUIRE(exposure[0].maxProximity == -40.0);
+  REQUIRE(exposure[2].unit == ProximityMeasurementUnit::RTT);
+  REQUIRE(exposure[2].count == 1);
+  REQUIRE(exposure[2].meanProximity == 2.0);
+}
+
+TEST_CASE("encounterstore-reopen", "[encounterstore][persistence]") {
+  TemporaryEncounterStore dir("herald-encounterstore-reopen");
+  EncounterStoreOptions options;
+  options.segmentCapacity = 4; // several segments per partition
+  {
+    EncounterStore store(dir.path, options);
+    for (std::uint64_t i = 0;i < 10;++i) {
+      REQUIRE(store.append(encounterAt(Start + i, 1, -50)));
+    }
+    REQUIRE(store.segments() == 3);
+    store.flush();
+  }
+  EncounterStore reopened(dir.path, options);
+  REQUIRE(reopened.isOpen());
+  REQUIRE(reopened.size() == 10);
+  REQUIRE(reopened.segments() == 3);
+  REQUIRE(reopened.append(encounterAt(Start + 10, 1, -50)));
+  REQUIRE(reopened.segments() == 3);
+  std::vector<EncounterView> results;
+  REQUIRE(reopened.encounters(PayloadData(std::byte(1), 8), Date(Start), Date(Start + 60), results) == 11);
+  for (std::size_t i = 0;i < results.size();++i) {
+    REQUIRE(results[i].time == Start + i);
+  }
+}
+
+TEST_CASE("encounterstore-invalid", "[encounterstore][invalid]") {
+  TemporaryEncounterStore dir("herald-encounterstore-invalid");
+  EncounterStore store(dir.path);
+  REQUIRE(!store.append(Encounter(std::string("not parsed"))));
+  REQUIRE(store.size() == 0);
+  REQUIRE(store.segments() == 0);
+
+  // Not a store segment, so skipped and kept
+  TemporaryEncounterStore other("herald-encounterstore-corrupt");
+  std::filesystem::create_directories(other.path);
+  const std::string notSegment = other.path + "/encounters-" + std::to_string(Start) + "-0.hes";
+  FILE* file = std::fopen(notSegment.c_str(), "wb");
+  std::fputs("not a segment", file);
+  std::fclose(file);
+  EncounterStore corrupt(other.path);
+  REQUIRE(corrupt.isOpen());
+  REQUIRE(corrupt.size() == 0);
+  REQUIRE(corrupt.append(encounterAt(Start, 1, -50)));
+  REQUIRE(corrupt.segments() == 1);
+  REQUIRE(std::filesystem::file_size(notSegment) == 13);
+}
+
+TEST_CASE("encounterstore-interrupted-create", "[encounterstore][persistence]") {
+  TemporaryEncounterStore dir("herald-encounterstore-interrupted");
+  EncounterStoreOptions options;
+  options.segmentCapacity = 4;
+  {
+    EncounterStore store(dir.path, options);
+    for (std::uint64_t i = 0;i < 4;++i) {
+      REQUIRE(store.append(encounterAt(Start + i, 1, -50)));
+    }
+    store.flush();
+  }
+  // As left by a crash after sizing a new segment file, but before writing its header
+  const std::string valid = dir.path + "/encounters-" + std::to_string(Start) + "-0.hes";
+  const std::string interrupted = dir.path + "/encounters-" + std::to_string(Start) + "-1.hes";
+  std::filesystem::copy_file(valid, interrupted);
+  std::filesystem::resize_file(interrupted, 0);
+  std::filesystem::resize_file(interrupted, std::filesystem::file_size(valid));
+
+  EncounterStore reopened(dir.path, options);
+  REQUIRE(reopened.isOpen());
+  REQUIRE(reopened.size() == 4);
+  REQUIRE(reopened.segments() == 1);
+  REQUIRE(!std::filesystem::exists(interrupted));
+  REQUIRE(reopened.append(encounterAt(Start + 4, 1, -50)));
+  REQUIRE(reopened.segments() == 2);
+  REQUIRE(std::filesystem::exists(interrupted));
+}
+
+TEST_CASE("encounterstore-benchmark", "[.][benchmark][encounterstore]") {
+  TemporaryEncounterStore dir("herald-encounterstore-benchmark");
+  EncounterStore store(dir.path);
+  // A week of encounters, 1000 distinct payloads, one encounter every 0.6 seconds
+  const std::uint64_t count = 1000000;
+  const std::uint64_t payloads = 1000;
+  auto payloadFor = [](std::uint64_t i) {
+    std::uint8_t bytes[16] = {0};
+    for (int b = 0;b < 8;++b) {
+      bytes[b] = (std::uint8_t)((i * 2654435761u) >> (8 * (b % 4)));
+    }
+    bytes[8] = (std::uint8_t)i;
+    bytes[9] = (std::uint8_t)(i >> 8);
+    return PayloadData((const std::byte*)bytes, sizeof(bytes));
+  };
+  auto started = std::chrono::steady_clock::now();
+  for (std::uint64_t i = 0;i < count;++i) {
+    store.append(Encounter(Proximity{ProximityMeasurementUnit::RSSI, -40.0 - i % 50}, payloadFor(i % payloads),
+      Date(Start + i * 6 / 10)));
+  }
+  store.flush();
+  double appendNanos = std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now() - started).count() / count;
+
+  // One payload over one day, by index
+  const int queries = 1000;
+  std::vector<EncounterView> results;
+  started = std::chrono::steady_clock::now();
+  for (int q = 0;q < queries;++q) {
+    results.clear();
+    store.encounters(payloadFor(q % payloads), Date(Start + 86400), Date(Start + 2 * 86400), results);
+  }
+  double queryMicros = std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now() - started).count() / queries;
+  const std::size_t perQuery = results.size();
+
+  // Exposure per payload over the whole week, scanning the columns
+  started = std::chrono::steady_clock::now();
+  auto exposure = store.exposure(Date(Start), Date(Start + 7 * 86400));
+  double exposureMillis = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now() - started).count();
+  REQUIRE(exposure.size() == payloads);
+
+  std::cout << "EncounterStore with " << count << " encounters in " << store.segments() << " segments" << std::endl
+            << "append:                        " << appendNanos << " ns per encounter" << std::endl
+            << "encounters(payload, one day):  " << queryMicros << " us per query (" << perQuery << " results)" << std::endl
+            << "exposure(one week):            " << exposureMillis << " ms (" << exposure.size() << " payloads)" << std::endl;
+}
+
+#endif
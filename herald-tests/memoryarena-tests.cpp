@@ -2,7 +2,10 @@
 //  SPDX-License-Identifier: Apache-2.0
 //
 
+#include <atomic>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include "catch.hpp"
 
@@ -116,4 +119,31 @@ TEST_CASE("memoryarena-entry-rawlocation","[memoryarena][entry][rawlocation]") {
     auto difference = entry2Address - entry1Address;
     REQUIRE(16 == difference);
   }
+}
+
+TEST_CASE("memoryarena-threads","[memoryarena][threads]") {
+  SECTION("memoryarena-threads") {
+    herald::datatype::MemoryArena<2048,8> arena;
+    const std::size_t freeBefore = arena.pagesFree();
+    std::atomic<int> shared(0);
+    std::vector<std::thread> threads;
+    for (int t = 0;t < 4;++t) {
+      threads.emplace_back([&arena,&shared,t] {
+        for (int i = 0;i < 10000;++i) {
+          auto entry = arena.allocate(8 + (i % 3) * 8);
+          arena.set(entry,0,(unsigned char)t);
+          std::this_thread::yield();
+          if ((unsigned char)t != (unsigned char)arena.get(entry,0)) {
+            ++shared; // another thread was given the same page
+          }
+          arena.deallocate(entry);
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    REQUIRE(shared == 0);
+    REQUIRE(arena.pagesFree() == freeBefore);
+  }
 }
\ No newline at end of file
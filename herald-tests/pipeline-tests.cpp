@@ -0,0 +1,149 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include "catch.hpp"
+
+#include <cmath>
+
+#include "herald/herald.h"
+
+using namespace herald::analysis::sampling;
+using namespace herald::analysis::aggregates;
+using namespace herald::datatype;
+
+namespace pipeline = herald::analysis::pipeline;
+namespace views = herald::analysis::views;
+
+static_assert(pipeline::is_one_pass_v<Count>, "Count is single pass");
+static_assert(pipeline::is_one_pass_v<Variance>, "Variance declares a one pass form");
+static_assert(std::is_same_v<pipeline::one_pass_t<Variance>,OnePassVariance>, "Variance uses OnePassVariance");
+
+/// Two pass aggregate with no one pass form, which pipelines must reject
+struct TwoPassOnly {
+  static constexpr int runs = 2;
+};
+static_assert(!pipeline::is_one_pass_v<TwoPassOnly>, "Multi pass aggregates are rejected");
+
+TEST_CASE("pipeline-summarise-nofilter", "[pipeline][summarise]") {
+  SECTION("pipeline-summarise-nofilter") {
+    SampleList<Sample<int>,5> ages;
+    ages.push(10,12);
+    ages.push(20,14);
+    ages.push(30,19);
+    ages.push(40,45);
+    ages.push(50,66);
+
+    auto summary = ages | pipeline::summarise<Count,Mean>();
+    REQUIRE(summary.get<Count>() == 5);
+    REQUIRE(summary.get<Mean>() == 31.2);
+  }
+}
+
+TEST_CASE("pipeline-summarise-filters", "[pipeline][summarise][filter]") {
+  SECTION("pipeline-summarise-filters") {
+    SampleList<Sample<int>,5> ages;
+    ages.push(10,12);
+    ages.push(20,14);
+    ages.push(30,19);
+    ages.push(40,45);
+    ages.push(50,66);
+
+    auto summary = ages
+                 | pipeline::filter(views::in_range(18,65))
+                 | pipeline::filter(views::since(Date(35)))
+                 | pipeline::summarise<Count,Mean>();
+    REQUIRE(summary.get<Count>() == 1);
+    REQUIRE(summary.get<Mean>() == 45);
+  }
+}
+
+TEST_CASE("pipeline-matches-views", "[pipeline][variance][views]") {
+  SECTION("pipeline-matches-views") {
+    SampleList<Sample<RSSI>,20> src;
+    int values[] = {-55,-56,-55,-60,-54,-55,-58,-56,-55,-120,-57,-55,-56,-59,-55,-5,-56,-55,-54,-57};
+    for (int i = 0;i < 20;++i) {
+      src.push(Date(1000 + i),RSSI(values[i]));
+    }
+    views::in_range valid(-99,-10);
+    views::since sinceWhen(Date(1002));
+
+    auto viewed = src
+                | views::filter(valid)
+                | views::filter(sinceWhen)
+                | views::to_view();
+    auto expected = viewed | summarise<Count,Mode,Variance>();
+
+    auto fused = src
+               | pipeline::filter(valid)
+               | pipeline::filter(sinceWhen)
+               | pipeline::summarise<Count,Mode,Variance>();
+
+    REQUIRE(fused.get<Count>() == expected.get<Count>());
+    REQUIRE(fused.get<Mode>() == expected.get<Mode>());
+    REQUIRE(std::fabs(fused.get<Variance>() - expected.get<Variance>()) < 0.000001);
+  }
+}
+
+TEST_CASE("pipeline-aggregate-configured", "[pipeline][aggregate]") {
+  SECTION("pipeline-aggregate-configured") {
+    SampleList<Sample<RSSI>,5> src;
+    src.push(Date(1000),RSSI(-55));
+    src.push(Date(1001),RSSI(-55));
+    src.push(Date(1002),RSSI(-60));
+    src.push(Date(1003),RSSI(-5));
+
+    herald::analysis::algorithms::distance::FowlerBasic basic(-50,-24);
+    auto fused = src
+               | pipeline::filter(views::in_range(-99,-10))
+               | pipeline::aggregate(basic);
+    auto viewed = src
+                | views::filter(views::in_range(-99,-10))
+                | aggregate(basic);
+    REQUIRE(fused.get<herald::analysis::algorithms::distance::FowlerBasic>().reduce() ==
+            viewed.get<herald::analysis::algorithms::distance::FowlerBasic>().reduce());
+  }
+}
+
+TEST_CASE("pipeline-benchmark", "[.][benchmark][pipeline]") {
+  SampleList<Sample<RSSI>,1000> src;
+  for (int i = 0;i < 1000;++i) {
+    src.push(Date(1000 + i),RSSI(-40 - (i * 7) % 70));
+  }
+  views::in_range valid(-99,-10);
+  views::since sinceWhen(Date(1100));
+
+  BENCHMARK("views-summarise-count-mode-variance") {
+    auto values = src
+                | views::filter(valid)
+                | views::filter(sinceWhen)
+                | views::to_view();
+    auto summary = values | summarise<Count,Mode,Variance>();
+    return summary.get<Variance>();
+  };
+
+  BENCHMARK("pipeline-summarise-count-mode-variance") {
+    auto summary = src
+                 | pipeline::filter(valid)
+                 | pipeline::filter(sinceWhen)
+                 | pipeline::summarise<Count,Mode,Variance>();
+    return summary.get<Variance>();
+  };
+
+  BENCHMARK("views-summarise-count-mean") {
+    auto values = src
+                | views::filter(valid)
+                | views::filter(sinceWhen)
+                | views::to_view();
+    auto summary = values | summarise<Count,Mean>();
+    return summary.get<Mean>();
+  };
+
+  BENCHMARK("pipeline-summarise-count-mean") {
+    auto summary = src
+                 | pipeline::filter(valid)
+                 | pipeline::filter(sinceWhen)
+                 | pipeline::summarise<Count,Mean>();
+    return summary.get<Mean>();
+  };
+}
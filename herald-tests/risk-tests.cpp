@@ -0,0 +1,96 @@
+//  Copyright 2021 Herald project contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include "catch.hpp"
+
+#include "herald/herald.h"
+
+using namespace herald::analysis::sampling;
+using namespace herald::analysis::algorithms::risk;
+using namespace herald::datatype;
+
+TEST_CASE("risk-slice-basic", "[risk][slice]") {
+  SECTION("risk-slice-basic") {
+    RiskSliceBasic slice; // 1 second, 1 metre, clamp at 1m with risk 1.0
+    REQUIRE(slice(0.5, 10) == 10.0); // within clamp
+    REQUIRE(slice(1.0, 10) == 10.0); // at clamp
+    REQUIRE(slice(2.0, 10) < 10.0); // falls off with distance
+    REQUIRE(slice(2.0, 10) >= 0.0);
+    REQUIRE(slice(1000.0, 10) == 0.0); // never negative
+  }
+}
+
+TEST_CASE("risk-accumulator-contact", "[risk][accumulator]") {
+  SECTION("risk-accumulator-contact") {
+    RiskSliceBasic slice;
+    ContactExposure<14> exposure;
+    std::uint64_t start = 10 * 86400; // midnight day 10
+    exposure.add(slice, Sample<Distance>(Date(start), Distance(1.0)), 300);
+    REQUIRE(exposure.total() == 0.0); // need two samples
+    exposure.add(slice, Sample<Distance>(Date(start + 60), Distance(1.0)), 300);
+    REQUIRE(exposure.total() == 60.0);
+    // Gap too long - contact lost, no integration
+    exposure.add(slice, Sample<Distance>(Date(start + 1000), Distance(1.0)), 300);
+    REQUIRE(exposure.total() == 60.0);
+    // Out of order - ignored
+    exposure.add(slice, Sample<Distance>(Date(start + 900), Distance(1.0)), 300);
+    REQUIRE(exposure.total() == 60.0);
+    REQUIRE(exposure.lastSampled().secondsSinceUnixEpoch() == start + 1000);
+    exposure.add(slice, Sample<Distance>(Date(start + 1030), Distance(0.5)), 300);
+    REQUIRE(exposure.total() == 90.0);
+
+    REQUIRE(exposure.lastHours(Date(start + 1030), 24) == 90.0);
+    REQUIRE(exposure.lastDays(Date(start + 1030), 14) == 90.0);
+    // A day later the hourly window is empty, but the daily window still holds it
+    REQUIRE(exposure.lastHours(Date(start + 86400 + 1030), 24) == 0.0);
+    REQUIRE(exposure.lastDays(Date(start + 86400 + 1030), 14) == 90.0);
+    REQUIRE(exposure.lastDays(Date(start + 86400 + 1030), 1) == 0.0);
+    // After 14 days it has rolled out of the window
+    REQUIRE(exposure.lastDays(Date(start + 14 * 86400), 14) == 0.0);
+    REQUIRE(exposure.total() == 90.0);
+  }
+
+  SECTION("risk-accumulator-contact-rolls-buckets") {
+    RiskSliceBasic slice;
+    ContactExposure<2> exposure;
+    std::uint64_t start = 10 * 86400;
+    exposure.add(slice, Sample<Distance>(Date(start), Distance(1.0)), 300);
+    exposure.add(slice, Sample<Distance>(Date(start + 10), Distance(1.0)), 300);
+    exposure.add(slice, Sample<Distance>(Date(start + 2 * 86400), Distance(1.0)), 300);
+    exposure.add(slice, Sample<Distance>(Date(start + 2 * 86400 + 20), Distance(1.0)), 300);
+    // The first day's bucket was reused for the third day
+    REQUIRE(exposure.lastDays(Date(start + 2 * 86400 + 20), 2) == 20.0);
+    REQUIRE(exposure.total() == 30.0);
+  }
+}
+
+TEST_CASE("risk-accumulator-delegate", "[risk][accumulator][runner]") {
+  SECTION("risk-accumulator-delegate") {
+    RiskAccumulator<RiskSliceBasic,14> accumulator(RiskSliceBasic(), TimeInterval::minutes(5));
+    std::uint64_t start = 20 * 86400;
+    for (std::uint64_t t = 0;t <= 600;t += 60) {
+      accumulator.newSample(1234, Sample<Distance>(Date(start + t), Distance(1.0)));
+      accumulator.newSample(5678, Sample<Distance>(Date(start + t), Distance(0.5)));
+    }
+    REQUIRE(accumulator.size() == 2);
+    REQUIRE(accumulator.contact(1234) != nullptr);
+    REQUIRE(accumulator.contact(1234)->total() == 600.0);
+    REQUIRE(accumulator.contact(9999) == nullptr);
+    REQUIRE(accumulator.lastDay(Date(start + 600)) == 1200.0);
+    REQUIRE(accumulator.lastDays(Date(start + 600)) == 1200.0);
+
+    accumulator.removeExpired(Date(start + 13 * 86400));
+    REQUIRE(accumulator.size() == 2);
+    accumulator.removeExpired(Date(start + 14 * 86400));
+    REQUIRE(accumulator.size() == 0);
+  }
+
+  SECTION("risk-accumulator-delegate-manager") {
+    herald::analysis::AnalysisDelegateManager adm(RiskAccumulator<>{});
+    adm.notify(1234, Sample<Distance>(Date(1000), Distance(1.0)));
+    adm.notify(1234, Sample<Distance>(Date(1060), Distance(1.0)));
+    auto& accumulator = adm.get<RiskAccumulator<>>();
+    REQUIRE(accumulator.contact(1234)->total() == 60.0);
+  }
+}
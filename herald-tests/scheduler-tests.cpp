@@ -0,0 +1,346 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test-templates.h"
+
+#include "catch.hpp"
+
+#include "herald/herald.h"
+
+using namespace herald::engine;
+
+Activity namedActivity(const std::string& name, Priority priority, std::uint32_t deadlineMillis = 0) {
+  return Activity{
+    .priority = priority,
+    .name = name,
+    .prerequisites = {},
+    .executor = [](const Activity) -> std::optional<Activity> { return {}; },
+    .deadlineMillis = deadlineMillis
+  };
+}
+
+/// \brief Requests a fixed list of activities every iteration, recording the order they run in
+class ScriptedCoordinationProvider : public CoordinationProvider {
+public:
+  ScriptedCoordinationProvider() : script(), ran() {}
+  ~ScriptedCoordinationProvider() = default;
+
+  std::vector<FeatureTag> connectionsProvided() override {
+    return {};
+  }
+
+  void provision(const std::vector<PrioritisedPrerequisite>&, std::vector<PrioritisedPrerequisite>&) override {
+  }
+
+  void requiredConnections(std::vector<PrioritisedPrerequisite>&) override {
+  }
+
+  void requiredActivities(std::vector<Activity>& required) override {
+    required.insert(required.end(),script.begin(),script.end());
+  }
+
+  /// \brief Adds an activity that records it ran, sleeping for busyMicros, and optionally returns a follow on
+  void add(const std::string& name, Priority priority, std::uint64_t busyMicros = 0,
+           std::optional<Activity> followOn = {}) {
+    script.push_back(Activity{
+      .priority = priority,
+      .name = name,
+      .prerequisites = {},
+      .executor = [this,name,busyMicros,followOn](const Activity) -> std::optional<Activity> {
+        ran.push_back(name);
+        std::uint64_t until = monotonicMicros() + busyMicros;
+        while (monotonicMicros() < until) {}
+        return followOn;
+      }
+    });
+  }
+
+  std::vector<Activity> script;
+  std::vector<std::string> ran;
+};
+
+class ScriptedSensor {
+public:
+  ScriptedSensor(ScriptedCoordinationProvider& provider) : cp(provider) {}
+  ~ScriptedSensor() = default;
+
+  std::optional<std::reference_wrapper<CoordinationProvider>> coordinationProvider() {
+    return std::optional<std::reference_wrapper<CoordinationProvider>>(cp);
+  }
+
+  ScriptedCoordinationProvider& cp;
+};
+
+TEST_CASE("activityqueue-order", "[scheduler][activityqueue][order]") {
+  ActivityQueue queue;
+  queue.beginIteration();
+  queue.require(namedActivity("low",Priorities::Low),0);
+  queue.require(namedActivity("default-nodeadline",Priorities::Default),0);
+  queue.require(namedActivity("default-late",Priorities::Default,500),0);
+  queue.require(namedActivity("default-soon",Priorities::Default,100),0);
+  queue.require(namedActivity("high",Priorities::High),0);
+  queue.require(namedActivity("default-nodeadline-2",Priorities::Default),0);
+  REQUIRE(queue.size() == 6);
+
+  std::vector<std::string> order;
+  while (!queue.empty()) {
+    order.push_back(queue.pop().activity.name);
+  }
+  REQUIRE(order == std::vector<std::string>{"high","default-soon","default-late",
+    "default-nodeadline","default-nodeadline-2","low"});
+}
+
+TEST_CASE("activityqueue-carry-over", "[scheduler][activityqueue][carry]") {
+  ActivityQueue queue;
+  queue.beginIteration();
+  queue.require(namedActivity("deferred",Priorities::Low,10),1000);
+  queue.require(namedActivity("parent",Priorities::Low,10),1000);
+  auto deferred = queue.pop();
+  REQUIRE(deferred.scheduled == 1000);
+  REQUIRE(deferred.deadline == 11000);
+  queue.defer(std::move(deferred));
+  auto followed = queue.pop();
+  queue.followOn(namedActivity("follow",Priorities::Low),followed,2000);
+  queue.restoreDeferred();
+  REQUIRE(queue.size() == 2); // deferred, follow
+
+  // Next iteration only re-requests deferred
+  queue.beginIteration();
+  REQUIRE(queue.size() == 1); // follow on persists
+  queue.require(namedActivity("deferred",Priorities::Low,10),5000);
+  REQUIRE(queue.size() == 2);
+  auto first = queue.pop();
+  REQUIRE(first.activity.name == "deferred");
+  REQUIRE(first.scheduled == 1000); // kept its original request time
+  REQUIRE(first.deadline == 11000);
+  REQUIRE(first.followOnDepth == 0);
+  auto second = queue.pop();
+  REQUIRE(second.activity.name == "follow");
+  REQUIRE(second.followOnDepth == 1);
+  REQUIRE(queue.empty());
+}
+
+TEST_CASE("coordinator-scheduler-priority", "[scheduler][coordinator][priority]") {
+  DummyLoggingSink dls;
+  DummyBluetoothStateManager dbsm;
+  herald::DefaultPlatformType dpt;
+  herald::Context ctx(dpt,dls,dbsm);
+  using CT = typename herald::Context<herald::DefaultPlatformType,DummyLoggingSink,DummyBluetoothStateManager>;
+
+  ScriptedCoordinationProvider provider;
+  ScriptedSensor sensor(provider);
+  Coordinator<CT> c(ctx);
+  c.add(sensor);
+
+  SECTION("coordinator-scheduler-priority-order") {
+    provider.add("low",Priorities::Low);
+    provider.add("critical",Priorities::Critical);
+    provider.add("default",Priorities::Default);
+    c.start();
+    c.iteration();
+    REQUIRE(provider.ran == std::vector<std::string>{"critical","default","low"});
+    REQUIRE(c.schedulerMetrics().executed == 3);
+    REQUIRE(c.schedulerMetrics().queueDepth.count() == 1);
+    REQUIRE(c.schedulerMetrics().queueDepth.max() == 3);
+    REQUIRE(c.schedulerMetrics().activityDuration.count() == 3);
+    REQUIRE(c.queuedActivities() == 0);
+  }
+
+  SECTION("coordinator-scheduler-follow-on") {
+    provider.add("parent",Priorities::Default,0,namedActivity("child",Priorities::High));
+    c.start();
+    c.iteration();
+    REQUIRE(provider.ran == std::vector<std::string>{"parent"});
+    REQUIRE(c.schedulerMetrics().followOns == 1);
+    REQUIRE(c.schedulerMetrics().executed == 2); // child ran within the same iteration
+    REQUIRE(c.queuedActivities() == 0);
+  }
+
+  SECTION("coordinator-scheduler-budget") {
+    provider.add("critical",Priorities::Critical,2000);
+    provider.add("high",Priorities::High,2000);
+    provider.add("low",Priorities::Low);
+    c.setIterationBudget(1000);
+    c.start();
+    c.iteration();
+    // critical is exempt, and spends the whole budget
+    REQUIRE(provider.ran == std::vector<std::string>{"critical"});
+    REQUIRE(c.schedulerMetrics().deferred == 2);
+    REQUIRE(c.queuedActivities() == 2);
+
+    c.setIterationBudget(0);
+    c.iteration();
+    REQUIRE(provider.ran == std::vector<std::string>{"critical","critical","high","low"});
+    REQUIRE(c.queuedActivities() == 0);
+    // Deferred activities keep their first request time
+    REQUIRE(c.schedulerMetrics().activityWait.max() >= 2000);
+  }
+  c.stop();
+}
+
+/// \brief Requires one connection per target, and a slow activity per target until each has run once
+class SlowCoordinationProvider : public CoordinationProvider {
+public:
+  SlowCoordinationProvider(std::size_t targets, std::chrono::milliseconds duration)
+    : targets(), feature(FeatureRegistry::Unknown), done(targets), duration(duration), running(0), maxRunning(0), executed(0)
+  {
+    for (std::size_t i = 0;i < targets;++i) {
+      this->targets.emplace_back(herald::datatype::Data(std::byte(i + 1),6));
+      done[i] = false;
+    }
+  }
+  ~SlowCoordinationProvider() = default;
+
+  std::vector<FeatureTag> connectionsProvided() override {
+    return {Features::HeraldBluetoothProtocolConnection};
+  }
+
+  void featuresRegistered(const FeatureRegistry& features) override {
+    feature = features.find(Features::HeraldBluetoothProtocolConnection);
+  }
+
+  void provision(const std::vector<PrioritisedPrerequisite>& requested, std::vector<PrioritisedPrerequisite>& provisioned) override {
+    provisioned.insert(provisioned.end(),requested.begin(),requested.end());
+  }
+
+  void requiredConnections(std::vector<PrioritisedPrerequisite>& results) override {
+    for (auto& target : targets) {
+      results.emplace_back(feature,Priorities::Default,target);
+    }
+  }
+
+  void requiredActivities(std::vector<Activity>& results) override {
+    for (std::size_t i = 0;i < targets.size();++i) {
+      if (done[i]) {
+        continue;
+      }
+      results.push_back(Activity{
+        .priority = Priorities::Default,
+        .name = "slow",
+        .prerequisites = {Prerequisite(feature,targets[i])},
+        .executor = [this,i](const Activity) -> std::optional<Activity> {
+          std::size_t now = ++running;
+          std::size_t prior = maxRunning;
+          while (now > prior && !maxRunning.compare_exchange_weak(prior,now)) {}
+          std::this_thread::sleep_for(duration);
+          --running;
+          ++executed;
+          done[i] = true;
+          return {};
+        }
+      });
+    }
+  }
+
+  std::vector<herald::datatype::TargetIdentifier> targets;
+  FeatureId feature;
+  std::vector<std::atomic<bool>> done;
+  std::chrono::milliseconds duration;
+  std::atomic<std::size_t> running;
+  std::atomic<std::size_t> maxRunning;
+  std::atomic<std::size_t> executed;
+};
+
+class SlowSensor {
+public:
+  SlowSensor(SlowCoordinationProvider& provider) : cp(provider) {}
+  ~SlowSensor() = default;
+
+  std::optional<std::reference_wrapper<CoordinationProvider>> coordinationProvider() {
+    return std::optional<std::reference_wrapper<CoordinationProvider>>(cp);
+  }
+
+  SlowCoordinationProvider& cp;
+};
+
+TEST_CASE("coordinator-async-activities", "[scheduler][coordinator][async]") {
+  DummyLoggingSink dls;
+  DummyBluetoothStateManager dbsm;
+  herald::DefaultPlatformType dpt;
+  herald::Context ctx(dpt,dls,dbsm);
+  using CT = typename herald::Context<herald::DefaultPlatformType,DummyLoggingSink,DummyBluetoothStateManager>;
+
+  const std::size_t count = 4;
+  const auto duration = std::chrono::milliseconds(100);
+  SlowCoordinationProvider provider(count,duration);
+  SlowSensor sensor(provider);
+  Coordinator<CT> c(ctx);
+  c.add(sensor);
+  WorkerPool pool(count,16);
+
+  SECTION("coordinator-async-activities-inline") {
+    c.start();
+    auto began = std::chrono::steady_clock::now();
+    c.iteration();
+    auto elapsed = std::chrono::steady_clock::now() - began;
+    REQUIRE(provider.executed == count);
+    REQUIRE(provider.maxRunning == 1);
+    REQUIRE(elapsed >= count * duration);
+  }
+
+  SECTION("coordinator-async-activities-concurrent") {
+    c.setWorkerPool(&pool);
+    c.start();
+    auto began = std::chrono::steady_clock::now();
+    c.iteration();
+    REQUIRE(std::chrono::steady_clock::now() - began < duration); // does not wait for activities
+    REQUIRE(c.runningActivities() == count);
+    c.iteration(); // re-requested while running, must not start again
+    REQUIRE(c.runningActivities() == count);
+    c.awaitActivities();
+    auto elapsed = std::chrono::steady_clock::now() - began;
+    REQUIRE(provider.executed == count);
+    REQUIRE(provider.maxRunning == count);
+    REQUIRE(elapsed < count * duration / 2); // did not serialise
+    REQUIRE(c.runningActivities() == 0);
+    REQUIRE(c.schedulerMetrics().executed == count);
+    REQUIRE(c.schedulerMetrics().maxRunning == count);
+  }
+
+  SECTION("coordinator-async-activities-feature-limit") {
+    c.setWorkerPool(&pool);
+    c.setConcurrencyLimit(Features::HeraldBluetoothProtocolConnection,2);
+    c.start();
+    c.iteration();
+    REQUIRE(c.runningActivities() == 2);
+    REQUIRE(c.schedulerMetrics().throttled == 2);
+    c.awaitActivities();
+    c.iteration(); // starts the remaining two
+    c.awaitActivities();
+    REQUIRE(provider.executed == count);
+    REQUIRE(provider.maxRunning == 2);
+  }
+  c.stop();
+}
+
+TEST_CASE("coordinator-async-destroy", "[scheduler][coordinator][async][destroy]") {
+  DummyLoggingSink dls;
+  DummyBluetoothStateManager dbsm;
+  herald::DefaultPlatformType dpt;
+  herald::Context ctx(dpt,dls,dbsm);
+  using CT = typename herald::Context<herald::DefaultPlatformType,DummyLoggingSink,DummyBluetoothStateManager>;
+
+  const std::size_t count = 4;
+  SlowCoordinationProvider provider(count,std::chrono::milliseconds(50));
+  SlowSensor sensor(provider);
+  WorkerPool pool(count,16); // outlives the Coordinator
+  {
+    Coordinator<CT> c(ctx);
+    c.add(sensor);
+    c.setWorkerPool(&pool);
+    c.start();
+    c.iteration();
+    REQUIRE(c.runningActivities() == count);
+    // Destroyed without stop(), while its activities are still running
+  }
+  REQUIRE(provider.executed == count);
+  REQUIRE(pool.pending() == 0);
+}
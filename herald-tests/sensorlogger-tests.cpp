@@ -6,6 +6,10 @@
 
 #include "catch.hpp"
 
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
 #include <string>
 
 #include "herald/herald.h"
@@ -251,4 +255,211 @@ TEST_CASE("sensorlogger-output-targetidentifier", "[sensorlogger][output]") {
     HTLOG("Complex {} type",t);
     REQUIRE(strcmp(r.c_str(),dls.value.c_str()) == 0);
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("sensorlogger-logformat-parse", "[sensorlogger][logformat]") {
+  SECTION("sensorlogger-logformat-parse") {
+    static constexpr herald::data::LogFormat<herald::data::placeholderCount("a {} b {} c")> f("a {} b {} c");
+    static_assert(2 == f.segments.size() - 1, "Placeholders counted at compile time");
+    static_assert(0 == f.segments[0].offset && 2 == f.segments[0].length, "Segments parsed at compile time");
+    REQUIRE(f.segment(0) == "a ");
+    REQUIRE(f.segment(1) == " b ");
+    REQUIRE(f.segment(2) == " c");
+    REQUIRE(f.literalLength() == 7);
+
+    // A lone '{' is a placeholder, as in tprintf
+    static constexpr herald::data::LogFormat<herald::data::placeholderCount("x{y}")> g("x{y}");
+    REQUIRE(g.segments.size() == 2);
+    REQUIRE(g.segment(0) == "x");
+    REQUIRE(g.segment(1) == "y}");
+  }
+}
+
+TEST_CASE("sensorlogger-logformat-matches-tprintf", "[sensorlogger][logformat]") {
+  SECTION("sensorlogger-logformat-matches-tprintf") {
+    DummyLoggingSink dls;
+    DummyBluetoothStateManager dbsm;
+    herald::DefaultPlatformType dpt;
+    herald::Context ctx(dpt,dls,dbsm); // default context include
+    herald::data::SensorLogger logger(ctx.getLoggingSink(),"testout","mytest");
+
+    // Runtime format strings go through tprintf, literals through the macro's compile time format
+    auto same = [&dls](auto&& runtime, auto&& compiled) {
+      runtime();
+      std::string expected(dls.value.c_str()); // without tprintf's trailing std::ends
+      compiled();
+      REQUIRE(expected == dls.value);
+    };
+    same([&] { logger.debug(std::string("{}{}{}"),1,2,3); },
+         [&] { HTDBG("{}{}{}",1,2,3); });
+    same([&] { logger.debug(std::string("{} at start and more {} than {}"),-1,'c'); },
+         [&] { HTDBG("{} at start and more {} than {}",-1,'c'); });
+    same([&] { logger.debug(std::string("}{ odd {"),1,2,3); },
+         [&] { HTDBG("}{ odd {",1,2,3); });
+    same([&] { logger.debug(std::string("Types {} {} {}"),2.25,true,std::string("str")); },
+         [&] { HTDBG("Types {} {} {}",2.25,true,std::string("str")); });
+    // tprintf only writes 8 bit integers as numbers when they are the last argument
+    same([&] { logger.debug(std::string("Small {}"),std::int8_t(-8)); },
+         [&] { HTDBG("Small {}",std::int8_t(-8)); });
+    same([&] { logger.debug(std::string("Small {}"),std::uint8_t(8)); },
+         [&] { HTDBG("Small {}",std::uint8_t(8)); });
+    HTDBG("Small {} {}",std::int8_t(-8),std::uint8_t(8));
+    REQUIRE(dls.value == "testout,mytest,Small -8 8");
+    herald::datatype::Data d(std::byte(0x0a),3);
+    same([&] { logger.debug(std::string("Streamed {}"),d); },
+         [&] { HTDBG("Streamed {}",d); });
+    same([&] { logger.debug(std::string("Literal {}"),"text"); },
+         [&] { HTDBG("Literal {}","text"); });
+    const char* none = nullptr;
+    HTDBG("Null {} pointer",none);
+    REQUIRE(dls.value == "testout,mytest,Null  pointer");
+  }
+}
+
+/// \brief Keeps the last message only, without printing it
+struct LastMessageLoggingSink {
+  void log(const std::string&, const std::string&, herald::data::SensorLoggerLevel, std::string message) {
+    last = std::move(message);
+    ++count;
+  }
+
+  std::string last;
+  std::size_t count = 0;
+};
+
+using LastMessageContext = herald::Context<herald::DefaultPlatformType,LastMessageLoggingSink,DummyBluetoothStateManager>;
+
+TEST_CASE("sensorlogger-logformat-benchmark", "[.][benchmark][sensorlogger][logformat]") {
+  LastMessageLoggingSink sink;
+  DummyBluetoothStateManager dbsm;
+  herald::DefaultPlatformType dpt;
+  LastMessageContext ctx(dpt,sink,dbsm);
+  herald::data::SensorLogger logger(ctx.getLoggingSink(),"Sensor","BLE.ConcreteBLEDatabase");
+  std::string existing("0a0b0c0d0e0f");
+  std::string target("1a1b1c1d1e1f");
+  const int count = 1000000;
+
+  // The message logged for every known device, each time ConcreteBLEDatabase looks up a target
+  auto timed = [count](auto&& call) {
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0;i < count;++i) {
+      call();
+    }
+    return std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now() - started).count() / count;
+  };
+  double runtime = timed([&] {
+    logger.debug(std::string(" Testing existing target identifier {} against new target identifier {}"),existing,target);
+  });
+  std::string runtimeMessage(sink.last.c_str());
+  double compiled = timed([&] {
+    HTDBG(" Testing existing target identifier {} against new target identifier {}",existing,target);
+  });
+  REQUIRE(runtimeMessage == sink.last);
+
+  // End to end: lookups in a full database, which logs a comparison per device
+  using CT = LastMessageContext;
+  herald::ble::ConcreteBLEDatabase<CT> db(ctx);
+  std::vector<herald::datatype::TargetIdentifier> targets;
+  for (std::uint8_t i = 0;i < 10;++i) {
+    targets.emplace_back(herald::datatype::Data(std::byte(i),6));
+    db.device(targets.back());
+  }
+  const int lookups = 100000;
+  sink.count = 0;
+  auto started = std::chrono::steady_clock::now();
+  for (int i = 0;i < lookups;++i) {
+    db.device(targets[i % targets.size()]);
+  }
+  double lookup = std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now() - started).count() / lookups;
+
+  std::cout << std::fixed << std::setprecision(1)
+            << "ConcreteBLEDatabase debug message, runtime format (tprintf): " << runtime << " ns" << std::endl
+            << "ConcreteBLEDatabase debug message, compile time format:      " << compiled << " ns" << std::endl
+            << std::setprecision(3)
+            << "ConcreteBLEDatabase::device(TargetIdentifier) with 10 devices: " << lookup << " us per lookup, "
+            << (sink.count / lookups) << " messages per lookup" << std::endl;
+}
+
+TEST_CASE("sensorlogger-levelfilter", "[sensorlogger][levelfilter]") {
+  using herald::data::LogLevelFilter;
+  using herald::data::SensorLoggerLevel;
+  LastMessageLoggingSink sink;
+  DummyBluetoothStateManager dbsm;
+  herald::DefaultPlatformType dpt;
+  LastMessageContext ctx(dpt,sink,dbsm);
+  herald::data::SensorLogger logger(ctx.getLoggingSink(),"filtertest","first");
+  herald::data::SensorLogger other(ctx.getLoggingSink(),"filtertest","second");
+  herald::data::SensorLogger unrelated(ctx.getLoggingSink(),"filterother","first");
+
+  SECTION("sensorlogger-levelfilter-default") {
+    REQUIRE(logger.enabled(SensorLoggerLevel::debug));
+    HTDBG("Message {}",1);
+    REQUIRE(sink.count == 1);
+  }
+
+  SECTION("sensorlogger-levelfilter-no-evaluation") {
+    LogLevelFilter::setLevel("filtertest","",SensorLoggerLevel::info);
+    int evaluated = 0;
+    auto argument = [&evaluated] { ++evaluated; return 1; };
+    HTDBG("Message {}",argument());
+    REQUIRE(evaluated == 0);
+    REQUIRE(sink.count == 0);
+    HTLOG("Message {}",argument());
+    REQUIRE(evaluated == 1);
+    REQUIRE(sink.count == 1);
+    logger.debug(std::string("Runtime {}"),2);
+    REQUIRE(sink.count == 1);
+  }
+
+  SECTION("sensorlogger-levelfilter-most-specific") {
+    LogLevelFilter::disable("","");
+    LogLevelFilter::setLevel("filtertest","",SensorLoggerLevel::fault);
+    LogLevelFilter::setLevel("filtertest","second",SensorLoggerLevel::debug);
+    REQUIRE(!logger.enabled(SensorLoggerLevel::info));
+    REQUIRE(logger.enabled(SensorLoggerLevel::fault));
+    REQUIRE(other.enabled(SensorLoggerLevel::debug));
+    REQUIRE(!unrelated.enabled(SensorLoggerLevel::fault));
+
+    // Loggers created later, and copies, pick up the settings
+    herald::data::SensorLogger later(ctx.getLoggingSink(),"filterother","later");
+    REQUIRE(!later.enabled(SensorLoggerLevel::fault));
+    auto copy = other;
+    REQUIRE(copy.enabled(SensorLoggerLevel::debug));
+
+    LogLevelFilter::reset();
+    REQUIRE(later.enabled(SensorLoggerLevel::debug));
+    REQUIRE(unrelated.enabled(SensorLoggerLevel::debug));
+    REQUIRE(logger.enabled(SensorLoggerLevel::debug));
+  }
+
+  LogLevelFilter::reset();
+}
+
+TEST_CASE("sensorlogger-levelfilter-benchmark", "[.][benchmark][sensorlogger][levelfilter]") {
+  LastMessageLoggingSink sink;
+  DummyBluetoothStateManager dbsm;
+  herald::DefaultPlatformType dpt;
+  LastMessageContext ctx(dpt,sink,dbsm);
+  herald::data::SensorLogger logger(ctx.getLoggingSink(),"Sensor","BLE.ConcreteBLEDatabase");
+  herald::datatype::TargetIdentifier existing(herald::datatype::Data(std::byte(1),6));
+  herald::datatype::TargetIdentifier target(herald::datatype::Data(std::byte(2),6));
+  const int count = 1000000;
+
+  auto timed = [&] {
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0;i < count;++i) {
+      HTDBG(" Testing existing target identifier {} against new target identifier {}",(std::string)existing,(std::string)target);
+    }
+    return std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now() - started).count() / count;
+  };
+  double enabled = timed();
+  herald::data::LogLevelFilter::setLevel("Sensor","",herald::data::SensorLoggerLevel::info);
+  sink.count = 0;
+  double disabled = timed();
+  herald::data::LogLevelFilter::reset();
+  REQUIRE(sink.count == 0);
+
+  std::cout << std::fixed << std::setprecision(1)
+            << "ConcreteBLEDatabase debug message, enabled:             " << enabled << " ns" << std::endl
+            << "ConcreteBLEDatabase debug message, disabled at runtime: " << disabled << " ns" << std::endl;
+}
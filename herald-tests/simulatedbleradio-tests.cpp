@@ -0,0 +1,261 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "test-templates.h"
+
+#include "catch.hpp"
+
+#include "herald/herald.h"
+
+using namespace herald::ble;
+
+/// \brief Records a hash of every advert heard, to compare runs
+struct RecordingRadioListener : public SimulatedBLERadioListener {
+  RecordingRadioListener() : hash(0), heard(0), devices() {}
+  ~RecordingRadioListener() = default;
+
+  void simulatedAdvert(const SimulatedBLEAdvert& advert) override {
+    hash = hash * 31 + advert.at;
+    hash = hash * 31 + std::uint64_t(advert.rssi + 200);
+    for (auto b : advert.address) {
+      hash = hash * 31 + b;
+    }
+    ++heard;
+    devices.insert(advert.device);
+  }
+
+  std::uint64_t hash;
+  std::uint64_t heard;
+  std::set<std::size_t> devices;
+};
+
+/// \brief Counts payloads read by a ConcreteBLESensor
+struct PayloadCountingDelegate {
+  PayloadCountingDelegate() : payloads(), reads(0) {}
+
+  void sensor(herald::datatype::SensorType, const herald::datatype::PayloadData& didRead,
+    const herald::datatype::TargetIdentifier&) {
+    ++reads;
+    payloads.insert(didRead.hashCode());
+  }
+
+  std::set<std::size_t> payloads;
+  std::size_t reads;
+};
+
+static SimulatedBLEDevice simulatedDevice(double x, double y, std::uint64_t payload) {
+  SimulatedBLEDevice device;
+  device.x = x;
+  device.y = y;
+  device.payload = payload;
+  return device;
+}
+
+static void populate(SimulatedBLERadio& radio, std::size_t count) {
+  // Square grid 1.5m apart around the local device, one in four iOS style (no pseudo address)
+  std::size_t side = 1;
+  while (side * side < count) {
+    ++side;
+  }
+  for (std::size_t i = 0;i < count;++i) {
+    auto device = simulatedDevice(1.5 * (double(i % side) - side / 2.0), 1.5 * (double(i / side) - side / 2.0), i + 1);
+    device.pseudoAddress = (i % 4 != 0);
+    device.advertIntervalMillis = 200 + (i % 5) * 50;
+    radio.add(device);
+  }
+}
+
+TEST_CASE("simulatedbleradio-deterministic", "[ble][simulatedradio][deterministic]") {
+  auto run = [](std::uint64_t seed) {
+    SimulatedBLERadio radio(seed);
+    RecordingRadioListener listener;
+    radio.listener(&listener);
+    radio.scanning(true);
+    populate(radio, 50);
+    for (int i = 0;i < 40;++i) {
+      radio.advance(250);
+      radio.connect(i % 50);
+      radio.gattOperation(i % 50);
+      radio.disconnect(i % 50);
+    }
+    return std::make_pair(listener.hash, radio.metrics().connectionFailures);
+  };
+  auto first = run(42);
+  REQUIRE(first == run(42));
+  REQUIRE(first.first != run(43).first);
+}
+
+TEST_CASE("simulatedbleradio-adverts", "[ble][simulatedradio][adverts]") {
+  SimulatedBLERadio radio(7);
+  RecordingRadioListener listener;
+  radio.listener(&listener);
+  auto near = radio.add(simulatedDevice(2, 0, 1));
+  auto far = radio.add(simulatedDevice(5000, 0, 2));
+
+  SECTION("simulatedbleradio-adverts-scanning") {
+    radio.advance(1000);
+    REQUIRE(listener.heard == 0); // not scanning
+    radio.scanning(true);
+    radio.advance(1000);
+    // 250ms interval with up to 10ms jitter
+    REQUIRE(listener.heard >= 3);
+    REQUIRE(listener.heard <= 4);
+    REQUIRE(listener.devices.count(near) == 1);
+    REQUIRE(listener.devices.count(far) == 0);
+    REQUIRE(radio.metrics().advertsSent > radio.metrics().advertsHeard);
+    REQUIRE(radio.now() == 2000);
+  }
+
+  SECTION("simulatedbleradio-adverts-busy") {
+    radio.scanning(true);
+    REQUIRE(radio.connect(near) == (radio.metrics().connectionFailures == 0));
+    radio.device(near).gattLatencyMillis = 1000;
+    std::uint64_t heard = listener.heard;
+    if (radio.connected(near)) {
+      REQUIRE(radio.gattOperation(near));
+    }
+    // Nothing is heard while the local radio is busy
+    REQUIRE(listener.heard == heard);
+    REQUIRE(!radio.connect(far));
+    REQUIRE(radio.metrics().busyMillis >= 2000);
+  }
+}
+
+TEST_CASE("simulatedbleradio-rotation", "[ble][simulatedradio][rotation]") {
+  SimulatedBLERadio radio(99);
+  auto android = simulatedDevice(1, 0, 1);
+  android.macRotationMillis = 1000;
+  auto ios = simulatedDevice(1, 0, 2);
+  ios.macRotationMillis = 1000;
+  ios.pseudoAddress = false;
+  auto a = radio.add(android);
+  auto i = radio.add(ios);
+
+  auto androidMac = radio.address(a);
+  auto iosMac = radio.address(i);
+  REQUIRE(radio.find(androidMac) == a);
+  REQUIRE(radio.find(iosMac) == i);
+
+  radio.advance(5000);
+  REQUIRE(radio.metrics().macRotations >= 8);
+  REQUIRE(radio.address(a) != androidMac);
+  REQUIRE(!radio.find(androidMac).has_value());
+  REQUIRE(!radio.find(iosMac).has_value());
+  REQUIRE(radio.find(radio.address(i)) == i);
+  // The pseudo address does not rotate
+  REQUIRE(radio.find(radio.pseudoAddress(a)) == a);
+}
+
+/// \brief Discards log output, which would otherwise dominate timings with thousands of devices
+struct SilentLoggingSink {
+  void log(const std::string&,const std::string&,herald::data::SensorLoggerLevel, std::string) {}
+};
+
+using SimulatedContext = herald::Context<herald::DefaultPlatformType,SilentLoggingSink,DummyBluetoothStateManager>;
+using SimulatedDelegates = herald::SensorDelegateSet<PayloadCountingDelegate>;
+template <std::size_t DBSize>
+using SimulatedSensor = herald::ble::ConcreteBLESensor<SimulatedContext,
+  herald::payload::fixed::ConcreteFixedPayloadDataSupplierV1,SimulatedDelegates,DBSize>;
+
+TEST_CASE("simulatedbleradio-sensor", "[ble][simulatedradio][sensor]") {
+  SilentLoggingSink sls;
+  DummyBluetoothStateManager dbsm;
+  herald::DefaultPlatformType dpt;
+  SimulatedContext ctx(dpt,sls,dbsm);
+  herald::payload::fixed::ConcreteFixedPayloadDataSupplierV1 pds(826,4,123456);
+  PayloadCountingDelegate counter;
+  SimulatedDelegates delegates(counter);
+
+  SimulatedBLERadio radio(2021);
+  populate(radio, 12);
+  // Connection backoff runs on wall clock time, which barely moves during this test
+  for (std::size_t i = 0;i < radio.size();++i) {
+    radio.device(i).connectionFailureRate = 0;
+  }
+  auto notHerald = simulatedDevice(3, 3, 999);
+  notHerald.heraldService = false;
+  radio.add(notHerald);
+  radio.add(simulatedDevice(4000, 0, 1000)); // out of range
+
+  auto sensor = std::make_unique<SimulatedSensor<32>>(ctx,dbsm,pds,delegates);
+  sensor->simulatedRadio(radio);
+  herald::engine::Coordinator<SimulatedContext> coordinator(ctx);
+  coordinator.add(*sensor);
+  coordinator.start();
+  sensor->start();
+  REQUIRE(radio.scanning());
+  REQUIRE(radio.advertising());
+
+  for (int i = 0;i < 200 && counter.payloads.size() < 12;++i) {
+    radio.advance(250);
+    coordinator.iteration();
+  }
+  sensor->stop();
+  coordinator.stop();
+  REQUIRE(!radio.scanning());
+  REQUIRE(!radio.advertising());
+
+  // Every Herald device in range is identified, and nothing else
+  REQUIRE(counter.payloads.size() == 12);
+  REQUIRE(radio.metrics().connectionAttempts >= 12);
+  REQUIRE(radio.metrics().gattOperations >= 24);
+}
+
+template <std::size_t DBSize>
+static void simulatedSensorScaling(std::size_t devices) {
+  SilentLoggingSink sls;
+  DummyBluetoothStateManager dbsm;
+  herald::DefaultPlatformType dpt;
+  SimulatedContext ctx(dpt,sls,dbsm);
+  herald::payload::fixed::ConcreteFixedPayloadDataSupplierV1 pds(826,4,123456);
+  PayloadCountingDelegate counter;
+  SimulatedDelegates delegates(counter);
+
+  SimulatedBLERadio radio(devices);
+  populate(radio, devices);
+  auto sensor = std::make_unique<SimulatedSensor<DBSize>>(ctx,dbsm,pds,delegates);
+  sensor->simulatedRadio(radio);
+  herald::engine::Coordinator<SimulatedContext> coordinator(ctx);
+  coordinator.add(*sensor);
+  coordinator.start();
+  sensor->start();
+
+  // One simulated minute, in 250ms coordinator iterations
+  const int iterations = 240;
+  auto started = std::chrono::steady_clock::now();
+  for (int i = 0;i < iterations;++i) {
+    radio.advance(250);
+    coordinator.iteration();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  sensor->stop();
+  coordinator.stop();
+
+  const auto& m = radio.metrics();
+  std::cout << std::setw(6) << devices
+            << std::setw(10) << m.advertsHeard
+            << std::setw(12) << std::fixed << std::setprecision(0) << (m.advertsHeard / seconds)
+            << std::setw(12) << std::setprecision(3) << (1000.0 * seconds / iterations)
+            << std::setw(10) << m.connectionAttempts
+            << std::setw(10) << counter.payloads.size()
+            << std::endl;
+}
+
+TEST_CASE("simulatedbleradio-sensor-scaling", "[.][benchmark][ble][simulatedradio][scaling]") {
+  // Database capacity is fixed (and bounded by the shared Data memory arena), so in larger
+  // crowds devices are evicted and rediscovered. This measures the cost of that churn.
+  std::cout << "Simulated BLE sensor, 60 simulated seconds, database of 48 devices" << std::endl;
+  std::cout << "devices    adverts  adverts/s  ms/iteration  connects  payloads" << std::endl;
+  for (std::size_t devices : {10, 100, 500, 1000, 2000}) {
+    simulatedSensorScaling<48>(devices);
+  }
+}
@@ -14,6 +14,7 @@ set(HERALD_HEADERS
   ${HERALD_BASE}/include/herald/analysis/aggregates.h
   ${HERALD_BASE}/include/herald/analysis/distance_conversion.h
   ${HERALD_BASE}/include/herald/analysis/logging_analysis_delegate.h
+  ${HERALD_BASE}/include/herald/analysis/pipeline.h
   ${HERALD_BASE}/include/herald/analysis/ranges.h
   ${HERALD_BASE}/include/herald/analysis/risk.h
   ${HERALD_BASE}/include/herald/analysis/runner.h
@@ -21,6 +22,7 @@ set(HERALD_HEADERS
   ${HERALD_BASE}/include/herald/analysis/sensor_source.h
   ${HERALD_BASE}/include/herald/ble/ble.h
   ${HERALD_BASE}/include/herald/ble/ble_concrete.h
+  ${HERALD_BASE}/include/herald/ble/ble_connection_scheduler.h
   ${HERALD_BASE}/include/herald/ble/ble_coordinator.h
   ${HERALD_BASE}/include/herald/ble/ble_database_delegate.h
   ${HERALD_BASE}/include/herald/ble/ble_database.h
@@ -35,10 +37,16 @@ set(HERALD_HEADERS
   ${HERALD_BASE}/include/herald/ble/ble_tx_power.h
   ${HERALD_BASE}/include/herald/ble/bluetooth_state_manager.h
   ${HERALD_BASE}/include/herald/ble/bluetooth_state_manager_delegate.h
+  ${HERALD_BASE}/include/herald/ble/default/simulated_ble_radio.h
   ${HERALD_BASE}/include/herald/ble/filter/ble_advert_parser.h
   ${HERALD_BASE}/include/herald/ble/filter/ble_advert_types.h
   ${HERALD_BASE}/include/herald/ble/zephyr/nordic_uart/nordic_uart_sensor_delegate.h
+  ${HERALD_BASE}/include/herald/data/async_logging_sink.h
+  ${HERALD_BASE}/include/herald/data/binary_logging_sink.h
   ${HERALD_BASE}/include/herald/data/contact_log.h
+  ${HERALD_BASE}/include/herald/data/contact_log_writer.h
+  ${HERALD_BASE}/include/herald/data/encounter_store.h
+  ${HERALD_BASE}/include/herald/data/log_format.h
   ${HERALD_BASE}/include/herald/data/payload_data_formatter.h
   ${HERALD_BASE}/include/herald/data/sensor_logger.h
   ${HERALD_BASE}/include/herald/data/stdout_logging_sink.h
@@ -71,6 +79,10 @@ set(HERALD_HEADERS
   ${HERALD_BASE}/include/herald/datatype/wgs84.h
   ${HERALD_BASE}/include/herald/engine/activities.h
   ${HERALD_BASE}/include/herald/engine/coordinator.h
+  ${HERALD_BASE}/include/herald/engine/feature_registry.h
+  ${HERALD_BASE}/include/herald/engine/metrics.h
+  ${HERALD_BASE}/include/herald/engine/scheduler.h
+  ${HERALD_BASE}/include/herald/engine/worker_pool.h
   ${HERALD_BASE}/include/herald/payload/payload_data_supplier.h
   ${HERALD_BASE}/include/herald/payload/beacon/beacon_payload_data_supplier.h
   ${HERALD_BASE}/include/herald/payload/fixed/fixed_payload_data_supplier.h
@@ -107,6 +119,7 @@ set(HERALD_HEADERS_WINDOWS
 set(HERALD_SOURCES
   ${HERALD_BASE}/src/ble/ble.cpp
   ${HERALD_BASE}/src/ble/ble_mac_address.cpp
+  ${HERALD_BASE}/src/ble/ble_connection_scheduler.cpp
   ${HERALD_BASE}/src/ble/ble_coordinator.cpp
   ${HERALD_BASE}/src/ble/ble_device.cpp
   ${HERALD_BASE}/src/ble/ble_sensor_configuration.cpp
@@ -114,9 +127,14 @@ set(HERALD_SOURCES
   ${HERALD_BASE}/src/ble/bluetooth_state_manager_delegate.cpp
   ${HERALD_BASE}/src/ble/concrete_ble_sensor.cpp
   ${HERALD_BASE}/src/ble/concrete_ble_database.cpp
+  ${HERALD_BASE}/src/ble/default/simulated_ble_radio.cpp
   ${HERALD_BASE}/src/ble/filter/ble_advert_parser.cpp
   ${HERALD_BASE}/src/ble/filter/ble_advert_types.cpp
+  ${HERALD_BASE}/src/data/async_logging_sink.cpp
+  ${HERALD_BASE}/src/data/binary_logging_sink.cpp
   ${HERALD_BASE}/src/data/concrete_payload_data_formatter.cpp
+  ${HERALD_BASE}/src/data/contact_log_writer.cpp
+  ${HERALD_BASE}/src/data/encounter_store.cpp
   ${HERALD_BASE}/src/data/sensor_logger.cpp
   ${HERALD_BASE}/src/data/stdout_logging_sink.cpp
   ${HERALD_BASE}/src/datatype/base64_string.cpp
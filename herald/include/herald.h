@@ -65,7 +65,12 @@
 #include "herald/datatype/wgs84.h"
 
 // data namespace
+#include "herald/data/async_logging_sink.h"
+#include "herald/data/binary_logging_sink.h"
 #include "herald/data/contact_log.h"
+#include "herald/data/contact_log_writer.h"
+#include "herald/data/encounter_store.h"
+#include "herald/data/log_format.h"
 #include "herald/data/payload_data_formatter.h"
 #include "herald/data/sensor_logger.h"
 #include "herald/data/stdout_logging_sink.h"
@@ -73,9 +78,14 @@
 // engine namespace
 #include "herald/engine/activities.h"
 #include "herald/engine/coordinator.h"
+#include "herald/engine/feature_registry.h"
+#include "herald/engine/metrics.h"
+#include "herald/engine/scheduler.h"
+#include "herald/engine/worker_pool.h"
 
 // ble namespace
 #include "herald/ble/ble.h"
+#include "herald/ble/ble_connection_scheduler.h"
 #include "herald/ble/ble_coordinator.h"
 #include "herald/ble/ble_database_delegate.h"
 #include "herald/ble/ble_database.h"
@@ -90,6 +100,7 @@
 #include "herald/ble/ble_tx_power.h"
 #include "herald/ble/bluetooth_state_manager.h"
 #include "herald/ble/bluetooth_state_manager_delegate.h"
+#include "herald/ble/default/simulated_ble_radio.h"
 
 #include "herald/ble/filter/ble_advert_types.h"
 #include "herald/ble/filter/ble_advert_parser.h"
@@ -104,6 +115,7 @@
 #include "herald/analysis/aggregates.h"
 #include "herald/analysis/distance_conversion.h"
 #include "herald/analysis/logging_analysis_delegate.h"
+#include "herald/analysis/pipeline.h"
 #include "herald/analysis/ranges.h"
 #include "herald/analysis/risk.h"
 #include "herald/analysis/runner.h"
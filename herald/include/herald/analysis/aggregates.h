@@ -124,8 +124,11 @@ private:
   std::map<double,int> counts; // value converted to double, and int count for each
 };
 
+struct OnePassVariance; // fwd decl
+
 struct Variance {
   static constexpr int runs = 2;
+  using one_pass_type = OnePassVariance; // used by fused pipelines
 
   Variance() : count(0), run(1), sum(0.0), mean(0.0) {}
   ~Variance() = default;
@@ -175,6 +178,51 @@ private:
 };
 
 
+/// \brief Single pass (Welford) form of Variance for use in fused pipelines
+struct OnePassVariance {
+  static constexpr int runs = 1;
+
+  OnePassVariance() : count(0), run(1), mean(0.0), m2(0.0) {}
+  OnePassVariance(const Variance&) : OnePassVariance() {}
+  ~OnePassVariance() = default;
+
+  void beginRun(int thisRun) { // 1 indexed
+    run = thisRun;
+  }
+
+  template <typename ValT>
+  void map(ValT value) {
+    if (run > 1) return; // performance enhancement
+
+    double dv = (double)value;
+    ++count;
+    double delta = dv - mean;
+    mean += delta / count;
+    m2 += delta * (dv - mean);
+  }
+
+  double reduce() {
+    if (count < 1) {
+      return 0.0; // div by zero check
+    }
+    return m2 / (count - 1); // Sample variance
+  }
+
+  void reset() {
+    count = 0;
+    run = 1;
+    mean = 0.0;
+    m2 = 0.0;
+  }
+
+private:
+  int count;
+  int run;
+  double mean;
+  double m2;
+};
+
+
 struct Median {
   static constexpr int runs = 1;
 
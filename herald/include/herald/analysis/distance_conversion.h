@@ -8,6 +8,7 @@
 #include <cmath>
 
 #include "aggregates.h"
+#include "pipeline.h"
 #include "ranges.h"
 #include "runner.h"
 #include "sampling.h"
@@ -63,8 +64,8 @@ struct FowlerBasicAnalyser {
   using output_value_type = Distance;
 
   /// default constructor required for array instantiation in manager AnalysisProviderManager
-  FowlerBasicAnalyser() : interval(10), basic(-11,-0.4), lastRan(0) {}
-  FowlerBasicAnalyser(long interval, double intercept, double coefficient) : interval(interval), basic(intercept, coefficient), lastRan(0) {}
+  FowlerBasicAnalyser() : interval(10), basic(-11,-0.4) {}
+  FowlerBasicAnalyser(long interval, double intercept, double coefficient) : interval(interval), basic(intercept, coefficient) {}
   ~FowlerBasicAnalyser() = default;
 
   // Generic
@@ -77,6 +78,10 @@ struct FowlerBasicAnalyser {
   // Specialisation
   template <std::size_t SrcSz,std::size_t DstSz, typename CallableForNewSample>
   bool analyse(Date timeNow, SampledID sampled, SampleList<Sample<RSSI>,SrcSz>& src, SampleList<Sample<Distance>,DstSz>& dst, CallableForNewSample& callable) {
+    // Each sampled ID has its own interval, otherwise only the first ID seen would ever be analysed.
+    // The last run is the time of this ID's latest output, so no per ID state is held here and
+    // none outlives the ID's lists in the ListManager
+    Date lastRan = 0 == dst.size() ? Date(0) : dst.latest();
     if (lastRan + interval >= timeNow) return false; // interval guard
     // std::cout << "RUNNING FOWLER BASIC ANALYSIS at " << timeNow.secondsSinceUnixEpoch() << std::endl;
 
@@ -84,29 +89,18 @@ struct FowlerBasicAnalyser {
 
     // Check that there has been any new data since the last run
     herald::analysis::views::since sinceLastRun(lastRan);
-    auto newData = src
-                 | herald::analysis::views::filter(valid) 
-                 | herald::analysis::views::filter(sinceLastRun)
-                 | herald::analysis::views::to_view();
-    // if (newData.ended()) { // Doesn't work because the filter's are not applied until a data item is fetched
-    //   lastRan = timeNow;
-    //   return false;
-    // }
 
     basic.reset();
 
-    auto values = src 
-                | herald::analysis::views::filter(valid) 
-                | herald::analysis::views::filter(sinceLastRun)
-                | herald::analysis::views::to_view();
-
-    auto summary = newData
-                 | summarise<Count,Mode,Variance>();
+    // Single pass over the new data only
+    auto summary = src
+                 | herald::analysis::pipeline::filter(valid)
+                 | herald::analysis::pipeline::filter(sinceLastRun)
+                 | herald::analysis::pipeline::summarise<Count,Mode,Variance>();
 
     auto count = summary.template get<Count>();
     if (0.0 == count) {
       // No actual new data after filtering has been applied
-      lastRan = timeNow;
       return false;
     }
     auto mode = summary.template get<Mode>();
@@ -114,21 +108,20 @@ struct FowlerBasicAnalyser {
     auto sd = std::sqrt(var);
 
     auto distance = src 
-                  | herald::analysis::views::filter(valid) 
-                  | herald::analysis::views::filter(
+                  | herald::analysis::pipeline::filter(valid) 
+                  | herald::analysis::pipeline::filter(
                       herald::analysis::views::in_range(
                         mode - 2*sd, // NOTE: WE USE THE MODE FOR FILTER, BUT SD FOR BOUNDS - See website for the reasoning
                         mode + 2*sd
                       )
                     )
-                  | aggregate(basic); // type actually <herald::analysis::algorithms::distance::FowlerBasic>
+                  | herald::analysis::pipeline::aggregate(basic); // type actually <herald::analysis::algorithms::distance::FowlerBasic>
     
     auto agg = distance.template get<FowlerBasic>();
     auto d = agg.reduce();
 
 
-    Date latestTime = values.latest();
-    lastRan = latestTime; // TODO move this logic to the caller not the analysis provider
+    Date latestTime = src.latest(); // becomes the last run time via dst
     // std::cout << "Latest value at time: " << latestTime.secondsSinceUnixEpoch() << std::endl;
 
     Sample<Distance> newSample((Date)latestTime,Distance(d));
@@ -140,7 +133,6 @@ struct FowlerBasicAnalyser {
 private:
   TimeInterval interval;
   FowlerBasic basic;
-  Date lastRan;
 };
 
 }
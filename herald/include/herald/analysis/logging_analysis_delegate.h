@@ -65,14 +65,14 @@ struct OptionalSensorLogger {
 
   void debug(std::string toLog,SampledID sampled,double value)
   {
-    HTDBG(toLog);
+    HTDBG("{}",toLog);
     // HTDBG(std::to_string(sampled));
     // HTDBG(std::to_string(value));
   }
 
   void debug(std::string toLog)
   {
-    HTDBG(toLog);
+    HTDBG("{}",toLog);
   }
 
 private:
@@ -0,0 +1,176 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef HERALD_PIPELINE_H
+#define HERALD_PIPELINE_H
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "aggregates.h"
+#include "ranges.h"
+#include "sampling.h"
+
+namespace herald {
+namespace analysis {
+/// \brief Compile time fused analysis pipelines.
+///
+/// A drop in alternative to chaining views::filter and aggregates::summarise/aggregate.
+/// All filters and aggregates in a pipeline are applied in a single loop over the
+/// source collection with no intermediate iterator proxies. Use like:-
+/// auto summary = src
+///              | pipeline::filter(valid)
+///              | pipeline::filter(sinceLastRun)
+///              | pipeline::summarise<Count,Mode,Variance>();
+///
+/// Aggregates with runs > 1 are rejected at compile time unless they declare
+/// a one_pass_type (E.g. Variance uses OnePassVariance) which is used instead.
+namespace pipeline {
+
+/// \brief Resolves the aggregate type to use in a single pass
+template <typename Agg, typename = void>
+struct one_pass {
+  using type = Agg;
+};
+
+template <typename Agg>
+struct one_pass<Agg, std::void_t<typename Agg::one_pass_type>> {
+  using type = typename Agg::one_pass_type;
+};
+
+template <typename Agg>
+using one_pass_t = typename one_pass<Agg>::type;
+
+template <typename Agg>
+constexpr bool is_one_pass_v = (1 == one_pass_t<Agg>::runs);
+
+/// \brief A filter stage in a fused pipeline. Holds the predicate only.
+template <typename Pred>
+struct filter {
+  filter(const Pred& pred) : pred(pred) {}
+  ~filter() = default;
+
+  Pred pred;
+};
+
+/// \brief A source collection with zero or more filters applied, but not yet iterated
+template <typename Coll, typename... Preds>
+struct stage {
+  stage(Coll& coll, std::tuple<Preds...> preds) : coll(coll), preds(std::move(preds)) {}
+  ~stage() = default;
+
+  /// \brief Appends another filter. Evaluated after all prior filters (short circuit)
+  template <typename Pred>
+  friend auto operator|(stage<Coll,Preds...> from, filter<Pred> next) -> stage<Coll,Preds...,Pred> {
+    return stage<Coll,Preds...,Pred>(from.coll,std::tuple_cat(std::move(from.preds),std::make_tuple(next.pred)));
+  }
+
+  /// \brief Calls fn once for each value passing every filter, in a single loop
+  template <typename Fn>
+  void each(Fn&& fn) {
+    for (auto& v : coll) {
+      if (passes(v, std::index_sequence_for<Preds...>{})) {
+        fn(v);
+      }
+    }
+  }
+
+private:
+  Coll& coll;
+  std::tuple<Preds...> preds;
+
+  template <typename ValT, std::size_t... Is>
+  bool passes(const ValT& v, std::index_sequence<Is...>) const {
+    return (true && ... && std::get<Is>(preds)(v));
+  }
+};
+
+template <typename T>
+struct is_stage : std::false_type {};
+
+template <typename Coll, typename... Preds>
+struct is_stage<stage<Coll,Preds...>> : std::true_type {};
+
+/// \brief Starts a pipeline from a source collection
+template <typename Coll, typename Pred, std::enable_if_t<!is_stage<Coll>::value, bool> = true>
+auto operator|(Coll& from, filter<Pred> first) -> stage<Coll,Pred> {
+  return stage<Coll,Pred>(from,std::make_tuple(first.pred));
+}
+
+/// \brief Runs the fused loop for a tuple of aggregates
+template <typename StageT, typename... Aggs>
+void run(StageT& from, std::tuple<Aggs...>& aggregates) {
+  std::apply([](auto&... agg) { (agg.beginRun(1), ...); }, aggregates);
+  from.each([&aggregates](auto& v) {
+    std::apply([&v](auto&... agg) { (agg.map(v), ...); }, aggregates);
+  });
+}
+
+/// \brief Fused version of aggregates::summarise. Default constructs each aggregate.
+template <typename... Aggs>
+struct summarise {
+  static_assert((is_one_pass_v<Aggs> && ...), "Multi pass aggregates must declare a one_pass_type to be used in a fused pipeline");
+
+  summarise() : aggregates() {}
+  ~summarise() = default;
+
+  template <typename Coll, typename... Preds>
+  friend auto operator|(stage<Coll,Preds...> from, summarise<Aggs...> me) -> summarise<Aggs...> {
+    run(from,me.aggregates);
+    return me;
+  }
+
+  template <typename Coll, std::enable_if_t<!is_stage<Coll>::value, bool> = true>
+  friend auto operator|(Coll& from, summarise<Aggs...> me) -> summarise<Aggs...> {
+    stage<Coll> all(from,std::tuple<>());
+    run(all,me.aggregates);
+    return me;
+  }
+
+  template <typename Agg>
+  double get() {
+    return std::get<one_pass_t<Agg>>(aggregates).reduce();
+  }
+
+private:
+  std::tuple<one_pass_t<Aggs>...> aggregates;
+};
+
+/// \brief Fused version of aggregates::aggregate. Takes prior initialised (i.e. configured) aggregates.
+template <typename... Aggs>
+struct aggregate {
+  static_assert((is_one_pass_v<Aggs> && ...), "Multi pass aggregates must declare a one_pass_type to be used in a fused pipeline");
+  static_assert((std::is_constructible_v<one_pass_t<Aggs>,const Aggs&> && ...), "one_pass_type must be constructible from its multi pass aggregate");
+
+  aggregate(Aggs... configuredAggregates) : aggregates(one_pass_t<Aggs>(configuredAggregates)...) {}
+  ~aggregate() = default;
+
+  template <typename Coll, typename... Preds>
+  friend auto operator|(stage<Coll,Preds...> from, aggregate<Aggs...> me) -> aggregate<Aggs...> {
+    run(from,me.aggregates);
+    return me;
+  }
+
+  template <typename Coll, std::enable_if_t<!is_stage<Coll>::value, bool> = true>
+  friend auto operator|(Coll& from, aggregate<Aggs...> me) -> aggregate<Aggs...> {
+    stage<Coll> all(from,std::tuple<>());
+    run(all,me.aggregates);
+    return me;
+  }
+
+  template <typename Agg>
+  one_pass_t<Agg>& get() {
+    return std::get<one_pass_t<Agg>>(aggregates);
+  }
+
+private:
+  std::tuple<one_pass_t<Aggs>...> aggregates;
+};
+
+} // end namespace pipeline
+}
+}
+
+#endif
@@ -5,11 +5,17 @@
 #ifndef HERALD_RISK_H
 #define HERALD_RISK_H
 
+#include <array>
 #include <cmath>
+#include <cstdint>
+#include <map>
 
 #include "aggregates.h"
 #include "ranges.h"
 #include "sampling.h"
+#include "../datatype/date.h"
+#include "../datatype/distance.h"
+#include "../datatype/time_interval.h"
 
 namespace herald {
 namespace analysis {
@@ -17,6 +23,52 @@ namespace algorithms {
 namespace risk {
 
 using namespace herald::analysis::aggregates;
+using namespace herald::analysis::sampling;
+using namespace herald::datatype;
+
+/// \brief The risk score for a single distance-time slice.
+/// Shared by the batch RiskAggregationBasic and the streaming RiskAccumulator.
+/// NOT FOR PRODUCTION EPIDEMIOLOGICAL USE - SAMPLE ONLY!!!
+struct RiskSliceBasic {
+  /// Default values are unscaled (1 second, 1 metre, clamp at 1m with a risk of 1.0)
+  RiskSliceBasic() : RiskSliceBasic(1.0,1.0,1.0,1.0) {}
+  RiskSliceBasic(double timeScale,double distanceScale,double minimumDistanceClamp,double minimumRiskScoreAtClamp,double logScale = 3.3598856662 )
+    : timeScale(timeScale), distanceScale(distanceScale), minimumDistanceClamp(minimumDistanceClamp), 
+      minimumRiskScoreAtClamp(minimumRiskScoreAtClamp), logScale(logScale)
+  {
+    ; // no other set up
+  }
+  ~RiskSliceBasic() = default;
+
+  /// \brief Returns the risk for having been at distance for the given number of seconds
+  double operator()(double distance, long seconds) const {
+    double dist = distanceScale * distance;
+    double t = timeScale * seconds;
+
+    double riskSlice = minimumRiskScoreAtClamp; // assume < clamp distance
+    if (dist > minimumDistanceClamp) {
+      // otherwise, do the inverse log of distance to get the risk score
+
+      // don't forget to clamp at risk score
+      riskSlice = minimumRiskScoreAtClamp - (logScale * std::log10(dist));
+      if (riskSlice > minimumRiskScoreAtClamp) {
+        // possible as the passed in logScale could be a negative
+        riskSlice = minimumRiskScoreAtClamp;
+      }
+      if (riskSlice < 0.0) {
+        riskSlice = 0.0; // cannot have a negative slice
+      }
+    }
+    return riskSlice * t;
+  }
+
+private:
+  double timeScale;
+  double distanceScale;
+  double minimumDistanceClamp;
+  double minimumRiskScoreAtClamp;
+  double logScale;
+};
 
 /// A Basic sample but non scientific risk aggregation model.
 /// Similar in function to the Oxford Risk Model, but without its calibration values and scaling.
@@ -25,8 +77,8 @@ struct RiskAggregationBasic {
   static constexpr int runs = 1;
 
   RiskAggregationBasic(double timeScale,double distanceScale,double minimumDistanceClamp,double minimumRiskScoreAtClamp,double logScale = 3.3598856662 ) 
-    : run(1), timeScale(timeScale), distanceScale(distanceScale), minimumDistanceClamp(minimumDistanceClamp), 
-      minimumRiskScoreAtClamp(minimumRiskScoreAtClamp), logScale(logScale), nMinusOne(-1.0), n(-1.0), timeMinusOne(0), time(0), riskScore(0)
+    : run(1), slice(timeScale,distanceScale,minimumDistanceClamp,minimumRiskScoreAtClamp,logScale),
+      nMinusOne(-1.0), n(-1.0), timeMinusOne(0), time(0), riskScore(0)
   {
     ; // no other set up
   }
@@ -55,27 +107,7 @@ struct RiskAggregationBasic {
     if (-1.0 != nMinusOne) {
       // we have two values with which to calculate
       // using nMinusOne and n, and calculate interim risk score addition
-      double dist = distanceScale * n;
-      double t = timeScale * (time - timeMinusOne); // seconds
-
-      double riskSlice = minimumRiskScoreAtClamp; // assume < clamp distance
-      if (dist > minimumDistanceClamp) {
-        // otherwise, do the inverse log of distance to get the risk score
-
-        // don't forget to clamp at risk score
-        riskSlice = minimumRiskScoreAtClamp - (logScale * std::log10(dist));
-        if (riskSlice > minimumRiskScoreAtClamp) {
-          // possible as the passed in logScale could be a negative
-          riskSlice = minimumRiskScoreAtClamp;
-        }
-        if (riskSlice < 0.0) {
-          riskSlice = 0.0; // cannot have a negative slice
-        }
-      }
-      riskSlice *= t;
-      
-      // add it to the risk score
-      riskScore += riskSlice;
+      riskScore += slice(n, time - timeMinusOne);
     }
 
     // return current full risk score
@@ -92,11 +124,7 @@ struct RiskAggregationBasic {
 private:
   int run;
 
-  double timeScale;
-  double distanceScale;
-  double minimumDistanceClamp;
-  double minimumRiskScoreAtClamp;
-  double logScale;
+  RiskSliceBasic slice;
 
   double nMinusOne; // distance of n-1
   double n; // distance of n
@@ -106,6 +134,194 @@ private:
   double riskScore;
 };
 
+/// \brief Bounded exposure state for a single contact.
+///
+/// Holds only the last sample, the cumulative score, and the score for each of the
+/// last 24 hours and last Days days. Raw samples are never retained, so the size is
+/// fixed however long the contact is tracked for.
+template <std::size_t Days = 14>
+struct ContactExposure {
+  static constexpr std::size_t hours = 24;
+  static constexpr std::size_t days = Days;
+  static constexpr std::uint64_t secondsPerHour = 3600;
+  static constexpr std::uint64_t secondsPerDay = 86400;
+
+  ContactExposure() : lastTaken(0), lastDistance(-1.0), cumulative(0.0), newestHour(0), newestDay(0), hourScores(), dayScores() {}
+  ~ContactExposure() = default;
+
+  /// \brief Integrates the risk since the previous sample, if that was no more than maximumGap seconds ago.
+  /// Samples older than the latest one already seen are ignored.
+  template <typename RiskModelT>
+  void add(const RiskModelT& model, const Sample<Distance>& sample, std::uint64_t maximumGap) {
+    std::uint64_t when = sample.taken.secondsSinceUnixEpoch();
+    if (lastDistance >= 0.0) {
+      if (when < lastTaken) return; // out of order
+      std::uint64_t elapsed = when - lastTaken;
+      if (elapsed > 0 && elapsed <= maximumGap) {
+        record(when, model(sample.value.value, (long)elapsed));
+      }
+    }
+    lastTaken = when;
+    lastDistance = sample.value.value;
+  }
+
+  /// \brief Total risk score over the whole lifetime of this contact
+  double total() const noexcept {
+    return cumulative;
+  }
+
+  /// \brief Risk score within the last count hours (up to 24) as of now
+  double lastHours(const Date& now, std::size_t count) const noexcept {
+    return windowed(hourScores, newestHour, now.secondsSinceUnixEpoch() / secondsPerHour, count);
+  }
+
+  /// \brief Risk score within the last count days (up to Days) as of now
+  double lastDays(const Date& now, std::size_t count) const noexcept {
+    return windowed(dayScores, newestDay, now.secondsSinceUnixEpoch() / secondsPerDay, count);
+  }
+
+  Date lastSampled() const noexcept {
+    return Date(lastTaken);
+  }
+
+  double lastSampledDistance() const noexcept {
+    return lastDistance;
+  }
+
+private:
+  std::uint64_t lastTaken;
+  double lastDistance; // -1.0 means no sample yet
+  double cumulative;
+  std::uint64_t newestHour; // hours since epoch of the newest hour bucket
+  std::uint64_t newestDay; // days since epoch of the newest day bucket
+  std::array<double,hours> hourScores;
+  std::array<double,Days> dayScores;
+
+  void record(std::uint64_t when, double risk) noexcept {
+    cumulative += risk;
+    advance(hourScores, newestHour, when / secondsPerHour) += risk;
+    advance(dayScores, newestDay, when / secondsPerDay) += risk;
+  }
+
+  /// Moves the ring forward to bucket, zeroing any skipped buckets, and returns the bucket's score
+  template <std::size_t Sz>
+  static double& advance(std::array<double,Sz>& ring, std::uint64_t& newest, std::uint64_t bucket) noexcept {
+    if (bucket > newest) {
+      std::uint64_t skipped = bucket - newest;
+      if (skipped >= Sz) {
+        ring.fill(0.0);
+      } else {
+        for (std::uint64_t b = newest + 1;b <= bucket;++b) {
+          ring[b % Sz] = 0.0;
+        }
+      }
+      newest = bucket;
+    }
+    // add() ignores out of order samples, so bucket is never older than newest
+    return ring[bucket % Sz];
+  }
+
+  template <std::size_t Sz>
+  static double windowed(const std::array<double,Sz>& ring, std::uint64_t newest, std::uint64_t nowBucket, std::size_t count) noexcept {
+    if (count > Sz) {
+      count = Sz;
+    }
+    double sum = 0.0;
+    for (std::size_t i = 0;i < count && i <= nowBucket;++i) {
+      std::uint64_t bucket = nowBucket - i;
+      if (bucket > newest) continue; // no data recorded that recently
+      if (newest - bucket >= Sz) break; // already rolled out of the ring
+      sum += ring[bucket % Sz];
+    }
+    return sum;
+  }
+};
+
+/// \brief Streaming exposure accumulator across all contacts.
+///
+/// Integrates distance over time as each Sample<Distance> arrives and keeps a
+/// fixed size ContactExposure per SampledID. Can be used directly as an 
+/// AnalysisDelegate for Distance values in an AnalysisDelegateManager.
+/// NOT FOR PRODUCTION EPIDEMIOLOGICAL USE - SAMPLE ONLY!!!
+template <typename RiskModelT = RiskSliceBasic, std::size_t Days = 14>
+struct RiskAccumulator {
+  using value_type = Distance;
+
+  RiskAccumulator() : model(), maximumGap(TimeInterval::minutes(5).seconds()), contacts() {}
+  RiskAccumulator(RiskModelT model, TimeInterval maximumGap = TimeInterval::minutes(5))
+    : model(model), maximumGap(maximumGap.seconds()), contacts()
+  {
+    ;
+  }
+  ~RiskAccumulator() = default;
+
+  /// \brief Called by the analysis API (or directly) when a new distance is estimated
+  void newSample(SampledID sampled, Sample<Distance> sample) {
+    contacts.try_emplace(sampled).first->second.add(model, sample, maximumGap);
+  }
+
+  /// \brief Returns the exposure for a contact, or nullptr if never sampled
+  const ContactExposure<Days>* contact(SampledID sampled) const {
+    auto iter = contacts.find(sampled);
+    if (contacts.end() == iter) {
+      return nullptr;
+    }
+    return &iter->second;
+  }
+
+  /// \brief Total risk over all contacts for the last 24 hours
+  double lastDay(const Date& now) const {
+    double sum = 0.0;
+    for (auto& c : contacts) {
+      sum += c.second.lastHours(now, ContactExposure<Days>::hours);
+    }
+    return sum;
+  }
+
+  /// \brief Total risk over all contacts for the last count days (Days by default)
+  double lastDays(const Date& now, std::size_t count = Days) const {
+    double sum = 0.0;
+    for (auto& c : contacts) {
+      sum += c.second.lastDays(now, count);
+    }
+    return sum;
+  }
+
+  /// \brief Removes all contacts not sampled within the retained Days as of now
+  void removeExpired(const Date& now) {
+    std::uint64_t nowDay = now.secondsSinceUnixEpoch() / ContactExposure<Days>::secondsPerDay;
+    for (auto iter = contacts.begin();iter != contacts.end();) {
+      std::uint64_t lastDay = iter->second.lastSampled().secondsSinceUnixEpoch() / ContactExposure<Days>::secondsPerDay;
+      if (nowDay >= lastDay + Days) {
+        iter = contacts.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+  }
+
+  void remove(SampledID sampled) {
+    contacts.erase(sampled);
+  }
+
+  /// \brief Calls fn(SampledID, const ContactExposure<Days>&) for every contact
+  template <typename Fn>
+  void each(Fn fn) const {
+    for (auto& c : contacts) {
+      fn(c.first, c.second);
+    }
+  }
+
+  std::size_t size() const {
+    return contacts.size();
+  }
+
+private:
+  RiskModelT model;
+  std::uint64_t maximumGap; // seconds. Longer gaps mean the contact was lost
+  std::map<SampledID,ContactExposure<Days>> contacts;
+};
+
 }
 }
 }
@@ -91,6 +91,14 @@ public:
     return {};
   }
 
+#ifndef __ZEPHYR__
+  /// \brief Uses a simulated radio in place of Bluetooth hardware. Call before start().
+  void simulatedRadio(SimulatedBLERadio& radio) {
+    transmitter.simulatedRadio(radio);
+    receiver.simulatedRadio(radio);
+  }
+#endif
+
   bool immediateSend(Data data, const TargetIdentifier& targetIdentifier) {
     return receiver.immediateSend(data,targetIdentifier);
   }
@@ -186,7 +194,7 @@ public:
     }
   }
 
-  void bleDatabaseDidDelete(const BLEDevice& device) override {
+  void bleDatabaseDidDelete(const BLEDevice& /* device */) override {
     ; // TODO just log this // TODO determine if to pass this on too
     // TODO fire this for analysis runner and others' benefit
   }
@@ -326,7 +326,7 @@ private:
           "^00","^1002","^06","^08","^03","^0C","^0D","^0F","^0E","^0B"
       */
       for (auto& segment : appleDataSegments) {
-        HTDBG(segment.data.hexEncodedString());
+        HTDBG("{}",segment.data.hexEncodedString());
         switch (segment.type) {
           case 0x00:
           case 0x05:
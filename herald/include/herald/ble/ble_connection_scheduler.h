@@ -0,0 +1,115 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef HERALD_BLE_CONNECTION_SCHEDULER_H
+#define HERALD_BLE_CONNECTION_SCHEDULER_H
+
+#include "ble_device.h"
+#include "../datatype/date.h"
+#include "../datatype/target_identifier.h"
+#include "../datatype/time_interval.h"
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace herald {
+namespace ble {
+
+using namespace herald::datatype;
+
+/// \brief Tuning for BLEConnectionScheduler. All weights are applied to values normalised to 0..1.
+struct BLEConnectionScoring {
+  /// \brief Weight of time spent waiting for a payload, capped at waitingCap
+  double waitingWeight = 2.0;
+  TimeInterval waitingCap = TimeInterval::minutes(2);
+  /// \brief Weight of signal strength, normalised from weakRSSI (0) to strongRSSI (1)
+  double rssiWeight = 1.0;
+  int weakRSSI = -100;
+  int strongRSSI = -40;
+  /// \brief Bonus for devices whose Herald service is already known, so a single payload read completes them
+  double knownServiceWeight = 0.5;
+  /// \brief Bonus for iOS devices, whose payload cannot be read from advertisements when in the background, so only a connection finds them
+  double iosWeight = 0.5;
+  /// \brief Penalty per consecutive failed connection attempt
+  double failurePenalty = 0.5;
+  /// \brief Backoff after the first failure. Doubles with each further failure up to maximumBackoff.
+  TimeInterval initialBackoff = TimeInterval::seconds(4);
+  TimeInterval maximumBackoff = TimeInterval::minutes(2);
+};
+
+/// \brief What the scheduler needs to know about a device wanting a connection
+struct BLEConnectionCandidate {
+  /// \brief Must remain valid until choose() has been called, and its result used
+  const TargetIdentifier& target;
+  /// \brief Most recent RSSI, or 0 if unknown
+  int rssi;
+  /// \brief True if the Herald service was already discovered, so only the payload is outstanding
+  bool serviceKnown;
+  /// \brief Operating system, if known from advertisements or a previous connection
+  BLEDeviceOperatingSystem operatingSystem = BLEDeviceOperatingSystem::unknown;
+};
+
+/// \brief Chooses which devices to connect to each iteration in a crowded environment
+///
+/// Candidates are scored on how long they have waited for a payload, signal strength, whether
+/// service discovery is already done, operating system, and recent connection failures. Devices that failed to
+/// connect are not chosen again until an exponential backoff expires. Use as:-
+/// scheduler.begin(now); scheduler.add(...) for each candidate; scheduler.choose(max);
+/// then report each attempt via connectionResult().
+///
+/// Targets are referenced, and tracked by hash code, rather than copied. This keeps
+/// the scheduler from using the (small, shared) Data memory arena in large crowds.
+class BLEConnectionScheduler {
+public:
+  BLEConnectionScheduler();
+  BLEConnectionScheduler(BLEConnectionScoring scoring);
+  ~BLEConnectionScheduler() = default;
+
+  /// \brief Starts a new round of candidate selection at the given time
+  void begin(const Date& now);
+  void add(const BLEConnectionCandidate& candidate);
+  /// \brief Returns up to maximum candidates added since begin(), highest score first, skipping any backing off
+  ///
+  /// Forgets about targets that were not candidates in this round and are not backing off.
+  const std::vector<std::reference_wrapper<const TargetIdentifier>>& choose(std::size_t maximum);
+
+  /// \brief Records the outcome of a connection attempt, so failing devices back off
+  void connectionResult(const TargetIdentifier& target, bool success, const Date& now);
+
+  /// \brief Score for a candidate at the time given to begin(). Higher is better.
+  double score(const BLEConnectionCandidate& candidate) const;
+
+  /// \brief True if the target failed recently and should not be attempted until its backoff expires
+  bool backingOff(const TargetIdentifier& target, const Date& now) const;
+
+  /// \brief Number of targets with remembered waiting or failure state
+  std::size_t tracked() const noexcept;
+
+private:
+  struct TargetState {
+    Date firstWanted;
+    Date retryAfter;
+    std::uint32_t round;
+    std::uint8_t failures;
+  };
+
+  struct ScoredCandidate {
+    const TargetIdentifier* target;
+    double score;
+  };
+
+  BLEConnectionScoring scoring;
+  Date now;
+  std::uint32_t round;
+  std::unordered_map<std::size_t,TargetState> states; // Keyed by TargetIdentifier hash code
+  std::vector<ScoredCandidate> candidates;
+  std::vector<std::reference_wrapper<const TargetIdentifier>> chosen;
+};
+
+}
+}
+
+#endif
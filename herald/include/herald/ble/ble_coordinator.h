@@ -10,11 +10,14 @@
 #include "ble_database.h"
 #include "ble_protocols.h"
 #include "ble_coordinator.h"
+#include "ble_connection_scheduler.h"
 #include "../engine/activities.h"
+#include "../engine/feature_registry.h"
 #include "ble_protocols.h"
 #include "../data/sensor_logger.h"
 #include "ble_sensor_configuration.h"
 
+#include <algorithm>
 #include <memory>
 #include <functional>
 #include <optional>
@@ -31,7 +34,9 @@ public:
   : context(ctx),
     db(bledb),
     pp(provider),
+    connectionFeature(FeatureRegistry::Unknown),
     previouslyProvisioned(),
+    connectionScheduler(),
     iterationsSinceBreak(0),
     breakEvery(10),
     breakFor(10)
@@ -47,10 +52,14 @@ public:
     return std::vector<FeatureTag>(1,herald::engine::Features::HeraldBluetoothProtocolConnection);
   }
 
+  void featuresRegistered(const FeatureRegistry& features) override {
+    connectionFeature = features.find(herald::engine::Features::HeraldBluetoothProtocolConnection);
+  }
+
   // void provision(const std::vector<PrioritisedPrerequisite>& requested,
   //   const ConnectionCallback& connCallback) override;
-  std::vector<PrioritisedPrerequisite> provision(
-    const std::vector<PrioritisedPrerequisite>& requested) override {
+  void provision(const std::vector<PrioritisedPrerequisite>& requested,
+    std::vector<PrioritisedPrerequisite>& provisioned) override {
     if (requested.empty()) {
       // HTDBG("No connections requested for provisioning");
     } else {
@@ -60,7 +69,8 @@ public:
     // Don't close connections if we've only paused for advertising/scanning
     if (iterationsSinceBreak >= breakEvery &&
       iterationsSinceBreak < (breakEvery + breakFor) ) {
-        return previouslyProvisioned;
+        provisioned.insert(provisioned.end(),previouslyProvisioned.begin(),previouslyProvisioned.end());
+        return;
     }
 
     // Remove those previously provisoned that we no longer require
@@ -80,8 +90,8 @@ public:
       }
     }
 
-    // Now provision new connections
-    std::vector<PrioritisedPrerequisite> provisioned;
+    // Now provision new connections, appending to those already in provisioned
+    const std::size_t firstProvisioned = provisioned.size();
     // For this provider, a prerequisite is a connection to a remote target identifier over Bluetooth
     auto requestIter = requested.cbegin();
     bool lastConnectionSuccessful = true;
@@ -107,6 +117,7 @@ public:
         // fut.get(); // TODO FIND OUT HOW TO DO THIS FUTURE WAITING FUNCTIONALITY
 
         lastConnectionSuccessful = pp.openConnection(optTarget.value());
+        connectionScheduler.connectionResult(optTarget.value(), lastConnectionSuccessful, Date());
 
         // If successful, add to provisioned list
         if (lastConnectionSuccessful) {
@@ -128,7 +139,7 @@ public:
       lastConnectionSuccessful = true;
     }
 
-    previouslyProvisioned = provisioned;
+    previouslyProvisioned.assign(provisioned.begin() + firstProvisioned,provisioned.end());
 
     // TODO schedule disconnection from not required items (E.g. after minimum connection time)
     //  - we already do this if provision is called, but not after a time period
@@ -136,13 +147,11 @@ public:
 
     // HTDBG("Returning from provision");
     // connCallback(provisioned);
-    return provisioned;
   }
 
   // Runtime coordination callbacks
-  /** Get a list of what connections are required to which devices now (may start, maintain, end (if not included)) **/
-  std::vector<PrioritisedPrerequisite> requiredConnections() override {
-    std::vector<std::tuple<FeatureTag,Priority,std::optional<TargetIdentifier>>> results;
+  /** Appends what connections are required to which devices now (may start, maintain, end (if not included)) **/
+  void requiredConnections(std::vector<PrioritisedPrerequisite>& results) override {
 
     // This ensures we break from making connections to allow advertising and scanning
     iterationsSinceBreak++;
@@ -152,7 +161,7 @@ public:
       // if (iterationsSinceBreak == breakEvery) { // incase it fails
         pp.restartScanningAndAdvertising();
       // }
-      return results;
+      return;
     } else if (iterationsSinceBreak == (breakEvery + breakFor) ) {
       // reset
       iterationsSinceBreak = 0;
@@ -176,9 +185,9 @@ public:
       if (exp.has_value()) {
         db.remove(exp.value().get().identifier());
         HTDBG("Removing expired device with ID: ");
-        HTDBG((std::string)exp.value().get().identifier());
+        HTDBG("{}",(std::string)exp.value().get().identifier());
         HTDBG("time since last update:-");
-        HTDBG(std::to_string(exp.value().get().timeIntervalSinceLastUpdate()));
+        HTDBG("{}",std::to_string(exp.value().get().timeIntervalSinceLastUpdate()));
       }
     }
 
@@ -206,14 +215,28 @@ public:
         )
         ;
     });
+    // Only connect to the best scoring few, so crowded environments don't starve anyone
+    connectionScheduler.begin(Date());
     for (auto& device : newConns) {
       if (device.has_value()) {
-        results.emplace_back(herald::engine::Features::HeraldBluetoothProtocolConnection,
-          herald::engine::Priorities::High,
-          device.value().get().identifier()
-        );
+        const BLEDevice& d = device.value().get();
+        connectionScheduler.add(BLEConnectionCandidate{
+          d.identifier(),
+          d.rssi().intValue(),
+          d.hasService(context.getSensorConfiguration().serviceUUID),
+          d.operatingSystem()
+        });
       }
     }
+    const auto& config = context.getSensorConfiguration();
+    std::size_t maxConnections = (std::size_t)std::max(0,
+      std::min(config.maxConnectionsPerIteration, config.maxBluetoothConnections));
+    for (auto& target : connectionScheduler.choose(maxConnections)) {
+      results.emplace_back(connectionFeature,
+        herald::engine::Priorities::High,
+        target.get()
+      );
+    }
 
     // TODO any other devices we may have outstanding work for that requires connections
 
@@ -274,18 +297,15 @@ public:
         // di += (device.value().get().hasServicesSet() ? "true" : "false");
         di += ", hasReadPayload=";
         di += (device.value().get().payloadData().size() > 0 ? device.value().get().payloadData().hexEncodedString() : "false");
-        HTDBG(di);
+        HTDBG("{}",di);
       }
     } else {
       // restart scanning when no connection activity is expected
       pp.restartScanningAndAdvertising();
     }
-
-    return results;
   }
 
-  std::vector<Activity> requiredActivities() override {
-    std::vector<Activity> results;
+  void requiredActivities(std::vector<Activity>& results) override {
 
     // General activities first - no connections required
     // taskRemoveExpiredDevices
@@ -353,10 +373,10 @@ public:
       results.emplace_back(Activity{
         .priority = Priorities::High + 10,
         .name = "herald-service-discovery",
-        .prerequisites = std::vector<std::tuple<FeatureTag,std::optional<TargetIdentifier>>>{
+        .prerequisites = std::vector<Prerequisite>{
           1,
-          std::tuple<FeatureTag,std::optional<TargetIdentifier>>{
-            herald::engine::Features::HeraldBluetoothProtocolConnection,
+          Prerequisite{
+            connectionFeature,
             device.value().get().identifier()
           }
         },
@@ -380,10 +400,10 @@ public:
       results.emplace_back(Activity{
         .priority = Priorities::High + 9,
         .name = "herald-read-payload",
-        .prerequisites =  std::vector<std::tuple<FeatureTag,std::optional<TargetIdentifier>>>{
+        .prerequisites =  std::vector<Prerequisite>{
           1,
-          std::tuple<FeatureTag,std::optional<TargetIdentifier>>{
-            herald::engine::Features::HeraldBluetoothProtocolConnection,
+          Prerequisite{
+            connectionFeature,
             device.value().get().identifier()
           }
         },
@@ -428,7 +448,6 @@ public:
     //   // TODO add immediate send all support
     //   // TODO add read of nearby payload data from remotes
     // }
-    return results;
   }
 
 private:
@@ -436,7 +455,9 @@ private:
   BLEDBT& db;
   ProviderT& pp;
 
+  FeatureId connectionFeature; // Of Features::HeraldBluetoothProtocolConnection, once registered
   std::vector<PrioritisedPrerequisite> previouslyProvisioned;
+  BLEConnectionScheduler connectionScheduler;
 
   int iterationsSinceBreak;
   int breakEvery;
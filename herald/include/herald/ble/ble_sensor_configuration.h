@@ -91,6 +91,9 @@ struct BLESensorConfiguration {
   /// Connection management
   /// Max connections - since v1.2 (allowing multiple connections on Android and C++)
   int maxBluetoothConnections; // Same as NRF 52840 max connections
+  /// Maximum new connections requested per coordinator iteration, highest scoring devices first
+  /// - Bounds the time spent connecting in each iteration in crowded environments (never more than maxBluetoothConnections)
+  int maxConnectionsPerIteration;
 
   // Does this Herald application support advertising?
   bool advertisingEnabled;
@@ -10,8 +10,13 @@
 #include "../../payload/payload_data_supplier.h"
 #include "../../datatype/data.h"
 #include "../../datatype/target_identifier.h"
+#include "../ble_mac_address.h"
+#include "simulated_ble_radio.h"
 
+#include <array>
+#include <cstddef>
 #include <optional>
+#include <vector>
 
 namespace herald {
 namespace ble {
@@ -19,7 +24,9 @@ namespace ble {
 using namespace herald::datatype;
 using namespace herald::payload;
 
-/// \brief Dummy implementation of a ConcreteBLEReceiver that does nothing (used for testing)
+#ifdef __ZEPHYR__
+
+/// \brief Dummy implementation of a ConcreteBLEReceiver that does nothing (Zephyr builds without CONFIG_BT_SCAN)
 template <typename ContextT, typename PayloadDataSupplierT, typename BLEDatabaseT, typename SensorDelegateSetT>
 class ConcreteBLEReceiver : public HeraldProtocolV1Provider {
 public:
@@ -34,6 +41,64 @@ public:
     return {};
   }
 
+  // Sensor overrides
+  void start() {}
+  void stop() {}
+
+  // Herald V1 Protocol Provider methods
+  bool openConnection(const TargetIdentifier& toTarget) override {
+    return false;
+  }
+
+  bool closeConnection(const TargetIdentifier& toTarget) override {
+    return true;
+  }
+
+  void restartScanningAndAdvertising() override {
+    ;
+  }
+
+  std::optional<Activity> serviceDiscovery(Activity) override {
+    return {};
+  }
+
+  std::optional<Activity> readPayload(Activity) override {
+    return {};
+  }
+};
+
+#else
+
+/// \brief Default ConcreteBLEReceiver for platforms without a Herald Bluetooth stack (E.g. Linux and testing)
+///
+/// Does nothing unless a SimulatedBLERadio is attached, in which case adverts it delivers are
+/// added to the BLE database, and connections, service discovery and payload reads are made
+/// to the simulated devices.
+template <typename ContextT, typename PayloadDataSupplierT, typename BLEDatabaseT, typename SensorDelegateSetT>
+class ConcreteBLEReceiver : public HeraldProtocolV1Provider, public SimulatedBLERadioListener {
+public:
+  ConcreteBLEReceiver(ContextT& ctx, BluetoothStateManager& /* bluetoothStateManager */,
+    PayloadDataSupplierT& /* payloadDataSupplier */, BLEDatabaseT& bleDatabase, SensorDelegateSetT& /* dels */)
+    : m_context(ctx),
+      db(bleDatabase),
+      radio(nullptr)
+  {}
+  ConcreteBLEReceiver(const ConcreteBLEReceiver& from) = delete;
+  ConcreteBLEReceiver(ConcreteBLEReceiver&& from) = delete;
+  ~ConcreteBLEReceiver() {
+    stop();
+  }
+
+  /// \brief Uses the given simulated radio in place of Bluetooth hardware. Call before start().
+  void simulatedRadio(SimulatedBLERadio& toUse) {
+    radio = &toUse;
+  }
+
+  // Coordination overrides - Since v1.2-beta3
+  std::optional<std::reference_wrapper<CoordinationProvider>> coordinationProvider() {
+    return {};
+  }
+
   // bool immediateSend(Data data, const TargetIdentifier& targetIdentifier) {
   //   return false;
   // }
@@ -42,27 +107,94 @@ public:
   // }
 
   // Sensor overrides
-  void start() {}
-  void stop() {}
+  void start() {
+    if (nullptr == radio) {
+      return;
+    }
+    radio->listener(this);
+    radio->scanning(true);
+  }
+
+  void stop() {
+    if (nullptr == radio) {
+      return;
+    }
+    radio->scanning(false);
+    radio->listener(nullptr);
+  }
 
   // Herald V1 Protocol Provider methods
   bool openConnection(const TargetIdentifier& toTarget) override {
-    return false;
+    auto index = find(toTarget);
+    if (!index.has_value()) {
+      return false;
+    }
+    if (radio->connected(index.value())) {
+      return true;
+    }
+    bool success = radio->connect(index.value());
+    auto& device = db.device(toTarget);
+    if (!device.ignore()) { // Setting state would clear an ignore
+      device.state(success ? BLEDeviceState::connected : BLEDeviceState::disconnected);
+    }
+    return success;
   }
 
   bool closeConnection(const TargetIdentifier& toTarget) override {
+    auto index = find(toTarget);
+    if (index.has_value() && radio->connected(index.value())) {
+      radio->disconnect(index.value());
+      auto& device = db.device(toTarget);
+      if (!device.ignore()) {
+        device.state(BLEDeviceState::disconnected);
+      }
+    }
     return true;
   }
 
   void restartScanningAndAdvertising() override {
-    ;
+    if (nullptr != radio) {
+      radio->scanning(true);
+    }
   }
 
-  std::optional<Activity> serviceDiscovery(Activity) override {
+  std::optional<Activity> serviceDiscovery(Activity activity) override {
+    auto target = std::get<1>(activity.prerequisites.front());
+    if (!target.has_value()) {
+      return {};
+    }
+    auto index = find(target.value());
+    if (!index.has_value() || !radio->gattOperation(index.value())) {
+      return {};
+    }
+    auto& device = db.device(target.value());
+    const SimulatedBLEDevice& simulated = radio->device(index.value());
+    if (!simulated.heraldService) {
+      device.services(std::vector<UUID>());
+      device.ignore(true);
+      return {};
+    }
+    device.services(std::vector<UUID>(1,m_context.getSensorConfiguration().serviceUUID));
+    device.payloadCharacteristic(m_context.getSensorConfiguration().payloadCharacteristicUUID);
+    device.operatingSystem(simulated.pseudoAddress ? BLEDeviceOperatingSystem::android : BLEDeviceOperatingSystem::ios);
     return {};
   }
 
-  std::optional<Activity> readPayload(Activity) override {
+  std::optional<Activity> readPayload(Activity activity) override {
+    auto target = std::get<1>(activity.prerequisites.front());
+    if (!target.has_value()) {
+      return {};
+    }
+    auto index = find(target.value());
+    if (!index.has_value() || !radio->gattOperation(index.value())) {
+      return {};
+    }
+    std::uint64_t value = radio->device(index.value()).payload;
+    std::byte bytes[8];
+    for (std::size_t i = 0;i < 8;++i) {
+      bytes[i] = std::byte(value >> (8 * (7 - i)));
+    }
+    db.device(target.value()).payloadData(PayloadData(bytes,8));
     return {};
   }
   
@@ -73,9 +205,40 @@ public:
   // std::optional<Activity> immediateSendAll(Activity) override {
   //   return {};
   // }
-  
+
+  // Simulated radio callbacks
+  void simulatedAdvert(const SimulatedBLEAdvert& advert) override {
+    BLEMacAddress mac(advert.address.data());
+    Data data(advert.data.data(),advert.length);
+    auto& device = db.device(mac,data);
+    if (device.ignore()) {
+      return;
+    }
+    device.rssi(RSSI(advert.rssi));
+  }
+
+private:
+  ContextT& m_context;
+  BLEDatabaseT& db;
+  SimulatedBLERadio* radio;
+
+  std::optional<std::size_t> find(const TargetIdentifier& target) const {
+    if (nullptr == radio) {
+      return {};
+    }
+    const Data& data = target.underlyingData();
+    std::array<std::uint8_t,6> address{};
+    for (std::size_t i = 0;i < address.size();++i) {
+      if (!data.uint8(i,address[i])) {
+        return {};
+      }
+    }
+    return radio->find(address);
+  }
 };
 
+#endif
+
 }
 }
 
@@ -20,6 +20,7 @@
 #include "../ble_sensor_configuration.h"
 #include "../ble_coordinator.h"
 #include "../../datatype/bluetooth_state.h"
+#include "simulated_ble_radio.h"
 
 // C++17 includes
 #include <algorithm>
@@ -34,28 +35,48 @@ using namespace herald::ble::filter;
 using namespace herald::payload;
 
 
-/// \brief Dummy implementation of a ConcreteBLETransmitter that does nothing (used for testing)
+/// \brief Default ConcreteBLETransmitter for platforms without a Herald Bluetooth stack (E.g. Linux and testing)
+///
+/// Does nothing unless a SimulatedBLERadio is attached, in which case it switches the simulated
+/// radio's advertising on and off.
 template <typename ContextT, typename PayloadDataSupplierT, typename BLEDatabaseT, typename SensorDelegateSetT>
 class ConcreteBLETransmitter {
 public:
-  ConcreteBLETransmitter(ContextT& ctx, BluetoothStateManager& bluetoothStateManager, 
-    PayloadDataSupplierT& payloadDataSupplier, BLEDatabaseT& bleDatabase, SensorDelegateSetT& dels) {}
+  ConcreteBLETransmitter(ContextT& /* ctx */, BluetoothStateManager& /* bluetoothStateManager */,
+    PayloadDataSupplierT& /* payloadDataSupplier */, BLEDatabaseT& /* bleDatabase */, SensorDelegateSetT& /* dels */)
+    : radio(nullptr)
+  {}
 
   ConcreteBLETransmitter(const ConcreteBLETransmitter& from) = delete;
   ConcreteBLETransmitter(ConcreteBLETransmitter&& from) = delete;
 
   ~ConcreteBLETransmitter() {}
 
+  /// \brief Uses the given simulated radio in place of Bluetooth hardware. Call before start().
+  void simulatedRadio(SimulatedBLERadio& toUse) {
+    radio = &toUse;
+  }
+
   // Coordination overrides - Since v1.2-beta3
   std::optional<std::reference_wrapper<CoordinationProvider>> coordinationProvider() {
     return {};
   }
 
   // Sensor overrides
-  void start() {}
+  void start() {
+    if (nullptr != radio) {
+      radio->advertising(true);
+    }
+  }
 
-  void stop() {}
+  void stop() {
+    if (nullptr != radio) {
+      radio->advertising(false);
+    }
+  }
 
+private:
+  SimulatedBLERadio* radio;
 };
 
 }
@@ -0,0 +1,188 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef HERALD_DEFAULT_SIMULATED_BLE_RADIO_H
+#define HERALD_DEFAULT_SIMULATED_BLE_RADIO_H
+
+// Host only (Linux and testing). Zephyr builds use the Bluetooth hardware.
+#ifndef __ZEPHYR__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace herald {
+namespace ble {
+
+/// \brief A virtual remote device within a SimulatedBLERadio
+struct SimulatedBLEDevice {
+  /// \brief Position in metres
+  double x = 0;
+  double y = 0;
+  std::uint32_t advertIntervalMillis = 250;
+  /// \brief How often the device changes its MAC address. 0 means never.
+  std::uint32_t macRotationMillis = 15 * 60 * 1000;
+  /// \brief Advertises a Herald pseudo device address (as Android does) that survives MAC rotation
+  bool pseudoAddress = true;
+  /// \brief False for devices that do not run Herald, which are ignored after service discovery
+  bool heraldService = true;
+  /// \brief Value of the payload characteristic, read as 8 bytes big endian
+  std::uint64_t payload = 0;
+  /// \brief RSSI measured at one metre
+  int txPower = -59;
+  std::uint32_t connectionLatencyMillis = 30;
+  /// \brief Time taken by each GATT operation (service discovery or characteristic read)
+  std::uint32_t gattLatencyMillis = 20;
+  /// \brief Probability (0..1) of an in range connection attempt failing
+  double connectionFailureRate = 0.1;
+};
+
+/// \brief Radio environment shared by all devices in a SimulatedBLERadio
+struct SimulatedBLERadioConfiguration {
+  /// \brief Local device (observer) position in metres
+  double x = 0;
+  double y = 0;
+  /// \brief Log distance path loss exponent. 2 is free space, 3 to 4 is indoors with people.
+  double pathLossExponent = 2.0;
+  /// \brief Standard deviation of RSSI noise in dB
+  double rssiNoise = 4.0;
+  /// \brief Adverts received weaker than this are lost, and connections fail
+  int sensitivity = -100;
+  /// \brief Time lost to a connection attempt that fails
+  std::uint32_t connectionTimeoutMillis = 2000;
+};
+
+/// \brief A single advert as heard by the local device
+struct SimulatedBLEAdvert {
+  std::size_t device;
+  std::array<std::uint8_t,6> address;
+  std::array<std::uint8_t,16> data;
+  std::uint8_t length;
+  int rssi;
+  std::uint64_t at;
+};
+
+/// \brief Receives adverts from a SimulatedBLERadio while scanning
+class SimulatedBLERadioListener {
+public:
+  SimulatedBLERadioListener() = default;
+  virtual ~SimulatedBLERadioListener() = default;
+
+  virtual void simulatedAdvert(const SimulatedBLEAdvert& advert) = 0;
+};
+
+/// \brief Counts of radio activity since a SimulatedBLERadio was created
+struct SimulatedBLERadioMetrics {
+  std::uint64_t advertsSent = 0;
+  /// \brief Adverts delivered to the listener (in range, while scanning)
+  std::uint64_t advertsHeard = 0;
+  std::uint64_t macRotations = 0;
+  std::uint64_t connectionAttempts = 0;
+  std::uint64_t connectionFailures = 0;
+  std::uint64_t gattOperations = 0;
+  /// \brief Simulated time spent connecting and in GATT operations, during which no adverts are heard
+  std::uint64_t busyMillis = 0;
+};
+
+/// \brief Deterministic simulation of the Bluetooth radio environment around the local device
+///
+/// Used by the default (non Zephyr) ConcreteBLEReceiver and ConcreteBLETransmitter so that
+/// ConcreteBLESensor, ConcreteBLEDatabase and the Coordinator can be exercised on Linux with
+/// any number of remote devices, and without Bluetooth hardware.
+///
+/// Time is virtual, in milliseconds since the radio was created. advance() delivers every
+/// advert due in the period, in time order. Connections and GATT operations take simulated
+/// time too, and adverts sent while the local radio is busy with them are not heard.
+///
+/// Every random outcome (advert phase and jitter, RSSI noise, MAC addresses, connection
+/// failures) is a hash of the seed, the device index and a per device counter, so a run is
+/// reproducible for a given seed however calls to different devices interleave.
+class SimulatedBLERadio {
+public:
+  SimulatedBLERadio(std::uint64_t seed);
+  SimulatedBLERadio(std::uint64_t seed, SimulatedBLERadioConfiguration configuration);
+  SimulatedBLERadio(const SimulatedBLERadio&) = delete;
+  SimulatedBLERadio& operator=(const SimulatedBLERadio&) = delete;
+  ~SimulatedBLERadio() = default;
+
+  /// \brief Adds a remote device, returning its index. It first advertises within one advert interval.
+  std::size_t add(const SimulatedBLEDevice& device);
+  /// \brief Device settings. May be changed at any time (E.g. to move a device).
+  SimulatedBLEDevice& device(std::size_t index);
+  std::size_t size() const noexcept;
+  SimulatedBLERadioConfiguration& configuration() noexcept;
+
+  void listener(SimulatedBLERadioListener* toNotify) noexcept;
+  void scanning(bool enabled) noexcept;
+  bool scanning() const noexcept;
+  void advertising(bool enabled) noexcept;
+  bool advertising() const noexcept;
+
+  /// \brief Current simulated time in milliseconds
+  std::uint64_t now() const noexcept;
+  /// \brief Moves time forward, delivering adverts heard to the listener if scanning
+  void advance(std::uint32_t millis);
+
+  /// \brief Current MAC address of a device
+  std::array<std::uint8_t,6> address(std::size_t index) const noexcept;
+  /// \brief Herald pseudo device address of a device (advertised only if pseudoAddress is set)
+  std::array<std::uint8_t,6> pseudoAddress(std::size_t index) const noexcept;
+  /// \brief Finds the device with the given current MAC address or pseudo address
+  std::optional<std::size_t> find(const std::array<std::uint8_t,6>& address) const;
+
+  /// \brief RSSI at the local device, without noise
+  int meanRSSI(std::size_t index) const noexcept;
+  bool inRange(std::size_t index) const noexcept;
+
+  /// \brief Attempts a connection, taking simulated time. Fails if out of range, or at the device's failure rate.
+  bool connect(std::size_t index);
+  void disconnect(std::size_t index) noexcept;
+  bool connected(std::size_t index) const noexcept;
+  /// \brief Performs a GATT operation over an open connection, taking simulated time. False if not connected.
+  bool gattOperation(std::size_t index);
+
+  const SimulatedBLERadioMetrics& metrics() const noexcept;
+
+private:
+  struct DeviceState {
+    std::uint64_t nextAdvert;
+    std::uint64_t adverts;
+    std::uint64_t attempts;
+    std::uint64_t epoch;
+    bool connected;
+  };
+
+  using Event = std::pair<std::uint64_t,std::size_t>; // (time, device index)
+
+  std::uint64_t seed;
+  SimulatedBLERadioConfiguration config;
+  std::vector<SimulatedBLEDevice> devices;
+  std::vector<DeviceState> states;
+  std::vector<Event> events; // min heap on time
+  std::unordered_map<std::uint64_t,std::size_t> addresses; // current and pseudo addresses to device index
+  SimulatedBLERadioListener* observer;
+  bool isScanning;
+  bool isAdvertising;
+  std::uint64_t clock;
+  SimulatedBLERadioMetrics counts;
+
+  std::uint64_t random(std::size_t index, std::uint64_t stream, std::uint64_t counter) const noexcept;
+  double uniform(std::size_t index, std::uint64_t stream, std::uint64_t counter) const noexcept;
+  std::uint64_t epochAt(std::size_t index, std::uint64_t at) const noexcept;
+  std::array<std::uint8_t,6> addressFor(std::size_t index, std::uint64_t epoch) const noexcept;
+  void run(std::uint64_t until, bool deliver);
+  void advertise(std::size_t index, bool deliver);
+  void busy(std::uint32_t millis);
+};
+
+}
+}
+
+#endif
+
+#endif
\ No newline at end of file
@@ -274,7 +274,7 @@ public:
     HTDBG("start bluetooth done");
     if (0 != startOk) {
       HTDBG("ERROR starting context bluetooth:-");
-      HTDBG(std::to_string(startOk));
+      HTDBG("{}",std::to_string(startOk));
     }
 
     HTDBG("Calling conn cb register");
@@ -351,7 +351,7 @@ public:
     // idiot check of copied data
     Data newAddr(state.address.a.val,6);
     BLEMacAddress newMac(newAddr);
-    HTDBG((std::string)newMac);
+    HTDBG("{}",(std::string)newMac);
 
 
 
@@ -418,7 +418,7 @@ public:
       char addr_str[BT_ADDR_LE_STR_LEN];
       bt_addr_le_to_str(&state.address, addr_str, sizeof(addr_str));
       HTDBG("ADDR AS STRING in openConnection:-");
-      HTDBG(addr_str);
+      HTDBG("{}",addr_str);
 
       state.state = BLEDeviceState::connecting; // this is used by the condition variable
       state.remoteInstigated = false; // as we're now definitely the instigators
@@ -449,7 +449,7 @@ public:
           HTDBG(" - Low level BT HCI opcode IO failure");
         } else {
           HTDBG(" - Unknown error code...");
-          HTDBG(std::to_string(success));
+          HTDBG("{}",std::to_string(success));
         }
 
         // Add to ignore list for now
@@ -484,8 +484,8 @@ public:
         });
         if (timedOut != 0) {
           HTDBG("ZEPHYR WAIT TIMED OUT. Is connected?");
-          HTDBG((state.state == BLEDeviceState::connected) ? "true" : "false");
-          HTDBG(std::to_string(timedOut));
+          HTDBG("{}",(state.state == BLEDeviceState::connected) ? "true" : "false");
+          HTDBG("{}",std::to_string(timedOut));
           return false;
         }
         // return connectionState == BLEDeviceState::connected;
@@ -505,7 +505,7 @@ public:
     ConnectedDeviceState& state = findOrCreateState(toTarget);
     char addr_str[BT_ADDR_LE_STR_LEN];
     bt_addr_le_to_str(&state.address, addr_str, sizeof(addr_str));
-    HTDBG(addr_str);
+    HTDBG("{}",addr_str);
     // if (0 == strcmp(addr_str,"00:00:00:00:00:00 (public)")) {
     //   HTDBG("Remote address is empty. Not removing old state object.");
     //   return false; // Assume this Zephyr internal state is being managed out eventually.
@@ -561,13 +561,13 @@ public:
         }
         ci += ", connection is null: ";
         ci += (NULL == value.connection ? "true" : "false");
-        HTDBG(ci);
+        HTDBG("{}",ci);
 
         // Check connection reference is valid by address - has happened with non connectable devices (VR headset bluetooth stations)
         bool nullBefore = (NULL == value.connection);
         char addr_str[BT_ADDR_LE_STR_LEN];
         bt_addr_le_to_str(&value.address, addr_str, sizeof(addr_str));
-        HTDBG(addr_str);
+        HTDBG("{}",addr_str);
         HTDBG("Looking up connection object for address just printed");
         value.connection = bt_conn_lookup_addr_le(BT_ID_DEFAULT, &value.address);
         if (!nullBefore && (NULL == value.connection)) {
@@ -658,7 +658,7 @@ public:
 
     if (0 != timedOut) {
       HTDBG("service discovery timed out for device");
-      HTDBG(std::to_string(timedOut));
+      HTDBG("{}",std::to_string(timedOut));
       return {};
     }
     return {};
@@ -736,7 +736,7 @@ private:
       bt_addr_le_to_str(addr, addr_str, sizeof(addr_str));
       std::string addrStr(addr_str);
       HTDBG("New address FROM SCAN:-");
-      HTDBG(addr_str);
+      HTDBG("{}",addr_str);
     }
 
     // Add this RSSI reading - called at the end to ensure all other data variables set
@@ -758,7 +758,7 @@ private:
     bt_addr_le_to_str(addr, addr_str, sizeof(addr_str));
     std::string addrStr(addr_str);
     BLEMacAddress bleMacAddress(addr->a.val);
-    HTDBG((std::string)bleMacAddress);
+    HTDBG("{}",(std::string)bleMacAddress);
 
     ConnectedDeviceState& state = findOrCreateStateByConnection(conn, true);
     auto& device = db.device(bleMacAddress); // Find by actual current physical address
@@ -768,7 +768,7 @@ private:
       // The below ensures that this is counted as a connection failure
 
       HTDBG("Connected: Error value:-");
-      HTDBG(std::to_string(err));
+      HTDBG("{}",std::to_string(err));
       // Note: See Bluetooth Specification, Vol 2. Part D (Error codes)
 
       bt_conn_unref(conn);
@@ -808,11 +808,11 @@ private:
     bt_addr_le_to_str(addr, addr_str, sizeof(addr_str));
     std::string addrStr(addr_str);
     BLEMacAddress bleMacAddress(addr->a.val);
-    HTDBG((std::string)bleMacAddress);
+    HTDBG("{}",(std::string)bleMacAddress);
 
     if (reason) {
       HTDBG("Disconnection: Reason value:-");
-      HTDBG(std::to_string(reason));
+      HTDBG("{}",std::to_string(reason));
       // Note: See Bluetooth Specification, Vol 2. Part D (Error codes)
       // 0x19 = Unknown LMP PDU (Issued if nRF Connect iOS app disconnects from this device)
       // 0x20 = Unsupported LL parameter value
@@ -891,7 +891,7 @@ private:
         char uuid_str[32];
         bt_uuid_to_str(chrc->uuid,uuid_str,sizeof(uuid_str));
         HTDBG("    - Char doesn't match any herald char uuid:-"); //, log_strdup(uuid_str));
-        HTDBG(uuid_str);
+        HTDBG("{}",uuid_str);
       }
     } while (NULL != prev);
     state.inDiscovery = false;
@@ -919,7 +919,7 @@ private:
   {
     HTDBG("The service could not be found during the discovery. Ignoring device:");
     ConnectedDeviceState& state = findOrCreateStateByConnection(conn);
-    HTDBG((std::string)state.target);
+    HTDBG("{}",(std::string)state.target);
 
     auto& device = db.device(state.target);
     std::vector<UUID> serviceList; // empty service list // TODO put other listened-for services here
@@ -930,7 +930,7 @@ private:
   void discovery_error_found_cb(struct bt_conn *conn, int err, void *context) override
   {
     HTDBG("The discovery procedure failed with ");
-    HTDBG(std::to_string(err));
+    HTDBG("{}",std::to_string(err));
     // TODO decide if we should ignore the device here, or just keep trying
   }
 
@@ -943,7 +943,7 @@ private:
     ConnectedDeviceState& state = findOrCreateStateByConnection(conn);
     if (NULL == data) {
       HTDBG("Finished reading CHAR read payload:-");
-      HTDBG(state.readPayload.hexEncodedString());
+      HTDBG("{}",state.readPayload.hexEncodedString());
       
       // Set final read payload (triggers success callback on observer)
       db.device(state.target).payloadData(state.readPayload);
@@ -1029,7 +1029,7 @@ private:
     err = bt_gatt_dm_start(conn, &zephyrinternal::getHeraldUUID()->uuid, zephyrinternal::getDiscoveryCallbacks(), NULL);
     if (err) {
       HTDBG("could not start the discovery procedure, error code")
-      HTDBG(std::to_string(err));
+      HTDBG("{}",std::to_string(err));
       bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN); // ensures disconnect() called, and loop completed
       return;
     }
@@ -0,0 +1,218 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef HERALD_ASYNC_LOGGING_SINK
+#define HERALD_ASYNC_LOGGING_SINK
+
+// Requires std::thread, so not available on Zephyr (which has its own deferred logging)
+#ifndef __ZEPHYR__
+
+#include "herald/data/sensor_logger.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+namespace herald::data {
+
+/// \brief A log message argument, captured by value on the logging thread
+struct AsyncLogArgument {
+  enum class Kind : std::uint8_t {
+    integer, unsignedInteger, floating, character, text
+  };
+
+  /// \brief Location of a string within the record's text area
+  struct TextRange {
+    std::uint16_t offset;
+    std::uint16_t length;
+  };
+
+  Kind kind;
+  union {
+    std::int64_t integer;
+    std::uint64_t unsignedInteger;
+    double floating;
+    char character;
+    TextRange text;
+  };
+};
+
+/// \brief A log call as captured by the logging thread, and formatted later by the writer thread
+///
+/// Fixed size so that it can live in a preallocated ring buffer slot. Strings (subsystem,
+/// category, format and string arguments) are copied into the text area, and are truncated
+/// if together they exceed it.
+struct AsyncLogRecord {
+  static constexpr std::size_t MaxArguments = 8;
+  static constexpr std::size_t TextSize = 256;
+
+  SensorLoggerLevel level;
+  /// \brief True if format is the complete message, and is not to be searched for placeholders
+  bool preformatted;
+  std::uint8_t argumentCount;
+  AsyncLogArgument subsystem;
+  AsyncLogArgument category;
+  AsyncLogArgument format;
+  AsyncLogArgument arguments[MaxArguments];
+  std::uint16_t textUsed;
+  char text[TextSize];
+
+  void reset(SensorLoggerLevel lvl, bool isPreformatted) noexcept {
+    level = lvl;
+    preformatted = isPreformatted;
+    argumentCount = 0;
+    textUsed = 0;
+  }
+
+  AsyncLogArgument copy(std::string_view value) noexcept;
+
+  template <typename T>
+  void capture(const T& value) {
+    if (argumentCount >= MaxArguments) {
+      return; // tprintf ignores surplus arguments too
+    }
+    AsyncLogArgument& arg = arguments[argumentCount++];
+    using V = std::decay_t<T>;
+    if constexpr (std::is_same_v<V,bool>) {
+      arg.kind = AsyncLogArgument::Kind::integer;
+      arg.integer = value ? 1 : 0;
+    } else if constexpr (std::is_same_v<V,char>) {
+      arg.kind = AsyncLogArgument::Kind::character;
+      arg.character = value;
+    } else if constexpr (std::is_integral_v<V> && std::is_signed_v<V>) {
+      // Includes std::int8_t, which tprintf writes as a number
+      arg.kind = AsyncLogArgument::Kind::integer;
+      arg.integer = value;
+    } else if constexpr (std::is_integral_v<V>) {
+      arg.kind = AsyncLogArgument::Kind::unsignedInteger;
+      arg.unsignedInteger = value;
+    } else if constexpr (std::is_enum_v<V>) {
+      arg.kind = AsyncLogArgument::Kind::integer;
+      arg.integer = (std::int64_t)value;
+    } else if constexpr (std::is_floating_point_v<V>) {
+      arg.kind = AsyncLogArgument::Kind::floating;
+      arg.floating = value;
+    } else if constexpr (std::is_array_v<T> && (std::is_same_v<V,const char*> || std::is_same_v<V,char*>)) {
+      arg = copy(std::string_view(value)); // A literal or char array, never null
+    } else if constexpr (std::is_same_v<V,const char*> || std::is_same_v<V,char*>) {
+      arg = copy(nullptr == value ? std::string_view() : std::string_view(value));
+    } else if constexpr (std::is_convertible_v<const T&,std::string_view>) {
+      arg = copy(std::string_view(value));
+    } else {
+      // Any other streamable type is formatted now, as it may not outlive the call
+      std::stringstream os;
+      os << value;
+      arg = copy(os.str());
+    }
+  }
+};
+
+/// \brief Logging sink that writes on a background thread, in batches
+///
+/// Logging calls copy their arguments into a bounded lock free ring buffer and return. A
+/// single writer thread formats queued records, writes them to the output stream, and
+/// flushes it once per batch rather than once per line. When the buffer is full the
+/// record is dropped and counted, so that logging never blocks the caller.
+///
+/// SensorLogger hands the unformatted message and arguments to this sink (see
+/// defers_formatting), so even the formatting cost is moved off the calling thread.
+///
+/// Everything logged before flush() is called is written before it returns. The destructor
+/// writes everything logged before it is called, then stops the writer thread.
+///
+/// Output lines are in the same format as StdOutLoggingSink.
+class AsyncLoggingSink {
+public:
+  static constexpr bool defers_formatting = true;
+
+  /// \brief Writes to std::cout, buffering up to 4096 records
+  AsyncLoggingSink();
+  /// \brief Writes to out, buffering up to capacity records (rounded up to a power of two)
+  AsyncLoggingSink(std::ostream& out, std::size_t capacity);
+  AsyncLoggingSink(const AsyncLoggingSink&) = delete;
+  AsyncLoggingSink& operator=(const AsyncLoggingSink&) = delete;
+  ~AsyncLoggingSink();
+
+  /// \brief Queues an already formatted message
+  void log(const std::string& subsystem, const std::string& category, SensorLoggerLevel level, std::string message);
+
+  /// \brief Queues an unformatted message, with {} placeholders formatted as tprintf does
+  template <typename... Types>
+  void log(const std::string& subsystem, const std::string& category, SensorLoggerLevel level,
+    std::string_view format, const Types&... args)
+  {
+    Slot* slot = claim();
+    if (nullptr == slot) {
+      return;
+    }
+    AsyncLogRecord& record = slot->record;
+    record.reset(level, 0 == sizeof...(args));
+    record.subsystem = record.copy(subsystem);
+    record.category = record.copy(category);
+    record.format = record.copy(format);
+    (record.capture(args), ...);
+    publish(slot);
+  }
+
+  template <std::size_t Placeholders, typename... Types>
+  void log(const std::string& subsystem, const std::string& category, SensorLoggerLevel level,
+    const LogFormat<Placeholders>& format, const Types&... args)
+  {
+    log(subsystem, category, level, format.view(), args...);
+  }
+
+  /// \brief Blocks until everything logged before this call has been written
+  void flush();
+
+  /// \brief Records dropped because the buffer was full
+  std::uint64_t dropped() const noexcept;
+  /// \brief Records written to the output stream
+  std::uint64_t written() const noexcept;
+  /// \brief Number of writes (and flushes) of the output stream
+  std::uint64_t batches() const noexcept;
+  std::size_t capacity() const noexcept;
+
+private:
+  struct Slot {
+    /// \brief Ring position the slot is ready for. Equal to position when free, position + 1 when published.
+    std::atomic<std::size_t> sequence;
+    std::size_t position;
+    AsyncLogRecord record;
+  };
+
+  std::ostream& out;
+  std::size_t mask;
+  std::unique_ptr<Slot[]> slots;
+  alignas(64) std::atomic<std::size_t> enqueuePosition;
+  alignas(64) std::atomic<std::uint64_t> droppedCount;
+  alignas(64) std::atomic<std::size_t> writtenPosition;
+  std::atomic<std::uint64_t> batchCount;
+  std::atomic<bool> writerIdle;
+  std::mutex lock;
+  std::condition_variable wake;
+  std::condition_variable drained;
+  bool stopping;
+  std::thread writer;
+
+  Slot* claim() noexcept;
+  void publish(Slot* slot) noexcept;
+  void run();
+  std::size_t drain(std::string& batch);
+};
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,245 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef HERALD_BINARY_LOGGING_SINK
+#define HERALD_BINARY_LOGGING_SINK
+
+// Requires std::mutex, so not available on Zephyr
+#ifndef __ZEPHYR__
+
+#include "herald/data/sensor_logger.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace herald::data {
+
+/// \brief Binary log format
+///
+/// A stream starts with the magic bytes "HLOG" and a version byte, followed by records. Each
+/// record starts with a BinaryLogRecordType byte. Integers are LEB128 varints unless stated.
+///
+/// - logger: varint logger ID, varint length + subsystem, varint length + category. Written
+///   before the first message from each subsystem and category pair.
+/// - site: varint microseconds since the previous message, uint32 little endian site ID,
+///   varint logger ID, level byte, argument count byte, then the arguments.
+/// - text: varint microseconds since the previous message, varint logger ID, level byte,
+///   varint length + formatted message. Used when the format was not a literal.
+///
+/// Each argument is a BinaryLogArgumentType byte then: zig zag varint (integer), varint
+/// (unsigned), 8 bytes little endian IEEE 754 (floating), 1 byte (character), or varint
+/// length + bytes (text). The first message's time is microseconds since the Unix epoch.
+///
+/// The site ID is LogFormat::id, a hash of the format literal. herald-log-decoder generates a
+/// dictionary of site IDs from the source tree at build time, and uses it to recreate the text.
+/// The build's dictionary only covers the Herald library sources (herald/include, herald/src).
+/// Application log calls through SensorLogger's std::string overloads fall back to text records,
+/// which need no dictionary. Application calls through the HTDBG etc. macros are site records,
+/// so pass the application's sources to --generate-sites too, or they decode as unknown sites.
+namespace binarylog {
+  constexpr char Magic[4] = {'H','L','O','G'};
+  constexpr std::uint8_t Version = 1;
+}
+
+enum class BinaryLogRecordType : std::uint8_t {
+  logger = 1, site = 2, text = 3
+};
+
+enum class BinaryLogArgumentType : std::uint8_t {
+  integer = 0, unsignedInteger = 1, floating = 2, character = 3, text = 4
+};
+
+/// \brief Logging sink writing compact binary records rather than text
+///
+/// Messages logged through the HTDBG etc. macros are written as their call site ID and raw
+/// argument values, without being formatted. Output is buffered, and written to the stream
+/// when the buffer fills, on flush(), and on destruction. Thread safe.
+///
+/// SensorLogger registers its subsystem and category once, on construction, and logs by the
+/// returned logger ID. Arguments are encoded before taking the lock, which is then only held
+/// to append the record to the buffer.
+class BinaryLoggingSink {
+public:
+  static constexpr bool defers_formatting = true;
+
+  BinaryLoggingSink(std::ostream& out);
+  BinaryLoggingSink(const BinaryLoggingSink&) = delete;
+  BinaryLoggingSink& operator=(const BinaryLoggingSink&) = delete;
+  ~BinaryLoggingSink();
+
+  /// \brief Writes an already formatted message as a text record
+  void log(const std::string& subsystem, const std::string& category, SensorLoggerLevel level, std::string message);
+
+  /// \brief Writes a message from a runtime format string as a text record (formatted now)
+  template <typename... Types>
+  void log(const std::string& subsystem, const std::string& category, SensorLoggerLevel level,
+    const std::string& format, const Types&... args)
+  {
+    if constexpr (0 == sizeof...(args)) {
+      log(subsystem, category, level, std::string(format));
+    } else {
+      std::stringstream os;
+      tprintf(os, format, args...);
+      log(subsystem, category, level, os.str());
+    }
+  }
+
+  /// \brief Writes a message from a compile time format as a site record
+  template <std::size_t Placeholders, typename... Types>
+  void log(const std::string& subsystem, const std::string& category, SensorLoggerLevel level,
+    const LogFormat<Placeholders>& format, const Types&... args)
+  {
+    log(loggerId(subsystem, category), level, format, args...);
+  }
+
+  /// \brief The ID of a subsystem and category pair, writing its logger record on first use
+  std::uint32_t loggerId(const std::string& subsystem, const std::string& category);
+
+  /// \brief Writes a message from a compile time format as a site record, for a loggerId()
+  template <std::size_t Placeholders, typename... Types>
+  void log(std::uint32_t loggerId, SensorLoggerLevel level, const LogFormat<Placeholders>& format, const Types&... args)
+  {
+    static_assert(sizeof...(args) < 256, "Too many log arguments");
+    // Appended to rather than cleared, in case a streamed argument itself logs
+    static thread_local std::string encoded;
+    const std::size_t start = encoded.size();
+    (argument(encoded, args), ...);
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      beginSite(loggerId, format.id, level, (std::uint8_t)sizeof...(args));
+      buffer.append(encoded, start, std::string::npos);
+      endRecord();
+    }
+    encoded.resize(start);
+  }
+
+  /// \brief Writes buffered records to the stream, and flushes it
+  void flush();
+
+  /// \brief Bytes written to the stream so far, including those still buffered
+  std::uint64_t bytes();
+  std::uint64_t records();
+
+private:
+  struct Logger {
+    std::string subsystem;
+    std::string category;
+  };
+
+  std::ostream& out;
+  std::mutex lock;
+  std::string buffer;
+  std::vector<Logger> loggers;
+  std::unordered_map<std::size_t, std::uint32_t> loggerIds; // hash of subsystem and category to ID
+  std::uint64_t lastMicros;
+  std::uint64_t flushedBytes;
+  std::uint64_t recordCount;
+
+  std::uint32_t logger(const std::string& subsystem, const std::string& category);
+  void beginSite(std::uint32_t loggerId, std::uint32_t site, SensorLoggerLevel level, std::uint8_t count);
+  void endRecord();
+  void timestamp();
+
+  // Encoders, appending to the given string
+  static void varint(std::string& to, std::uint64_t value);
+  static void text(std::string& to, std::string_view value);
+  static void integer(std::string& to, std::int64_t value);
+  static void unsignedInteger(std::string& to, std::uint64_t value);
+  static void floating(std::string& to, double value);
+  static void character(std::string& to, char value);
+  static void textArgument(std::string& to, std::string_view value);
+
+  template <typename T>
+  static void argument(std::string& to, const T& value) {
+    using V = std::decay_t<T>;
+    if constexpr (std::is_same_v<V,bool>) {
+      integer(to, value ? 1 : 0);
+    } else if constexpr (std::is_same_v<V,char>) {
+      character(to, value);
+    } else if constexpr (std::is_integral_v<V> && std::is_signed_v<V>) {
+      integer(to, value);
+    } else if constexpr (std::is_integral_v<V>) {
+      unsignedInteger(to, value);
+    } else if constexpr (std::is_floating_point_v<V>) {
+      floating(to, value);
+    } else if constexpr (std::is_array_v<T> && (std::is_same_v<V,const char*> || std::is_same_v<V,char*>)) {
+      textArgument(to, std::string_view(value)); // A literal or char array, never null
+    } else if constexpr (std::is_same_v<V,const char*> || std::is_same_v<V,char*>) {
+      textArgument(to, nullptr == value ? std::string_view() : std::string_view(value));
+    } else if constexpr (std::is_convertible_v<const T&,std::string_view>) {
+      textArgument(to, std::string_view(value));
+    } else {
+      std::stringstream os;
+      os << value;
+      textArgument(to, os.str());
+    }
+  }
+};
+
+/// \brief A decoded binary log argument
+struct BinaryLogArgument {
+  BinaryLogArgumentType type = BinaryLogArgumentType::integer;
+  std::int64_t integer = 0;
+  std::uint64_t unsignedInteger = 0;
+  double floating = 0;
+  std::string text;
+};
+
+/// \brief A decoded binary log message
+struct BinaryLogRecord {
+  /// \brief Microseconds since the Unix epoch
+  std::uint64_t micros = 0;
+  /// \brief Site ID. Only valid if hasSite, otherwise text holds the formatted message.
+  std::uint32_t site = 0;
+  bool hasSite = false;
+  std::string subsystem;
+  std::string category;
+  SensorLoggerLevel level = SensorLoggerLevel::debug;
+  std::vector<BinaryLogArgument> arguments;
+  std::string text;
+};
+
+/// \brief Reads messages written by BinaryLoggingSink
+class BinaryLogReader {
+public:
+  BinaryLogReader(std::istream& in);
+  ~BinaryLogReader() = default;
+
+  /// \brief False if the stream does not start with a supported binary log header
+  bool valid() const noexcept;
+  /// \brief Reads the next message. False at the end of the stream, or if it is truncated or corrupt.
+  bool next(BinaryLogRecord& record);
+  /// \brief True if reading stopped before the end of the stream
+  bool corrupt() const noexcept;
+
+private:
+  std::istream& in;
+  bool isValid;
+  bool isCorrupt;
+  std::uint64_t lastMicros;
+  std::vector<std::pair<std::string,std::string>> loggers;
+
+  bool varint(std::uint64_t& value);
+  bool text(std::string& value);
+  bool argument(BinaryLogArgument& value);
+  bool byte(std::uint8_t& value);
+};
+
+/// \brief Formats a site record's arguments into its format string, as tprintf would
+std::string formatBinaryLogMessage(std::string_view format, const BinaryLogRecord& record);
+
+}
+
+#endif
+
+#endif
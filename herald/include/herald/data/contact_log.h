@@ -8,7 +8,11 @@
 #include "../sensor_delegate.h"
 #include "payload_data_formatter.h"
 #include "sensor_logger.h"
+#include "contact_log_writer.h"
 #include "../context.h"
+#include "../datatype/date.h"
+
+#include <vector>
 
 namespace herald::data {
 
@@ -64,6 +68,107 @@ private:
   HLOGGER(ContextT);
 };
 
+#ifndef __ZEPHYR__
+
+/**
+ * Logs all contact info to a file, via a ContactLogWriter. Suitable for high event rates:
+ * events are encoded straight into the writer's buffer, which is written by a background thread.
+ *
+ * Safe to call from multiple threads at once (E.g. delegates called from several sensors), as
+ * each event only refers to its arguments and ContactLogWriter is thread safe. Requires the
+ * PayloadDataFormatter's shortFormat() to be thread safe too, as ConcretePayloadDataFormatter's is.
+ */
+template <typename ContextT, typename PayloadDataFormatterT>
+class FileContactLogger {
+public:
+  FileContactLogger(ContextT& context, PayloadDataFormatterT& formatter, ContactLogWriter& writer)
+    : ctx(context),
+      fmt(formatter),
+      out(writer)
+      HLOGGERINIT(ctx,"Sensor","contacts.log")
+  {
+    if (!out.isOpen()) {
+      HTERR("Could not open contact log {}", out.path());
+    }
+  }
+  ~FileContactLogger() = default;
+
+  // Sensor delegate overrides
+  void sensor(SensorType sensor, const TargetIdentifier& didDetect) {
+    out.append(event(ContactLogEventType::detect, sensor, &didDetect.data()));
+  }
+
+  void sensor(SensorType sensor, const PayloadData& didRead, const TargetIdentifier& fromTarget) {
+    static thread_local std::string payload; // reused, so formatting doesn't allocate per event
+    fmt.shortFormat(didRead, payload);
+    ContactLogEvent e = event(ContactLogEventType::read, sensor, &fromTarget.data());
+    e.payload = &didRead;
+    e.text = payload;
+    out.append(e);
+  }
+
+  void sensor(SensorType sensor, const ImmediateSendData& didReceive, const TargetIdentifier& fromTarget) {
+    ContactLogEvent e = event(ContactLogEventType::receive, sensor, &fromTarget.data());
+    e.payload = &didReceive;
+    out.append(e);
+  }
+
+  void sensor(SensorType sensor, const std::vector<PayloadData>& didShare, const TargetIdentifier& fromTarget) {
+    static thread_local std::string payload;
+    ContactLogEvent e = event(ContactLogEventType::share, sensor, &fromTarget.data());
+    for (auto& shared : didShare) {
+      fmt.shortFormat(shared, payload);
+      e.payload = &shared;
+      e.text = payload;
+      out.append(e);
+    }
+  }
+
+  void sensor(SensorType sensor, const Proximity& didMeasure, const TargetIdentifier& fromTarget) {
+    ContactLogEvent e = event(ContactLogEventType::measure, sensor, &fromTarget.data());
+    e.proximity = didMeasure;
+    out.append(e);
+  }
+
+  template <typename LocationT>
+  void sensor(SensorType sensor, const Location<LocationT>& didVisit) {
+    std::string visit = didVisit.description();
+    ContactLogEvent e = event(ContactLogEventType::visit, sensor, nullptr);
+    e.text = visit;
+    out.append(e);
+  }
+
+  void sensor(SensorType sensor, const Proximity& didMeasure, const TargetIdentifier& fromTarget, const PayloadData& withPayload) {
+    // As the separate didMeasure and didRead events
+    this->sensor(sensor, didMeasure, fromTarget);
+    this->sensor(sensor, withPayload, fromTarget);
+  }
+
+  void sensor(SensorType sensor, const SensorState& didUpdateState) {
+    ContactLogEvent e = event(ContactLogEventType::state, sensor, nullptr);
+    e.text = SensorState::on == didUpdateState ? "on" : (SensorState::off == didUpdateState ? "off" : "unavailable");
+    out.append(e);
+  }
+
+private:
+  ContactLogEvent event(ContactLogEventType type, SensorType sensor, const Data* target) const {
+    ContactLogEvent e;
+    e.type = type;
+    e.sensor = sensor;
+    e.time = Date().secondsSinceUnixEpoch();
+    e.target = target;
+    return e;
+  }
+
+  ContextT& ctx;
+  PayloadDataFormatterT& fmt;
+  ContactLogWriter& out;
+
+  HLOGGER(ContextT);
+};
+
+#endif
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,146 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef HERALD_CONTACT_LOG_WRITER_H
+#define HERALD_CONTACT_LOG_WRITER_H
+
+// Requires std::thread and a file system, so not available on Zephyr
+#ifndef __ZEPHYR__
+
+#include "../datatype/data.h"
+#include "../datatype/proximity.h"
+#include "../datatype/sensor_type.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace herald::data {
+
+using namespace herald::datatype;
+
+enum class ContactLogFormat : int {
+  /// \brief As Herald's contacts.csv, with receive and state columns instead of detectHerald
+  /// and delete: time,sensor,id,detect,read,measure,share,visit,receive,state,data
+  csv,
+  /// \brief "HCON" and a version byte, then one record per event: type byte, varint time,
+  /// sensor byte, varint length + target bytes, then by type
+  /// - read, share, receive: varint length + payload bytes
+  /// - measure: unit byte, zig zag varint value
+  /// - visit, state: varint length + text
+  binary
+};
+
+/// \brief Contact log event types, numbered as the contacts.csv event columns
+enum class ContactLogEventType : std::uint8_t {
+  detect = 1, read = 2, measure = 3, share = 4, visit = 5, receive = 6, state = 7
+};
+
+/// \brief One contact log event. Only the fields relevant to its type are set.
+struct ContactLogEvent {
+  ContactLogEventType type = ContactLogEventType::detect;
+  SensorType sensor = SensorType::BLE;
+  /// \brief Seconds since the Unix epoch
+  std::uint64_t time = 0;
+  const Data* target = nullptr;
+  /// \brief Payload (read, share), immediate send data (receive), or nullptr
+  const Data* payload = nullptr;
+  /// \brief Payload short format (read, share), or state name
+  std::string_view text;
+  Proximity proximity{ProximityMeasurementUnit::RSSI, 0};
+};
+
+struct ContactLogWriterOptions {
+  ContactLogFormat format = ContactLogFormat::csv;
+  /// \brief Starts a new file once the current one would exceed this size
+  std::size_t maxFileBytes = 16 * 1024 * 1024;
+  /// \brief Starts a new file once the current one is this old
+  std::chrono::seconds maxFileAge = std::chrono::hours(24);
+  /// \brief Rotated files kept, as path.1 (newest) to path.maxFiles
+  std::size_t maxFiles = 7;
+  /// \brief Encoded events buffered before the writer thread is woken
+  std::size_t bufferBytes = 64 * 1024;
+  /// \brief Encoded events buffered at most, while the writer thread is behind. Events appended
+  /// once the buffer holds this much are dropped, and counted by dropped().
+  std::size_t maxBufferBytes = 4 * 1024 * 1024;
+  /// \brief Longest time between writes, and between fsync calls
+  std::chrono::milliseconds syncInterval = std::chrono::milliseconds(1000);
+};
+
+/// \brief High volume contact log file writer
+///
+/// Events are encoded into a memory buffer by the calling thread. A background thread writes
+/// the buffer to the file when it fills or syncInterval passes, rotates the file by size and
+/// age, and calls fsync at most once per syncInterval, so callers never wait for the disk.
+/// If the disk falls behind, the buffer grows to maxBufferBytes and then further events are
+/// dropped rather than blocking callers. Every file starts with a CSV header row or binary
+/// header. Thread safe.
+class ContactLogWriter {
+public:
+  ContactLogWriter(std::string path, ContactLogWriterOptions options = ContactLogWriterOptions());
+  ContactLogWriter(const ContactLogWriter&) = delete;
+  ContactLogWriter& operator=(const ContactLogWriter&) = delete;
+  /// \brief Writes and syncs all buffered events before returning
+  ~ContactLogWriter();
+
+  void append(const ContactLogEvent& event);
+
+  /// \brief Writes all events appended so far to the file, and syncs it, before returning
+  void flush();
+
+  const std::string& path() const noexcept;
+  /// \brief False if the log file could not be opened. Events are then discarded.
+  bool isOpen();
+  /// \brief Events buffered to be written, not counting those dropped
+  std::uint64_t events();
+  /// \brief Events dropped because the buffer held maxBufferBytes
+  std::uint64_t dropped();
+  std::uint64_t rotations();
+
+private:
+  void encodeCsv(const ContactLogEvent& event);
+  void encodeBinary(const ContactLogEvent& event);
+  void run();
+  void write(const std::string& data);
+  void open();
+  void rotate();
+  void sync();
+
+  const std::string filePath;
+  const ContactLogWriterOptions options;
+
+  std::mutex lock;
+  std::condition_variable wake;
+  std::condition_variable written;
+  std::string active; // appended to by callers, under lock
+  std::uint64_t appended;
+  std::uint64_t droppedCount;
+  std::uint64_t requested; // flush requests
+  std::uint64_t completed;
+  std::uint64_t rotationCount;
+  bool opened;
+  bool stopping;
+
+  // Writer thread only
+  std::string pending;
+  std::FILE* file;
+  std::size_t fileBytes;
+  std::chrono::steady_clock::time_point fileOpened;
+  std::chrono::steady_clock::time_point lastSync;
+  bool unsynced;
+
+  std::thread writer;
+};
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,115 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef HERALD_ENCOUNTER_STORE_H
+#define HERALD_ENCOUNTER_STORE_H
+
+// Requires POSIX memory mapped files, so not available on Zephyr or Windows
+#if !defined(__ZEPHYR__) && !defined(_WIN32)
+
+#include "../datatype/date.h"
+#include "../datatype/encounter.h"
+#include "../datatype/payload_data.h"
+#include "../datatype/proximity.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace herald::data {
+
+using namespace herald::datatype;
+
+struct EncounterStoreOptions {
+  /// \brief Time covered by each partition. Queries only read partitions overlapping their window.
+  std::chrono::seconds partitionDuration = std::chrono::hours(1);
+  /// \brief Encounters per segment file. A partition has as many segments as it needs.
+  std::uint32_t segmentCapacity = 65536;
+  /// \brief Payload bytes reserved per encounter in each segment
+  std::uint32_t payloadBytesPerEncounter = 32;
+};
+
+/// \brief An encounter read in place from an EncounterStore, without copying its payload
+///
+/// Only valid while the store is open. Creating PayloadData instances uses Data's fixed size
+/// memory arena, so call payloadData() or encounter() for the records needed, not for all.
+struct EncounterView {
+  /// \brief Seconds since the Unix epoch
+  std::uint64_t time;
+  Proximity proximity;
+  const std::uint8_t* payload;
+  std::size_t payloadLength;
+  std::uint64_t payloadHash;
+
+  PayloadData payloadData() const;
+  Encounter encounter() const;
+};
+
+/// \brief Encounters aggregated per payload and proximity unit over a time window
+struct EncounterExposure {
+  /// \brief Payload bytes, in place in the store as for EncounterView
+  const std::uint8_t* payload;
+  std::size_t payloadLength;
+  std::uint64_t payloadHash;
+  /// \brief Unit of the proximity values. Values in different units are aggregated separately.
+  ProximityMeasurementUnit unit;
+  std::uint64_t count;
+  std::uint64_t firstSeen;
+  std::uint64_t lastSeen;
+  double meanProximity;
+  /// \brief Highest proximity value (closest, for RSSI)
+  double maxProximity;
+};
+
+/// \brief Append only, memory mapped, columnar store of Encounter records
+///
+/// Encounters are partitioned by time. Each partition is one or more fixed capacity segment
+/// files in the store's directory, holding a column per field (time, proximity unit and value,
+/// payload hash and location), a payload byte heap, and a chained hash index on the payload
+/// hash. Queries read the mapped columns directly, skipping segments outside their time
+/// window. Segments use the host's byte order. Not thread safe.
+class EncounterStore {
+public:
+  /// \brief Opens the store in a directory, creating it if needed, and maps existing segments
+  EncounterStore(std::string directory, EncounterStoreOptions options = EncounterStoreOptions());
+  EncounterStore(const EncounterStore&) = delete;
+  EncounterStore& operator=(const EncounterStore&) = delete;
+  ~EncounterStore();
+
+  /// \brief False if the directory could not be opened
+  ///
+  /// Segment files left empty by a crash during creation are removed. Other invalid segment
+  /// files are skipped, and left in place.
+  bool isOpen() const noexcept;
+
+  /// \brief False if the encounter is invalid, its payload is too big, or the segment could not be created
+  bool append(const Encounter& encounter);
+
+  /// \brief Writes mapped changes to disk before returning
+  void flush();
+
+  /// \brief Number of encounters stored
+  std::uint64_t size() const noexcept;
+  std::size_t segments() const noexcept;
+
+  /// \brief Appends encounters with this payload, at times in [from,to), in time order. Returns the number found.
+  std::size_t encounters(const PayloadData& payload, const Date& from, const Date& to,
+    std::vector<EncounterView>& results) const;
+
+  /// \brief Aggregates encounters at times in [from,to) per payload and proximity unit, most encounters first
+  std::vector<EncounterExposure> exposure(const Date& from, const Date& to) const;
+
+private:
+  class Impl;
+  std::unique_ptr<Impl> mImpl;
+};
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,163 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef HERALD_LOG_FORMAT_H
+#define HERALD_LOG_FORMAT_H
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace herald {
+namespace data {
+
+/// \brief Number of placeholders in a log format string literal, as understood by tprintf
+///
+/// Each '{}' is a placeholder, as is a '{' not followed by '}'.
+template <std::size_t N>
+constexpr std::size_t placeholderCount(const char (&format)[N]) noexcept
+{
+  std::size_t count = 0;
+  for (std::size_t pos = 0;pos + 1 < N;++pos) {
+    if ('{' == format[pos]) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+/// \brief 32 bit FNV-1a hash of a log format string, used as its call site ID in binary logs
+constexpr std::uint32_t logFormatId(const char* text, std::size_t length) noexcept
+{
+  std::uint32_t hash = 2166136261u;
+  for (std::size_t i = 0;i < length;++i) {
+    hash = (hash ^ (std::uint8_t)text[i]) * 16777619u;
+  }
+  return hash;
+}
+
+/// \brief A log format string literal, split at its placeholders at compile time
+///
+/// Created by the HTDBG, HTLOG and HTERR (etc.) macros as a static constexpr value per
+/// call site, so formatting a message just appends the literal text segments and the
+/// arguments in turn, without searching or copying the format string.
+template <std::size_t Placeholders>
+struct LogFormat {
+  /// \brief Text between placeholders, as offsets into the format string
+  struct Segment {
+    std::size_t offset;
+    std::size_t length;
+  };
+
+  template <std::size_t N>
+  constexpr LogFormat(const char (&format)[N]) noexcept
+    : text(format), length(N - 1), id(logFormatId(format, N - 1)), segments{}
+  {
+    static_assert(N > 0, "Log format must be a string literal");
+    std::size_t segment = 0;
+    std::size_t start = 0;
+    for (std::size_t pos = 0;pos < length && segment < Placeholders;++pos) {
+      if ('{' != format[pos]) {
+        continue;
+      }
+      segments[segment] = Segment{start, pos - start};
+      ++segment;
+      if (pos + 1 < length && '}' == format[pos + 1]) {
+        ++pos;
+      }
+      start = pos + 1;
+    }
+    segments[Placeholders] = Segment{start, length - start};
+  }
+
+  constexpr std::string_view view() const noexcept {
+    return std::string_view(text, length);
+  }
+
+  constexpr std::string_view segment(std::size_t index) const noexcept {
+    return std::string_view(text + segments[index].offset, segments[index].length);
+  }
+
+  /// \brief Length of the formatted message, excluding arguments
+  constexpr std::size_t literalLength() const noexcept {
+    std::size_t total = 0;
+    for (const auto& s : segments) {
+      total += s.length;
+    }
+    return total;
+  }
+
+  const char* text;
+  std::size_t length;
+  /// \brief Hash of the format text, identifying it (and so its call sites) in binary logs
+  std::uint32_t id;
+  /// \brief One more than the placeholder count: text before each placeholder, then the remainder
+  std::array<Segment, Placeholders + 1> segments;
+};
+
+/// \brief Appends a log argument as text, as tprintf would write it to a std::stringstream
+template <typename T>
+void appendLogArgument(std::string& out, const T& value)
+{
+  using V = std::decay_t<T>;
+  if constexpr (std::is_same_v<V,bool>) {
+    out.push_back(value ? '1' : '0');
+  } else if constexpr (std::is_same_v<V,char>) {
+    out.push_back(value);
+  } else if constexpr (std::is_integral_v<V>) {
+    // Includes std::int8_t and std::uint8_t, which tprintf writes as numbers
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+  } else if constexpr (std::is_floating_point_v<V>) {
+    // Same as the default std::ostream floating point format
+    char buffer[32];
+    int written = std::snprintf(buffer, sizeof(buffer), "%g", (double)value);
+    if (written > 0) {
+      out.append(buffer, std::min<std::size_t>(written, sizeof(buffer) - 1));
+    }
+  } else if constexpr (std::is_array_v<T> && (std::is_same_v<V,const char*> || std::is_same_v<V,char*>)) {
+    out.append(std::string_view(value)); // A literal or char array, never null
+  } else if constexpr (std::is_same_v<V,const char*> || std::is_same_v<V,char*>) {
+    if (nullptr != value) {
+      out.append(value);
+    }
+  } else if constexpr (std::is_convertible_v<const T&,std::string_view>) {
+    out.append(std::string_view(value));
+  } else {
+    std::stringstream os;
+    os << value;
+    out.append(os.str());
+  }
+}
+
+/// \brief Formats a message from a parsed format. Surplus placeholders are removed and surplus arguments ignored.
+template <std::size_t Placeholders, typename... Types>
+void formatLogMessage(std::string& out, const LogFormat<Placeholders>& format, const Types&... args)
+{
+  std::size_t next = 0;
+  auto one = [&out, &format, &next](const auto& arg) {
+    if (next < Placeholders) {
+      out.append(format.segment(next));
+      appendLogArgument(out, arg);
+      ++next;
+    }
+  };
+  (one(args), ...);
+  for (;next <= Placeholders;++next) {
+    out.append(format.segment(next));
+  }
+}
+
+} // end namespace
+} // end namespace
+
+#endif
@@ -19,6 +19,11 @@ public:
   virtual ~PayloadDataFormatter() = default;
 
   virtual std::string shortFormat(const PayloadData& payloadData) const noexcept = 0;
+  /// \brief As shortFormat(payloadData), but replaces the content of into, so a caller can
+  /// reuse one string for every payload
+  virtual void shortFormat(const PayloadData& payloadData, std::string& into) const noexcept {
+    into = shortFormat(payloadData);
+  }
 };
 
 class ConcretePayloadDataFormatter : public PayloadDataFormatter {
@@ -27,6 +32,7 @@ public:
   ~ConcretePayloadDataFormatter() = default;
 
   std::string shortFormat(const PayloadData& payloadData) const noexcept override;
+  void shortFormat(const PayloadData& payloadData, std::string& into) const noexcept override;
 };
 
 }
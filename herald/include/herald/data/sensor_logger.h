@@ -6,11 +6,15 @@
 #define HERALD_SENSOR_LOGGER_H
 
 #include "../datatype/bluetooth_state.h"
+#include "log_format.h"
 
+#include <atomic>
 #include <string>
 #include <memory>
 #include <ostream>
 #include <sstream>
+#include <type_traits>
+#include <utility>
 
 // Zephyr compile workaround. Not ideal.
 // #ifndef HERALD_LOG_LEVEL
@@ -24,36 +28,51 @@
 #define HLOGGER(_ctxT) \
   herald::data::SensorLogger<typename _ctxT::logging_sink_type> logger;
 #define HLOGGERINIT(_ctx,_subsystem,_category) ,logger(_ctx.getLoggingSink(),_subsystem,_category)
+
+// Parses a format string literal once, at compile time, into a static per call site LogFormat.
+// Text only known at runtime must be passed as an argument instead: HTDBG("{}",text)
+#define HLOGFORMAT(_msg) ([]() -> const auto& { \
+    static constexpr herald::data::LogFormat<herald::data::placeholderCount(_msg)> hlogformat(_msg); \
+    return hlogformat; \
+  }())
+
+// Checks the logger's runtime level (see LogLevelFilter) before the arguments are evaluated
+#define HLOGCALL(_logger,_level,_msg, ...) \
+  do { \
+    if (_logger.enabled(herald::data::SensorLoggerLevel::_level)) { \
+      _logger._level(HLOGFORMAT(_msg), ##__VA_ARGS__); \
+    } \
+  } while (false);
 #endif
 
 // HDBG Defines for within main class (more common)
 // HTDBG Defines for within Impl class
 #if HERALD_LOG_LEVEL == 4
-#define HDBG(_msg, ...) mImpl->logger.debug(_msg, ##__VA_ARGS__);
-#define HTDBG(_msg, ...) logger.debug(_msg, ##__VA_ARGS__);
-#define HLOG(_msg, ...) mImpl->logger.info(_msg, ##__VA_ARGS__);
-#define HTLOG(_msg, ...) logger.info(_msg, ##__VA_ARGS__);
-#define HERR(_msg, ...) mImpl->logger.fault(_msg, ##__VA_ARGS__);
-#define HTERR(_msg, ...) logger.fault(_msg, ##__VA_ARGS__);
+#define HDBG(_msg, ...) HLOGCALL(mImpl->logger,debug,_msg, ##__VA_ARGS__)
+#define HTDBG(_msg, ...) HLOGCALL(logger,debug,_msg, ##__VA_ARGS__)
+#define HLOG(_msg, ...) HLOGCALL(mImpl->logger,info,_msg, ##__VA_ARGS__)
+#define HTLOG(_msg, ...) HLOGCALL(logger,info,_msg, ##__VA_ARGS__)
+#define HERR(_msg, ...) HLOGCALL(mImpl->logger,fault,_msg, ##__VA_ARGS__)
+#define HTERR(_msg, ...) HLOGCALL(logger,fault,_msg, ##__VA_ARGS__)
 #endif
 
 #if HERALD_LOG_LEVEL == 3
 #define HDBG(...) /* No debug log */
 #define HTDBG(...) /* No debug log */
-#define HLOG(_msg, ...) mImpl->logger.info(_msg, ##__VA_ARGS__);
-#define HTLOG(_msg, ...) logger.info(_msg, ##__VA_ARGS__);
-#define HERR(_msg, ...) mImpl->logger.fault(_msg, ##__VA_ARGS__);
-#define HTERR(_msg, ...) logger.fault(_msg, ##__VA_ARGS__);
+#define HLOG(_msg, ...) HLOGCALL(mImpl->logger,info,_msg, ##__VA_ARGS__)
+#define HTLOG(_msg, ...) HLOGCALL(logger,info,_msg, ##__VA_ARGS__)
+#define HERR(_msg, ...) HLOGCALL(mImpl->logger,fault,_msg, ##__VA_ARGS__)
+#define HTERR(_msg, ...) HLOGCALL(logger,fault,_msg, ##__VA_ARGS__)
 #endif
 
 // This 'WARN' exists for runtime valid logging. E.g. contacts.log to RTT on Zephyr
 #if HERALD_LOG_LEVEL == 2
 #define HDBG(...) /* No debug log */
 #define HTDBG(...) /* No debug log */
-#define HLOG(_msg, ...) mImpl->logger.info(_msg, ##__VA_ARGS__);
-#define HTLOG(_msg, ...) logger.info(_msg, ##__VA_ARGS__);
-#define HERR(_msg, ...) mImpl->logger.fault(_msg, ##__VA_ARGS__);
-#define HTERR(_msg, ...) logger.fault(_msg, ##__VA_ARGS__);
+#define HLOG(_msg, ...) HLOGCALL(mImpl->logger,info,_msg, ##__VA_ARGS__)
+#define HTLOG(_msg, ...) HLOGCALL(logger,info,_msg, ##__VA_ARGS__)
+#define HERR(_msg, ...) HLOGCALL(mImpl->logger,fault,_msg, ##__VA_ARGS__)
+#define HTERR(_msg, ...) HLOGCALL(logger,fault,_msg, ##__VA_ARGS__)
 #endif
 
 #if HERALD_LOG_LEVEL == 1
@@ -61,8 +80,8 @@
 #define HTDBG(...) /* No debug log */
 #define HLOG(...) /* No info log */
 #define HTLOG(...) /* No info log */
-#define HERR(_msg, ...) mImpl->logger.fault(_msg, ##__VA_ARGS__);
-#define HTERR(_msg, ...) logger.fault(_msg, ##__VA_ARGS__);
+#define HERR(_msg, ...) HLOGCALL(mImpl->logger,fault,_msg, ##__VA_ARGS__)
+#define HTERR(_msg, ...) HLOGCALL(logger,fault,_msg, ##__VA_ARGS__)
 #endif
 
 #if HERALD_LOG_LEVEL == 0
@@ -264,23 +283,73 @@ namespace {
   
 }
 
+/// \brief True for logging sinks that format messages themselves (declaring defers_formatting = true)
+///
+/// SensorLogger passes such sinks the format (a LogFormat, or a std::string if only known at
+/// runtime) and the arguments rather than the formatted message. A message without arguments
+/// is to be logged as is, without removing placeholders.
+template <typename LoggingSinkT, typename = void>
+struct defers_formatting : std::false_type {};
+
+template <typename LoggingSinkT>
+struct defers_formatting<LoggingSinkT, std::void_t<decltype(LoggingSinkT::defers_formatting)>>
+  : std::bool_constant<LoggingSinkT::defers_formatting> {};
+
+/// \brief True for logging sinks that register each subsystem and category pair as an ID
+///
+/// SensorLogger calls loggerId(subsystem, category) once, on construction, and passes the ID
+/// rather than the strings to log() for compile time formats, so the sink does not look it up.
+template <typename LoggingSinkT, typename = void>
+struct registers_loggers : std::false_type {};
+
+template <typename LoggingSinkT>
+struct registers_loggers<LoggingSinkT, std::void_t<decltype(
+    std::declval<LoggingSinkT&>().loggerId(std::declval<const std::string&>(), std::declval<const std::string&>()))>>
+  : std::true_type {};
+
+/// \brief Minimum log levels set at runtime, per subsystem and category
+///
+/// Each SensorLogger looks up its level once, on construction, and checks it with a single
+/// relaxed atomic load before any formatting. The most specific setting applies: subsystem and
+/// category, then subsystem (empty category), then category (empty subsystem), then the
+/// default (both empty). The initial default is HERALD_RUNTIME_LOG_LEVEL, which takes
+/// HERALD_LOG_LEVEL values and defaults to HERALD_LOG_LEVEL, so all compiled in logging is
+/// enabled unless set otherwise.
+class LogLevelFilter {
+public:
+  /// \brief Sets the minimum level logged. Empty subsystem or category strings match any.
+  static void setLevel(const std::string& subsystem, const std::string& category, SensorLoggerLevel minimum);
+  /// \brief Disables all logging. Empty subsystem or category strings match any.
+  static void disable(const std::string& subsystem, const std::string& category);
+  /// \brief Removes all settings, restoring the initial default
+  static void reset();
+
+  /// \brief The lowest enabled level (as an int) for a subsystem and category, valid for the life of the process
+  static const std::atomic<int>& threshold(const std::string& subsystem, const std::string& category);
+};
+
 template <typename LoggingSinkT>
 class SensorLogger {
 public:
   SensorLogger(LoggingSinkT& sink, std::string subsystem, std::string category) 
-    : mSink(sink), mSubsystem(subsystem), mCategory(category)
+    : mSink(sink), mSubsystem(subsystem), mCategory(category),
+      mThreshold(&LogLevelFilter::threshold(mSubsystem, mCategory)), mLoggerId(0)
   {
-    ;
+    if constexpr (registers_loggers<LoggingSinkT>::value) {
+      mLoggerId = mSink.loggerId(mSubsystem, mCategory);
+    }
   }
 
   SensorLogger(const SensorLogger& other)
-    : mSink(other.mSink), mSubsystem(other.mSubsystem), mCategory(other.mCategory)
+    : mSink(other.mSink), mSubsystem(other.mSubsystem), mCategory(other.mCategory), mThreshold(other.mThreshold),
+      mLoggerId(other.mLoggerId)
   {
     ;
   }
 
   SensorLogger(SensorLogger&& other)
-    : mSink(other.mSink), mSubsystem(other.mSubsystem), mCategory(other.mCategory)
+    : mSink(other.mSink), mSubsystem(other.mSubsystem), mCategory(other.mCategory), mThreshold(other.mThreshold),
+      mLoggerId(other.mLoggerId)
   {
     ;
   }
@@ -290,6 +359,8 @@ public:
     mSink = other.mSink;
     mSubsystem = other.mSubsystem;
     mCategory = other.mCategory;
+    mThreshold = other.mThreshold;
+    mLoggerId = other.mLoggerId;
     return *this;
   }
 
@@ -298,6 +369,8 @@ public:
     mSink = other.mSink;
     mSubsystem = other.mSubsystem;
     mCategory = other.mCategory;
+    mThreshold = other.mThreshold;
+    mLoggerId = other.mLoggerId;
     return *this;
   }
   
@@ -310,9 +383,14 @@ public:
   // Note: C++11 Variadic template parameter pack expansion
   template <typename ... Types>
   void debug(const std::string& message, const Types&... args) {
+    if (!enabled(SensorLoggerLevel::debug)) {
+      return;
+    }
     const int size = sizeof...(args);
     if (0 == size) {
       log(SensorLoggerLevel::debug,message);
+    } else if constexpr (defers_formatting<LoggingSinkT>::value) {
+      mSink.log(mSubsystem, mCategory, SensorLoggerLevel::debug, message, args...);
     } else {
       std::stringstream os;
       tprintf(os,message,args...);
@@ -323,9 +401,14 @@ public:
 
   template <typename ... Types>
   void info(const std::string& message, const Types&... args) {
+    if (!enabled(SensorLoggerLevel::info)) {
+      return;
+    }
     const int size = sizeof...(args);
     if (0 == size) {
-      log(SensorLoggerLevel::debug,message);
+      log(SensorLoggerLevel::info,message);
+    } else if constexpr (defers_formatting<LoggingSinkT>::value) {
+      mSink.log(mSubsystem, mCategory, SensorLoggerLevel::info, message, args...);
     } else {
       std::stringstream os;
       tprintf(os,message,args...);
@@ -336,9 +419,14 @@ public:
 
   template <typename ... Types>
   void fault(const std::string& message, const Types&... args) {
+    if (!enabled(SensorLoggerLevel::fault)) {
+      return;
+    }
     const int size = sizeof...(args);
     if (0 == size) {
-      log(SensorLoggerLevel::debug,message);
+      log(SensorLoggerLevel::fault,message);
+    } else if constexpr (defers_formatting<LoggingSinkT>::value) {
+      mSink.log(mSubsystem, mCategory, SensorLoggerLevel::fault, message, args...);
     } else {
       std::stringstream os;
       tprintf(os,message,args...);
@@ -347,14 +435,56 @@ public:
     }
   }
 
+  /// \brief True if messages at this level are currently logged (see LogLevelFilter)
+  bool enabled(SensorLoggerLevel lvl) const noexcept {
+    return (int)lvl >= mThreshold->load(std::memory_order_relaxed);
+  }
+
+  /// \brief Logs using a format parsed at compile time (as created by the HTDBG etc. macros)
+  ///
+  /// Does not check enabled(), as the macros do so before evaluating the arguments.
+  template <std::size_t Placeholders, typename ... Types>
+  void debug(const LogFormat<Placeholders>& format, const Types&... args) {
+    write(SensorLoggerLevel::debug, format, args...);
+  }
+
+  template <std::size_t Placeholders, typename ... Types>
+  void info(const LogFormat<Placeholders>& format, const Types&... args) {
+    write(SensorLoggerLevel::info, format, args...);
+  }
+
+  template <std::size_t Placeholders, typename ... Types>
+  void fault(const LogFormat<Placeholders>& format, const Types&... args) {
+    write(SensorLoggerLevel::fault, format, args...);
+  }
+
 private:
   inline void log(SensorLoggerLevel lvl, std::string msg) {
-    mSink.log(mSubsystem, mCategory, lvl, msg);
+    mSink.log(mSubsystem, mCategory, lvl, std::move(msg));
+  }
+
+  template <std::size_t Placeholders, typename ... Types>
+  void write(SensorLoggerLevel lvl, const LogFormat<Placeholders>& format, const Types&... args) {
+    if constexpr (registers_loggers<LoggingSinkT>::value) {
+      mSink.log(mLoggerId, lvl, format, args...);
+    } else if constexpr (defers_formatting<LoggingSinkT>::value) {
+      mSink.log(mSubsystem, mCategory, lvl, format, args...);
+    } else if constexpr (0 == sizeof...(args)) {
+      log(lvl, std::string(format.view()));
+    } else {
+      // The message is the only allocation
+      std::string message;
+      message.reserve(format.literalLength() + 16 * sizeof...(args));
+      formatLogMessage(message, format, args...);
+      log(lvl, std::move(message));
+    }
   }
 
   LoggingSinkT& mSink;
   std::string mSubsystem;
   std::string mCategory;
+  const std::atomic<int>* mThreshold;
+  std::uint32_t mLoggerId; // only if registers_loggers
 };
 
 } // end namespace
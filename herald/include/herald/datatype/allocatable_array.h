@@ -199,7 +199,7 @@ private:
     while (idx < max_size) {
       if (m_allocated.test(idx)) {
         lastMatchedIndex = idx;
-        if (virtualIndex == count - 1) {
+        if (virtualIndex == count) {
           // return this index
           return idx;
         }
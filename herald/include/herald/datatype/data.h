@@ -88,6 +88,11 @@ public:
   /// \brief Copy assign operator. Copies the data to be sure only one object owns the entry
   DataRef& operator=(const DataRef& other)
   {
+    if (this == &other) {
+      return *this;
+    }
+    // Release our existing entry first, else it is leaked from the arena
+    getArena().deallocate(entry);
     entry = getArena().allocate(other.entry.byteLength);
     for (std::size_t i = 0;i < other.size(); ++i) {
       getArena().set(entry, i, other.getArena().get(other.entry,i));
@@ -95,6 +100,16 @@ public:
     return *this;
   }
 
+  /// \brief Move assign operator. Takes control of the other DataRef's memory allocation
+  DataRef& operator=(DataRef&& other)
+  {
+    if (this != &other) {
+      getArena().deallocate(entry);
+      std::swap(entry,other.entry);
+    }
+    return *this;
+  }
+
   /// \brief Default destructor
   ~DataRef() {
     clear();
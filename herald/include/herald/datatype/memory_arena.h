@@ -9,6 +9,10 @@
 #include <bitset>
 #include <array>
 
+#ifndef __ZEPHYR__
+#include <mutex>
+#endif
+
 /// \brief Acts as a non-global memory arena for arbitrary classes
 namespace herald {
 namespace datatype {
@@ -36,6 +40,10 @@ constexpr unsigned long pagesRequired(std::size_t size,std::size_t pageSize)
 /// Can be used one arena per dynamic allocation class, or used by multiple classes.
 /// In this non-global implementation, pass it as a static reference variable to the class
 /// once during application startup after allocation in a main class or similar.
+///
+/// On platforms with threads (not Zephyr) the page table is locked, so entries may be
+/// allocated and deallocated from any thread. Entry contents are not locked: as with any
+/// object, a DataRef must not be modified on one thread while used on another.
 template <std::size_t MaxSize, std::size_t AllocationSize>
 class MemoryArena {
 public:
@@ -69,6 +77,9 @@ public:
     if (0 == size) {
       return MemoryArenaEntry{0,0};
     }
+#ifndef __ZEPHYR__
+    std::lock_guard<std::mutex> guard(pageTableLock());
+#endif
     // find first page location with enough space
     unsigned long pages = pagesRequired(size,PageSize);
     bool inEmpty = false;
@@ -103,6 +114,9 @@ public:
     if (!entry.isInitialised()) {
       return; // guard
     }
+#ifndef __ZEPHYR__
+    std::lock_guard<std::mutex> guard(pageTableLock());
+#endif
     // set relevant bits to empty
     long pages = pagesRequired(entry.byteLength,PageSize);
     for (int i = 0;i < pages;++i) {
@@ -135,12 +149,23 @@ public:
   }
 
   std::size_t pagesFree() const noexcept {
+#ifndef __ZEPHYR__
+    std::lock_guard<std::mutex> guard(pageTableLock());
+#endif
     return pagesRequired(Size,PageSize) - pagesInUse.count();
   }
 
 private:
   std::array<unsigned char,Size> arena;
   std::bitset<pagesRequired(Size,PageSize)> pagesInUse;
+
+#ifndef __ZEPHYR__
+  /// \brief Guards pagesInUse. Shared by all arenas of this type, so as not to change the arena's size.
+  static std::mutex& pageTableLock() noexcept {
+    static std::mutex lock;
+    return lock;
+  }
+#endif
 };
 
 }
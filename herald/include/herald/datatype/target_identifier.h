@@ -36,6 +36,7 @@ public:
   operator Data() const;
 
   Data underlyingData() const;
+  const Data& data() const noexcept; // As underlyingData(), without copying
 
 private:
   Data value;
@@ -9,10 +9,13 @@
 #include "../datatype/data.h"
 #include "../datatype/target_identifier.h"
 
+#include <cstdint>
 #include <memory>
 #include <functional>
 #include <optional>
+#include <string>
 #include <tuple>
+#include <vector>
 
 namespace herald {
 namespace engine {
@@ -24,6 +27,14 @@ using namespace herald::datatype;
 /// \brief Herald implementation provided Feature tag/identifier
 using FeatureTag = herald::datatype::Data;
 
+/// \brief Small integer identifier for a FeatureTag, assigned by a FeatureRegistry
+///
+/// The Coordinator interns each provider's FeatureTag values once, when it starts, and passes
+/// its registry to every provider. Prerequisites then refer to features by FeatureId only.
+using FeatureId = std::uint8_t;
+
+class FeatureRegistry; // fwd decl
+
 /// \brief Lists all Features currently supported by Herald providers
 namespace Features {
   /// \brief Herald Bluetooth protocol connection is the first supported dependency type.
@@ -49,9 +60,9 @@ struct Activity; // fwd decl
 /// \brief An absolute prerequisite required before an activity can take place
 ///
 /// An example would be the presence of a Bluetooth connection to a specified Device.
-using Prerequisite = std::tuple<FeatureTag,std::optional<TargetIdentifier>>;
+using Prerequisite = std::tuple<FeatureId,std::optional<TargetIdentifier>>;
 /// \brief a Presrequisite with a relative priority assigned to assist Herald to prioritise effectively.
-using PrioritisedPrerequisite = std::tuple<FeatureTag,Priority,std::optional<TargetIdentifier>>;
+using PrioritisedPrerequisite = std::tuple<FeatureId,Priority,std::optional<TargetIdentifier>>;
 
 
 // THE FOLLOWING IS FOR PLATFORMS WITH CALLBACK / STD::ASYNC+STD::FUTURE SUPPORT
@@ -82,6 +93,10 @@ struct Activity {
   std::vector<Prerequisite> prerequisites; // no target id means all that are connected
   /// \brief The Activity function to call when all prerequisites have been met. May not be called.
   ActivityFunction executor;
+  /// \brief How long after first being requested this activity should have run by. Zero means no deadline.
+  ///
+  /// Used to order activities of equal priority, and to exempt overdue activities from the iteration time budget.
+  std::uint32_t deadlineMillis = 0;
 };
 
 /// \brief Coordination management class that arranges Sensor's periodic requirements and activity interdependencies.
@@ -99,16 +114,26 @@ public:
   /// What connections does this Sensor type provide for Coordination
   virtual std::vector<FeatureTag> connectionsProvided() = 0;
 
+  /// \brief Called once all providers' features are registered, before the first iteration
+  ///
+  /// Providers look up (find()) the FeatureId of each feature their prerequisites require here.
+  virtual void featuresRegistered(const FeatureRegistry&) {}
+
   /// \brief Runtime connection provisioning (if it isn't requested, it can be closed)
   ///
+  /// Appends those requested that are now provisioned to provisioned. The Coordinator reuses
+  /// the vectors passed to these runtime methods between iterations, so appending to them
+  /// does not allocate once they have grown to their steady state size.
+  ///
   /// Note:  WITH STD::SYNC ONLY: virtual void provision(const std::vector<PrioritisedPrerequisite>& requested, const ConnectionCallback& connCallback) = 0;
-  virtual std::vector<PrioritisedPrerequisite> provision(const std::vector<PrioritisedPrerequisite>& requested) = 0;
+  virtual void provision(const std::vector<PrioritisedPrerequisite>& requested,
+                         std::vector<PrioritisedPrerequisite>& provisioned) = 0;
 
   // Runtime coordination callbacks
-  /// \brief Get a list of what connections are required to which devices now (may start, maintain, end (if not included))
-  virtual std::vector<PrioritisedPrerequisite> requiredConnections() = 0;
-  /// \brief Get a list of activities that are currently outstanding in this iteration
-  virtual std::vector<Activity> requiredActivities() = 0;
+  /// \brief Appends what connections are required to which devices now (may start, maintain, end (if not included))
+  virtual void requiredConnections(std::vector<PrioritisedPrerequisite>& required) = 0;
+  /// \brief Appends the activities that are currently outstanding in this iteration
+  virtual void requiredActivities(std::vector<Activity>& required) = 0;
 };
 
 }
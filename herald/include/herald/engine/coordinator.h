@@ -7,13 +7,23 @@
 
 #include "../context.h"
 #include "activities.h"
+#include "feature_registry.h"
+#include "metrics.h"
+#include "scheduler.h"
+#include "worker_pool.h"
 #include "../data/sensor_logger.h"
 
-#include <map>
 #include <vector>
 #include <algorithm>
-#include <iterator>
+#include <cstdint>
 #include <optional>
+#include <tuple>
+#include <utility>
+
+#ifndef __ZEPHYR__
+#include <condition_variable>
+#include <mutex>
+#endif
 
 namespace herald {
 
@@ -42,11 +52,38 @@ public:
   Coordinator(ContextT& ctx)
   : context(ctx),
     providers(),
+    features(),
+    featureProviders(),
+    assignPrereqs(),
+    required(),
+    providerProvisioned(),
+    provisioned(),
+    activities(),
+    iterationHistogram(),
+    queue(),
+    metrics(),
+    iterationBudget(0),
+    budgetExemptPriority(Priorities::Critical),
+#ifndef __ZEPHYR__
+    pool(nullptr),
+    concurrencyLimits(),
+    runningPerFeature(),
+    inFlight(),
+    completionLock(),
+    completionSignal(),
+    completions(),
+    drained(),
+#endif
     running(false)
     HLOGGERINIT(ctx,"engine","coordinator")
   {}
 
-  ~Coordinator() = default;
+  /// Waits for any asynchronous activities still running, as they refer to this Coordinator
+  ~Coordinator() {
+#ifndef __ZEPHYR__
+    setWorkerPool(nullptr);
+#endif
+  }
 
   /// Introspect and include in iteration planning
   template <typename SensorT>
@@ -70,13 +107,36 @@ public:
     HTDBG("Start called");
     // Clear feature providers
     featureProviders.clear();
-    // Fetch feature providers
-    for (auto prov: providers) {
-      auto myFeatures = prov.get().connectionsProvided();
-      for (auto feature : myFeatures) {
-        featureProviders.emplace(feature,prov);
+    // Fetch feature providers, interning their tags
+    for (std::size_t idx = 0;idx < providers.size();++idx) {
+      for (auto& feature : providers[idx].get().connectionsProvided()) {
+        FeatureId id = features.intern(feature);
+        if (FeatureRegistry::Unknown == id) {
+          HTERR("Too many feature tags registered, ignoring feature");
+          continue;
+        }
+        if (featureProviders.size() <= id) {
+          featureProviders.resize(id + 1, NoProvider);
+        }
+        if (NoProvider == featureProviders[id]) {
+          featureProviders[id] = idx;
+        }
       }
     }
+    featureProviders.resize(features.size(), NoProvider);
+    for (auto& prov : providers) {
+      prov.get().featuresRegistered(features);
+    }
+    // Pre-size iteration scratch space so the Coordinator's own containers do not reallocate in steady state
+    assignPrereqs.resize(providers.size());
+    for (auto& assigned : assignPrereqs) {
+      assigned.reserve(ScratchReserve);
+    }
+    required.reserve(ScratchReserve);
+    providerProvisioned.reserve(ScratchReserve);
+    provisioned.reserve(ScratchReserve * providers.size());
+    activities.reserve(ScratchReserve);
+    queue.reserve(ScratchReserve * providers.size());
     running = true;
     HTDBG("Start returning");
   }
@@ -88,123 +148,370 @@ public:
       return;
     }
     HTDBG("################# ITERATION #################");
-    // HTDBG("Entered iteration");
-    // Create empty list of required prereqs per provider
-    std::map<std::reference_wrapper<CoordinationProvider>,std::vector<PrioritisedPrerequisite>> assignPrereqs;
-    for (auto& prov : providers) {
-      assignPrereqs.emplace(prov,std::vector<PrioritisedPrerequisite>());
+    const std::uint64_t iterationStart = monotonicMicros();
+#ifndef __ZEPHYR__
+    drainCompletions();
+#endif
+    // Reuse the required prereqs per provider scratch (clear() retains capacity)
+    if (assignPrereqs.size() != providers.size()) {
+      assignPrereqs.resize(providers.size());
     }
-    // HTDBG("Completed initialisation of provider prerequisities containers");
-    // HTDBG(" - Provider count: {}", providers.size());
-    
-    std::vector<PrioritisedPrerequisite> connsRequired;
-    // Loop over providers and ask for feature pre-requisites
-    for (auto& prov : providers) {
-      auto myConns = prov.get().requiredConnections();
-      std::copy(myConns.begin(),myConns.end(),
-        std::back_insert_iterator<std::vector<PrioritisedPrerequisite>>(connsRequired));
+    for (auto& assigned : assignPrereqs) {
+      assigned.clear();
     }
-    // HTDBG(std::to_string(connsRequired.size()));
-    // HTDBG("Retrieved providers' current prerequisites");
+
+    // Loop over providers and ask for feature pre-requisites, linking each to its provider
     // TODO de-duplicate pre-reqs
-    // Now link required prereqs to each provider
-    for (auto& p : connsRequired) {
-      auto el = featureProviders.find(std::get<0>(p)); // find provider for given prereq by feature tag
-      if (featureProviders.end() != el) {
-        assignPrereqs[el->second].push_back(p);
+    for (auto& prov : providers) {
+      required.clear();
+      prov.get().requiredConnections(required);
+      for (auto& p : required) {
+        std::size_t idx = providerFor(std::get<0>(p)); // find provider for given prereq by feature
+        if (NoProvider != idx) {
+          assignPrereqs[idx].push_back(std::move(p));
+        }
       }
     }
-    // HTDBG("Linked pre-reqs to their providers");
-
-    // // Some debug checks here
-    // int cnt = 0;
-    // for (auto& ass : assignPrereqs) {
-    //   // HTDBG("assign prereqs number {} has this many prereqs to fill {}", cnt, ass.second.size());
-    //   cnt++;
-    // }
     
     // Communicate with relevant feature providers and request features for targets (in descending priority order)
     //  - Includes removal of previous features no longer needed
-    std::vector<PrioritisedPrerequisite> provisioned;
-    for (auto& prov : assignPrereqs) {
+    provisioned.clear();
+    for (std::size_t idx = 0;idx < providers.size();++idx) {
       // TODO sort by descending priority before passing on
-
-      // FOR PLATFORMS WITH STD::FUTURE AND STD::ASYNC
-      // std::future<void> fut = std::async(std::launch::async,
-      //     &CoordinationProvider::provision, prov.first,
-      // //prov.first->provision(
-      //     prov.second,[&provisioned] (
-      //   const std::vector<PrioritisedPrerequisite> myProvisioned) -> void {
-      //   std::copy(myProvisioned.begin(),myProvisioned.end(),
-      //     std::back_insert_iterator<std::vector<PrioritisedPrerequisite>>(provisioned));
-      // });
-      // fut.get(); // waits for callback // TODO wait with timeout
-
-      // FOR OTHER PLATFORMS (E.g. ZEPHYR):-
-      std::vector<PrioritisedPrerequisite> myProvisioned = prov.first.get().provision(prov.second);
-      std::copy(myProvisioned.begin(),myProvisioned.end(),
-        std::back_insert_iterator<std::vector<PrioritisedPrerequisite>>(provisioned));
-    }
-    // HTDBG("All pre-requisities requests sent and responses received");
+      providerProvisioned.clear();
+      providers[idx].get().provision(assignPrereqs[idx],providerProvisioned);
+      for (auto& myProvisioned : providerProvisioned) {
+        provisioned.push_back(ProvisionedKey(std::get<0>(myProvisioned),std::get<2>(myProvisioned)));
+      }
+    }
+    std::sort(provisioned.begin(),provisioned.end());
     // TODO do the above asynchronously and await callback or timeout for all
 
-    // For each which are now present, ask for activities (in descending priority order)
+    // For each which are now present, ask for activities, and run them in priority then deadline order
+    queue.beginIteration();
+    const std::uint64_t requested = monotonicMicros();
     for (auto& prov : providers) {
-      auto maxActs = prov.get().requiredActivities();
-      // TODO sort by descending priority before actioning
-      for (auto& act : maxActs) {
-        std::string san("Activity ");
-        san += act.name;
-        HTDBG(san);
-        // HTDBG("Checking next desired activity for prereqs being satisfied");
-        // Filter requested by provisioned
-        bool allFound = true;
-        for (auto& pre : act.prerequisites) {
-          bool myFound = false;
-          for (auto& exists : provisioned) {
-            if (std::get<0>(pre) == std::get<0>(exists) &&
-                std::get<1>(pre) == std::get<2>(exists)) {
-              myFound = true;
-            }
-          }
-          allFound = allFound & myFound;
-          if (myFound) {
-            HTDBG(" - Prereq satisfied");
-          } else {
-            HTDBG(" - Prereq NOT SATISFIED");
-          }
-        }
-        // Carry out activities with completion callbacks passed in
-        if (allFound) {
-          HTDBG("All satisfied, calling activity");
-          // do activity
-
-          // FOR PLATFORMS WITH STD::ASYNC
-          // act.executor(act,[this] (Activity act, std::optional<Activity> followOn) -> void {
-          //   // TODO handle result
-          //   // TODO Carry out any follow up activities
-          //   HTDBG("Activity completion callback called");
-          // });
-
-          // FOR PLATFORMS WITHOUT
-          std::optional<Activity> followOn = act.executor(act);
-          // TODO carry out follow on activity until no more follow ons (or max follow on number hit)
+      activities.clear();
+      prov.get().requiredActivities(activities);
+      for (auto& act : activities) {
+        queue.require(std::move(act),requested);
+      }
+    }
+    metrics.queueDepth.record(queue.size());
+    while (!queue.empty()) {
+      ScheduledActivity next = queue.pop();
+      const std::uint64_t started = monotonicMicros();
+      const bool overdue = started > next.deadline;
+      if (0 != iterationBudget && started - iterationStart >= iterationBudget &&
+          next.activity.priority < budgetExemptPriority && !overdue) {
+        ++metrics.deferred;
+        queue.defer(std::move(next));
+        continue;
+      }
+      HTDBG("Activity {}", next.activity.name);
+      if (!prerequisitesProvisioned(next.activity)) {
+        // Provider requested activities are requested again next iteration, follow ons are not
+        if (next.followOnDepth > 0) {
+          ++metrics.discarded;
         }
+        continue;
+      }
+      HTDBG("All satisfied, calling activity");
+      if (overdue) {
+        ++metrics.overdue;
+      }
+#ifndef __ZEPHYR__
+      if (nullptr != pool) {
+        dispatch(std::move(next),started);
+        continue;
       }
+#endif
+      std::optional<Activity> followOn = next.activity.executor(next.activity);
+      complete(next,std::move(followOn),started,monotonicMicros());
     }
-    // HTDBG("Leaving iteration");
+    queue.restoreDeferred();
+    iterationHistogram.record(monotonicMicros() - iterationStart);
     HTDBG("#################    END    #################");
   }
+
+  /// \brief Limits the time spent running activities in each iteration. Zero (the default) means no limit.
+  ///
+  /// Once spent, remaining activities below exemptPriority that are not yet overdue are
+  /// deferred to the next iteration.
+  void setIterationBudget(std::uint64_t micros, Priority exemptPriority = Priorities::Critical) noexcept {
+    iterationBudget = micros;
+    budgetExemptPriority = exemptPriority;
+  }
+
+  /// \brief Activity queue depth, latency, and outcome counts
+  const SchedulerMetrics& schedulerMetrics() const noexcept {
+    return metrics;
+  }
+
+  /// \brief Activities (including follow ons) held over to the next iteration
+  std::size_t queuedActivities() const noexcept {
+    return queue.size();
+  }
+
+  /// \brief Wall clock duration of each completed iteration(), in microseconds
+  const LatencyHistogram<>& iterationLatency() const noexcept {
+    return iterationHistogram;
+  }
+
+#ifndef __ZEPHYR__
+  /// \brief Runs activities on the given pool rather than inline in iteration()
+  ///
+  /// Executors will then be called from pool threads, and so must be safe to call concurrently
+  /// with each other and with the provider's other methods. (Data, and so FeatureTag and
+  /// TargetIdentifier, may be created and destroyed on any thread, as its memory arena is
+  /// locked on platforms with threads.) Results (metrics and follow on activities) are
+  /// processed at the start of the next iteration(). An activity that is still running is not
+  /// started again when re-requested. Pass nullptr to run activities inline again.
+  ///
+  /// Changing the pool, stop(), and destroying this Coordinator all wait for running activities,
+  /// after which the pool is no longer used and may be destroyed.
+  void setWorkerPool(WorkerPool* workers) {
+    awaitActivities();
+    pool = workers;
+  }
+
+  /// \brief Limits how many asynchronous activities requiring the given feature run at once. Zero means no limit.
+  ///
+  /// Activities over the limit are deferred to the next iteration.
+  void setConcurrencyLimit(const FeatureTag& feature, std::size_t limit) {
+    FeatureId id = features.intern(feature);
+    if (FeatureRegistry::Unknown == id) {
+      HTERR("Too many feature tags registered, ignoring concurrency limit");
+      return;
+    }
+    if (concurrencyLimits.size() <= id) {
+      concurrencyLimits.resize(id + 1, 0);
+    }
+    if (runningPerFeature.size() <= id) {
+      runningPerFeature.resize(id + 1, 0);
+    }
+    concurrencyLimits[id] = limit;
+  }
+
+  /// \brief Asynchronous activities started but whose completion has not yet been processed
+  std::size_t runningActivities() const noexcept {
+    return inFlight.size();
+  }
+
+  /// \brief Blocks until all asynchronous activities complete, then processes their results
+  ///
+  /// Follow on activities are queued for the next iteration.
+  void awaitActivities() {
+    {
+      std::unique_lock<std::mutex> guard(completionLock);
+      completionSignal.wait(guard, [this] { return completions.size() >= inFlight.size(); });
+    }
+    drainCompletions();
+  }
+#endif
+
   /// Closes out any existing connections/activities
   void stop() {
     running = false;
+#ifndef __ZEPHYR__
+    awaitActivities();
+#endif
   }
 
 private:
+  /// \brief Initial per provider capacity of the iteration scratch space
+  static constexpr std::size_t ScratchReserve = 16;
+  /// \brief Longest chain of follow on activities run from one requested activity
+  static constexpr std::uint8_t MaxFollowOnDepth = 8;
+
+  /// \brief Index of no provider in featureProviders
+  static constexpr std::size_t NoProvider = SIZE_MAX;
+
+  /// \brief Interned form of a provisioned (FeatureId,optional<TargetIdentifier>) pair
+  ///
+  /// Target equality matches TargetIdentifier equality, which also compares hash codes.
+  struct ProvisionedKey {
+    ProvisionedKey(FeatureId feature, const std::optional<TargetIdentifier>& target) noexcept
+      : feature(feature),
+        target(target.has_value() ? target.value().hashCode() : 0),
+        hasTarget(target.has_value())
+    {}
+
+    bool operator<(const ProvisionedKey& other) const noexcept {
+      return std::tie(feature,hasTarget,target) < std::tie(other.feature,other.hasTarget,other.target);
+    }
+
+    FeatureId feature;
+    std::size_t target;
+    bool hasTarget;
+  };
+
+  std::size_t providerFor(FeatureId id) const noexcept {
+    return id < featureProviders.size() ? featureProviders[id] : NoProvider;
+  }
+
+  bool prerequisitesProvisioned(const Activity& act) {
+    bool allFound = true;
+    for (auto& pre : act.prerequisites) {
+      FeatureId id = std::get<0>(pre);
+      bool myFound = FeatureRegistry::Unknown != id && std::binary_search(provisioned.begin(),provisioned.end(),
+        ProvisionedKey(id,std::get<1>(pre)));
+      allFound = allFound && myFound;
+      if (myFound) {
+        HTDBG(" - Prereq satisfied");
+      } else {
+        HTDBG(" - Prereq NOT SATISFIED");
+      }
+    }
+    return allFound;
+  }
+
+  /// \brief Records the outcome of an activity, and queues its follow on activity (if any)
+  void complete(const ScheduledActivity& done, std::optional<Activity>&& followOn,
+                std::uint64_t started, std::uint64_t finished) {
+    ++metrics.executed;
+    metrics.activityWait.record(started - done.scheduled);
+    metrics.activityDuration.record(finished - started);
+    if (!followOn.has_value()) {
+      return;
+    }
+    if (done.followOnDepth >= MaxFollowOnDepth) {
+      HTERR("Follow on chain too long, discarding follow on of {}", done.activity.name);
+      ++metrics.discarded;
+      return;
+    }
+    ++metrics.followOns;
+    queue.followOn(std::move(followOn.value()),done,finished);
+  }
+
+#ifndef __ZEPHYR__
+  /// \brief An asynchronous activity's result, passed back from a pool thread
+  struct Completion {
+    ScheduledActivity activity;
+    std::optional<Activity> followOn;
+    std::uint64_t started;
+    std::uint64_t finished;
+  };
+
+  /// \brief Starts an activity on the pool, or defers it if it cannot start yet
+  void dispatch(ScheduledActivity&& next, std::uint64_t started) {
+    // Providers re-request outstanding activities, so one may still be running from a prior iteration
+    if (0 != next.key) {
+      for (auto& running : inFlight) {
+        if (running.key == next.key) {
+          HTDBG("Activity already running");
+          return;
+        }
+      }
+    }
+    // Respect per feature concurrency limits
+    InFlightActivity running{next.sequence,next.key,{}};
+    running.features.reserve(next.activity.prerequisites.size());
+    for (auto& pre : next.activity.prerequisites) {
+      FeatureId id = std::get<0>(pre);
+      if (id < concurrencyLimits.size() && 0 != concurrencyLimits[id] &&
+          runningPerFeature[id] >= concurrencyLimits[id]) {
+        HTDBG("Activity deferred, feature concurrency limit reached");
+        ++metrics.throttled;
+        queue.defer(std::move(next));
+        return;
+      }
+      running.features.push_back(id);
+    }
+    // The task owns its copy of the activity; the queue keeps next only if the pool is full
+    bool submitted = pool->submit([this,scheduled = next,started] () mutable {
+      std::optional<Activity> followOn = scheduled.activity.executor(scheduled.activity);
+      std::uint64_t finished = monotonicMicros();
+      // Notify while holding the lock, as once it is released the Coordinator may be destroyed
+      std::lock_guard<std::mutex> guard(completionLock);
+      completions.push_back(Completion{std::move(scheduled),std::move(followOn),started,finished});
+      completionSignal.notify_all();
+    });
+    if (!submitted) {
+      HTDBG("Activity deferred, worker pool queue full");
+      ++metrics.throttled;
+      queue.defer(std::move(next));
+      return;
+    }
+    for (FeatureId id : running.features) {
+      if (FeatureRegistry::Unknown == id) {
+        continue;
+      }
+      if (runningPerFeature.size() <= id) {
+        runningPerFeature.resize(id + 1, 0);
+      }
+      ++runningPerFeature[id];
+    }
+    inFlight.push_back(std::move(running));
+    if (inFlight.size() > metrics.maxRunning) {
+      metrics.maxRunning = inFlight.size();
+    }
+  }
+
+  /// \brief Processes results from asynchronous activities completed since the last call
+  void drainCompletions() {
+    {
+      std::lock_guard<std::mutex> guard(completionLock);
+      std::swap(completions,drained);
+    }
+    for (auto& done : drained) {
+      for (auto it = inFlight.begin();it != inFlight.end();++it) {
+        if (it->sequence == done.activity.sequence) {
+          for (FeatureId id : it->features) {
+            if (id < runningPerFeature.size()) {
+              --runningPerFeature[id];
+            }
+          }
+          inFlight.erase(it);
+          break;
+        }
+      }
+      complete(done.activity,std::move(done.followOn),done.started,done.finished);
+    }
+    drained.clear();
+  }
+
+#endif
+
   ContextT& context;
 
   std::vector<std::reference_wrapper<CoordinationProvider>> providers;
-  std::map<FeatureTag,std::reference_wrapper<CoordinationProvider>> featureProviders;
+  FeatureRegistry features;
+  std::vector<std::size_t> featureProviders; // Indexed by FeatureId, index in providers or NoProvider
+
+  // Iteration scratch space, reused between iterations. Only the Coordinator's own containers
+  // are covered: any allocation within a provider, or by the Activity values it creates
+  // (names, prerequisite lists, executors), still happens every iteration.
+  std::vector<std::vector<PrioritisedPrerequisite>> assignPrereqs; // Indexed as providers
+  std::vector<PrioritisedPrerequisite> required; // Filled by each provider in turn
+  std::vector<PrioritisedPrerequisite> providerProvisioned; // Filled by each provider in turn
+  std::vector<ProvisionedKey> provisioned; // Sorted after provisioning
+  std::vector<Activity> activities; // Filled by each provider in turn
+
+  LatencyHistogram<> iterationHistogram;
+
+  ActivityQueue queue;
+  SchedulerMetrics metrics;
+  std::uint64_t iterationBudget;
+  Priority budgetExemptPriority;
+
+#ifndef __ZEPHYR__
+  /// \brief An activity submitted to the pool. Only accessed from the iteration() thread.
+  struct InFlightActivity {
+    std::uint64_t sequence; // Unique per queued activity
+    std::size_t key;
+    std::vector<FeatureId> features; // Of each prerequisite
+  };
+
+  WorkerPool* pool;
+  std::vector<std::size_t> concurrencyLimits; // Indexed by FeatureId, 0 for no limit
+  std::vector<std::size_t> runningPerFeature; // Indexed by FeatureId
+  std::vector<InFlightActivity> inFlight;
+  std::mutex completionLock;
+  std::condition_variable completionSignal;
+  std::vector<Completion> completions; // Guarded by completionLock
+  std::vector<Completion> drained;
+#endif
 
   bool running;
 
@@ -0,0 +1,72 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef HERALD_ENGINE_FEATURE_REGISTRY_H
+#define HERALD_ENGINE_FEATURE_REGISTRY_H
+
+#include "activities.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace herald {
+namespace engine {
+
+/// \brief Interns FeatureTag values to FeatureId values, usable as indexes into flat lookup tables
+///
+/// FeatureId values are allocated sequentially from zero in registration order. Lookup hashes the
+/// tag once and scans the (very short) list of registered hashes, rather than comparing Data.
+class FeatureRegistry {
+public:
+  /// \brief Returned by find() for tags that were never registered
+  static constexpr FeatureId Unknown = 0xff;
+
+  FeatureRegistry() : hashes(), tags() {}
+  ~FeatureRegistry() = default;
+
+  /// \brief Returns the existing FeatureId for tag, or allocates one. Returns Unknown if the registry is full.
+  FeatureId intern(const FeatureTag& tag) {
+    FeatureId existing = find(tag);
+    if (Unknown != existing || hashes.size() >= Unknown) {
+      return existing;
+    }
+    hashes.push_back(tag.hashCode());
+    tags.push_back(tag);
+    return FeatureId(hashes.size() - 1);
+  }
+
+  FeatureId find(const FeatureTag& tag) const noexcept {
+    const std::size_t hash = tag.hashCode();
+    for (std::size_t id = 0;id < hashes.size();++id) {
+      if (hashes[id] == hash) {
+        return FeatureId(id);
+      }
+    }
+    return Unknown;
+  }
+
+  /// \brief The tag registered with the given id. id must be less than size().
+  const FeatureTag& tag(FeatureId id) const noexcept {
+    return tags[id];
+  }
+
+  std::size_t size() const noexcept {
+    return hashes.size();
+  }
+
+  void clear() noexcept {
+    hashes.clear();
+    tags.clear();
+  }
+
+private:
+  std::vector<std::size_t> hashes; // Indexed by FeatureId
+  std::vector<FeatureTag> tags; // Indexed by FeatureId
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,131 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef HERALD_ENGINE_METRICS_H
+#define HERALD_ENGINE_METRICS_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+#ifdef __ZEPHYR__
+#include <kernel.h>
+#else
+#include <chrono>
+#endif
+
+namespace herald {
+namespace engine {
+
+/// \brief Monotonic microsecond counter used for latency measurement only
+inline std::uint64_t monotonicMicros() noexcept {
+#ifdef __ZEPHYR__
+  return k_ticks_to_us_floor64(k_uptime_ticks());
+#else
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/// \brief Fixed size, allocation free, latency histogram with power of two microsecond buckets
+///
+/// Bucket 0 holds values of 0us, bucket i holds values in [2^(i-1), 2^i) us, and
+/// the last bucket holds everything larger.
+template <std::size_t Buckets = 24>
+struct LatencyHistogram {
+  static constexpr std::size_t bucket_count = Buckets;
+
+  LatencyHistogram() : buckets(), total(0), sum(0), minimum(UINT64_MAX), maximum(0) {}
+  ~LatencyHistogram() = default;
+
+  void record(std::uint64_t micros) noexcept {
+    std::size_t idx = 0;
+    std::uint64_t v = micros;
+    while (v > 0 && idx < Buckets - 1) {
+      v >>= 1;
+      ++idx;
+    }
+    ++buckets[idx];
+    ++total;
+    sum += micros;
+    if (micros < minimum) {
+      minimum = micros;
+    }
+    if (micros > maximum) {
+      maximum = micros;
+    }
+  }
+
+  std::uint64_t count() const noexcept {
+    return total;
+  }
+
+  std::uint64_t bucket(std::size_t idx) const noexcept {
+    if (idx >= Buckets) {
+      return 0;
+    }
+    return buckets[idx];
+  }
+
+  /// \brief Exclusive upper bound of the bucket, in microseconds (UINT64_MAX for the last)
+  static std::uint64_t bucketUpperBound(std::size_t idx) noexcept {
+    if (idx >= Buckets - 1) {
+      return UINT64_MAX;
+    }
+    return std::uint64_t(1) << idx;
+  }
+
+  std::uint64_t min() const noexcept {
+    return 0 == total ? 0 : minimum;
+  }
+
+  std::uint64_t max() const noexcept {
+    return maximum;
+  }
+
+  double mean() const noexcept {
+    return 0 == total ? 0.0 : (double)sum / (double)total;
+  }
+
+  /// \brief Returns the upper bound of the bucket containing the given percentile (0-100), capped at max()
+  std::uint64_t percentile(double pct) const noexcept {
+    if (0 == total) {
+      return 0;
+    }
+    std::uint64_t target = (std::uint64_t)std::ceil((pct / 100.0) * total);
+    if (target < 1) {
+      target = 1;
+    }
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0;i < Buckets;++i) {
+      seen += buckets[i];
+      if (seen >= target) {
+        std::uint64_t bound = bucketUpperBound(i);
+        return bound > maximum ? maximum : bound;
+      }
+    }
+    return maximum;
+  }
+
+  void reset() noexcept {
+    buckets.fill(0);
+    total = 0;
+    sum = 0;
+    minimum = UINT64_MAX;
+    maximum = 0;
+  }
+
+private:
+  std::array<std::uint64_t,Buckets> buckets;
+  std::uint64_t total;
+  std::uint64_t sum;
+  std::uint64_t minimum;
+  std::uint64_t maximum;
+};
+
+}
+}
+
+#endif
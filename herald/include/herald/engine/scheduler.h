@@ -0,0 +1,178 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef HERALD_ENGINE_SCHEDULER_H
+#define HERALD_ENGINE_SCHEDULER_H
+
+#include "activities.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace herald {
+namespace engine {
+
+/// \brief An Activity waiting in an ActivityQueue, with its scheduling state
+struct ScheduledActivity {
+  Activity activity;
+  /// \brief monotonicMicros() when this activity was first requested
+  std::uint64_t scheduled;
+  /// \brief monotonicMicros() by which this activity should have run. UINT64_MAX if none.
+  std::uint64_t deadline;
+  /// \brief Tie breaker that keeps equal priority and deadline activities in request order
+  std::uint64_t sequence;
+  /// \brief Identity of a provider requested activity across iterations. Unused for follow ons.
+  std::size_t key;
+  /// \brief 0 for provider requested activities, else the number of executors in the follow on chain
+  std::uint8_t followOnDepth;
+};
+
+/// \brief Counters and histograms describing ActivityQueue use by the Coordinator
+struct SchedulerMetrics {
+  SchedulerMetrics() : queueDepth(), activityWait(), activityDuration(),
+    executed(0), deferred(0), overdue(0), followOns(0), discarded(0), throttled(0), maxRunning(0) {}
+  ~SchedulerMetrics() = default;
+
+  /// \brief Queue length after all activities for an iteration are requested (values are counts, not microseconds)
+  LatencyHistogram<> queueDepth;
+  /// \brief Microseconds between an activity first being requested and it starting
+  LatencyHistogram<> activityWait;
+  /// \brief Microseconds spent in each activity executor
+  LatencyHistogram<> activityDuration;
+  std::uint64_t executed;
+  /// \brief Times an activity was left in the queue because the iteration time budget was spent
+  std::uint64_t deferred;
+  /// \brief Activities that started after their deadline
+  std::uint64_t overdue;
+  std::uint64_t followOns;
+  /// \brief Follow on activities dropped as their prerequisites were no longer provisioned, or their chain was too long
+  std::uint64_t discarded;
+  /// \brief Times an asynchronous activity was deferred by a feature concurrency limit or a full worker pool
+  std::uint64_t throttled;
+  /// \brief Most asynchronous activities running at once
+  std::size_t maxRunning;
+};
+
+/// \brief Priority queue of activities, highest Priority first, then earliest deadline, then request order.
+///
+/// Providers re-request outstanding activities every iteration, so provider requested
+/// activities left in the queue are replaced by the next iteration's requests. An activity
+/// requested again (same name and prerequisites) keeps its original schedule time so that
+/// its deadline is not pushed back by being deferred. Follow on activities persist until run.
+class ActivityQueue {
+public:
+  ActivityQueue() : heap(), deferred(), carried(), nextSequence(0) {}
+  ~ActivityQueue() = default;
+
+  void reserve(std::size_t count) {
+    heap.reserve(count);
+    deferred.reserve(count);
+    carried.reserve(count);
+  }
+
+  /// \brief Starts an iteration. Removes provider requested activities, remembering when they were first requested.
+  void beginIteration() {
+    carried.clear();
+    auto followOnsEnd = std::partition(heap.begin(),heap.end(),[](const ScheduledActivity& sa) {
+      return sa.followOnDepth > 0;
+    });
+    for (auto it = followOnsEnd;it != heap.end();++it) {
+      carried.emplace_back(it->key,it->scheduled);
+    }
+    heap.erase(followOnsEnd,heap.end());
+    std::make_heap(heap.begin(),heap.end(),runsAfter);
+    std::sort(carried.begin(),carried.end());
+  }
+
+  /// \brief Enqueues an activity a provider requires this iteration
+  void require(Activity&& activity, std::uint64_t now) {
+    std::size_t key = identity(activity);
+    std::uint64_t scheduled = now;
+    auto found = std::lower_bound(carried.begin(),carried.end(),std::make_pair(key,std::uint64_t(0)));
+    if (carried.end() != found && found->first == key) {
+      scheduled = found->second;
+    }
+    push(std::move(activity),scheduled,key,0);
+  }
+
+  /// \brief Enqueues an activity returned by the executor of parent
+  void followOn(Activity&& activity, const ScheduledActivity& parent, std::uint64_t now) {
+    push(std::move(activity),now,0,parent.followOnDepth + 1);
+  }
+
+  /// \brief Removes and returns the next activity to run. Must not be called when empty().
+  ScheduledActivity pop() {
+    std::pop_heap(heap.begin(),heap.end(),runsAfter);
+    ScheduledActivity next(std::move(heap.back()));
+    heap.pop_back();
+    return next;
+  }
+
+  /// \brief Holds a popped activity back until restoreDeferred() is called
+  void defer(ScheduledActivity&& activity) {
+    deferred.push_back(std::move(activity));
+  }
+
+  /// \brief Returns all deferred activities to the queue for the next iteration
+  void restoreDeferred() {
+    for (auto& sa : deferred) {
+      heap.push_back(std::move(sa));
+      std::push_heap(heap.begin(),heap.end(),runsAfter);
+    }
+    deferred.clear();
+  }
+
+  bool empty() const noexcept {
+    return heap.empty();
+  }
+
+  std::size_t size() const noexcept {
+    return heap.size() + deferred.size();
+  }
+
+  /// \brief Heap comparator. True if first should run after second.
+  static bool runsAfter(const ScheduledActivity& first, const ScheduledActivity& second) noexcept {
+    if (first.activity.priority != second.activity.priority) {
+      return first.activity.priority < second.activity.priority;
+    }
+    if (first.deadline != second.deadline) {
+      return first.deadline > second.deadline;
+    }
+    return first.sequence > second.sequence;
+  }
+
+private:
+  std::vector<ScheduledActivity> heap;
+  std::vector<ScheduledActivity> deferred;
+  std::vector<std::pair<std::size_t,std::uint64_t>> carried; // sorted (key,scheduled)
+  std::uint64_t nextSequence;
+
+  void push(Activity&& activity, std::uint64_t scheduled, std::size_t key, std::uint8_t depth) {
+    std::uint64_t deadline = 0 == activity.deadlineMillis ? UINT64_MAX
+                           : scheduled + 1000 * std::uint64_t(activity.deadlineMillis);
+    heap.push_back(ScheduledActivity{std::move(activity),scheduled,deadline,nextSequence++,key,depth});
+    std::push_heap(heap.begin(),heap.end(),runsAfter);
+  }
+
+  static std::size_t identity(const Activity& activity) noexcept {
+    std::size_t key = std::hash<std::string>{}(activity.name);
+    for (auto& pre : activity.prerequisites) {
+      key = key * 31 + std::get<0>(pre);
+      if (std::get<1>(pre).has_value()) {
+        key = key * 31 + std::get<1>(pre).value().hashCode();
+      }
+    }
+    return key;
+  }
+};
+
+}
+}
+
+#endif
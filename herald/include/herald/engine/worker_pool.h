@@ -0,0 +1,105 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef HERALD_ENGINE_WORKER_POOL_H
+#define HERALD_ENGINE_WORKER_POOL_H
+
+// Worker threads are only available on platforms with std::thread (not Zephyr)
+#ifndef __ZEPHYR__
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace herald {
+namespace engine {
+
+/// \brief Fixed size thread pool with a bounded task queue
+///
+/// Used by the Coordinator to run activities asynchronously. Tasks must not throw.
+/// On destruction all queued tasks are completed before the threads are joined.
+class WorkerPool {
+public:
+  /// \brief Starts threadCount threads, queueing at most capacity tasks not yet started
+  WorkerPool(std::size_t threadCount, std::size_t capacity)
+    : workers(), tasks(), capacity(capacity), lock(), available(), stopping(false)
+  {
+    workers.reserve(threadCount);
+    for (std::size_t i = 0;i < threadCount;++i) {
+      workers.emplace_back([this] { work(); });
+    }
+  }
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      stopping = true;
+    }
+    available.notify_all();
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+
+  /// \brief Queues a task. Returns false, without running it, if the queue is full.
+  bool submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if (stopping || tasks.size() >= capacity) {
+        return false;
+      }
+      tasks.push_back(std::move(task));
+    }
+    available.notify_one();
+    return true;
+  }
+
+  std::size_t threadCount() const noexcept {
+    return workers.size();
+  }
+
+  /// \brief Tasks queued but not yet started
+  std::size_t pending() {
+    std::lock_guard<std::mutex> guard(lock);
+    return tasks.size();
+  }
+
+private:
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> tasks;
+  std::size_t capacity;
+  std::mutex lock;
+  std::condition_variable available;
+  bool stopping;
+
+  void work() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> guard(lock);
+        available.wait(guard, [this] { return stopping || !tasks.empty(); });
+        if (tasks.empty()) {
+          return; // stopping, and nothing left to do
+        }
+        task = std::move(tasks.front());
+        tasks.pop_front();
+      }
+      task();
+    }
+  }
+};
+
+}
+}
+
+#endif
+
+#endif
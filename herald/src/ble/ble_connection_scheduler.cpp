@@ -0,0 +1,147 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include "herald/ble/ble_connection_scheduler.h"
+
+#include <algorithm>
+
+namespace herald {
+namespace ble {
+
+using namespace herald::datatype;
+
+BLEConnectionScheduler::BLEConnectionScheduler()
+  : BLEConnectionScheduler(BLEConnectionScoring())
+{
+  ;
+}
+
+BLEConnectionScheduler::BLEConnectionScheduler(BLEConnectionScoring scoring)
+  : scoring(scoring),
+    now(0),
+    round(0),
+    states(),
+    candidates(),
+    chosen()
+{
+  ;
+}
+
+void
+BLEConnectionScheduler::begin(const Date& at)
+{
+  now = at;
+  ++round;
+  candidates.clear();
+}
+
+void
+BLEConnectionScheduler::add(const BLEConnectionCandidate& candidate)
+{
+  auto inserted = states.try_emplace(candidate.target.hashCode(),TargetState{now,Date(0),round,0});
+  inserted.first->second.round = round;
+  candidates.push_back(ScoredCandidate{&candidate.target,score(candidate)});
+}
+
+const std::vector<std::reference_wrapper<const TargetIdentifier>>&
+BLEConnectionScheduler::choose(std::size_t maximum)
+{
+  chosen.clear();
+  std::stable_sort(candidates.begin(),candidates.end(),
+    [](const ScoredCandidate& a, const ScoredCandidate& b) {
+      return a.score > b.score;
+    }
+  );
+  for (auto& candidate : candidates) {
+    if (chosen.size() >= maximum) {
+      break;
+    }
+    if (backingOff(*candidate.target,now)) {
+      continue;
+    }
+    chosen.push_back(std::cref(*candidate.target));
+  }
+  // Forget targets no longer wanting a connection (payload read, or device gone), unless still backing off
+  for (auto it = states.begin();it != states.end();) {
+    if (it->second.round != round && it->second.retryAfter <= now) {
+      it = states.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return chosen;
+}
+
+void
+BLEConnectionScheduler::connectionResult(const TargetIdentifier& target, bool success, const Date& at)
+{
+  auto found = states.find(target.hashCode());
+  if (success) {
+    if (states.end() != found) {
+      found->second.failures = 0;
+      found->second.retryAfter = Date(0);
+    }
+    return;
+  }
+  if (states.end() == found) {
+    found = states.try_emplace(target.hashCode(),TargetState{at,Date(0),round,0}).first;
+  }
+  TargetState& state = found->second;
+  if (state.failures < 255) {
+    ++state.failures;
+  }
+  long backoff = scoring.initialBackoff.seconds();
+  for (std::uint8_t i = 1;i < state.failures && backoff < scoring.maximumBackoff.seconds();++i) {
+    backoff *= 2;
+  }
+  backoff = std::min(backoff,scoring.maximumBackoff.seconds());
+  state.retryAfter = Date(at.secondsSinceUnixEpoch() + backoff);
+}
+
+double
+BLEConnectionScheduler::score(const BLEConnectionCandidate& candidate) const
+{
+  double waited = 0;
+  double failures = 0;
+  auto found = states.find(candidate.target.hashCode());
+  if (states.end() != found) {
+    if (now > found->second.firstWanted) {
+      waited = (double)(now.secondsSinceUnixEpoch() - found->second.firstWanted.secondsSinceUnixEpoch());
+    }
+    failures = found->second.failures;
+  }
+  double cap = (double)scoring.waitingCap.seconds();
+  double waiting = cap > 0 ? std::min(waited, cap) / cap : 0.0;
+
+  double signal = 0;
+  if (0 != candidate.rssi && scoring.strongRSSI > scoring.weakRSSI) {
+    signal = (double)(candidate.rssi - scoring.weakRSSI) / (double)(scoring.strongRSSI - scoring.weakRSSI);
+    signal = std::max(0.0, std::min(1.0, signal));
+  }
+
+  bool ios = BLEDeviceOperatingSystem::ios == candidate.operatingSystem ||
+             BLEDeviceOperatingSystem::ios_tbc == candidate.operatingSystem;
+
+  return scoring.waitingWeight * waiting
+       + scoring.rssiWeight * signal
+       + (candidate.serviceKnown ? scoring.knownServiceWeight : 0.0)
+       + (ios ? scoring.iosWeight : 0.0)
+       - scoring.failurePenalty * failures;
+}
+
+bool
+BLEConnectionScheduler::backingOff(const TargetIdentifier& target, const Date& at) const
+{
+  auto found = states.find(target.hashCode());
+  return states.end() != found && found->second.retryAfter > at;
+}
+
+std::size_t
+BLEConnectionScheduler::tracked() const noexcept
+{
+  return states.size();
+}
+
+}
+}
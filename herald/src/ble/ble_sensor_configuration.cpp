@@ -23,6 +23,7 @@ BLESensorConfiguration::BLESensorConfiguration()
     advertRefreshTimeInterval(TimeInterval::minutes(15)),
     peripheralCleanInterval(TimeInterval::minutes(2)),
     maxBluetoothConnections(20),
+    maxConnectionsPerIteration(4),
     advertisingEnabled(true),
     scanningEnabled(true)
 {
@@ -45,6 +46,7 @@ BLESensorConfiguration::BLESensorConfiguration(const BLESensorConfiguration& oth
     advertRefreshTimeInterval(other.advertRefreshTimeInterval),
     peripheralCleanInterval(other.peripheralCleanInterval),
     maxBluetoothConnections(other.maxBluetoothConnections),
+    maxConnectionsPerIteration(other.maxConnectionsPerIteration),
     advertisingEnabled(other.advertisingEnabled),
     scanningEnabled(other.scanningEnabled)
 {
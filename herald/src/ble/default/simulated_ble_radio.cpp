@@ -0,0 +1,361 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+// Host only (Linux and testing). Zephyr builds use the Bluetooth hardware.
+#ifndef __ZEPHYR__
+
+#include "herald/ble/default/simulated_ble_radio.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace herald {
+namespace ble {
+
+namespace {
+
+// Random streams, so that each kind of outcome is independent of the others
+constexpr std::uint64_t StreamPhase = 1;
+constexpr std::uint64_t StreamJitter = 2;
+constexpr std::uint64_t StreamNoise = 3;
+constexpr std::uint64_t StreamAddress = 4;
+constexpr std::uint64_t StreamPseudo = 5;
+constexpr std::uint64_t StreamConnect = 6;
+constexpr std::uint64_t StreamRotation = 7;
+
+/// \brief SplitMix64 finaliser
+std::uint64_t mix(std::uint64_t z) noexcept
+{
+  z += 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+std::uint64_t key(const std::array<std::uint8_t,6>& address) noexcept
+{
+  std::uint64_t k = 0;
+  for (auto b : address) {
+    k = (k << 8) | b;
+  }
+  return k;
+}
+
+constexpr double Pi = 3.14159265358979323846;
+
+}
+
+SimulatedBLERadio::SimulatedBLERadio(std::uint64_t seed)
+  : SimulatedBLERadio(seed, SimulatedBLERadioConfiguration())
+{
+  ;
+}
+
+SimulatedBLERadio::SimulatedBLERadio(std::uint64_t seed, SimulatedBLERadioConfiguration configuration)
+  : seed(seed),
+    config(configuration),
+    devices(),
+    states(),
+    events(),
+    addresses(),
+    observer(nullptr),
+    isScanning(false),
+    isAdvertising(false),
+    clock(0),
+    counts()
+{
+  ;
+}
+
+std::size_t
+SimulatedBLERadio::add(const SimulatedBLEDevice& device)
+{
+  std::size_t index = devices.size();
+  devices.push_back(device);
+  std::uint64_t interval = std::max<std::uint32_t>(1, device.advertIntervalMillis);
+  std::uint64_t first = clock + random(index, StreamPhase, 0) % interval;
+  states.push_back(DeviceState{first, 0, 0, epochAt(index, clock), false});
+  events.emplace_back(first, index);
+  std::push_heap(events.begin(), events.end(), std::greater<Event>());
+  addresses[key(address(index))] = index;
+  if (device.pseudoAddress) {
+    addresses[key(pseudoAddress(index))] = index;
+  }
+  return index;
+}
+
+SimulatedBLEDevice&
+SimulatedBLERadio::device(std::size_t index)
+{
+  return devices[index];
+}
+
+std::size_t
+SimulatedBLERadio::size() const noexcept
+{
+  return devices.size();
+}
+
+SimulatedBLERadioConfiguration&
+SimulatedBLERadio::configuration() noexcept
+{
+  return config;
+}
+
+void
+SimulatedBLERadio::listener(SimulatedBLERadioListener* toNotify) noexcept
+{
+  observer = toNotify;
+}
+
+void
+SimulatedBLERadio::scanning(bool enabled) noexcept
+{
+  isScanning = enabled;
+}
+
+bool
+SimulatedBLERadio::scanning() const noexcept
+{
+  return isScanning;
+}
+
+void
+SimulatedBLERadio::advertising(bool enabled) noexcept
+{
+  isAdvertising = enabled;
+}
+
+bool
+SimulatedBLERadio::advertising() const noexcept
+{
+  return isAdvertising;
+}
+
+std::uint64_t
+SimulatedBLERadio::now() const noexcept
+{
+  return clock;
+}
+
+void
+SimulatedBLERadio::advance(std::uint32_t millis)
+{
+  run(clock + millis, true);
+}
+
+std::array<std::uint8_t,6>
+SimulatedBLERadio::address(std::size_t index) const noexcept
+{
+  return addressFor(index, epochAt(index, clock));
+}
+
+std::array<std::uint8_t,6>
+SimulatedBLERadio::pseudoAddress(std::size_t index) const noexcept
+{
+  std::uint64_t bits = random(index, StreamPseudo, 0);
+  std::array<std::uint8_t,6> pseudo;
+  for (std::size_t i = 0;i < 6;++i) {
+    pseudo[i] = std::uint8_t(bits >> (8 * i));
+  }
+  return pseudo;
+}
+
+std::optional<std::size_t>
+SimulatedBLERadio::find(const std::array<std::uint8_t,6>& toFind) const
+{
+  auto found = addresses.find(key(toFind));
+  if (addresses.end() == found) {
+    return {};
+  }
+  std::size_t index = found->second;
+  // The map is updated as devices advertise, so a device may have rotated its address since
+  if (address(index) == toFind || (devices[index].pseudoAddress && pseudoAddress(index) == toFind)) {
+    return index;
+  }
+  return {};
+}
+
+int
+SimulatedBLERadio::meanRSSI(std::size_t index) const noexcept
+{
+  const SimulatedBLEDevice& d = devices[index];
+  double distance = std::max(0.1, std::hypot(d.x - config.x, d.y - config.y));
+  return (int)std::lround(d.txPower - 10.0 * config.pathLossExponent * std::log10(distance));
+}
+
+bool
+SimulatedBLERadio::inRange(std::size_t index) const noexcept
+{
+  return meanRSSI(index) >= config.sensitivity;
+}
+
+bool
+SimulatedBLERadio::connect(std::size_t index)
+{
+  DeviceState& state = states[index];
+  ++state.attempts;
+  ++counts.connectionAttempts;
+  if (!inRange(index) || uniform(index, StreamConnect, state.attempts) < devices[index].connectionFailureRate) {
+    ++counts.connectionFailures;
+    busy(config.connectionTimeoutMillis);
+    return false;
+  }
+  busy(devices[index].connectionLatencyMillis);
+  state.connected = true;
+  return true;
+}
+
+void
+SimulatedBLERadio::disconnect(std::size_t index) noexcept
+{
+  states[index].connected = false;
+}
+
+bool
+SimulatedBLERadio::connected(std::size_t index) const noexcept
+{
+  return states[index].connected;
+}
+
+bool
+SimulatedBLERadio::gattOperation(std::size_t index)
+{
+  if (!states[index].connected) {
+    return false;
+  }
+  ++counts.gattOperations;
+  busy(devices[index].gattLatencyMillis);
+  return true;
+}
+
+const SimulatedBLERadioMetrics&
+SimulatedBLERadio::metrics() const noexcept
+{
+  return counts;
+}
+
+std::uint64_t
+SimulatedBLERadio::random(std::size_t index, std::uint64_t stream, std::uint64_t counter) const noexcept
+{
+  return mix(mix(mix(seed ^ (stream << 56)) ^ index) ^ counter);
+}
+
+double
+SimulatedBLERadio::uniform(std::size_t index, std::uint64_t stream, std::uint64_t counter) const noexcept
+{
+  return (random(index, stream, counter) >> 11) * (1.0 / 9007199254740992.0); // 53 bits to [0,1)
+}
+
+std::uint64_t
+SimulatedBLERadio::epochAt(std::size_t index, std::uint64_t at) const noexcept
+{
+  std::uint64_t rotation = devices[index].macRotationMillis;
+  if (0 == rotation) {
+    return 0;
+  }
+  return (at + random(index, StreamRotation, 0) % rotation) / rotation;
+}
+
+std::array<std::uint8_t,6>
+SimulatedBLERadio::addressFor(std::size_t index, std::uint64_t epoch) const noexcept
+{
+  std::uint64_t bits = random(index, StreamAddress, epoch);
+  std::array<std::uint8_t,6> mac;
+  for (std::size_t i = 0;i < 6;++i) {
+    mac[i] = std::uint8_t(bits >> (8 * i));
+  }
+  mac[0] = (mac[0] & 0x3f) | 0x40; // Resolvable private address
+  return mac;
+}
+
+void
+SimulatedBLERadio::run(std::uint64_t until, bool deliver)
+{
+  while (!events.empty() && events.front().first <= until) {
+    std::pop_heap(events.begin(), events.end(), std::greater<Event>());
+    Event next = events.back();
+    events.pop_back();
+    clock = std::max(clock, next.first);
+    advertise(next.second, deliver);
+    std::uint64_t interval = std::max<std::uint32_t>(1, devices[next.second].advertIntervalMillis);
+    // Advertising events are delayed by a random 0-10ms to avoid persistent collisions
+    std::uint64_t jitter = random(next.second, StreamJitter, states[next.second].adverts) % 11;
+    states[next.second].nextAdvert = next.first + interval + jitter;
+    events.emplace_back(states[next.second].nextAdvert, next.second);
+    std::push_heap(events.begin(), events.end(), std::greater<Event>());
+  }
+  clock = std::max(clock, until);
+}
+
+void
+SimulatedBLERadio::advertise(std::size_t index, bool deliver)
+{
+  DeviceState& state = states[index];
+  const SimulatedBLEDevice& d = devices[index];
+  ++state.adverts;
+  ++counts.advertsSent;
+
+  std::uint64_t epoch = epochAt(index, clock);
+  if (epoch != state.epoch) {
+    auto previous = addresses.find(key(addressFor(index, state.epoch)));
+    if (addresses.end() != previous && previous->second == index) {
+      addresses.erase(previous);
+    }
+    state.epoch = epoch;
+    addresses[key(addressFor(index, epoch))] = index;
+    ++counts.macRotations;
+  }
+
+  if (!deliver || !isScanning || nullptr == observer) {
+    return;
+  }
+  // Box-Muller transform for normally distributed noise
+  double u1 = std::max(uniform(index, StreamNoise, 2 * state.adverts), 1e-12);
+  double u2 = uniform(index, StreamNoise, 2 * state.adverts + 1);
+  double noise = config.rssiNoise * std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * Pi * u2);
+  double distance = std::max(0.1, std::hypot(d.x - config.x, d.y - config.y));
+  int rssi = (int)std::lround(d.txPower - 10.0 * config.pathLossExponent * std::log10(distance) + noise);
+  if (rssi < config.sensitivity) {
+    return;
+  }
+  rssi = std::min(rssi, -1); // 0 means no RSSI reading
+
+  SimulatedBLEAdvert advert{index, addressFor(index, epoch), {}, 0, rssi, clock};
+  // Flags: LE General Discoverable, BR/EDR not supported
+  advert.data[advert.length++] = 0x02;
+  advert.data[advert.length++] = 0x01;
+  advert.data[advert.length++] = 0x06;
+  // Transmit power level
+  advert.data[advert.length++] = 0x02;
+  advert.data[advert.length++] = 0x0a;
+  advert.data[advert.length++] = std::uint8_t(std::int8_t(d.txPower + 41)); // At 0m (approx)
+  if (d.pseudoAddress) {
+    // Herald unregistered manufacturer data containing the pseudo device address
+    auto pseudo = pseudoAddress(index);
+    advert.data[advert.length++] = 0x09;
+    advert.data[advert.length++] = 0xff;
+    advert.data[advert.length++] = 0xff;
+    advert.data[advert.length++] = 0xfa;
+    for (auto b : pseudo) {
+      advert.data[advert.length++] = b;
+    }
+  }
+  ++counts.advertsHeard;
+  observer->simulatedAdvert(advert);
+}
+
+void
+SimulatedBLERadio::busy(std::uint32_t millis)
+{
+  counts.busyMillis += millis;
+  // The local radio cannot scan while connecting or connected, so adverts in this period are lost
+  run(clock + millis, false);
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,304 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef __ZEPHYR__
+
+#include "herald/data/async_logging_sink.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace herald::data {
+
+namespace {
+
+// Records formatted per write to the output stream
+constexpr std::size_t MaxBatch = 256;
+
+// Bounds how late output can be if a wake up is missed (producers notify without the lock)
+constexpr auto IdleWait = std::chrono::milliseconds(10);
+
+std::size_t roundUpToPowerOfTwo(std::size_t value) noexcept
+{
+  std::size_t result = 2;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+std::string_view view(const AsyncLogRecord& record, const AsyncLogArgument& arg) noexcept
+{
+  return std::string_view(record.text + arg.text.offset, arg.text.length);
+}
+
+void append(std::string& out, const AsyncLogRecord& record, const AsyncLogArgument& arg)
+{
+  char buffer[32];
+  switch (arg.kind) {
+    case AsyncLogArgument::Kind::integer: {
+      auto result = std::to_chars(buffer, buffer + sizeof(buffer), arg.integer);
+      out.append(buffer, result.ptr);
+      break;
+    }
+    case AsyncLogArgument::Kind::unsignedInteger: {
+      auto result = std::to_chars(buffer, buffer + sizeof(buffer), arg.unsignedInteger);
+      out.append(buffer, result.ptr);
+      break;
+    }
+    case AsyncLogArgument::Kind::floating: {
+      // Same as the default std::ostream floating point format
+      int length = std::snprintf(buffer, sizeof(buffer), "%g", arg.floating);
+      out.append(buffer, std::min<std::size_t>(std::max(length, 0), sizeof(buffer) - 1));
+      break;
+    }
+    case AsyncLogArgument::Kind::character:
+      out.push_back(arg.character);
+      break;
+    case AsyncLogArgument::Kind::text:
+      out.append(view(record, arg));
+      break;
+  }
+}
+
+void format(std::string& out, const AsyncLogRecord& record)
+{
+  out.append(view(record, record.subsystem));
+  out.push_back(',');
+  out.append(view(record, record.category));
+  out.push_back(',');
+  switch (record.level) {
+    case SensorLoggerLevel::debug:
+      out.append("debug");
+      break;
+    case SensorLoggerLevel::fault:
+      out.append("fault");
+      break;
+    default:
+      out.append("info");
+      break;
+  }
+  out.push_back(',');
+  std::string_view fmt = view(record, record.format);
+  if (record.preformatted) {
+    out.append(fmt);
+    out.push_back('\n');
+    return;
+  }
+  // Same placeholder handling as tprintf: '{}' (or a lone '{') takes the next argument,
+  // placeholders without an argument are removed, and surplus arguments are ignored
+  std::size_t next = 0;
+  std::size_t start = 0;
+  for (std::size_t pos = 0;pos < fmt.size();++pos) {
+    if ('{' != fmt[pos]) {
+      continue;
+    }
+    out.append(fmt.substr(start, pos - start));
+    if (next < record.argumentCount) {
+      append(out, record, record.arguments[next++]);
+    }
+    if (pos + 1 < fmt.size() && '}' == fmt[pos + 1]) {
+      ++pos;
+    }
+    start = pos + 1;
+  }
+  out.append(fmt.substr(std::min(start, fmt.size())));
+  out.push_back('\n');
+}
+
+}
+
+AsyncLogArgument
+AsyncLogRecord::copy(std::string_view value) noexcept
+{
+  AsyncLogArgument arg;
+  arg.kind = AsyncLogArgument::Kind::text;
+  std::size_t length = std::min(value.size(), TextSize - textUsed);
+  std::memcpy(text + textUsed, value.data(), length);
+  arg.text.offset = textUsed;
+  arg.text.length = (std::uint16_t)length;
+  textUsed += (std::uint16_t)length;
+  return arg;
+}
+
+AsyncLoggingSink::AsyncLoggingSink()
+  : AsyncLoggingSink(std::cout, 4096)
+{
+  ;
+}
+
+AsyncLoggingSink::AsyncLoggingSink(std::ostream& out, std::size_t capacity)
+  : out(out),
+    mask(roundUpToPowerOfTwo(capacity) - 1),
+    slots(new Slot[mask + 1]),
+    enqueuePosition(0),
+    droppedCount(0),
+    writtenPosition(0),
+    batchCount(0),
+    writerIdle(false),
+    lock(),
+    wake(),
+    drained(),
+    stopping(false),
+    writer()
+{
+  for (std::size_t i = 0;i <= mask;++i) {
+    slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  writer = std::thread([this] { run(); });
+}
+
+AsyncLoggingSink::~AsyncLoggingSink()
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_one();
+  writer.join();
+}
+
+void
+AsyncLoggingSink::log(const std::string& subsystem, const std::string& category, SensorLoggerLevel level, std::string message)
+{
+  Slot* slot = claim();
+  if (nullptr == slot) {
+    return;
+  }
+  AsyncLogRecord& record = slot->record;
+  record.reset(level, true);
+  record.subsystem = record.copy(subsystem);
+  record.category = record.copy(category);
+  // SensorLogger terminates formatted messages with std::ends
+  std::string_view text(message);
+  if (!text.empty() && '\0' == text.back()) {
+    text.remove_suffix(1);
+  }
+  record.format = record.copy(text);
+  publish(slot);
+}
+
+void
+AsyncLoggingSink::flush()
+{
+  std::size_t target = enqueuePosition.load(std::memory_order_acquire);
+  wake.notify_one();
+  std::unique_lock<std::mutex> guard(lock);
+  drained.wait(guard, [this, target] {
+    return writtenPosition.load(std::memory_order_acquire) >= target;
+  });
+}
+
+std::uint64_t
+AsyncLoggingSink::dropped() const noexcept
+{
+  return droppedCount.load(std::memory_order_relaxed);
+}
+
+std::uint64_t
+AsyncLoggingSink::written() const noexcept
+{
+  return writtenPosition.load(std::memory_order_relaxed);
+}
+
+std::uint64_t
+AsyncLoggingSink::batches() const noexcept
+{
+  return batchCount.load(std::memory_order_relaxed);
+}
+
+std::size_t
+AsyncLoggingSink::capacity() const noexcept
+{
+  return mask + 1;
+}
+
+AsyncLoggingSink::Slot*
+AsyncLoggingSink::claim() noexcept
+{
+  // Bounded multiple producer queue (after Vyukov). Each slot's sequence says which
+  // ring position it is free for, so producers only contend on enqueuePosition.
+  std::size_t position = enqueuePosition.load(std::memory_order_relaxed);
+  while (true) {
+    Slot& slot = slots[position & mask];
+    std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+    std::ptrdiff_t difference = (std::ptrdiff_t)sequence - (std::ptrdiff_t)position;
+    if (0 == difference) {
+      if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+        slot.position = position;
+        return &slot;
+      }
+    } else if (difference < 0) {
+      // Still holds the record from one lap ago, not yet written: full
+      droppedCount.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    } else {
+      position = enqueuePosition.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void
+AsyncLoggingSink::publish(Slot* slot) noexcept
+{
+  slot->sequence.store(slot->position + 1, std::memory_order_release);
+  if (writerIdle.load(std::memory_order_relaxed)) {
+    wake.notify_one();
+  }
+}
+
+void
+AsyncLoggingSink::run()
+{
+  std::string batch;
+  batch.reserve(MaxBatch * 128);
+  while (true) {
+    std::size_t count = drain(batch);
+    if (count > 0) {
+      out.write(batch.data(), (std::streamsize)batch.size());
+      out.flush();
+      batchCount.fetch_add(1, std::memory_order_relaxed);
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        writtenPosition.fetch_add(count, std::memory_order_release);
+      }
+      drained.notify_all();
+      continue;
+    }
+    std::unique_lock<std::mutex> guard(lock);
+    if (stopping) {
+      // Everything published before the destructor was called has now been written
+      return;
+    }
+    writerIdle.store(true, std::memory_order_relaxed);
+    wake.wait_for(guard, IdleWait);
+    writerIdle.store(false, std::memory_order_relaxed);
+  }
+}
+
+std::size_t
+AsyncLoggingSink::drain(std::string& batch)
+{
+  batch.clear();
+  std::size_t position = writtenPosition.load(std::memory_order_relaxed);
+  std::size_t count = 0;
+  while (count < MaxBatch) {
+    Slot& slot = slots[(position + count) & mask];
+    if (slot.sequence.load(std::memory_order_acquire) != position + count + 1) {
+      break; // Not yet published
+    }
+    format(batch, slot.record);
+    // Free the slot for the producer one lap ahead
+    slot.sequence.store(position + count + mask + 1, std::memory_order_release);
+    ++count;
+  }
+  return count;
+}
+
+}
+
+#endif
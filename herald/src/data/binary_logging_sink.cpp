@@ -0,0 +1,433 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef __ZEPHYR__
+
+#include "herald/data/binary_logging_sink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+
+namespace herald::data {
+
+namespace {
+
+// Buffered bytes written to the stream at once
+constexpr std::size_t FlushThreshold = 16384;
+
+std::uint64_t nowMicros() noexcept
+{
+  return (std::uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+}
+
+BinaryLoggingSink::BinaryLoggingSink(std::ostream& out)
+  : out(out),
+    lock(),
+    buffer(),
+    loggers(),
+    loggerIds(),
+    lastMicros(0),
+    flushedBytes(0),
+    recordCount(0)
+{
+  buffer.reserve(FlushThreshold + 1024);
+  buffer.append(binarylog::Magic, sizeof(binarylog::Magic));
+  buffer.push_back((char)binarylog::Version);
+}
+
+BinaryLoggingSink::~BinaryLoggingSink()
+{
+  flush();
+}
+
+void
+BinaryLoggingSink::log(const std::string& subsystem, const std::string& category, SensorLoggerLevel level, std::string message)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  std::uint32_t loggerId = logger(subsystem, category);
+  buffer.push_back((char)BinaryLogRecordType::text);
+  timestamp();
+  varint(buffer, loggerId);
+  buffer.push_back((char)level);
+  // SensorLogger terminates messages formatted with tprintf with std::ends
+  std::string_view view(message);
+  if (!view.empty() && '\0' == view.back()) {
+    view.remove_suffix(1);
+  }
+  text(buffer, view);
+  endRecord();
+}
+
+void
+BinaryLoggingSink::flush()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  out.write(buffer.data(), (std::streamsize)buffer.size());
+  out.flush();
+  flushedBytes += buffer.size();
+  buffer.clear();
+}
+
+std::uint64_t
+BinaryLoggingSink::bytes()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return flushedBytes + buffer.size();
+}
+
+std::uint64_t
+BinaryLoggingSink::records()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return recordCount;
+}
+
+std::uint32_t
+BinaryLoggingSink::loggerId(const std::string& subsystem, const std::string& category)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return logger(subsystem, category);
+}
+
+std::uint32_t
+BinaryLoggingSink::logger(const std::string& subsystem, const std::string& category)
+{
+  std::size_t hash = std::hash<std::string>()(subsystem) * 31 + std::hash<std::string>()(category);
+  auto found = loggerIds.find(hash);
+  if (loggerIds.end() != found) {
+    const Logger& known = loggers[found->second];
+    if (known.subsystem == subsystem && known.category == category) {
+      return found->second;
+    }
+    // Hash collision, so search the (short) list
+    for (std::size_t i = 0;i < loggers.size();++i) {
+      if (loggers[i].subsystem == subsystem && loggers[i].category == category) {
+        return (std::uint32_t)i;
+      }
+    }
+  }
+  std::uint32_t id = (std::uint32_t)loggers.size();
+  loggers.push_back(Logger{subsystem, category});
+  loggerIds.emplace(hash, id);
+  buffer.push_back((char)BinaryLogRecordType::logger);
+  varint(buffer, id);
+  text(buffer, subsystem);
+  text(buffer, category);
+  return id;
+}
+
+void
+BinaryLoggingSink::beginSite(std::uint32_t loggerId, std::uint32_t site, SensorLoggerLevel level, std::uint8_t count)
+{
+  buffer.push_back((char)BinaryLogRecordType::site);
+  timestamp();
+  char id[4] = {(char)site, (char)(site >> 8), (char)(site >> 16), (char)(site >> 24)};
+  buffer.append(id, sizeof(id));
+  varint(buffer, loggerId);
+  buffer.push_back((char)level);
+  buffer.push_back((char)count);
+}
+
+void
+BinaryLoggingSink::endRecord()
+{
+  ++recordCount;
+  if (buffer.size() >= FlushThreshold) {
+    out.write(buffer.data(), (std::streamsize)buffer.size());
+    flushedBytes += buffer.size();
+    buffer.clear();
+  }
+}
+
+void
+BinaryLoggingSink::timestamp()
+{
+  std::uint64_t micros = nowMicros();
+  // The system clock can step backwards, in which case the message gets the previous time
+  varint(buffer, micros > lastMicros ? micros - lastMicros : 0);
+  lastMicros = std::max(micros, lastMicros);
+}
+
+void
+BinaryLoggingSink::varint(std::string& to, std::uint64_t value)
+{
+  while (value >= 0x80) {
+    to.push_back((char)((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  to.push_back((char)value);
+}
+
+void
+BinaryLoggingSink::text(std::string& to, std::string_view value)
+{
+  varint(to, value.size());
+  to.append(value);
+}
+
+void
+BinaryLoggingSink::integer(std::string& to, std::int64_t value)
+{
+  to.push_back((char)BinaryLogArgumentType::integer);
+  varint(to, ((std::uint64_t)value << 1) ^ (std::uint64_t)(value >> 63)); // zig zag
+}
+
+void
+BinaryLoggingSink::unsignedInteger(std::string& to, std::uint64_t value)
+{
+  to.push_back((char)BinaryLogArgumentType::unsignedInteger);
+  varint(to, value);
+}
+
+void
+BinaryLoggingSink::floating(std::string& to, double value)
+{
+  to.push_back((char)BinaryLogArgumentType::floating);
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  for (int i = 0;i < 8;++i) {
+    to.push_back((char)(bits >> (8 * i)));
+  }
+}
+
+void
+BinaryLoggingSink::character(std::string& to, char value)
+{
+  to.push_back((char)BinaryLogArgumentType::character);
+  to.push_back(value);
+}
+
+void
+BinaryLoggingSink::textArgument(std::string& to, std::string_view value)
+{
+  to.push_back((char)BinaryLogArgumentType::text);
+  text(to, value);
+}
+
+BinaryLogReader::BinaryLogReader(std::istream& in)
+  : in(in),
+    isValid(false),
+    isCorrupt(false),
+    lastMicros(0),
+    loggers()
+{
+  char header[sizeof(binarylog::Magic) + 1];
+  if (in.read(header, sizeof(header))) {
+    isValid = 0 == std::memcmp(header, binarylog::Magic, sizeof(binarylog::Magic))
+           && binarylog::Version == (std::uint8_t)header[sizeof(binarylog::Magic)];
+  }
+}
+
+bool
+BinaryLogReader::valid() const noexcept
+{
+  return isValid;
+}
+
+bool
+BinaryLogReader::corrupt() const noexcept
+{
+  return isCorrupt;
+}
+
+bool
+BinaryLogReader::next(BinaryLogRecord& record)
+{
+  if (!isValid || isCorrupt) {
+    return false;
+  }
+  while (true) {
+    std::uint8_t type;
+    if (!in.read((char*)&type, 1)) {
+      return false; // clean end of stream
+    }
+    isCorrupt = true; // until the record is complete
+    if ((std::uint8_t)BinaryLogRecordType::logger == type) {
+      std::uint64_t id;
+      std::pair<std::string,std::string> logger;
+      if (!varint(id) || !text(logger.first) || !text(logger.second) || id != loggers.size()) {
+        return false;
+      }
+      loggers.push_back(std::move(logger));
+      isCorrupt = false;
+      continue;
+    }
+    if ((std::uint8_t)BinaryLogRecordType::site != type && (std::uint8_t)BinaryLogRecordType::text != type) {
+      return false;
+    }
+    std::uint64_t delta;
+    if (!varint(delta)) {
+      return false;
+    }
+    lastMicros += delta;
+    record.micros = lastMicros;
+    record.hasSite = (std::uint8_t)BinaryLogRecordType::site == type;
+    record.site = 0;
+    record.arguments.clear();
+    record.text.clear();
+    if (record.hasSite) {
+      std::uint8_t id[4];
+      if (!in.read((char*)id, sizeof(id))) {
+        return false;
+      }
+      record.site = id[0] | (id[1] << 8) | (id[2] << 16) | ((std::uint32_t)id[3] << 24);
+    }
+    std::uint64_t loggerId;
+    std::uint8_t level;
+    if (!varint(loggerId) || loggerId >= loggers.size() || !byte(level) || level > (std::uint8_t)SensorLoggerLevel::fault) {
+      return false;
+    }
+    record.subsystem = loggers[loggerId].first;
+    record.category = loggers[loggerId].second;
+    record.level = (SensorLoggerLevel)level;
+    if (record.hasSite) {
+      std::uint8_t count;
+      if (!byte(count)) {
+        return false;
+      }
+      record.arguments.resize(count);
+      for (auto& arg : record.arguments) {
+        if (!argument(arg)) {
+          return false;
+        }
+      }
+    } else if (!text(record.text)) {
+      return false;
+    }
+    isCorrupt = false;
+    return true;
+  }
+}
+
+bool
+BinaryLogReader::byte(std::uint8_t& value)
+{
+  return (bool)in.read((char*)&value, 1);
+}
+
+bool
+BinaryLogReader::varint(std::uint64_t& value)
+{
+  value = 0;
+  for (int shift = 0;shift < 64;shift += 7) {
+    std::uint8_t b;
+    if (!byte(b)) {
+      return false;
+    }
+    value |= (std::uint64_t)(b & 0x7f) << shift;
+    if (0 == (b & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool
+BinaryLogReader::text(std::string& value)
+{
+  std::uint64_t length;
+  if (!varint(length) || length > (1 << 20)) {
+    return false;
+  }
+  value.resize(length);
+  return 0 == length || (bool)in.read(value.data(), (std::streamsize)length);
+}
+
+bool
+BinaryLogReader::argument(BinaryLogArgument& value)
+{
+  std::uint8_t type;
+  if (!byte(type)) {
+    return false;
+  }
+  value.type = (BinaryLogArgumentType)type;
+  switch (value.type) {
+    case BinaryLogArgumentType::integer: {
+      std::uint64_t zigzag;
+      if (!varint(zigzag)) {
+        return false;
+      }
+      value.integer = (std::int64_t)(zigzag >> 1) ^ -(std::int64_t)(zigzag & 1);
+      return true;
+    }
+    case BinaryLogArgumentType::unsignedInteger:
+      return varint(value.unsignedInteger);
+    case BinaryLogArgumentType::floating: {
+      std::uint8_t bytes[8];
+      if (!in.read((char*)bytes, sizeof(bytes))) {
+        return false;
+      }
+      std::uint64_t bits = 0;
+      for (int i = 0;i < 8;++i) {
+        bits |= (std::uint64_t)bytes[i] << (8 * i);
+      }
+      std::memcpy(&value.floating, &bits, sizeof(bits));
+      return true;
+    }
+    case BinaryLogArgumentType::character: {
+      std::uint8_t c;
+      if (!byte(c)) {
+        return false;
+      }
+      value.text.assign(1, (char)c);
+      return true;
+    }
+    case BinaryLogArgumentType::text:
+      return text(value.text);
+  }
+  return false;
+}
+
+std::string
+formatBinaryLogMessage(std::string_view format, const BinaryLogRecord& record)
+{
+  if (!record.hasSite) {
+    return record.text;
+  }
+  if (record.arguments.empty()) {
+    return std::string(format); // Logged as is, as SensorLogger does
+  }
+  // Same placeholder handling as tprintf
+  std::string out;
+  std::size_t next = 0;
+  std::size_t start = 0;
+  for (std::size_t pos = 0;pos < format.size();++pos) {
+    if ('{' != format[pos]) {
+      continue;
+    }
+    out.append(format.substr(start, pos - start));
+    if (next < record.arguments.size()) {
+      const BinaryLogArgument& arg = record.arguments[next++];
+      switch (arg.type) {
+        case BinaryLogArgumentType::integer:
+          appendLogArgument(out, arg.integer);
+          break;
+        case BinaryLogArgumentType::unsignedInteger:
+          appendLogArgument(out, arg.unsignedInteger);
+          break;
+        case BinaryLogArgumentType::floating:
+          appendLogArgument(out, arg.floating);
+          break;
+        default:
+          out.append(arg.text);
+          break;
+      }
+    }
+    if (pos + 1 < format.size() && '}' == format[pos + 1]) {
+      ++pos;
+    }
+    start = pos + 1;
+  }
+  out.append(format.substr(std::min(start, format.size())));
+  return out;
+}
+
+}
+
+#endif
@@ -5,14 +5,47 @@
 #include "herald/data/payload_data_formatter.h"
 #include "herald/datatype/payload_data.h"
 
+#include <algorithm>
+#include <cstdint>
+
 namespace herald::data {
 
 using namespace herald::datatype;
 
+namespace {
+
+constexpr char Base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+}
+
 std::string
 ConcretePayloadDataFormatter::shortFormat(const PayloadData& payloadData) const noexcept
 {
-  return payloadData.shortName();
+  std::string formatted;
+  shortFormat(payloadData, formatted);
+  return formatted;
+}
+
+void
+ConcretePayloadDataFormatter::shortFormat(const PayloadData& payloadData, std::string& into) const noexcept
+{
+  // As PayloadData::shortName(): the first 6 base64 characters of the payload after its 3 byte
+  // header, or all of a payload of 3 bytes or less, but encoded in place rather than via copies
+  into.clear();
+  const std::size_t size = payloadData.size();
+  const std::size_t start = size > 3 ? 3 : 0;
+  const std::size_t maxChars = size > 3 ? 6 : 4;
+  const std::size_t end = std::min(size, start + 6); // 6 characters need at most 6 bytes
+  for (std::size_t i = start;i < end;i += 3) {
+    const std::size_t bytes = std::min((std::size_t)3, end - i);
+    std::uint32_t group = 0;
+    for (std::size_t b = 0;b < 3;++b) {
+      group = (group << 8) | (b < bytes ? (std::uint32_t)payloadData.at(i + b) : 0);
+    }
+    for (std::size_t c = 0;c < 4 && into.size() < maxChars;++c) {
+      into.push_back(c <= bytes ? Base64Chars[(group >> (18 - 6 * c)) & 0x3f] : '=');
+    }
+  }
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,385 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef __ZEPHYR__
+
+#include "herald/data/contact_log_writer.h"
+
+#include <charconv>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace herald::data {
+
+namespace {
+
+constexpr char CsvHeader[] = "time,sensor,id,detect,read,measure,share,visit,receive,state,data\n";
+constexpr char BinaryHeader[] = {'H','C','O','N',1};
+
+constexpr char HexChars[] = "0123456789abcdef";
+
+const char* sensorName(SensorType sensor) noexcept
+{
+  switch (sensor) {
+    case SensorType::BLE: return "ble";
+    case SensorType::GPS: return "gps";
+    case SensorType::BEACON: return "beacon";
+    case SensorType::ACCELEROMETER: return "accelerometer";
+    case SensorType::ULTRASOUND: return "ultrasound";
+    default: return "other";
+  }
+}
+
+template <typename T>
+void appendNumber(std::string& out, T value)
+{
+  char digits[24];
+  auto result = std::to_chars(digits, digits + sizeof(digits), value);
+  out.append(digits, result.ptr - digits);
+}
+
+void appendHex(std::string& out, const Data* data)
+{
+  if (nullptr == data) {
+    return;
+  }
+  for (std::size_t i = 0;i < data->size();++i) {
+    auto b = (std::uint8_t)data->at(i);
+    out.push_back(HexChars[b >> 4]);
+    out.push_back(HexChars[b & 0x0f]);
+  }
+}
+
+void appendCsvText(std::string& out, std::string_view text)
+{
+  if (std::string_view::npos == text.find_first_of(",\"'\n")) {
+    out.append(text);
+    return;
+  }
+  out.push_back('"');
+  for (char c : text) {
+    if ('"' == c) {
+      out.push_back('"');
+    }
+    out.push_back(c);
+  }
+  out.push_back('"');
+}
+
+void appendVarint(std::string& out, std::uint64_t value)
+{
+  while (value >= 0x80) {
+    out.push_back((char)((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back((char)value);
+}
+
+void appendBytes(std::string& out, const Data* data)
+{
+  if (nullptr == data) {
+    appendVarint(out, 0);
+    return;
+  }
+  appendVarint(out, data->size());
+  for (std::size_t i = 0;i < data->size();++i) {
+    out.push_back((char)data->at(i));
+  }
+}
+
+}
+
+ContactLogWriter::ContactLogWriter(std::string path, ContactLogWriterOptions options)
+  : filePath(std::move(path)),
+    options(options),
+    lock(),
+    wake(),
+    written(),
+    active(),
+    appended(0),
+    droppedCount(0),
+    requested(0),
+    completed(0),
+    rotationCount(0),
+    opened(false),
+    stopping(false),
+    pending(),
+    file(nullptr),
+    fileBytes(0),
+    fileOpened(),
+    lastSync(std::chrono::steady_clock::now()),
+    unsynced(false),
+    writer()
+{
+  active.reserve(options.bufferBytes + 1024);
+  pending.reserve(options.bufferBytes + 1024);
+  open();
+  opened = nullptr != file;
+  writer = std::thread([this] { run(); });
+}
+
+ContactLogWriter::~ContactLogWriter()
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_one();
+  writer.join();
+  if (nullptr != file) {
+    std::fclose(file);
+  }
+}
+
+void
+ContactLogWriter::append(const ContactLogEvent& event)
+{
+  bool wakeWriter = false;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!opened) {
+      return;
+    }
+    if (active.size() >= options.maxBufferBytes) {
+      ++droppedCount;
+      return;
+    }
+    const std::size_t before = active.size();
+    if (ContactLogFormat::csv == options.format) {
+      encodeCsv(event);
+    } else {
+      encodeBinary(event);
+    }
+    ++appended;
+    // Only wake the writer as the buffer fills, not for every later event
+    wakeWriter = before < options.bufferBytes && active.size() >= options.bufferBytes;
+  }
+  if (wakeWriter) {
+    wake.notify_one();
+  }
+}
+
+void
+ContactLogWriter::flush()
+{
+  std::unique_lock<std::mutex> guard(lock);
+  const std::uint64_t request = ++requested;
+  wake.notify_one();
+  written.wait(guard, [this, request] { return completed >= request; });
+}
+
+const std::string&
+ContactLogWriter::path() const noexcept
+{
+  return filePath;
+}
+
+bool
+ContactLogWriter::isOpen()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return opened;
+}
+
+std::uint64_t
+ContactLogWriter::events()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return appended;
+}
+
+std::uint64_t
+ContactLogWriter::dropped()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return droppedCount;
+}
+
+std::uint64_t
+ContactLogWriter::rotations()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return rotationCount;
+}
+
+void
+ContactLogWriter::encodeCsv(const ContactLogEvent& event)
+{
+  appendNumber(active, event.time);
+  active.push_back(',');
+  active.append(sensorName(event.sensor));
+  active.push_back(',');
+  appendHex(active, event.target);
+  // One column per event type, holding the type number
+  for (int column = 1;column <= (int)ContactLogEventType::state;++column) {
+    active.push_back(',');
+    if (column == (int)event.type) {
+      appendNumber(active, column);
+    }
+  }
+  active.push_back(',');
+  switch (event.type) {
+    case ContactLogEventType::measure:
+      // As Proximity::description()
+      appendNumber(active, (short)event.proximity.unit);
+      active.push_back(':');
+      appendNumber(active, (int)event.proximity.value);
+      break;
+    case ContactLogEventType::receive:
+      appendHex(active, event.payload);
+      break;
+    default:
+      appendCsvText(active, event.text);
+      break;
+  }
+  active.push_back('\n');
+}
+
+void
+ContactLogWriter::encodeBinary(const ContactLogEvent& event)
+{
+  active.push_back((char)event.type);
+  appendVarint(active, event.time);
+  active.push_back((char)event.sensor);
+  appendBytes(active, event.target);
+  switch (event.type) {
+    case ContactLogEventType::read:
+    case ContactLogEventType::share:
+    case ContactLogEventType::receive:
+      appendBytes(active, event.payload);
+      break;
+    case ContactLogEventType::measure: {
+      active.push_back((char)event.proximity.unit);
+      const std::int64_t value = (std::int64_t)event.proximity.value;
+      appendVarint(active, ((std::uint64_t)value << 1) ^ (std::uint64_t)(value >> 63));
+      break;
+    }
+    case ContactLogEventType::visit:
+    case ContactLogEventType::state:
+      appendVarint(active, event.text.size());
+      active.append(event.text);
+      break;
+    default:
+      break;
+  }
+}
+
+void
+ContactLogWriter::run()
+{
+  std::unique_lock<std::mutex> guard(lock);
+  while (true) {
+    wake.wait_for(guard, options.syncInterval, [this] {
+      return stopping || requested != completed || active.size() >= options.bufferBytes;
+    });
+    const bool stop = stopping;
+    const std::uint64_t request = requested;
+    pending.swap(active);
+    guard.unlock();
+
+    if (!pending.empty()) {
+      write(pending);
+      pending.clear();
+    }
+    const bool forced = stop || request != completed; // completed is only changed by this thread
+    if (unsynced && (forced || std::chrono::steady_clock::now() - lastSync >= options.syncInterval)) {
+      sync();
+    }
+
+    guard.lock();
+    if (request != completed) {
+      completed = request;
+      written.notify_all();
+    }
+    if (stop && active.empty()) {
+      return;
+    }
+  }
+}
+
+void
+ContactLogWriter::write(const std::string& data)
+{
+  if (nullptr == file) {
+    return;
+  }
+  const std::size_t headerBytes = ContactLogFormat::csv == options.format ? sizeof(CsvHeader) - 1 : sizeof(BinaryHeader);
+  const bool tooBig = fileBytes + data.size() > options.maxFileBytes;
+  const bool tooOld = std::chrono::steady_clock::now() - fileOpened >= options.maxFileAge;
+  if (fileBytes > headerBytes && (tooBig || tooOld)) {
+    rotate();
+    if (nullptr == file) {
+      return;
+    }
+  }
+  fileBytes += std::fwrite(data.data(), 1, data.size(), file);
+  unsynced = true;
+}
+
+void
+ContactLogWriter::open()
+{
+  file = std::fopen(filePath.c_str(), "ab");
+  if (nullptr == file) {
+    return;
+  }
+  // Appends to an existing log, as after a restart
+  std::fseek(file, 0, SEEK_END);
+  long existing = std::ftell(file);
+  fileBytes = existing > 0 ? (std::size_t)existing : 0;
+  fileOpened = std::chrono::steady_clock::now();
+  if (0 == fileBytes) {
+    if (ContactLogFormat::csv == options.format) {
+      fileBytes += std::fwrite(CsvHeader, 1, sizeof(CsvHeader) - 1, file);
+    } else {
+      fileBytes += std::fwrite(BinaryHeader, 1, sizeof(BinaryHeader), file);
+    }
+  }
+}
+
+void
+ContactLogWriter::rotate()
+{
+  sync();
+  std::fclose(file);
+  file = nullptr;
+  // path.maxFiles is dropped, path.N becomes path.N+1, and path becomes path.1
+  if (0 == options.maxFiles) {
+    std::remove(filePath.c_str());
+  } else {
+    std::remove((filePath + "." + std::to_string(options.maxFiles)).c_str());
+    for (std::size_t n = options.maxFiles - 1;n >= 1;--n) {
+      std::rename((filePath + "." + std::to_string(n)).c_str(), (filePath + "." + std::to_string(n + 1)).c_str());
+    }
+    std::rename(filePath.c_str(), (filePath + ".1").c_str());
+  }
+  open();
+  std::lock_guard<std::mutex> guard(lock);
+  ++rotationCount;
+  opened = nullptr != file;
+}
+
+void
+ContactLogWriter::sync()
+{
+  if (nullptr == file) {
+    return;
+  }
+  std::fflush(file);
+#ifdef _WIN32
+  _commit(_fileno(file));
+#else
+  fsync(fileno(file));
+#endif
+  lastSync = std::chrono::steady_clock::now();
+  unsynced = false;
+}
+
+}
+
+#endif
@@ -0,0 +1,536 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#if !defined(__ZEPHYR__) && !defined(_WIN32)
+
+#include "herald/data/encounter_store.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace herald::data {
+
+namespace {
+
+constexpr char SegmentMagic[4] = {'H','E','N','C'};
+constexpr std::uint32_t SegmentVersion = 1;
+constexpr char SegmentPrefix[] = "encounters-";
+constexpr char SegmentExtension[] = ".hes";
+
+/// \brief Start of each segment file. The columns follow, then the payload heap.
+struct SegmentHeader {
+  char magic[4];
+  std::uint32_t version;
+  std::uint64_t partitionStart;
+  std::uint32_t capacity;
+  /// \brief Rows written. Set after the rest of the row, so a partly written row is ignored.
+  std::uint32_t count;
+  std::uint32_t bucketCount;
+  std::uint32_t reserved;
+  std::uint64_t heapCapacity;
+  std::uint64_t heapUsed;
+  std::uint64_t minTime;
+  std::uint64_t maxTime;
+};
+static_assert(sizeof(SegmentHeader) == 64, "SegmentHeader must be packed");
+
+/// \brief 64 bit FNV-1a hash, as stored in the payload hash column (stable between runs)
+std::uint64_t payloadHash(const std::uint8_t* bytes, std::size_t length) noexcept
+{
+  std::uint64_t hash = 14695981039346656037ull;
+  for (std::size_t i = 0;i < length;++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+std::uint32_t roundUpToPowerOfTwo(std::uint32_t value) noexcept
+{
+  std::uint32_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+/// \brief Payload bytes copied out of Data, for hashing and comparison
+std::vector<std::uint8_t> payloadBytes(const Data& payload)
+{
+  std::vector<std::uint8_t> bytes(payload.size());
+  for (std::size_t i = 0;i < bytes.size();++i) {
+    bytes[i] = (std::uint8_t)payload.at(i);
+  }
+  return bytes;
+}
+
+/// \brief One memory mapped segment file
+class Segment {
+public:
+  /// \brief Column locations within the file, for a capacity
+  struct Layout {
+    Layout(std::uint32_t capacity, std::uint32_t bucketCount, std::uint64_t heapCapacity)
+    {
+      // Widest columns first, so every column is aligned
+      std::size_t offset = sizeof(SegmentHeader);
+      hashes = offset; offset += sizeof(std::uint64_t) * capacity;
+      times = offset; offset += sizeof(std::uint32_t) * capacity;
+      values = offset; offset += sizeof(float) * capacity;
+      offsets = offset; offset += sizeof(std::uint32_t) * capacity;
+      nexts = offset; offset += sizeof(std::uint32_t) * capacity;
+      buckets = offset; offset += sizeof(std::uint32_t) * bucketCount;
+      lengths = offset; offset += sizeof(std::uint16_t) * capacity;
+      units = offset; offset += capacity;
+      heap = offset;
+      bytes = offset + heapCapacity;
+    }
+
+    std::size_t hashes, times, values, offsets, nexts, buckets, lengths, units, heap, bytes;
+  };
+
+  static std::unique_ptr<Segment> create(const std::string& path, std::uint64_t partitionStart,
+    std::uint32_t capacity, std::uint64_t heapCapacity)
+  {
+    const std::uint32_t bucketCount = roundUpToPowerOfTwo(capacity);
+    Layout layout(capacity, bucketCount, heapCapacity);
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+      return nullptr;
+    }
+    // The new file reads as zeros, so the index starts empty
+    if (0 != ::ftruncate(fd, (off_t)layout.bytes)) {
+      ::close(fd);
+      ::unlink(path.c_str());
+      return nullptr;
+    }
+    auto segment = map(fd, layout.bytes);
+    if (!segment) {
+      ::unlink(path.c_str());
+      return nullptr;
+    }
+    SegmentHeader& header = *segment->header;
+    std::memcpy(header.magic, SegmentMagic, sizeof(SegmentMagic));
+    header.version = SegmentVersion;
+    header.partitionStart = partitionStart;
+    header.capacity = capacity;
+    header.count = 0;
+    header.bucketCount = bucketCount;
+    header.heapCapacity = heapCapacity;
+    header.heapUsed = 0;
+    header.minTime = UINT64_MAX;
+    header.maxTime = 0;
+    segment->locate(layout);
+    return segment;
+  }
+
+  /// \brief Sets unwritten if the file is empty or its header was never written, as when
+  /// create() was interrupted, in which case it holds no encounters
+  static std::unique_ptr<Segment> open(const std::string& path, bool& unwritten)
+  {
+    unwritten = false;
+    int fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+      return nullptr;
+    }
+    struct stat info;
+    if (0 != ::fstat(fd, &info)) {
+      ::close(fd);
+      return nullptr;
+    }
+    if ((std::size_t)info.st_size < sizeof(SegmentHeader)) {
+      unwritten = 0 == info.st_size;
+      ::close(fd);
+      return nullptr;
+    }
+    auto segment = map(fd, (std::size_t)info.st_size);
+    if (!segment) {
+      return nullptr;
+    }
+    const SegmentHeader& header = *segment->header;
+    constexpr char unwrittenMagic[sizeof(SegmentMagic)] = {};
+    if (0 == std::memcmp(header.magic, unwrittenMagic, sizeof(unwrittenMagic))) {
+      unwritten = true;
+      return nullptr;
+    }
+    if (0 != std::memcmp(header.magic, SegmentMagic, sizeof(SegmentMagic)) || SegmentVersion != header.version ||
+        header.count > header.capacity || header.heapUsed > header.heapCapacity) {
+      return nullptr;
+    }
+    Layout layout(header.capacity, header.bucketCount, header.heapCapacity);
+    if (layout.bytes != segment->bytes) {
+      return nullptr;
+    }
+    segment->locate(layout);
+    return segment;
+  }
+
+  ~Segment()
+  {
+    ::munmap(base, bytes);
+    ::close(fd);
+  }
+
+  bool hasRoomFor(std::size_t payloadLength) const noexcept
+  {
+    return header->count < header->capacity && header->heapUsed + payloadLength <= header->heapCapacity;
+  }
+
+  void append(std::uint64_t time, const Proximity& proximity, const std::vector<std::uint8_t>& payload, std::uint64_t hash)
+  {
+    const std::uint32_t row = header->count;
+    hashes[row] = hash;
+    times[row] = (std::uint32_t)(time - header->partitionStart);
+    values[row] = (float)proximity.value;
+    units[row] = (std::uint8_t)proximity.unit;
+    offsets[row] = (std::uint32_t)header->heapUsed;
+    lengths[row] = (std::uint16_t)payload.size();
+    std::memcpy(heap + header->heapUsed, payload.data(), payload.size());
+    std::uint32_t& bucket = buckets[hash & (header->bucketCount - 1)];
+    nexts[row] = bucket;
+    bucket = row + 1; // 0 ends a chain
+    header->heapUsed += payload.size();
+    header->minTime = std::min(header->minTime, time);
+    header->maxTime = std::max(header->maxTime, time);
+    // The row must reach the mapping before the count that makes it visible
+    std::atomic_signal_fence(std::memory_order_release);
+    header->count = row + 1;
+  }
+
+  /// \brief True if any row could be at a time in [from,to)
+  bool overlaps(std::uint64_t from, std::uint64_t to) const noexcept
+  {
+    return 0 != header->count && header->minTime < to && header->maxTime >= from;
+  }
+
+  std::uint64_t time(std::uint32_t row) const noexcept
+  {
+    return header->partitionStart + times[row];
+  }
+
+  EncounterView view(std::uint32_t row) const noexcept
+  {
+    return EncounterView{time(row), Proximity{(ProximityMeasurementUnit)units[row], values[row]},
+      heap + offsets[row], lengths[row], hashes[row]};
+  }
+
+  bool samePayload(std::uint32_t row, const std::uint8_t* payload, std::size_t length) const noexcept
+  {
+    return lengths[row] == length && 0 == std::memcmp(heap + offsets[row], payload, length);
+  }
+
+  void sync() noexcept
+  {
+    ::msync(base, bytes, MS_SYNC);
+  }
+
+  SegmentHeader* header;
+  std::uint64_t* hashes;
+  std::uint32_t* times;
+  float* values;
+  std::uint32_t* offsets;
+  std::uint32_t* nexts;
+  std::uint32_t* buckets;
+  std::uint16_t* lengths;
+  std::uint8_t* units;
+  std::uint8_t* heap;
+
+private:
+  Segment(int fd, void* base, std::size_t bytes)
+    : header((SegmentHeader*)base), hashes(nullptr), times(nullptr), values(nullptr), offsets(nullptr),
+      nexts(nullptr), buckets(nullptr), lengths(nullptr), units(nullptr), heap(nullptr),
+      fd(fd), base(base), bytes(bytes)
+  {
+    ;
+  }
+
+  static std::unique_ptr<Segment> map(int fd, std::size_t bytes)
+  {
+    void* base = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == base) {
+      ::close(fd);
+      return nullptr;
+    }
+    return std::unique_ptr<Segment>(new Segment(fd, base, bytes));
+  }
+
+  void locate(const Layout& layout) noexcept
+  {
+    std::uint8_t* start = (std::uint8_t*)base;
+    hashes = (std::uint64_t*)(start + layout.hashes);
+    times = (std::uint32_t*)(start + layout.times);
+    values = (float*)(start + layout.values);
+    offsets = (std::uint32_t*)(start + layout.offsets);
+    nexts = (std::uint32_t*)(start + layout.nexts);
+    buckets = (std::uint32_t*)(start + layout.buckets);
+    lengths = (std::uint16_t*)(start + layout.lengths);
+    units = start + layout.units;
+    heap = start + layout.heap;
+  }
+
+  int fd;
+  void* base;
+  std::size_t bytes;
+};
+
+}
+
+class EncounterStore::Impl {
+public:
+  Impl(std::string directory, EncounterStoreOptions options);
+  ~Impl() = default;
+
+  std::string directory;
+  EncounterStoreOptions options;
+  /// \brief Segments by partition start time, oldest first within each partition
+  std::map<std::uint64_t, std::vector<std::unique_ptr<Segment>>> partitions;
+  /// \brief Next segment file sequence number by partition start time, after any skipped files
+  std::map<std::uint64_t, std::uint64_t> sequences;
+  std::uint64_t count;
+  bool open;
+
+  template <typename FunctionT>
+  void forEachSegment(std::uint64_t from, std::uint64_t to, FunctionT function) const
+  {
+    // Partitions starting at or after 'to' cannot hold matches
+    for (auto it = partitions.begin();it != partitions.end() && it->first < to;++it) {
+      for (auto& segment : it->second) {
+        if (segment->overlaps(from, to)) {
+          function(*segment);
+        }
+      }
+    }
+  }
+};
+
+EncounterStore::Impl::Impl(std::string directoryPath, EncounterStoreOptions storeOptions)
+  : directory(std::move(directoryPath)),
+    options(storeOptions),
+    partitions(),
+    sequences(),
+    count(0),
+    open(false)
+{
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  if (!std::filesystem::is_directory(directory, error)) {
+    return;
+  }
+  // File names order the segments within a partition: encounters-<partition start>-<sequence>.hes
+  std::map<std::pair<std::uint64_t,std::uint64_t>, std::string> found;
+  for (auto& entry : std::filesystem::directory_iterator(directory, error)) {
+    const std::string name = entry.path().filename().string();
+    if (0 != name.rfind(SegmentPrefix, 0) || entry.path().extension() != SegmentExtension) {
+      continue;
+    }
+    std::uint64_t start = 0;
+    std::uint64_t sequence = 0;
+    if (2 != std::sscanf(name.c_str() + sizeof(SegmentPrefix) - 1, "%" SCNu64 "-%" SCNu64, &start, &sequence)) {
+      continue;
+    }
+    found.emplace(std::make_pair(start, sequence), entry.path().string());
+  }
+  for (auto& file : found) {
+    bool unwritten = false;
+    auto segment = Segment::open(file.second, unwritten);
+    if (!segment) {
+      // Creation interrupted by a crash, so nothing to lose. Other invalid files are skipped
+      // but kept, and their names not reused.
+      if (unwritten && std::filesystem::remove(file.second, error)) {
+        continue;
+      }
+      sequences[file.first.first] = file.first.second + 1;
+      continue;
+    }
+    sequences[file.first.first] = file.first.second + 1;
+    count += segment->header->count;
+    partitions[file.first.first].push_back(std::move(segment));
+  }
+  open = true;
+}
+
+PayloadData
+EncounterView::payloadData() const
+{
+  return PayloadData((const std::byte*)payload, payloadLength);
+}
+
+Encounter
+EncounterView::encounter() const
+{
+  return Encounter(proximity, payloadData(), Date(time));
+}
+
+EncounterStore::EncounterStore(std::string directory, EncounterStoreOptions options)
+  : mImpl(std::make_unique<Impl>(std::move(directory), options))
+{
+  ;
+}
+
+EncounterStore::~EncounterStore() = default;
+
+bool
+EncounterStore::isOpen() const noexcept
+{
+  return mImpl->open;
+}
+
+bool
+EncounterStore::append(const Encounter& encounter)
+{
+  if (!mImpl->open || !encounter.isValid() || encounter.payload().size() > UINT16_MAX) {
+    return false;
+  }
+  const std::uint64_t time = encounter.timestamp().secondsSinceUnixEpoch();
+  const std::uint64_t duration = std::max<std::uint64_t>(1, mImpl->options.partitionDuration.count());
+  const std::uint64_t partitionStart = time - time % duration;
+  const std::vector<std::uint8_t> payload = payloadBytes(encounter.payload());
+
+  auto& segments = mImpl->partitions[partitionStart];
+  if (segments.empty() || !segments.back()->hasRoomFor(payload.size())) {
+    const std::uint32_t capacity = std::max<std::uint32_t>(1, mImpl->options.segmentCapacity);
+    const std::uint64_t heapCapacity = std::min<std::uint64_t>(UINT32_MAX,
+      std::max<std::uint64_t>((std::uint64_t)capacity * mImpl->options.payloadBytesPerEncounter, payload.size()));
+    const std::string path = mImpl->directory + "/" + SegmentPrefix + std::to_string(partitionStart) + "-" +
+      std::to_string(mImpl->sequences[partitionStart]++) + SegmentExtension;
+    auto segment = Segment::create(path, partitionStart, capacity, heapCapacity);
+    if (!segment) {
+      return false;
+    }
+    segments.push_back(std::move(segment));
+  }
+  segments.back()->append(time, encounter.proximity(), payload, payloadHash(payload.data(), payload.size()));
+  ++mImpl->count;
+  return true;
+}
+
+void
+EncounterStore::flush()
+{
+  for (auto& partition : mImpl->partitions) {
+    for (auto& segment : partition.second) {
+      segment->sync();
+    }
+  }
+}
+
+std::uint64_t
+EncounterStore::size() const noexcept
+{
+  return mImpl->count;
+}
+
+std::size_t
+EncounterStore::segments() const noexcept
+{
+  std::size_t total = 0;
+  for (auto& partition : mImpl->partitions) {
+    total += partition.second.size();
+  }
+  return total;
+}
+
+std::size_t
+EncounterStore::encounters(const PayloadData& payload, const Date& from, const Date& to,
+  std::vector<EncounterView>& results) const
+{
+  const std::size_t before = results.size();
+  const std::vector<std::uint8_t> bytes = payloadBytes(payload);
+  const std::uint64_t hash = payloadHash(bytes.data(), bytes.size());
+  const std::uint64_t start = from.secondsSinceUnixEpoch();
+  const std::uint64_t end = to.secondsSinceUnixEpoch();
+  mImpl->forEachSegment(start, end, [&](const Segment& segment) {
+    const std::size_t segmentStart = results.size();
+    const std::uint32_t count = segment.header->count;
+    // Walk the bucket's chain, newest first. Links beyond count are from an unfinished append.
+    for (std::uint32_t link = segment.buckets[hash & (segment.header->bucketCount - 1)];0 != link;) {
+      const std::uint32_t row = link - 1;
+      link = segment.nexts[row];
+      if (row >= count || hash != segment.hashes[row]) {
+        continue;
+      }
+      const std::uint64_t time = segment.time(row);
+      if (time >= start && time < end && segment.samePayload(row, bytes.data(), bytes.size())) {
+        results.push_back(segment.view(row));
+      }
+    }
+    std::reverse(results.begin() + segmentStart, results.end());
+  });
+  std::stable_sort(results.begin() + before, results.end(),
+    [](const EncounterView& a, const EncounterView& b) { return a.time < b.time; });
+  return results.size() - before;
+}
+
+std::vector<EncounterExposure>
+EncounterStore::exposure(const Date& from, const Date& to) const
+{
+  std::vector<EncounterExposure> results;
+  std::vector<double> totals;
+  std::unordered_map<std::uint64_t, std::size_t> byKey; // payload hash plus unit
+  const std::uint64_t start = from.secondsSinceUnixEpoch();
+  const std::uint64_t end = to.secondsSinceUnixEpoch();
+  mImpl->forEachSegment(start, end, [&](const Segment& segment) {
+    const bool allInWindow = segment.header->minTime >= start && segment.header->maxTime < end;
+    const std::uint32_t count = segment.header->count;
+    for (std::uint32_t row = 0;row < count;++row) {
+      const std::uint64_t time = segment.time(row);
+      if (!allInWindow && (time < start || time >= end)) {
+        continue;
+      }
+      const std::uint64_t hash = segment.hashes[row];
+      const std::uint8_t* payload = segment.heap + segment.offsets[row];
+      const std::size_t length = segment.lengths[row];
+      const ProximityMeasurementUnit unit = (ProximityMeasurementUnit)segment.units[row];
+      auto same = [&](const EncounterExposure& e) {
+        return e.unit == unit && segment.samePayload(row, e.payload, e.payloadLength);
+      };
+      const std::uint64_t key = hash + segment.units[row];
+      auto found = byKey.find(key);
+      std::size_t index = byKey.end() == found ? results.size() : found->second;
+      if (index < results.size() && !same(results[index])) {
+        // Key collision between different payloads or units, so search for this one
+        index = results.size();
+        for (std::size_t i = 0;i < results.size();++i) {
+          if (results[i].payloadHash == hash && same(results[i])) {
+            index = i;
+            break;
+          }
+        }
+      }
+      const double value = segment.values[row];
+      if (index == results.size()) {
+        byKey.emplace(key, index);
+        results.push_back(EncounterExposure{payload, length, hash, unit, 0, time, time, 0, value});
+        totals.push_back(0);
+      }
+      EncounterExposure& exposure = results[index];
+      ++exposure.count;
+      exposure.firstSeen = std::min(exposure.firstSeen, time);
+      exposure.lastSeen = std::max(exposure.lastSeen, time);
+      exposure.maxProximity = std::max(exposure.maxProximity, value);
+      totals[index] += value;
+    }
+  });
+  for (std::size_t i = 0;i < results.size();++i) {
+    results[i].meanProximity = totals[i] / results[i].count;
+  }
+  std::stable_sort(results.begin(), results.end(),
+    [](const EncounterExposure& a, const EncounterExposure& b) { return a.count > b.count; });
+  return results;
+}
+
+}
+
+#endif
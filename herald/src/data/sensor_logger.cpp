@@ -4,10 +4,127 @@
 
 #include "herald/data/sensor_logger.h"
 
+#include <map>
 #include <string>
+#include <tuple>
+#include <utility>
+
+#ifndef __ZEPHYR__
+#include <mutex>
+#endif
+
+#ifndef HERALD_RUNTIME_LOG_LEVEL
+#ifdef HERALD_LOG_LEVEL
+#define HERALD_RUNTIME_LOG_LEVEL HERALD_LOG_LEVEL
+#else
+#define HERALD_RUNTIME_LOG_LEVEL 4
+#endif
+#endif
 
 namespace herald {
 namespace data {
 
+namespace {
+
+// Threshold above every level, so nothing is logged
+constexpr int Disabled = (int)SensorLoggerLevel::fault + 1;
+
+// Converts a HERALD_LOG_LEVEL style value to the lowest level logged
+constexpr int thresholdFor(int logLevel) noexcept
+{
+  return logLevel >= 4 ? (int)SensorLoggerLevel::debug
+       : logLevel >= 2 ? (int)SensorLoggerLevel::info
+       : logLevel == 1 ? (int)SensorLoggerLevel::fault
+       : Disabled;
+}
+
+struct LogLevelSettings {
+  using Key = std::pair<std::string,std::string>;
+
+  // Map nodes do not move, so loggers can hold pointers to the thresholds
+  std::map<Key,std::atomic<int>> thresholds;
+  std::map<Key,int> settings;
+#ifndef __ZEPHYR__
+  std::mutex lock;
+#endif
+
+  int resolve(const std::string& subsystem, const std::string& category) const
+  {
+    for (auto& key : {std::make_pair(subsystem, category), std::make_pair(subsystem, std::string()),
+                      std::make_pair(std::string(), category), std::make_pair(std::string(), std::string())}) {
+      auto found = settings.find(key);
+      if (settings.end() != found) {
+        return found->second;
+      }
+    }
+    return thresholdFor(HERALD_RUNTIME_LOG_LEVEL);
+  }
+
+  void set(const std::string& subsystem, const std::string& category, int threshold)
+  {
+#ifndef __ZEPHYR__
+    std::lock_guard<std::mutex> guard(lock);
+#endif
+    settings[Key(subsystem, category)] = threshold;
+    update();
+  }
+
+  void update()
+  {
+    for (auto& threshold : thresholds) {
+      threshold.second.store(resolve(threshold.first.first, threshold.first.second), std::memory_order_relaxed);
+    }
+  }
+};
+
+// Constructed on first use, as loggers may be static objects themselves
+LogLevelSettings& logLevelSettings()
+{
+  static LogLevelSettings instance;
+  return instance;
+}
+
+}
+
+void
+LogLevelFilter::setLevel(const std::string& subsystem, const std::string& category, SensorLoggerLevel minimum)
+{
+  logLevelSettings().set(subsystem, category, (int)minimum);
+}
+
+void
+LogLevelFilter::disable(const std::string& subsystem, const std::string& category)
+{
+  logLevelSettings().set(subsystem, category, Disabled);
+}
+
+void
+LogLevelFilter::reset()
+{
+  auto& instance = logLevelSettings();
+#ifndef __ZEPHYR__
+  std::lock_guard<std::mutex> guard(instance.lock);
+#endif
+  instance.settings.clear();
+  instance.update();
+}
+
+const std::atomic<int>&
+LogLevelFilter::threshold(const std::string& subsystem, const std::string& category)
+{
+  auto& instance = logLevelSettings();
+#ifndef __ZEPHYR__
+  std::lock_guard<std::mutex> guard(instance.lock);
+#endif
+  auto key = std::make_pair(subsystem, category);
+  auto found = instance.thresholds.find(key);
+  if (instance.thresholds.end() != found) {
+    return found->second;
+  }
+  int value = instance.resolve(subsystem, category);
+  return instance.thresholds.emplace(std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+    std::forward_as_tuple(value)).first->second;
+}
+
+}
 }
-}
\ No newline at end of file
@@ -116,5 +116,10 @@ TargetIdentifier::underlyingData() const {
   return Data(value);
 }
 
+const Data&
+TargetIdentifier::data() const noexcept {
+  return value;
+}
+
 } // end namespace
 } // end namespace
@@ -5,9 +5,39 @@
 /*
  * The main executable of the herald-network-simulation process
  */
+#include <fstream>
 #include <iostream>
+#include <string>
 #include "../heraldns/heraldns.h"
 
+/*
+ * heraldns-cli --ensemble <settings file>
+ * runs replicates of a sweep of scenarios. See EnsembleSettings for the file format.
+ */
+int runEnsemble(const std::string& settingsFile) {
+  using namespace heraldns::simulator;
+
+  std::ifstream in(settingsFile);
+  if (!in) {
+    std::cerr << "Cannot read " << settingsFile << std::endl;
+    return 1;
+  }
+  EnsembleSettings settings;
+  std::string error;
+  if (!EnsembleSettings::read(in, settings, error)) {
+    std::cerr << settingsFile << ": " << error << std::endl;
+    return 1;
+  }
+  std::cout << "Running " << settings.replicates << " replicates of " << settings.scenarios.size()
+            << " scenarios, writing results to " << settings.output << std::endl;
+  Ensemble ensemble(settings);
+  if (!ensemble.run()) {
+    std::cerr << "Ensemble failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
 int main(int argc, char* argv[]) {
   using namespace heraldns;
   using namespace heraldns::simulator;
@@ -16,6 +46,16 @@ int main(int argc, char* argv[]) {
   using namespace heraldns::mixing;
   using namespace heraldns::transmission;
 
+  if (argc == 3 && std::string("--ensemble") == argv[1]) {
+    return runEnsemble(argv[2]);
+  }
+  // heraldns-cli --results <folder> streams per tick results and daily presence snapshots to folder
+  std::string resultsFolder = "./";
+  bool streaming = (argc == 3 && std::string("--results") == argv[1]);
+  if (streaming) {
+    resultsFolder = argv[2];
+  }
+
   PresenceManager pm(100);
 
   std::shared_ptr<Grid> grid = std::make_shared<Grid>(5, 5, 0.5);
@@ -37,10 +77,23 @@ int main(int argc, char* argv[]) {
   std::shared_ptr<StdOutIntermediateResults> ir = std::make_shared<StdOutIntermediateResults>();
   
   Simulation sim(grid, pm, scoring, transmission);
+  sim.threads(0); // one per hardware thread
 
-  sim.runToCompletion(50, 60 * 5, ir, 14400/50); // 200 days, 1 day = 5 minutes per tick = 57600 ticks
+  if (streaming) {
+    std::shared_ptr<StreamingResults> results = std::make_shared<StreamingResults>(resultsFolder, 24 * 60 / 5);
+    sim.runToCompletion(50, 60 * 5, results, 1);
+    if (!results->close()) {
+      std::cerr << "Cannot write results to " << resultsFolder << std::endl;
+      return 1;
+    }
+  } else {
+    sim.runToCompletion(50, 60 * 5, ir, 14400/50); // 200 days, 1 day = 5 minutes per tick = 57600 ticks
+  }
 
-  sim.writeStandardResults("./");
+  if (!sim.writeStandardResults(resultsFolder)) {
+    std::cerr << "Cannot write results to " << resultsFolder << std::endl;
+    return 1;
+  }
 
   return 0;
 }
@@ -17,10 +17,32 @@ under the License.
 */
 #include "catch.hpp"
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "heraldns/heraldns.h"
 
+using namespace heraldns::datatype;
+using namespace heraldns::mixing;
+using namespace heraldns::providers;
+using namespace heraldns::simulator;
+using namespace heraldns::transmission;
+
+/// \brief Hides a model's active presences, so a Simulation determines every presence's state
+struct EveryPresence : public TransmissionModelProvider {
+  EveryPresence(std::shared_ptr<TransmissionModelProvider> model) : model(model) {}
+
+  void initialiseInfectionState(uint64_t presence) override {
+    model->initialiseInfectionState(presence);
+  }
+  void determineInfectionState(uint64_t presence, double minutesPassed, uint64_t tick) override {
+    model->determineInfectionState(presence, minutesPassed, tick);
+  }
+
+  std::shared_ptr<TransmissionModelProvider> model;
+};
+
 TEST_CASE("basictrans","[basictrans][basic][transmission]") {
 
   SECTION("basictrans-basic") {
@@ -35,4 +57,81 @@ TEST_CASE("basictrans","[basictrans][basic][transmission]") {
 
   }
 
-}
\ No newline at end of file
+}
+
+TEST_CASE("basictrans-transitions","[basictrans][transmission]") {
+  PresenceManager pm(3);
+  std::shared_ptr<Grid> grid = std::make_shared<Grid>(100, 100, 0.5);
+  grid->moveTo(pm, 0, 0, 0);
+  grid->moveTo(pm, 1, 1, 0); // 0.5 m from 0
+  grid->moveTo(pm, 2, 99, 99); // far from both
+  grid->reindex(pm);
+  BasicTransmissionModelProvider model(pm, grid, 3, 6, 1); // recover after 3 ticks, immune for 6
+  for (uint64_t id = 0;id < 3;id++) {
+    model.initialiseInfectionState(id);
+  }
+  pm.commitChanges();
+  REQUIRE(pm.state(0) == State::Ill);
+
+  std::vector<std::vector<uint64_t>> actives;
+  for (uint64_t tick = 0;tick < 12;tick++) {
+    std::vector<uint64_t> active;
+    REQUIRE(model.activePresences(tick, active));
+    for (uint64_t id : active) {
+      model.determineInfectionState(id, 20.0, tick);
+    }
+    pm.commitChanges();
+    actives.push_back(active);
+    if (0 == tick) {
+      REQUIRE(pm.state(1) == State::Ill); // 20 minutes at 0.5 m
+    }
+    if (tick < 4) {
+      REQUIRE(pm.state(0) == State::Ill);
+    } else if (tick < 7) {
+      REQUIRE(pm.state(0) == State::Recovered);
+      REQUIRE(pm.state(1) == State::Recovered);
+    } else {
+      REQUIRE(pm.state(0) == State::Well);
+      REQUIRE(pm.state(1) == State::Well);
+    }
+    REQUIRE(pm.state(2) == State::Well);
+  }
+  // only the exposed, then the due
+  REQUIRE(actives[0] == std::vector<uint64_t>{1});
+  REQUIRE(actives[1].empty());
+  REQUIRE(actives[4] == std::vector<uint64_t>{0, 1});
+  REQUIRE(actives[5].empty());
+  REQUIRE(actives[7] == std::vector<uint64_t>{0, 1});
+  REQUIRE(actives[8].empty());
+}
+
+TEST_CASE("basictrans-active","[basictrans][transmission]") {
+  // The same results as determining every presence, through recovery and lost immunity
+  std::vector<std::unique_ptr<PresenceManager>> pms;
+  std::vector<std::vector<uint64_t>> cases;
+  for (int every = 0;every < 2;every++) {
+    pms.push_back(std::make_unique<PresenceManager>(400));
+    PresenceManager& pm = *pms.back();
+    std::shared_ptr<Grid> grid = std::make_shared<Grid>(30, 30, 0.5);
+    auto scoring = std::make_shared<DirectMixingScoreProvider>(pm, grid, 100, 1.0 / 14.0);
+    std::shared_ptr<TransmissionModelProvider> model =
+      std::make_shared<BasicTransmissionModelProvider>(pm, grid, 10, 20, 5);
+    if (every) {
+      model = std::make_shared<EveryPresence>(model);
+    }
+    Simulation sim(grid, pm, scoring, model);
+    sim.seed(9);
+    sim.verbose(false);
+    sim.runToCompletion(1, 24 * 60); // 60 ticks
+    cases.push_back(sim.dailyCases());
+  }
+  REQUIRE(cases[0] == cases[1]);
+  uint64_t everIll = 0;
+  for (uint64_t id = 0;id < 400;id++) {
+    REQUIRE(pms[0]->state(id) == pms[1]->state(id));
+    REQUIRE(pms[0]->lastFellIll(id) == pms[1]->lastFellIll(id));
+    REQUIRE(pms[0]->lastRecovered(id) == pms[1]->lastRecovered(id));
+    everIll += pms[0]->hasEverBeenIll(id);
+  }
+  REQUIRE(everIll > 5); // it spread
+}
@@ -17,8 +17,15 @@ under the License.
 */
 #include "tests.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <filesystem>
+#include <iostream>
+#include <random>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "heraldns/heraldns.h"
 
@@ -73,4 +80,205 @@ TEST_CASE("grid","[grid][basic][datatypes]") {
 
   }
 
-}
\ No newline at end of file
+}
+
+TEST_CASE("grid-index","[grid][index][datatypes]") {
+  heraldns::datatype::PresenceManager pm(6);
+  heraldns::datatype::Grid grid(4, 3, 1.0);
+  grid.moveTo(pm, 0, 3, 2);
+  grid.moveTo(pm, 1, 0, 0);
+  grid.moveTo(pm, 2, 3, 2);
+  grid.moveTo(pm, 3, 1, 0);
+  grid.moveTo(pm, 4, 0, 0);
+  // 5 not placed
+  grid.reindex(pm);
+
+  const heraldns::datatype::CellIndex& index = grid.index();
+  REQUIRE(std::vector<uint32_t>(index.begin(grid.key(0, 0)), index.end(grid.key(0, 0))) == std::vector<uint32_t>{1, 4});
+  REQUIRE(std::vector<uint32_t>(index.begin(grid.key(1, 0)), index.end(grid.key(1, 0))) == std::vector<uint32_t>{3});
+  REQUIRE(index.begin(grid.key(2, 0)) == index.end(grid.key(2, 0)));
+  REQUIRE(std::vector<uint32_t>(index.begin(grid.key(3, 2)), index.end(grid.key(3, 2))) == std::vector<uint32_t>{0, 2});
+  // a row is contiguous
+  REQUIRE(index.end(grid.key(3, 0)) - index.begin(grid.key(0, 0)) == 3);
+}
+
+TEST_CASE("grid-tiles","[grid][tiles][datatypes]") {
+  using namespace heraldns::datatype;
+  // 10 km square at 0.5 m, which would be 400 million cells
+  Grid grid(20000, 20000, 0.5);
+  REQUIRE(grid.tiles() == 0);
+  REQUIRE(grid.cell(19999, 19999)->present().empty());
+  REQUIRE(grid.tiles() == 0);
+
+  PresenceManager pm(1000);
+  for (uint64_t id = 0;id < 1000;id++) {
+    grid.moveTo(pm, id, 10000 + (id % 100), 10000 + (id / 100)); // within tile 156,156 and the next
+  }
+  REQUIRE(grid.tiles() == 2);
+  REQUIRE(grid.tile(156, 156) == 0);
+  REQUIRE(grid.tile(157, 156) == 1);
+  REQUIRE(grid.tile(0, 0) == Grid::NoTile);
+  REQUIRE(grid.cell(10099, 10009)->present() == std::vector<uint64_t>{999});
+
+  // cells share blocks of one arena, so a crowd can gather and leave
+  for (uint64_t id = 0;id < 1000;id++) {
+    grid.moveTo(pm, id, 19999, 0);
+  }
+  REQUIRE(grid.tiles() == 3);
+  REQUIRE(grid.cell(19999, 0)->present().size() == 1000);
+  REQUIRE(grid.cell(10000, 10000)->present().empty());
+  for (uint64_t id = 0;id < 1000;id += 2) {
+    grid.moveTo(pm, id, 19998, 0);
+  }
+  auto odd = grid.cell(19999, 0)->present();
+  auto even = grid.cell(19998, 0)->present();
+  REQUIRE(odd.size() == 500);
+  REQUIRE(even.size() == 500);
+  for (uint64_t id : odd) {
+    REQUIRE(1 == id % 2);
+  }
+
+  grid.reindex(pm);
+  const CellIndex& index = grid.index();
+  REQUIRE(index.end(grid.key(19998, 0)) - index.begin(grid.key(19998, 0)) == 500);
+}
+
+TEST_CASE("neighbourhood","[neighbourhood][datatypes]") {
+  using namespace heraldns::datatype;
+  PresenceManager pm(400);
+  std::shared_ptr<Grid> grid = std::make_shared<Grid>(30, 20, 0.5);
+  grid->randomisePositions(pm, 7);
+  grid->reindex(pm);
+  Neighbourhood near(*grid, 2.0);
+  REQUIRE(near.radius() == 4);
+  REQUIRE(near.weight(0, 0) == 1.0);
+  REQUIRE(near.weight(2, 0) == 1.0); // within 1 m
+  REQUIRE(near.weight(-4, 0) == 0.25);
+  REQUIRE(near.weight(3, 4) == Approx(1.0 / 6.25));
+
+  // Same presences and weights as checking every cell in the box
+  for (uint64_t id = 0;id < pm.size();id++) {
+    std::vector<std::pair<uint64_t,double>> found;
+    near.forEach(*grid, pm, id, [&found] (uint64_t other, double weight) {
+      found.emplace_back(other, weight);
+    });
+    std::sort(found.begin(), found.end());
+
+    std::vector<std::pair<uint64_t,double>> expected;
+    auto here = grid->cell(pm.x(id), pm.y(id));
+    for (uint64_t other = 0;other < pm.size();other++) {
+      int64_t dx = (int64_t)pm.x(other) - (int64_t)pm.x(id);
+      int64_t dy = (int64_t)pm.y(other) - (int64_t)pm.y(id);
+      if (other != id && std::abs(dx) <= 4 && std::abs(dy) <= 4) {
+        double distance = grid->distance(grid->cell(pm.x(other), pm.y(other)), here);
+        expected.emplace_back(other, 1.0 / std::pow(std::max(1.0, distance), 2.0));
+      }
+    }
+    REQUIRE(found.size() == expected.size());
+    for (std::size_t i = 0;i < found.size();i++) {
+      REQUIRE(found[i].first == expected[i].first);
+      REQUIRE(found[i].second == Approx(expected[i].second));
+    }
+  }
+}
+
+TEST_CASE("neighbourhood-tiles","[neighbourhood][tiles][datatypes]") {
+  using namespace heraldns::datatype;
+  // Clusters around tile corners of a grid with partial tiles at its edges, leaving some tiles empty
+  PresenceManager pm(600);
+  std::shared_ptr<Grid> grid = std::make_shared<Grid>(300, 200, 0.5);
+  std::mt19937_64 gen(3);
+  std::uniform_int_distribution<int64_t> offset(-12, 12);
+  const std::vector<std::pair<int64_t,int64_t>> corners{{64, 64}, {128, 128}, {299, 199}, {256, 0}};
+  for (uint64_t id = 0;id < pm.size();id++) {
+    auto corner = corners[id % corners.size()];
+    grid->moveTo(pm, id, std::clamp<int64_t>(corner.first + offset(gen), 0, 299),
+                         std::clamp<int64_t>(corner.second + offset(gen), 0, 199));
+  }
+  grid->reindex(pm);
+  REQUIRE(grid->tiles() < 20);
+  Neighbourhood near(*grid, 8.0);
+
+  for (uint64_t id = 0;id < pm.size();id++) {
+    std::vector<std::pair<uint64_t,double>> found;
+    near.forEach(*grid, pm, id, [&found] (uint64_t other, double weight) {
+      found.emplace_back(other, weight);
+    });
+    std::sort(found.begin(), found.end());
+
+    std::vector<std::pair<uint64_t,double>> expected;
+    for (uint64_t other = 0;other < pm.size();other++) {
+      int64_t dx = (int64_t)pm.x(other) - (int64_t)pm.x(id);
+      int64_t dy = (int64_t)pm.y(other) - (int64_t)pm.y(id);
+      if (other != id && std::abs(dx) <= 16 && std::abs(dy) <= 16) {
+        expected.emplace_back(other, near.weight(dx, dy));
+      }
+    }
+    REQUIRE(found == expected);
+  }
+}
+
+TEST_CASE("timerwheel","[timerwheel][datatypes]") {
+  heraldns::datatype::TimerWheel wheel(4);
+  REQUIRE(wheel.slots() == 4);
+  wheel.schedule(2, 10);
+  wheel.schedule(6, 11); // same slot, next turn
+  wheel.schedule(2, 12);
+  wheel.schedule(3, 13);
+  REQUIRE(wheel.size() == 4);
+
+  std::vector<uint64_t> due;
+  wheel.take(1, due);
+  REQUIRE(due.empty());
+  wheel.take(2, due);
+  REQUIRE(due == std::vector<uint64_t>{10, 12}); // in the order scheduled
+  REQUIRE(wheel.size() == 2);
+  due.clear();
+  wheel.take(3, due);
+  REQUIRE(due == std::vector<uint64_t>{13});
+  due.clear();
+  wheel.take(6, due);
+  REQUIRE(due == std::vector<uint64_t>{11});
+  REQUIRE(wheel.size() == 0);
+
+  wheel.schedule(9, 14);
+  wheel.clear();
+  REQUIRE(wheel.size() == 0);
+  due.clear();
+  wheel.take(9, due);
+  REQUIRE(due.empty());
+}
+
+TEST_CASE("grid-moveto-benchmark","[.][benchmark][grid]") {
+  using namespace heraldns::datatype;
+  // 1M presences, 100 per cell on average, each taking a random step (or none) per tick
+  const uint64_t count = 1000000;
+  PresenceManager pm(count);
+  Grid grid(100, 100, 1.0);
+  grid.randomisePositions(pm, 1);
+  std::mt19937_64 gen(2);
+  std::uniform_int_distribution<int64_t> step(-1,1);
+  std::vector<uint32_t> toX(count), toY(count);
+  const int ticks = 5;
+  double seconds = 0.0;
+  for (int tick = 0;tick < ticks;tick++) {
+    for (uint64_t id = 0;id < count;id++) {
+      toX[id] = (uint32_t)std::clamp<int64_t>((int64_t)pm.x(id) + step(gen), 0, 99);
+      toY[id] = (uint32_t)std::clamp<int64_t>((int64_t)pm.y(id) + step(gen), 0, 99);
+    }
+    auto started = std::chrono::steady_clock::now();
+    for (uint64_t id = 0;id < count;id++) {
+      grid.moveTo(pm, id, toX[id], toY[id]);
+    }
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  }
+  uint64_t present = 0;
+  for (uint64_t x = 0;x < 100;x++) {
+    for (uint64_t y = 0;y < 100;y++) {
+      present += grid.cell(x,y)->present().size();
+    }
+  }
+  REQUIRE(present == count);
+  std::cout << "Grid::moveTo of " << count << " presences on a 100x100 grid: "
+            << (seconds * 1e9 / (count * ticks)) << " ns per presence per tick" << std::endl;
+}
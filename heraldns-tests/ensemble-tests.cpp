@@ -0,0 +1,169 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include "catch.hpp"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "heraldns/heraldns.h"
+
+using namespace heraldns::datatype;
+using namespace heraldns::mixing;
+using namespace heraldns::providers;
+using namespace heraldns::simulator;
+using namespace heraldns::transmission;
+
+static std::vector<std::string> readLines(const std::filesystem::path& path) {
+  std::ifstream in(path);
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(in, line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+TEST_CASE("ensemble-settings", "[ensemble][settings]") {
+  SECTION("ensemble-settings-sweep") {
+    std::istringstream in(
+      "# a sweep\n"
+      "replicates = 20\n"
+      "seed=7\n"
+      "\n"
+      "threads = 2\n"
+      "output = sweep-results\n"
+      "presences = 100, 200\n"
+      "separation = 0.5,1.0,2.0\n"
+      "days = 3\n");
+    EnsembleSettings settings;
+    std::string error;
+    REQUIRE(EnsembleSettings::read(in, settings, error));
+    REQUIRE(settings.replicates == 20);
+    REQUIRE(settings.seed == 7);
+    REQUIRE(settings.threads == 2);
+    REQUIRE(settings.output == "sweep-results");
+    REQUIRE(settings.scenarios.size() == 6);
+    // first name read varies slowest
+    REQUIRE(settings.scenarios[0].presences == 100);
+    REQUIRE(settings.scenarios[0].separation == 0.5);
+    REQUIRE(settings.scenarios[2].presences == 100);
+    REQUIRE(settings.scenarios[2].separation == 2.0);
+    REQUIRE(settings.scenarios[3].presences == 200);
+    REQUIRE(settings.scenarios[3].separation == 0.5);
+    for (auto& scenario : settings.scenarios) {
+      REQUIRE(scenario.days == 3);
+      REQUIRE(scenario.width == ScenarioSettings().width);
+    }
+  }
+
+  SECTION("ensemble-settings-invalid") {
+    for (std::string text : {"presences 100\n", "colour = blue\n", "presences = many\n", "presences = -1\n",
+                             "days = 1,,2\n", "replicates = 0\n", "secondsPerTick = 0\n",
+                             "secondsPerTick = 86401\n"}) {
+      std::istringstream in(text);
+      EnsembleSettings settings;
+      std::string error;
+      REQUIRE(!EnsembleSettings::read(in, settings, error));
+      REQUIRE(!error.empty());
+    }
+  }
+}
+
+TEST_CASE("ensemble-bands", "[ensemble][bands]") {
+  auto bands = Ensemble::bands({{1, 10}, {3, 10}, {5, 10}, {7, 10}});
+  REQUIRE(bands.size() == 2);
+  REQUIRE(bands[0].mean == 4.0);
+  // sample sd = sqrt(20/3), so half width = 1.96 * sd / 2
+  REQUIRE(bands[0].low == Approx(4.0 - 1.96 * std::sqrt(20.0 / 3.0) / 2.0));
+  REQUIRE(bands[0].high == Approx(4.0 + 1.96 * std::sqrt(20.0 / 3.0) / 2.0));
+  REQUIRE(bands[1].mean == 10.0);
+  REQUIRE(bands[1].low == 10.0);
+  REQUIRE(bands[1].high == 10.0);
+
+  auto one = Ensemble::bands({{3, 4}});
+  REQUIRE(one[1].low == 4.0);
+  REQUIRE(Ensemble::bands({}).empty());
+}
+
+TEST_CASE("ensemble-run", "[ensemble][run]") {
+  std::filesystem::path folder = std::filesystem::temp_directory_path() / "heraldns-ensemble-test";
+  std::filesystem::remove_all(folder);
+
+  EnsembleSettings settings;
+  settings.replicates = 4;
+  settings.seed = 11;
+  settings.output = folder.string();
+  ScenarioSettings scenario;
+  scenario.presences = 200;
+  scenario.width = 20;
+  scenario.height = 20;
+  scenario.initialInfections = 10;
+  scenario.days = 2;
+  scenario.secondsPerTick = 3600;
+  settings.scenarios = {scenario, scenario};
+  settings.scenarios[1].presences = 400;
+
+  // the same results on any number of threads
+  std::vector<std::vector<DailyBand>> cases;
+  for (unsigned int threads : {1, 3}) {
+    settings.threads = threads;
+    Ensemble ensemble(settings);
+    REQUIRE(ensemble.run());
+    REQUIRE(ensemble.seed(0, 1) != ensemble.seed(1, 0));
+    for (uint64_t s = 0;s < 2;s++) {
+      REQUIRE(ensemble.cases(s).size() == 3); // day 0, 1, 2
+      REQUIRE(ensemble.recovered(s).size() == 3);
+      REQUIRE(ensemble.cases(s)[0].mean == 10.0);
+      cases.push_back(ensemble.cases(s));
+    }
+  }
+  for (std::size_t day = 0;day < 3;day++) {
+    REQUIRE(cases[0][day].mean == cases[2][day].mean);
+    REQUIRE(cases[0][day].high == cases[2][day].high);
+    REQUIRE(cases[1][day].mean == cases[3][day].mean);
+  }
+
+  // each replicate is a run of its own
+  auto replicate = Ensemble::runReplicate(scenario, Ensemble(settings).seed(0, 2));
+  REQUIRE(replicate.first.size() == 3);
+
+  // with ticks that do not divide a day, recovery and immunity are rounded up as the run's length is
+  {
+    ScenarioSettings uneven = scenario;
+    uneven.secondsPerTick = 7 * 60 * 60; // 3.43 ticks a day
+    uneven.days = 4;
+    uneven.recoveryDays = 2;  // 6.86 ticks
+    uneven.immunityDays = 3;  // 10.29 ticks
+    PresenceManager pm(uneven.presences);
+    auto grid = std::make_shared<Grid>(uneven.width, uneven.height, uneven.separation);
+    auto scoring = std::make_shared<DirectMixingScoreProvider>(pm, grid, uneven.initialRisk, uneven.riskDropOffPerDay);
+    auto transmission = std::make_shared<BasicTransmissionModelProvider>(pm, grid, 7, 11, uneven.initialInfections);
+    Simulation sim(grid, pm, scoring, transmission);
+    sim.seed(5);
+    sim.threads(1);
+    sim.verbose(false);
+    sim.runToCompletion(uneven.days, uneven.secondsPerTick);
+    auto exact = Ensemble::runReplicate(uneven, 5);
+    REQUIRE(exact.first == sim.dailyCases());
+    REQUIRE(exact.second == sim.dailyRecovered());
+  }
+
+  auto scenarios = readLines(folder / "scenarios.csv");
+  REQUIRE(scenarios.size() == 3);
+  REQUIRE(scenarios[2].rfind("1,400,20,20,", 0) == 0);
+  auto replicates = readLines(folder / "replicates.csv");
+  REQUIRE(replicates.size() == 1 + (2 * 4 * 3));
+  REQUIRE(replicates[0] == "scenario,replicate,seed,day,cases,recovered");
+  auto summary = readLines(folder / "summary.csv");
+  REQUIRE(summary.size() == 1 + (2 * 3));
+  REQUIRE(summary[1].rfind("0,0,10,10,10,0,0,0", 0) == 0);
+
+  std::filesystem::remove_all(folder);
+}
@@ -18,6 +18,7 @@ under the License.
 #include "catch.hpp"
 
 #include <string>
+#include <vector>
 
 #include "heraldns/heraldns.h"
 
@@ -27,37 +28,125 @@ TEST_CASE("presencemanager","[presence][basic][presencemanager]") {
     heraldns::datatype::PresenceManager pm(64);
 
     REQUIRE(pm.size() == 64);
-    REQUIRE_NOTHROW(pm.get(0));
-    REQUIRE_NOTHROW(pm.get(63));
-    // REQUIRE_THROWS(pm.get(64));
+    REQUIRE_NOTHROW(pm.state(0));
+    REQUIRE_NOTHROW(pm.state(63));
   }
 
 }
 
 TEST_CASE("presence-ctor","[presence][basic][ctor][presence]") {
   SECTION("presence-ctor") {
-    heraldns::datatype::Presence p(5);
-
-    REQUIRE(p.id() == 5);
-    REQUIRE(p.risk() == 0);
-    REQUIRE(p.newRisk() == 0);
-    REQUIRE(p.transmittedRisk() == 0);
-    REQUIRE(p.newTransmittedRisk() == 0);
-    REQUIRE(p.flightiness() == 0);
-    REQUIRE(p.state() == heraldns::datatype::State::Well);
-    REQUIRE(p.hasEverBeenIll() == false);
-    REQUIRE(p.lastFellIll() == 0);
-    REQUIRE(p.lastRecovered() == 0);
-    REQUIRE(p.highestRiskScore() == 0);
-    REQUIRE(p.transmissionModelScore() == 0);
-    REQUIRE(p.newTransmissionModelScore() == 0);
-    bool hasValue = (bool)p.position();
-    REQUIRE(false == hasValue);
+    heraldns::datatype::PresenceManager pm(6);
+
+    REQUIRE(pm.risk(5) == 0);
+    REQUIRE(pm.newRisk(5) == 0);
+    REQUIRE(pm.transmittedRisk(5) == 0);
+    REQUIRE(pm.newTransmittedRisk(5) == 0);
+    REQUIRE(pm.flightiness(5) == 0);
+    REQUIRE(pm.state(5) == heraldns::datatype::State::Well);
+    REQUIRE(pm.hasEverBeenIll(5) == false);
+    REQUIRE(pm.lastFellIll(5) == 0);
+    REQUIRE(pm.lastRecovered(5) == 0);
+    REQUIRE(pm.highestRiskScore(5) == 0);
+    REQUIRE(pm.transmissionModelScore(5) == 0);
+    REQUIRE(pm.newTransmissionModelScore(5) == 0);
+    REQUIRE(false == pm.placed(5));
+  }
+}
+
+TEST_CASE("presence-commit","[presence][basic][commit]") {
+  using namespace heraldns::datatype;
+  PresenceManager pm(3);
+
+  SECTION("presence-commit-risk") {
+    pm.newRisk(1, 0.5);
+    pm.newTransmittedRisk(1, 0.25);
+    REQUIRE(pm.risk(1) == 0);
+    REQUIRE(pm.transmittedRisk(1) == 0);
+    pm.commitChanges();
+    REQUIRE(pm.risk(1) == 0.5);
+    REQUIRE(pm.newRisk(1) == 0);
+    REQUIRE(pm.transmittedRisk(1) == 0.25);
+    REQUIRE(pm.highestRiskScore(1) == 0.5);
+    pm.newRisk(1, 0.1);
+    pm.commitChanges(1);
+    REQUIRE(pm.risk(1) == 0.1);
+    REQUIRE(pm.highestRiskScore(1) == 0.5);
+    // others unchanged
+    REQUIRE(pm.risk(0) == 0);
+    REQUIRE(pm.risk(2) == 0);
+  }
+
+  SECTION("presence-commit-state") {
+    pm.newState(2, State::Ill, 10);
+    REQUIRE(pm.state(2) == State::Well);
+    REQUIRE(pm.lastFellIll(2) == 10);
+    REQUIRE(pm.hasEverBeenIll(2));
+    pm.commitChanges();
+    REQUIRE(pm.state(2) == State::Ill);
+
+    pm.newTransmittedRisk(2, 1.0);
+    pm.newTransmissionModelScore(2, 30.0);
+    pm.newState(2, State::Recovered, 20);
+    REQUIRE(pm.lastRecovered(2) == 20);
+    REQUIRE(pm.newTransmittedRisk(2) == 0);
+    REQUIRE(pm.newTransmissionModelScore(2) == 0);
+    pm.commitChanges();
+    REQUIRE(pm.state(2) == State::Recovered);
+    REQUIRE(pm.state(0) == State::Well);
   }
 }
 
-// TODO test setters and retrievers without commit
+TEST_CASE("presence-moveto","[presence][basic][position]") {
+  using namespace heraldns::datatype;
+  PresenceManager pm(2);
+  Grid grid(4, 4, 1.0);
 
-// TODO test commit post-conditions
+  grid.moveTo(pm, 1, 2, 3);
+  REQUIRE(pm.placed(1));
+  REQUIRE(!pm.placed(0));
+  REQUIRE(pm.x(1) == 2);
+  REQUIRE(pm.y(1) == 3);
+  REQUIRE(grid.cell(2,3)->present() == std::vector<uint64_t>{1});
 
-// TODO test move to and position
\ No newline at end of file
+  grid.moveTo(pm, 1, 0, 0);
+  REQUIRE(pm.x(1) == 0);
+  REQUIRE(pm.y(1) == 0);
+  REQUIRE(grid.cell(2,3)->present().empty());
+  REQUIRE(grid.cell(0,0)->present() == std::vector<uint64_t>{1});
+
+  grid.randomisePositions(pm);
+  REQUIRE(pm.placed(0));
+  REQUIRE(pm.placed(1));
+  uint64_t present = 0;
+  for (uint64_t x = 0;x < 4;x++) {
+    for (uint64_t y = 0;y < 4;y++) {
+      present += grid.cell(x,y)->present().size();
+    }
+  }
+  REQUIRE(present == 2);
+}
+
+TEST_CASE("presence-moveto-crowded","[presence][basic][position]") {
+  using namespace heraldns::datatype;
+  PresenceManager pm(5);
+  Grid grid(2, 1, 1.0);
+  for (uint64_t id = 0;id < 5;id++) {
+    grid.moveTo(pm, id, 0, 0);
+  }
+  REQUIRE(grid.cell(0,0)->present() == std::vector<uint64_t>{0, 1, 2, 3, 4});
+
+  // the last presence takes the leaver's place
+  grid.moveTo(pm, 1, 1, 0);
+  REQUIRE(grid.cell(0,0)->present() == std::vector<uint64_t>{0, 4, 2, 3});
+  // so must know its new place to leave in turn
+  grid.moveTo(pm, 4, 1, 0);
+  REQUIRE(grid.cell(0,0)->present() == std::vector<uint64_t>{0, 3, 2});
+  grid.moveTo(pm, 2, 1, 0);
+  REQUIRE(grid.cell(0,0)->present() == std::vector<uint64_t>{0, 3});
+  REQUIRE(grid.cell(1,0)->present() == std::vector<uint64_t>{1, 4, 2});
+
+  // staying put changes nothing
+  grid.moveTo(pm, 4, 1, 0);
+  REQUIRE(grid.cell(1,0)->present() == std::vector<uint64_t>{1, 4, 2});
+}
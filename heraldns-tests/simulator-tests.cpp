@@ -0,0 +1,516 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include "catch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "heraldns/heraldns.h"
+
+using namespace heraldns::datatype;
+using namespace heraldns::mixing;
+using namespace heraldns::providers;
+using namespace heraldns::simulator;
+using namespace heraldns::transmission;
+
+/// \brief Records every intermediate result, and when it was received
+struct RecordingResults : public IntermediateResultsListener {
+  void intermediateResults(uint64_t casesNow, uint64_t recoveredNow,
+    const PresenceManager& pm,
+    double, uint64_t ticksComplete) override {
+    cases.push_back(casesNow);
+    recovered.push_back(recoveredNow);
+    ticks.push_back(ticksComplete);
+    population = pm.size();
+    received.push_back(std::chrono::steady_clock::now());
+  }
+
+  std::vector<uint64_t> cases;
+  std::vector<uint64_t> recovered;
+  std::vector<uint64_t> ticks;
+  uint64_t population = 0;
+  std::vector<std::chrono::steady_clock::time_point> received;
+};
+
+/// \brief A population spread over a square grid, with one cell in every cellsPerPresence free
+struct Scenario {
+  Scenario(uint64_t presences, uint64_t cellsPerPresence, double separation, uint64_t infections)
+    : pm(presences),
+      grid(std::make_shared<Grid>(side(presences, cellsPerPresence), side(presences, cellsPerPresence), separation)),
+      scoring(std::make_shared<DirectMixingScoreProvider>(pm, grid, 100, 1.0 / 14.0)),
+      transmission(std::make_shared<BasicTransmissionModelProvider>(pm, grid, 14 * 24 * 12, 90 * 24 * 12, infections)),
+      sim(grid, pm, scoring, transmission)
+  {
+    ;
+  }
+
+  static uint64_t side(uint64_t presences, uint64_t cellsPerPresence) {
+    return (uint64_t)std::ceil(std::sqrt((double)(presences * cellsPerPresence)));
+  }
+
+  PresenceManager pm;
+  std::shared_ptr<Grid> grid;
+  std::shared_ptr<DirectMixingScoreProvider> scoring;
+  std::shared_ptr<BasicTransmissionModelProvider> transmission;
+  Simulation sim;
+};
+
+TEST_CASE("simulation-basic", "[simulation][basic]") {
+  Scenario s(200, 1, 0.5, 10);
+  auto results = std::make_shared<RecordingResults>();
+  s.sim.runToCompletion(1, 4 * 60 * 60, results, 1); // 1 day, 4 hours per tick = 6 ticks
+
+  REQUIRE(results->population == 200);
+  REQUIRE(results->cases.size() == 7); // initial state, after each tick
+  REQUIRE(results->ticks == std::vector<uint64_t>{0, 1, 2, 3, 4, 5, 6});
+  REQUIRE(results->cases.front() == 10);
+  for (auto cases : results->cases) {
+    REQUIRE(cases <= 200);
+  }
+  for (std::size_t i = 0;i < results->recovered.size();++i) {
+    REQUIRE(results->cases[i] + results->recovered[i] <= 200);
+  }
+  REQUIRE(results->ticks.back() == 6);
+}
+
+TEST_CASE("tickexecutor", "[simulation][tickexecutor]") {
+  for (unsigned int threads : {1, 3}) {
+    TickExecutor executor(threads);
+    REQUIRE(executor.threads() == threads);
+
+    std::vector<int> ran(1000, 0);
+    executor.forEachChunk(1000, 64, [&ran] (uint64_t from, uint64_t to) {
+      REQUIRE(to - from <= 64);
+      for (uint64_t id = from;id < to;id++) {
+        ran[id]++;
+      }
+    });
+    for (auto times : ran) {
+      REQUIRE(times == 1);
+    }
+  }
+}
+
+TEST_CASE("counterrng", "[simulation][counterrng]") {
+  // Known answers from the Random123 library's Philox4x32-10 test vectors
+  REQUIRE(CounterRng::philox({0, 0, 0, 0}, {0, 0}) == CounterRng::Block{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+  REQUIRE(CounterRng::philox({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff}) ==
+    CounterRng::Block{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd});
+  REQUIRE(CounterRng::philox({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0}) ==
+    CounterRng::Block{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+
+  CounterRng rng(0x299f31d0a4093822);
+  REQUIRE(rng.seed() == 0x299f31d0a4093822);
+  REQUIRE(rng.block(0x85a308d3243f6a88, 0x0370734413198a2e) == CounterRng::Block{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+
+  REQUIRE(CounterRng::step(0) == -1);
+  REQUIRE(CounterRng::step(0x55555555) == -1);
+  REQUIRE(CounterRng::step(0x55555556) == 0);
+  REQUIRE(CounterRng::step(0xaaaaaaab) == 1);
+  REQUIRE(CounterRng::step(0xffffffff) == 1);
+
+  // Steps for a range are the same as for each presence on its own, and roughly uniform
+  const uint64_t count = 30000;
+  std::vector<int8_t> dx(count), dy(count);
+  rng.steps(7, 100, 100 + count, dx.data(), dy.data());
+  int counts[3] = {0, 0, 0};
+  for (uint64_t i = 0;i < count;i++) {
+    auto block = rng.block(100 + i, 7);
+    REQUIRE(dx[i] == CounterRng::step(block[0]));
+    REQUIRE(dy[i] == CounterRng::step(block[1]));
+    counts[dx[i] + 1]++;
+  }
+  for (int c : counts) {
+    REQUIRE(c > 9500);
+    REQUIRE(c < 10500);
+  }
+  // Another tick or seed gives other numbers
+  REQUIRE(rng.block(100, 8) != rng.block(100, 7));
+  REQUIRE(CounterRng(1).block(100, 7) != rng.block(100, 7));
+}
+
+TEST_CASE("counterrng-benchmark", "[.][benchmark][counterrng]") {
+  const uint64_t count = 1000000;
+  const int ticks = 20;
+  std::vector<int8_t> dx(count), dy(count);
+
+  std::mt19937_64 gen(42);
+  std::uniform_int_distribution<int64_t> distrib(-1,1);
+  auto started = std::chrono::steady_clock::now();
+  for (int tick = 0;tick < ticks;tick++) {
+    for (uint64_t id = 0;id < count;id++) {
+      dx[id] = (int8_t)distrib(gen);
+      dy[id] = (int8_t)distrib(gen);
+    }
+  }
+  double twister = std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now() - started).count() / (count * ticks);
+
+  CounterRng rng(42);
+  started = std::chrono::steady_clock::now();
+  for (int tick = 0;tick < ticks;tick++) {
+    rng.steps(tick, 0, count, dx.data(), dy.data());
+  }
+  double counter = std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now() - started).count() / (count * ticks);
+
+  std::cout << "Movement steps per presence: mt19937_64 " << twister << " ns, CounterRng::steps " << counter << " ns" << std::endl;
+}
+
+TEST_CASE("simulation-deterministic", "[simulation][deterministic]") {
+  Scenario first(500, 1, 0.5, 20);
+  Scenario second(500, 1, 0.5, 20);
+  first.sim.seed(42);
+  second.sim.seed(42);
+  first.sim.threads(1);
+  second.sim.threads(3); // same results on any number of threads
+  first.sim.runToCompletion(1, 4 * 60 * 60);
+  second.sim.runToCompletion(1, 4 * 60 * 60);
+  for (uint64_t id = 0;id < 500;id++) {
+    REQUIRE(first.pm.x(id) == second.pm.x(id));
+    REQUIRE(first.pm.y(id) == second.pm.y(id));
+    REQUIRE(first.pm.state(id) == second.pm.state(id));
+    REQUIRE(first.pm.risk(id) == second.pm.risk(id));
+    REQUIRE(first.pm.transmittedRisk(id) == second.pm.transmittedRisk(id));
+    REQUIRE(first.pm.highestRiskScore(id) == second.pm.highestRiskScore(id));
+  }
+}
+
+TEST_CASE("simulation-large-world", "[simulation][tiles]") {
+  // Two districts of a 10 km square city at 0.5 m, which would be 400 million cells
+  PresenceManager pm(2000);
+  std::shared_ptr<Grid> grid = std::make_shared<Grid>(20000, 20000, 0.5);
+  for (uint64_t id = 0;id < 2000;id++) {
+    const uint64_t district = (id % 2) * 15000;
+    grid->moveTo(pm, id, 2000 + district + (id % 40), 3000 + district + (id / 40));
+  }
+  const uint64_t tilesBefore = grid->tiles();
+  auto scoring = std::make_shared<DirectMixingScoreProvider>(pm, grid, 100, 1.0 / 14.0);
+  auto transmission = std::make_shared<BasicTransmissionModelProvider>(pm, grid, 14 * 24 * 12, 90 * 24 * 12, 20);
+  Simulation sim(grid, pm, scoring, transmission);
+  sim.seed(1);
+  sim.verbose(false);
+  sim.placeAtRandom(false);
+  sim.runToCompletion(1, 2 * 60 * 60); // 12 ticks
+  REQUIRE(sim.dailyCases().size() == 2);
+  // presences wander at most one cell per tick, so stay within or beside their tiles
+  REQUIRE(grid->tiles() <= tilesBefore * 4);
+  for (uint64_t id = 0;id < 2000;id++) {
+    const uint64_t district = (id % 2) * 15000;
+    REQUIRE(pm.x(id) + 12 >= 2000 + district);
+    REQUIRE(pm.x(id) <= 2000 + district + 40 + 12);
+  }
+}
+
+TEST_CASE("simulation-long-ticks", "[simulation][days]") {
+  // Each two day tick crosses two days, so every day still has its totals
+  Scenario s(200, 1, 0.5, 10);
+  s.sim.seed(2);
+  s.sim.verbose(false);
+  auto results = std::make_shared<RecordingResults>();
+  s.sim.runToCompletion(4, 2 * 24 * 60 * 60, results, 1); // 2 ticks
+  REQUIRE(s.sim.dailyCases().size() == 5);
+  REQUIRE(s.sim.dailyRecovered().size() == 5);
+  REQUIRE(s.sim.dailyCases()[1] == s.sim.dailyCases()[2]);
+  REQUIRE(s.sim.dailyCases()[3] == s.sim.dailyCases()[4]);
+  REQUIRE(results->ticks == std::vector<uint64_t>{0, 1, 2});
+  REQUIRE(results->cases.back() == s.sim.dailyCases()[4]);
+}
+
+TEST_CASE("simulation-checkpoint", "[simulation][checkpoint]") {
+  std::filesystem::path file = std::filesystem::temp_directory_path() / "heraldns-checkpoint-test.bin";
+  std::filesystem::remove(file);
+
+  Scenario first(500, 1, 0.5, 20);
+  first.sim.seed(5);
+  first.sim.verbose(false);
+  first.sim.checkpoints(file.string(), 5);
+  first.sim.runToCompletion(2, 4 * 60 * 60); // 12 ticks, the last checkpoint after tick 10
+  REQUIRE(std::filesystem::exists(file));
+  REQUIRE(!std::filesystem::exists(file.string() + ".tmp"));
+
+  // A fresh simulation, on more threads, continues identically
+  Scenario second(500, 1, 0.5, 20);
+  second.sim.threads(3);
+  second.sim.verbose(false);
+  auto results = std::make_shared<RecordingResults>();
+  REQUIRE(second.sim.resume(file.string(), results, 1));
+  REQUIRE(results->ticks == std::vector<uint64_t>{10, 11, 12});
+  REQUIRE(second.sim.dailyCases() == first.sim.dailyCases());
+
+  // Streamed results continue from the checkpoint's time, not from zero
+  {
+    std::filesystem::path folder = std::filesystem::temp_directory_path() / "heraldns-checkpoint-streaming-test";
+    std::filesystem::remove_all(folder);
+    Scenario streamed(500, 1, 0.5, 20);
+    streamed.sim.verbose(false);
+    auto streaming = std::make_shared<heraldns::intermediate::StreamingResults>(folder.string(), 0);
+    REQUIRE(streamed.sim.resume(file.string(), streaming, 1));
+    REQUIRE(streaming->close());
+    std::ifstream ticks(folder / "ticks.csv");
+    std::vector<std::string> rows;
+    for (std::string row;std::getline(ticks, row);) {
+      rows.push_back(row);
+    }
+    REQUIRE(rows.size() == 1 + 3);
+    REQUIRE(rows[1].rfind("10,2400,", 0) == 0);
+    REQUIRE(rows[2].rfind("11,2640,", 0) == 0);
+    REQUIRE(rows[3].rfind("12,2880,", 0) == 0);
+    std::ifstream days(folder / "days.csv");
+    std::vector<std::string> dayRows;
+    for (std::string row;std::getline(days, row);) {
+      dayRows.push_back(row);
+    }
+    REQUIRE(dayRows.size() == 1 + 2);
+    REQUIRE(dayRows[1].rfind("1,", 0) == 0);
+    REQUIRE(dayRows[2].rfind("2,", 0) == 0);
+    std::filesystem::remove_all(folder);
+  }
+  REQUIRE(second.sim.dailyRecovered() == first.sim.dailyRecovered());
+  for (uint64_t id = 0;id < 500;id++) {
+    REQUIRE(first.pm.x(id) == second.pm.x(id));
+    REQUIRE(first.pm.y(id) == second.pm.y(id));
+    REQUIRE(first.pm.state(id) == second.pm.state(id));
+    REQUIRE(first.pm.risk(id) == second.pm.risk(id));
+    REQUIRE(first.pm.transmittedRisk(id) == second.pm.transmittedRisk(id));
+    REQUIRE(first.pm.transmissionModelScore(id) == second.pm.transmissionModelScore(id));
+    REQUIRE(first.pm.highestRiskScore(id) == second.pm.highestRiskScore(id));
+    REQUIRE(first.pm.lastFellIll(id) == second.pm.lastFellIll(id));
+  }
+  // and the grid's cells hold the same presences in the same order
+  for (uint64_t x = 0;x < first.grid->width();x++) {
+    for (uint64_t y = 0;y < first.grid->height();y++) {
+      REQUIRE(first.grid->cell(x, y)->present() == second.grid->cell(x, y)->present());
+    }
+  }
+
+  // Columns are aligned for memory mapping
+  Checkpoint checkpoint;
+  REQUIRE(checkpoint.open(file.string()));
+  REQUIRE(checkpoint.bytes("x") == 500 * sizeof(uint32_t));
+  REQUIRE(checkpoint.fileSize() == std::filesystem::file_size(file));
+  std::vector<uint32_t> x(500);
+  REQUIRE(checkpoint.read("x", x.data(), x.size() * sizeof(uint32_t)));
+  REQUIRE(!checkpoint.read("x", x.data(), 10));
+  REQUIRE(!checkpoint.has("none"));
+
+  // Cannot resume a different size of population, or from something else
+  Scenario other(400, 1, 0.5, 20);
+  other.sim.verbose(false);
+  REQUIRE(!other.sim.resume(file.string()));
+  std::ofstream((file.string() + ".not")) << "not a checkpoint";
+  REQUIRE(!second.sim.resume(file.string() + ".not"));
+  REQUIRE(!second.sim.resume(file.string() + ".missing"));
+
+  // A checkpoint the grid rejects, as its positions are outside it, changes nothing
+  std::array<uint64_t,8> settings{};
+  REQUIRE(checkpoint.read("simulation", settings.data(), sizeof(settings)));
+  std::vector<uint64_t> transmissionState(checkpoint.bytes("transmission") / sizeof(uint64_t));
+  REQUIRE(checkpoint.read("transmission", transmissionState.data(), transmissionState.size() * sizeof(uint64_t)));
+  std::vector<uint32_t> outside(500, 100000);
+  Checkpoint invalid;
+  invalid.add("simulation", settings.data(), sizeof(settings));
+  for (auto& column : first.pm.columns()) {
+    invalid.add(column.name, 0 == std::strcmp(column.name, "x") ? outside.data() : column.data, column.bytes);
+  }
+  invalid.add("casesPerDay", first.sim.dailyCases().data(), first.sim.dailyCases().size() * sizeof(uint64_t));
+  invalid.add("recoveredPerDay", first.sim.dailyRecovered().data(), first.sim.dailyRecovered().size() * sizeof(uint64_t));
+  invalid.add("mixing", nullptr, 0);
+  invalid.add("transmission", transmissionState.data(), transmissionState.size() * sizeof(uint64_t));
+  REQUIRE(invalid.write(file.string() + ".outside"));
+  REQUIRE(!second.sim.resume(file.string() + ".outside"));
+  REQUIRE(second.sim.dailyCases() == first.sim.dailyCases());
+  for (uint64_t id = 0;id < 500;id++) {
+    REQUIRE(first.pm.x(id) == second.pm.x(id));
+    REQUIRE(first.pm.state(id) == second.pm.state(id));
+  }
+  for (uint64_t x = 0;x < first.grid->width();x++) {
+    for (uint64_t y = 0;y < first.grid->height();y++) {
+      REQUIRE(first.grid->cell(x, y)->present() == second.grid->cell(x, y)->present());
+    }
+  }
+
+  std::filesystem::remove(file.string() + ".not");
+  std::filesystem::remove(file.string() + ".outside");
+  std::filesystem::remove(file);
+}
+
+TEST_CASE("streaming-results", "[simulation][streaming]") {
+  std::filesystem::path folder = std::filesystem::temp_directory_path() / "heraldns-streaming-test";
+  std::filesystem::remove_all(folder);
+
+  Scenario s(200, 1, 0.5, 10);
+  s.sim.seed(3);
+  auto results = std::make_shared<heraldns::intermediate::StreamingResults>(folder.string(), 2);
+  s.sim.runToCompletion(1, 4 * 60 * 60, results, 1); // 6 ticks, snapshots at 0, 2, 4, 6
+  REQUIRE(results->close());
+
+  std::ifstream ticks(folder / "ticks.csv");
+  std::vector<std::string> rows;
+  for (std::string row;std::getline(ticks, row);) {
+    rows.push_back(row);
+  }
+  REQUIRE(rows.size() == 1 + 7);
+  REQUIRE(rows[0] == "tick,minutes,well,ill,recovered,dead,everIll");
+  REQUIRE(rows[1] == "0,0,190,10,0,0,10");
+  REQUIRE(rows[7].rfind("6,1440,", 0) == 0);
+
+  // day rows agree with the simulation's own daily totals
+  std::ifstream days(folder / "days.csv");
+  std::string header;
+  std::getline(days, header);
+  for (std::size_t day = 0;day < s.sim.dailyCases().size();day++) {
+    uint64_t dayNumber, well, ill, recovered, dead, everIll;
+    char comma;
+    days >> dayNumber >> comma >> well >> comma >> ill >> comma >> recovered >> comma >> dead >> comma >> everIll;
+    REQUIRE(dayNumber == day);
+    REQUIRE(ill == s.sim.dailyCases()[day]);
+    REQUIRE(recovered == s.sim.dailyRecovered()[day]);
+    REQUIRE(well + ill + recovered + dead == 200);
+  }
+
+  // 4 snapshots, the last being the final state
+  const uint64_t snapshotSize = 16 + 200 * (4 + 4 + 1 + 8);
+  REQUIRE(std::filesystem::file_size(folder / "presences.bin") == 8 + 4 * snapshotSize);
+  std::ifstream presences(folder / "presences.bin", std::ios::binary);
+  presences.seekg(8 + 3 * snapshotSize);
+  uint64_t tick, count;
+  presences.read((char*)&tick, sizeof(tick));
+  presences.read((char*)&count, sizeof(count));
+  REQUIRE(tick == 6);
+  REQUIRE(count == 200);
+  std::vector<uint32_t> x(count);
+  presences.read((char*)x.data(), count * sizeof(uint32_t));
+  for (uint64_t id = 0;id < count;id++) {
+    REQUIRE(x[id] == s.pm.x(id));
+  }
+  std::vector<uint32_t> y(count);
+  std::vector<uint8_t> state(count);
+  presences.read((char*)y.data(), count * sizeof(uint32_t));
+  presences.read((char*)state.data(), count);
+  for (uint64_t id = 0;id < count;id++) {
+    REQUIRE(state[id] == (uint8_t)s.pm.state(id));
+  }
+
+  // far more callbacks than queued frames: each waits for the writer rather than queueing more
+  std::filesystem::remove_all(folder);
+  {
+    heraldns::intermediate::StreamingResults many(folder.string(), 1);
+    for (uint64_t t = 0;t < 20 * heraldns::intermediate::StreamingResults::MaxQueuedFrames;t++) {
+      many.intermediateResults(0, 0, s.pm, 1.0, t);
+    }
+    REQUIRE(many.close());
+  }
+  std::ifstream manyTicks(folder / "ticks.csv");
+  std::size_t manyRows = 0;
+  for (std::string row;std::getline(manyTicks, row);) {
+    manyRows++;
+  }
+  REQUIRE(manyRows == 1 + 20 * heraldns::intermediate::StreamingResults::MaxQueuedFrames);
+
+  // nothing is written to an unusable folder
+  std::ofstream((folder / "file").string()) << "not a folder";
+  heraldns::intermediate::StreamingResults unusable((folder / "file" / "results").string());
+  unusable.intermediateResults(0, 0, s.pm, 0.0, 0);
+  REQUIRE(!unusable.close());
+
+  std::filesystem::remove_all(folder);
+}
+
+TEST_CASE("simulation-benchmark", "[.][benchmark][simulation]") {
+  // Dense enough for every presence to have neighbours: one presence per two 1m cells
+  for (uint64_t presences : {10000, 100000, 1000000}) {
+    const uint64_t ticks = presences >= 1000000 ? 2 : (presences >= 100000 ? 5 : 20);
+    Scenario s(presences, 2, 1.0, presences / 100);
+    auto results = std::make_shared<RecordingResults>();
+    // One day over ticks ticks, with a callback only at the start and end
+    s.sim.runToCompletion(1, 24 * 60 * 60 / ticks, results, 1000000);
+    REQUIRE(results->received.size() == 2);
+    double seconds = std::chrono::duration<double>(results->received.back() - results->received.front()).count();
+    std::cout << "Simulation of " << presences << " presences on a " << s.grid->width() << "x" << s.grid->height()
+              << " grid: " << (ticks / seconds) << " ticks/s" << std::endl;
+  }
+
+  // Strong scaling: the same 100k presences on more threads
+  const unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+  double oneThread = 0.0;
+  for (unsigned int threads = 1;threads <= std::max(4u, hardware);threads *= 2) {
+    Scenario s(100000, 2, 1.0, 1000);
+    s.sim.seed(42);
+    s.sim.threads(threads);
+    auto results = std::make_shared<RecordingResults>();
+    s.sim.runToCompletion(1, 24 * 60 * 60 / 5, results, 1000000);
+    double seconds = std::chrono::duration<double>(results->received.back() - results->received.front()).count();
+    if (1 == threads) {
+      oneThread = seconds;
+    }
+    std::cout << "Simulation of 100000 presences on " << threads << " of " << hardware << " hardware threads: "
+              << (5 / seconds) << " ticks/s, speedup " << (oneThread / seconds) << std::endl;
+  }
+}
+
+TEST_CASE("streaming-results-benchmark", "[.][benchmark][streaming]") {
+  // Tick rate with a callback every tick, without and with streamed results and snapshots
+  std::filesystem::path folder = std::filesystem::temp_directory_path() / "heraldns-streaming-benchmark";
+  std::filesystem::remove_all(folder);
+  for (int streaming = 0;streaming < 2;streaming++) {
+    Scenario s(100000, 2, 1.0, 1000);
+    s.sim.seed(42);
+    auto timing = std::make_shared<RecordingResults>();
+    auto results = std::make_shared<heraldns::intermediate::StreamingResults>(folder.string(), 1);
+    struct Both : public IntermediateResultsListener {
+      void intermediateResults(uint64_t casesNow, uint64_t recoveredNow, const PresenceManager& pm,
+        double minutesPassed, uint64_t ticksComplete) override {
+        if (streaming) {
+          streaming->intermediateResults(casesNow, recoveredNow, pm, minutesPassed, ticksComplete);
+        }
+        timing->intermediateResults(casesNow, recoveredNow, pm, minutesPassed, ticksComplete);
+      }
+      std::shared_ptr<IntermediateResultsListener> streaming;
+      std::shared_ptr<RecordingResults> timing;
+    };
+    auto both = std::make_shared<Both>();
+    both->streaming = streaming ? results : nullptr;
+    both->timing = timing;
+    s.sim.runToCompletion(1, 24 * 60 * 60 / 10, both, 1);
+    double seconds = std::chrono::duration<double>(timing->received.back() - timing->received.front()).count();
+    auto closing = std::chrono::steady_clock::now();
+    REQUIRE(results->close());
+    double closeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - closing).count();
+    std::cout << "Simulation of 100000 presences " << (streaming ? "with" : "without")
+              << " streamed results and snapshots every tick: " << (10 / seconds) << " ticks/s, "
+              << closeSeconds << "s to finish writing" << std::endl;
+  }
+  std::filesystem::remove_all(folder);
+}
+
+TEST_CASE("checkpoint-benchmark", "[.][benchmark][checkpoint]") {
+  std::filesystem::path file = std::filesystem::temp_directory_path() / "heraldns-checkpoint-benchmark.bin";
+  Scenario s(1000000, 2, 1.0, 10000);
+  s.sim.seed(42);
+  s.sim.runToCompletion(1, 24 * 60 * 60 / 2);
+  for (int run = 0;run < 3;run++) {
+    auto started = std::chrono::steady_clock::now();
+    REQUIRE(s.sim.writeCheckpoint(file.string()));
+    double writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    Scenario resumed(1000000, 2, 1.0, 10000);
+    resumed.sim.verbose(false);
+    started = std::chrono::steady_clock::now();
+    REQUIRE(resumed.sim.resume(file.string())); // already complete, so restores only
+    double readSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "Checkpoint of 1000000 presences: " << std::filesystem::file_size(file) << " bytes, written in "
+              << writeSeconds << "s, restored in " << readSeconds << "s" << std::endl;
+  }
+  std::filesystem::remove(file);
+}
@@ -5,24 +5,25 @@
 #ifndef GRID_H
 #define GRID_H
 
+#include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <memory>
 #include <vector>
 
 namespace heraldns {
 namespace datatype {
 
-class Presence; // fwd decl
 class PresenceManager; // fwd decl
+class Grid; // fwd decl
 
+/// \brief A copy of a cell's position and the presences in it
 class Cell {
 public:
   Cell(uint64_t x, uint64_t y); // randomise properties
+  Cell(uint64_t x, uint64_t y, std::vector<uint64_t> present);
   ~Cell() = default;
 
-  void movedIn(uint64_t arrival);
-  void movedOut(uint64_t leaver);
-
   uint64_t x() const;
   uint64_t y() const;
 
@@ -34,16 +35,55 @@ private:
   std::vector<uint64_t> m_present;
 };
 
+/**
+ * Presence ids sorted by cell, rebuilt with a counting sort after presences move.
+ * Cells are identified by Grid::key(), which numbers the cells of each tile a row at a
+ * time, so a row of cells within a tile is one contiguous range of ids. Ids within a
+ * cell are in ascending order. Holds up to 2^32 presences.
+ */
+class CellIndex {
+public:
+  CellIndex();
+  ~CellIndex() = default;
+
+  void rebuild(const PresenceManager& pm, const Grid& grid);
+
+  // Ids of the presences in the cell with key
+  const uint32_t* begin(uint64_t key) const { return m_ids.data() + m_start[key]; }
+  const uint32_t* end(uint64_t key) const { return m_ids.data() + m_start[key + 1]; }
+
+private:
+  std::vector<uint32_t> m_start; // first index in m_ids per cell key, plus the end
+  std::vector<uint32_t> m_ids;
+};
+
+/**
+ * Cells in square tiles of TileSide cells. A tile is only created when a presence first
+ * moves into it, so memory is proportional to the area presences have visited rather
+ * than the size of the grid.
+ *
+ * The presences in each cell are held in a block of a shared arena, doubling in size as
+ * it fills and returned to a free list when the cell empties.
+ */
 class Grid {
 public:
+  static constexpr uint64_t TileSide = 64;
+  static constexpr uint64_t TileCells = TileSide * TileSide;
+  static constexpr uint32_t NoTile = std::numeric_limits<uint32_t>::max();
+
   Grid(std::uint64_t width,std::uint64_t height, double cellSeparationMetres);
   ~Grid() = default;
 
-  void randomisePositions(const PresenceManager& pm) const;
+  void randomisePositions(PresenceManager& pm);
+  void randomisePositions(PresenceManager& pm, uint64_t seed); // same seed, same positions
+
+  // Moves a presence out of its current cell, if placed, and into the cell at x,y.
+  // Does nothing if already in that cell.
+  void moveTo(PresenceManager& pm, uint64_t id, uint64_t x, uint64_t y);
 
   double separation() const;
 
-  std::shared_ptr<Cell> cell(uint64_t x, uint64_t y) const;
+  std::shared_ptr<Cell> cell(uint64_t x, uint64_t y) const; // a copy
 
   uint64_t height() const;
 
@@ -51,11 +91,43 @@ public:
 
   double distance(const std::shared_ptr<Cell>& c1, const std::shared_ptr<Cell>& c2) const;
 
+  // TILES
+  uint64_t tiles() const; // created so far
+  // Index of the tile at tileX,tileY among those created, or NoTile
+  uint32_t tile(uint64_t tileX, uint64_t tileY) const { return m_tiles[tileX + (tileY * m_tilesWide)]; }
+  // The cell's CellIndex key. Its tile must have been created.
+  uint64_t key(uint64_t x, uint64_t y) const {
+    return (tile(x / TileSide, y / TileSide) * TileCells) + ((y % TileSide) * TileSide) + (x % TileSide);
+  }
+
+  // Rebuilds every cell's presences from their restored positions and cell indexes.
+  // returns false if the positions are outside the grid or the indexes inconsistent.
+  bool restore(PresenceManager& pm);
+
+  // Sorts presences by cell for neighbour queries. Call after moving presences.
+  void reindex(const PresenceManager& pm);
+  const CellIndex& index() const;
+
 private:
+  struct Occupancy {
+    uint32_t offset; // of the cell's block in m_arena
+    uint32_t count;
+    uint32_t capacity; // 0, or a power of 2
+  };
+
+  Occupancy& occupancy(uint64_t x, uint64_t y); // creating the tile if need be
+  uint32_t add(uint64_t id, uint64_t x, uint64_t y); // returns index in the cell
+  void release(Occupancy& cell);
+
   uint64_t m_width;
   uint64_t m_height;
-  std::vector<std::shared_ptr<Cell>> m_cells; // row (width) then column (height)
   double m_separation;
+  uint64_t m_tilesWide;
+  std::vector<uint32_t> m_tiles; // per tile, row (width) then column (height)
+  std::vector<Occupancy> m_cells; // TileCells per created tile, a row of cells at a time
+  std::vector<uint32_t> m_arena; // presence ids
+  std::vector<std::vector<uint32_t>> m_free; // offsets of free blocks, by log2 of capacity
+  CellIndex m_index;
 };
 
 } // end namespace
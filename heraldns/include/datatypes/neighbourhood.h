@@ -0,0 +1,76 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef NEIGHBOURHOOD_H
+#define NEIGHBOURHOOD_H
+
+#include "grid.h"
+#include "presence.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace heraldns {
+namespace datatype {
+
+/**
+ * The box of cells within a radius of a presence's cell, with the inverse square
+ * distance weight of each cell precomputed. Weights are 1 within 1 metre, as all
+ * risk incurred under 1 m is the same.
+ */
+class Neighbourhood {
+public:
+  Neighbourhood(const Grid& grid, double radiusMetres);
+  ~Neighbourhood() = default;
+
+  uint64_t radius() const; // in cells
+  double weight(int64_t dx, int64_t dy) const; // for a cell dx,dy cells away, within radius
+
+  // Calls fn(otherId, weight) for every other presence in the box, using the grid's
+  // current index. Rows are read in order, each as one contiguous range of the index per tile.
+  template <typename Fn>
+  void forEach(const Grid& grid, const PresenceManager& pm, uint64_t id, Fn&& fn) const {
+    const CellIndex& index = grid.index();
+    const int64_t r = (int64_t)m_radius;
+    const int64_t x = pm.x(id);
+    const int64_t y = pm.y(id);
+    const int64_t minX = std::max<int64_t>(0, x - r);
+    const int64_t maxX = std::min<int64_t>((int64_t)grid.width() - 1, x + r);
+    const int64_t minY = std::max<int64_t>(0, y - r);
+    const int64_t maxY = std::min<int64_t>((int64_t)grid.height() - 1, y + r);
+    const int64_t side = (int64_t)Grid::TileSide;
+    for (int64_t cy = minY;cy <= maxY;cy++) {
+      const double* rowWeights = m_weights.data() + ((cy - y + r) * m_side) + (minX - x + r);
+      for (int64_t from = minX;from <= maxX;) {
+        const int64_t tileX = from / side;
+        const int64_t to = std::min(maxX, ((tileX + 1) * side) - 1);
+        const uint32_t tile = grid.tile(tileX, cy / side);
+        if (Grid::NoTile != tile) {
+          // key of cx in this tile's row
+          const uint64_t row = (tile * Grid::TileCells) + ((cy % side) * side) - (tileX * side);
+          for (int64_t cx = from;cx <= to;cx++) {
+            const double w = rowWeights[cx - minX];
+            for (const uint32_t* other = index.begin(row + cx), *last = index.end(row + cx);other != last;++other) {
+              if (*other != id) {
+                fn((uint64_t)*other, w);
+              }
+            }
+          }
+        }
+        from = to + 1;
+      }
+    }
+  }
+
+private:
+  uint64_t m_radius;
+  int64_t m_side; // 2 * radius + 1
+  std::vector<double> m_weights; // row (dy) then column (dx), from -radius
+};
+
+} // end namespace
+} // end namespace
+
+#endif
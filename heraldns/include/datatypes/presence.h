@@ -9,111 +9,125 @@
 #include "grid.h"
 
 #include <cstdint>
+#include <limits>
 #include <memory>
 #include <vector>
-#include <optional>
 
 namespace heraldns {
 namespace datatype {
 
-enum class State : int {
+enum class State : std::uint8_t {
   Well, Ill, Recovered, Dead
 };
 
 /**
- * Base class for people, static items, etc.
+ * Holds the state of every person, static item, etc. in the simulation.
+ *
+ * Each property is a contiguous array indexed by presence id (0 to size()-1),
+ * so a pass over the population reads only the properties it uses.
+ *
+ * As in a simulation tick, 'new' values are calculated from the current values
+ * of every presence and only become current when commitChanges() is called.
  */
-class Presence {
+class PresenceManager {
 public:
-  Presence(std::uint64_t id);
-  virtual ~Presence() = default;
+  /// \brief x and y of a presence not yet placed on a Grid
+  static constexpr uint32_t Unplaced = std::numeric_limits<uint32_t>::max();
 
-  // BEHAVIOUR SETTINGS
-  void flightiness(double flightiness); // How likely it is that a person generally moves about
-  double flightiness();
+  PresenceManager(uint64_t count);
+  ~PresenceManager() = default;
 
+  uint64_t size() const;
 
-  // ACTUAL STATE TRACKING
+  // BEHAVIOUR SETTINGS
+  // How likely it is that a person generally moves about
+  void flightiness(uint64_t id, double flightiness) { m_flightiness[id] = flightiness; }
+  double flightiness(uint64_t id) const { return m_flightiness[id]; }
 
-  uint64_t id() const;
 
-  uint64_t lastFellIll() const; // 0 if never
-  bool hasEverBeenIll() const;
-  double highestRiskScore() const;
-  uint64_t lastRecovered() const;
+  // ACTUAL STATE TRACKING
 
-  State state() const;
-  void newState(State newState, uint64_t atTick);
+  uint64_t lastFellIll(uint64_t id) const { return m_lastFellIll[id]; } // 0 if never
+  bool hasEverBeenIll(uint64_t id) const { return 0 != m_hasEverBeenIll[id]; }
+  double highestRiskScore(uint64_t id) const { return m_highestRiskScore[id]; }
+  uint64_t lastRecovered(uint64_t id) const { return m_lastRecovered[id]; }
 
-  std::shared_ptr<Cell> position() const;
-  void moveTo(std::shared_ptr<Cell> newPlace); // will remove presence from current cell (will call cell function to ensure this), then will move to the newPlace.
+  State state(uint64_t id) const { return m_state[id]; }
+  void newState(uint64_t id, State newState, uint64_t atTick);
 
+  // Grid cell. Only Grid moves presences, so that cells know who is present.
+  bool placed(uint64_t id) const { return Unplaced != m_x[id]; }
+  uint32_t x(uint64_t id) const { return m_x[id]; }
+  uint32_t y(uint64_t id) const { return m_y[id]; }
 
 
   // ACTUAL TRANSMISSION MODEL TRACKING
-  double transmissionModelScore() const;
+  double transmissionModelScore(uint64_t id) const { return m_transmissionModelScore[id]; }
   // For *actual* illness tracking exposed to
-  double newTransmissionModelScore() const;
-  void newTransmissionModelScore(double riskMinutes);
+  double newTransmissionModelScore(uint64_t id) const { return m_newTransmissionModelScore[id]; }
+  void newTransmissionModelScore(uint64_t id, double riskMinutes) { m_newTransmissionModelScore[id] = riskMinutes; }
 
 
   // SOCIAL MIXING SCORE APPROXIMATION SCORING
-  double risk() const; // Current risk - 0-1
+  double risk(uint64_t id) const { return m_currentRisk[id]; } // Current risk - 0-1
 
   // Calculated Risk Score using the current formula
-  double newRisk(); // current risk prior to commital - 0-1
-  void newRisk(double newRisk); // modify new risk prior to committal - 0-1
+  double newRisk(uint64_t id) const { return m_newRisk[id]; } // current risk prior to commital - 0-1
+  void newRisk(uint64_t id, double newRisk) { m_newRisk[id] = newRisk; } // modify new risk prior to committal - 0-1
 
-  // Calculated risk number the social mixing function may transmit to other phones 
-  double transmittedRisk() const;
+  // Calculated risk number the social mixing function may transmit to other phones
+  double transmittedRisk(uint64_t id) const { return m_currentTransmittedRisk[id]; }
 
-  double newTransmittedRisk() const;
-  void newTransmittedRisk(double newT);
+  double newTransmittedRisk(uint64_t id) const { return m_newTransmittedRisk[id]; }
+  void newTransmittedRisk(uint64_t id, double newT) { m_newTransmittedRisk[id] = newT; }
 
   // STATE CHANGES
-  void commitChanges(); // Move 'newRisk' to 'Risk' (at end of this sim 'turn')
+  void commitChanges(uint64_t id); // Move 'newRisk' to 'Risk' (at end of this sim 'turn')
+  void commitChanges(); // For every presence
+
+  // CHECKPOINTS
+  struct Column {
+    const char* name;
+    void* data;
+    uint64_t bytes;
+  };
+  // Every property array, to save or restore as a whole. Restoring positions does not
+  // update Grid cells, so call Grid::restore() afterwards.
+  std::vector<Column> columns();
 
 private:
-  const uint64_t m_id;
-  
-  double m_currentRisk;
-  double m_newRisk;
-
-  double m_currentTransmittedRisk;
-  double m_newTransmittedRisk;
+  friend class Grid;
 
-  double m_flightiness;
+  void place(uint64_t id, uint32_t x, uint32_t y) { m_x[id] = x; m_y[id] = y; }
 
-  std::optional<std::shared_ptr<Cell>> m_position;
+  std::vector<uint32_t> m_x;
+  std::vector<uint32_t> m_y;
+  std::vector<uint32_t> m_cellIndex; // index in its Cell's present() list
 
-  State m_state;
-  State m_newState;
+  std::vector<State> m_state;
+  std::vector<State> m_newState;
 
-  double m_transmissionModelScore;
-  double m_newTransmissionModelScore;
+  std::vector<double> m_currentRisk;
+  std::vector<double> m_newRisk;
 
-  // current state metrics
-  uint64_t m_lastFellIll;
-  uint64_t m_lastRecovered;
+  std::vector<double> m_currentTransmittedRisk;
+  std::vector<double> m_newTransmittedRisk;
 
-  // for all time metrics
-  bool m_hasEverBeenIll;
-  double m_highestRiskScore;
-};
+  std::vector<double> m_transmissionModelScore;
+  std::vector<double> m_newTransmissionModelScore;
 
-class PresenceManager {
-public:
-  PresenceManager(uint64_t count);
-  ~PresenceManager() = default;
+  std::vector<double> m_flightiness;
 
-  uint64_t size() const;
-  std::shared_ptr<Presence> get(uint64_t id) const;
+  // current state metrics (ticks)
+  std::vector<uint64_t> m_lastFellIll;
+  std::vector<uint64_t> m_lastRecovered;
 
-private:
-  std::vector<std::shared_ptr<Presence>> actors;
+  // for all time metrics
+  std::vector<uint8_t> m_hasEverBeenIll; // not vector<bool>, so separate ids can be written concurrently
+  std::vector<double> m_highestRiskScore;
 };
 
 } // end namespace
 } // end namespace
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,49 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstdint>
+#include <vector>
+
+namespace heraldns {
+namespace datatype {
+
+/**
+ * Ids scheduled for a future tick, held in a ring of slots with one slot per tick.
+ * Scheduling is O(1) and taking a tick's ids reads only that tick's slot, so the cost
+ * per tick is the number of ids due, not the number scheduled.
+ *
+ * An id scheduled more than slots() ticks ahead waits in its slot for later turns of
+ * the ring. Ids due in a tick are returned in the order they were scheduled.
+ */
+class TimerWheel {
+public:
+  TimerWheel(uint64_t slots);
+  ~TimerWheel() = default;
+
+  uint64_t slots() const;
+  uint64_t size() const; // ids scheduled
+
+  void clear();
+  void schedule(uint64_t tick, uint64_t id);
+  // Appends the ids scheduled for tick, or an earlier tick in the same slot, to due and
+  // removes them. Call for every tick in turn so none are missed.
+  void take(uint64_t tick, std::vector<uint64_t>& due);
+
+private:
+  struct Timer {
+    uint64_t tick;
+    uint64_t id;
+  };
+
+  std::vector<std::vector<Timer>> m_slots;
+  uint64_t m_size;
+};
+
+} // end namespace
+} // end namespace
+
+#endif
@@ -9,11 +9,18 @@
 
 // datatypes namespace
 #include "datatypes/grid.h"
+#include "datatypes/neighbourhood.h"
 #include "datatypes/presence.h"
+#include "datatypes/timer_wheel.h"
 #include "intermediate/stdout_intermediate_results.h"
+#include "intermediate/streaming_results.h"
 #include "mixing/direct_mixing.h"
 #include "providers/intermediate_results.h"
 #include "providers/social_mixing.h"
 #include "providers/transmission.h"
+#include "simulator/checkpoint.h"
+#include "simulator/counter_rng.h"
+#include "simulator/ensemble.h"
 #include "simulator/simulator.h"
+#include "simulator/tick_executor.h"
 #include "transmission/basic_transmission.h"
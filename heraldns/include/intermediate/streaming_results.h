@@ -0,0 +1,98 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef STREAMING_RESULTS_H
+#define STREAMING_RESULTS_H
+
+#include "../providers/intermediate_results.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace heraldns {
+namespace intermediate {
+
+using namespace heraldns::providers;
+
+/**
+ * Streams results to files in an output folder as a simulation runs.
+ *
+ * Each callback copies the presence properties it needs into a frame and hands it to
+ * a background thread, which aggregates and writes it. Frames are reused once written.
+ * At most MaxQueuedFrames wait to be written: a callback finding the queue full waits for
+ * the background thread (backpressure), so a slow disk slows the simulation rather than
+ * growing memory without limit.
+ *
+ * Files written:-
+ * - ticks.csv: tick,minutes,well,ill,recovered,dead,everIll - one row per callback
+ *   (So per tick when run with ticksPerCallback = 1)
+ * - days.csv: day,well,ill,recovered,dead,everIll - the first callback at or after the end of each day. Day 0 = initial state.
+ * - presences.bin: only if ticksPerSnapshot > 0. Every presence's state, in columns, at
+ *   the first callback at or after each multiple of ticksPerSnapshot ticks. Native byte order:-
+ *     file header: char[4] "HNSP", uint32 version (1)
+ *     per snapshot: uint64 tick, uint64 count,
+ *                   uint32 x[count], uint32 y[count], uint8 state[count], double risk[count]
+ */
+class StreamingResults : public IntermediateResultsListener {
+public:
+  static constexpr std::size_t MaxQueuedFrames = 4;
+
+  StreamingResults(std::string outputFolder, uint64_t ticksPerSnapshot = 0);
+  StreamingResults(const StreamingResults&) = delete;
+  StreamingResults& operator=(const StreamingResults&) = delete;
+  ~StreamingResults(); // calls close()
+
+  void intermediateResults(uint64_t, uint64_t,
+    const PresenceManager& pm,
+    double minutesPassed, uint64_t ticksComplete) override;
+
+  // Writes all outstanding frames and closes the files. Returns success = true.
+  bool close() noexcept;
+
+private:
+  struct Frame {
+    uint64_t tick;
+    double minutes; // since the start
+    std::vector<uint8_t> state; // State, as written to presences.bin
+    std::vector<uint8_t> everIll;
+    bool snapshot;
+    std::vector<uint32_t> x;
+    std::vector<uint32_t> y;
+    std::vector<double> risk;
+  };
+
+  void write(); // background thread
+  void write(const Frame& frame);
+
+  std::string m_outputFolder;
+  uint64_t m_ticksPerSnapshot;
+  double m_minutes; // since the start
+  uint64_t m_nextSnapshot; // tick
+
+  std::ofstream m_ticksFile;
+  std::ofstream m_daysFile;
+  std::ofstream m_presencesFile;
+  uint64_t m_nextDay; // next day to write, for the background thread
+  bool m_failed;
+
+  std::mutex m_lock; // Below, shared with the background thread
+  std::condition_variable m_queued;
+  std::condition_variable m_dequeued;
+  std::deque<std::unique_ptr<Frame>> m_queue;
+  std::vector<std::unique_ptr<Frame>> m_free;
+  bool m_closing;
+  std::thread m_writer;
+};
+
+} // end namespace
+} // end namespace
+
+#endif
@@ -7,6 +7,7 @@
 #define DIRECT_MIXING_H
 
 #include "../providers/social_mixing.h"
+#include "../datatypes/neighbourhood.h"
 
 #include <cstdint>
 #include <memory>
@@ -19,17 +20,18 @@ using namespace heraldns::providers;
 
 class DirectMixingScoreProvider : public SocialMixingScoreProvider {
 public:
-  DirectMixingScoreProvider(const PresenceManager& pm, std::shared_ptr<Grid> grid, double initialScore, double dropOffPerDay);
+  DirectMixingScoreProvider(PresenceManager& pm, std::shared_ptr<Grid> grid, double initialScore, double dropOffPerDay);
   ~DirectMixingScoreProvider() = default;
 
-  void initialiseRiskScore(std::shared_ptr<Presence> presence);
-  void calculateNewRiskScore(std::shared_ptr<Presence> presence, double minutesPassed);
+  void initialiseRiskScore(uint64_t presence) override;
+  void calculateNewRiskScore(uint64_t presence, double minutesPassed) override;
 
 private:
-  const PresenceManager& m_pm;
+  PresenceManager& m_pm;
   double m_initial;
   double m_dropoffPerMinute; // more efficient
   std::shared_ptr<Grid> m_grid;
+  Neighbourhood m_neighbourhood; // within 8 metres
 };
 
 } // end namespace
@@ -22,8 +22,16 @@ public:
   SocialMixingScoreProvider() = default;
   virtual ~SocialMixingScoreProvider() = default;
 
-  virtual void initialiseRiskScore(std::shared_ptr<Presence> presence) = 0;
-  virtual void calculateNewRiskScore(std::shared_ptr<Presence> presence, double minutesPassed) = 0;
+  // Presences are identified by their index in the PresenceManager the provider was created with.
+  // calculateNewRiskScore is called concurrently for different presences, so must only
+  // modify the new risk values of the presence given.
+  virtual void initialiseRiskScore(uint64_t presence) = 0;
+  virtual void calculateNewRiskScore(uint64_t presence, double minutesPassed) = 0;
+
+  // State held outside the PresenceManager, saved in a Simulation checkpoint and restored
+  // before resuming. None by default. restoreState returns success = true
+  virtual std::vector<uint64_t> checkpointState() const { return {}; }
+  virtual bool restoreState(const std::vector<uint64_t>& state) { return state.empty(); }
 };
 
 }
@@ -22,9 +22,21 @@ public:
   TransmissionModelProvider() = default;
   virtual ~TransmissionModelProvider() = default;
 
-  virtual void initialiseInfectionState(std::shared_ptr<Presence> presence) = 0;
-  virtual void determineInfectionState(std::shared_ptr<Presence> presence, double minutesPassed, 
+  // Presences are identified by their index in the PresenceManager the provider was created with.
+  // determineInfectionState is called concurrently for different presences, so must only
+  // modify the new state of the presence given.
+  virtual void initialiseInfectionState(uint64_t presence) = 0;
+  virtual void determineInfectionState(uint64_t presence, double minutesPassed, 
     uint64_t tick) = 0;
+  // Fills active with the presences whose state may change at tick. Called once per tick, on
+  // one thread, after presences move and before determineInfectionState is called for each
+  // presence in active. Returns false if any presence may change, so all are determined.
+  virtual bool activePresences(uint64_t, std::vector<uint64_t>&) { return false; }
+
+  // State held outside the PresenceManager, saved in a Simulation checkpoint and restored
+  // before resuming. None by default. restoreState returns success = true
+  virtual std::vector<uint64_t> checkpointState() const { return {}; }
+  virtual bool restoreState(const std::vector<uint64_t>& state) { return state.empty(); }
 };
 
 }
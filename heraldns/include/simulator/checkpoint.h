@@ -0,0 +1,68 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace heraldns {
+namespace simulator {
+
+/**
+ * A file of named columns of bytes, laid out so the file may be memory mapped:-
+ *   header:    char[4] "HNSC", uint32 version (1), uint64 column count
+ *   directory: per column char[24] name, uint64 offset, uint64 bytes
+ *   columns:   each starting on a 64 byte boundary, in native byte order
+ *
+ * Columns are written straight from, and read straight into, the caller's arrays.
+ */
+class Checkpoint {
+public:
+  static constexpr std::size_t NameLength = 24; // including the terminating 0
+  static constexpr uint64_t Alignment = 64;
+
+  Checkpoint() = default;
+  ~Checkpoint() = default;
+
+  // WRITING
+  // Adds a column to write. data must remain valid until write().
+  void add(const std::string& name, const void* data, uint64_t bytes);
+  // Writes every column added to a temporary file, syncs it to disk, then renames it to path
+  // and syncs the directory, so an existing checkpoint at path is only replaced by a complete
+  // one, even after a power failure. returns success = true
+  bool write(const std::string& path) noexcept;
+
+  // READING
+  bool open(const std::string& path) noexcept; // reads the directory. returns success = true
+  bool has(const std::string& name) const;
+  uint64_t bytes(const std::string& name) const; // 0 if not present
+  // Reads a column of exactly bytes into data. returns success = true
+  bool read(const std::string& name, void* data, uint64_t bytes) noexcept;
+
+  // Size of the file last written or opened
+  uint64_t fileSize() const;
+
+private:
+  struct Column {
+    std::string name;
+    const void* data; // when writing
+    uint64_t offset;
+    uint64_t bytes;
+  };
+
+  const Column* find(const std::string& name) const;
+
+  std::vector<Column> m_columns;
+  std::ifstream m_in;
+  uint64_t m_fileSize = 0;
+};
+
+} // end namespace
+} // end namespace
+
+#endif
@@ -0,0 +1,66 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef COUNTER_RNG_H
+#define COUNTER_RNG_H
+
+#include <array>
+#include <cstdint>
+
+namespace heraldns {
+namespace simulator {
+
+/**
+ * Philox4x32-10 counter based random number generator, as described in Salmon et al.,
+ * "Parallel Random Numbers: As Easy as 1, 2, 3" (SC11).
+ *
+ * Each block of random numbers is a pure function of the seed and a counter made from
+ * a presence id and tick, so every presence's numbers for a tick are the same whichever
+ * thread draws them, in whatever order. There is no state to share or to save.
+ */
+class CounterRng {
+public:
+  using Block = std::array<uint32_t,4>;
+
+  CounterRng(uint64_t seed);
+  ~CounterRng() = default;
+
+  uint64_t seed() const;
+
+  // Random numbers for a presence at a tick
+  Block block(uint64_t id, uint64_t tick) const {
+    return philox({(uint32_t)id, (uint32_t)(id >> 32), (uint32_t)tick, (uint32_t)(tick >> 32)}, m_key);
+  }
+
+  // Steps of -1, 0 or +1 in x and y for presences [from,to) at a tick, one block each.
+  // A simple loop over ids, so the compiler can vectorise it.
+  void steps(uint64_t tick, uint64_t from, uint64_t to, int8_t* dx, int8_t* dy) const;
+
+  static Block philox(Block counter, std::array<uint32_t,2> key) {
+    for (int round = 0;round < 10;round++) {
+      if (round > 0) {
+        key[0] += 0x9E3779B9; // golden ratio
+        key[1] += 0xBB67AE85; // sqrt(3) - 1
+      }
+      const uint64_t p0 = (uint64_t)0xD2511F53 * counter[0];
+      const uint64_t p1 = (uint64_t)0xCD9E8D57 * counter[2];
+      counter = {(uint32_t)(p1 >> 32) ^ counter[1] ^ key[0], (uint32_t)p1,
+                 (uint32_t)(p0 >> 32) ^ counter[3] ^ key[1], (uint32_t)p0};
+    }
+    return counter;
+  }
+
+  // A uniformly distributed step of -1, 0 or +1 from 32 random bits
+  static int8_t step(uint32_t random) {
+    return (int8_t)(((uint64_t)random * 3) >> 32) - 1;
+  }
+
+private:
+  std::array<uint32_t,2> m_key;
+};
+
+} // end namespace
+} // end namespace
+
+#endif
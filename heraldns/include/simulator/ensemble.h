@@ -0,0 +1,114 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace heraldns {
+namespace simulator {
+
+// One set of simulation parameters. Defaults are those of the single run CLI.
+struct ScenarioSettings {
+  uint64_t presences = 100;
+  uint64_t width = 5;
+  uint64_t height = 5;
+  double separation = 0.5; // metres
+  uint64_t initialInfections = 25;
+  double initialRisk = 100;
+  double riskDropOffPerDay = 1.0 / 14.0;
+  uint64_t recoveryDays = 14;
+  uint64_t immunityDays = 90;
+  uint64_t days = 50;
+  uint64_t secondsPerTick = 300; // 1 to 86400
+};
+
+/**
+ * A sweep of scenarios, each run as a number of independent replicates.
+ *
+ * Read from a text file of 'name = value' lines. Blank lines and lines starting with
+ * # are ignored. A ScenarioSettings name may be given a comma separated list of values,
+ * and every combination of listed values is a scenario. Other names:-
+ * - replicates: runs per scenario
+ * - seed: the seed of every replicate's seed
+ * - threads: replicates run at once, 0 = one per hardware thread
+ * - output: folder for the results
+ */
+struct EnsembleSettings {
+  uint64_t replicates = 10;
+  uint64_t seed = 0;
+  unsigned int threads = 0;
+  std::string output = "ensemble";
+  std::vector<ScenarioSettings> scenarios; // one default scenario if none are read
+
+  // returns success = true, else sets error
+  static bool read(std::istream& in, EnsembleSettings& settings, std::string& error);
+};
+
+// Mean and 95% confidence interval of the mean for one day, over all replicates
+struct DailyBand {
+  double mean;
+  double low;
+  double high;
+};
+
+/**
+ * Runs every replicate of every scenario on a pool of threads. Each replicate has its
+ * own population, grid, providers and seed, so replicates share nothing while running.
+ *
+ * Results are written to the output folder as they complete:-
+ * - scenarios.csv: the settings of each scenario, at the start
+ * - replicates.csv: the cases and recovered per day of each replicate, as it completes
+ * - summary.csv: the DailyBand of cases and recovered per day of each scenario, as its last replicate completes
+ */
+class Ensemble {
+public:
+  Ensemble(EnsembleSettings settings);
+  ~Ensemble() = default;
+
+  bool run() noexcept; // returns success = true
+
+  // The seed of a replicate, from the ensemble seed
+  uint64_t seed(uint64_t scenario, uint64_t replicate) const;
+
+  // Results of the last run, per scenario
+  const std::vector<DailyBand>& cases(uint64_t scenario) const;
+  const std::vector<DailyBand>& recovered(uint64_t scenario) const;
+
+  // Runs one replicate, returning cases then recovered per day
+  static std::pair<std::vector<uint64_t>,std::vector<uint64_t>> runReplicate(const ScenarioSettings& scenario, uint64_t seed);
+
+  // Per day bands over series of equal length
+  static std::vector<DailyBand> bands(const std::vector<std::vector<uint64_t>>& series);
+
+private:
+  struct ScenarioResults {
+    std::vector<std::vector<uint64_t>> cases; // per replicate
+    std::vector<std::vector<uint64_t>> recovered;
+    uint64_t completed = 0;
+    std::vector<DailyBand> casesBands;
+    std::vector<DailyBand> recoveredBands;
+  };
+
+  void completed(uint64_t scenario, uint64_t replicate, std::pair<std::vector<uint64_t>,std::vector<uint64_t>>& series);
+
+  EnsembleSettings m_settings;
+  std::vector<ScenarioResults> m_results;
+
+  std::mutex m_lock; // results and output files
+  std::ofstream m_replicatesFile;
+  std::ofstream m_summaryFile;
+};
+
+} // end namespace
+} // end namespace
+
+#endif
@@ -10,6 +10,8 @@
 #include "../providers/social_mixing.h"
 #include "../providers/transmission.h"
 #include "../providers/intermediate_results.h"
+#include "counter_rng.h"
+#include "tick_executor.h"
 
 #include <cstdint>
 #include <memory>
@@ -25,7 +27,7 @@ using namespace heraldns::providers;
 
 class Simulation {
 public:
-  Simulation(std::shared_ptr<Grid> grid, const PresenceManager& pm,
+  Simulation(std::shared_ptr<Grid> grid, PresenceManager& pm,
              std::shared_ptr<SocialMixingScoreProvider> scoring,
              std::shared_ptr<TransmissionModelProvider> transmission);
   Simulation(const Simulation& from); // copy ctor
@@ -35,12 +37,40 @@ public:
   void runToCompletion(uint64_t days, uint64_t secondsPerTick, 
     std::shared_ptr<IntermediateResultsListener> callback, uint64_t ticksPerCallback); // for future UI
 
-  bool writeStandardResults(std::string outputFolder) noexcept; // returns success = true
+  // Continues the run saved in a checkpoint to completion. This simulation must have the same
+  // size of grid and population, and equivalent providers, as the one that wrote it. Returns
+  // false without running if the checkpoint cannot be restored.
+  bool resume(std::string checkpointFile);
+  bool resume(std::string checkpointFile,
+    std::shared_ptr<IntermediateResultsListener> callback, uint64_t ticksPerCallback);
+
+  // Writes the full state of the run, as of the last complete tick. returns success = true
+  bool writeCheckpoint(std::string checkpointFile) noexcept;
+
+  // daily.csv to outputFolder, final totals to stdout. returns success = true
+  bool writeStandardResults(std::string outputFolder) noexcept;
+
+  // Settings used from the next run. The same seed gives the same results on any number of threads.
+  void seed(uint64_t seed); // Initial positions and movement. Random by default.
+  void threads(unsigned int threads); // 0 = one per hardware thread. 1 by default.
+  void verbose(bool verbose); // Progress written to stdout. true by default.
+  // Places every presence at random. true by default. false only places unplaced presences at
+  // random, keeping those placed beforehand. E.g. in the populated parts of a large grid.
+  void placeAtRandom(bool placeAtRandom);
+  // Writes a checkpoint every ticksPerCheckpoint ticks, replacing the last. 0 = never, the default.
+  void checkpoints(std::string checkpointFile, uint64_t ticksPerCheckpoint);
+
+  // Results of the last run. Day 0 = initial values, day 1 = end of first day of simulation.
+  const std::vector<uint64_t>& dailyCases() const;
+  const std::vector<uint64_t>& dailyRecovered() const;
 
 private:
   // methods
   void reset(uint64_t days, uint64_t secondsPerTick); // resets the sim before beginning
   void tick(); // perform a single tick in the simulation
+  bool restore(std::string checkpointFile) noexcept; // instead of reset
+  void run(); // ticks until maxTicks
+  void run(std::shared_ptr<IntermediateResultsListener> callback, uint64_t ticksPerCallback);
 
   // initial settings
   std::shared_ptr<Grid> m_grid;
@@ -53,19 +83,29 @@ private:
   uint64_t maxTicks;
   double minutesPerTick;
 
+  // Presences per chunk of the risk and infection phases
+  static constexpr uint64_t ChunkSize = 1024;
+
   // Runtime variables
   uint64_t currentTick;
   uint64_t today; // day number. 0 = start
 
-  const PresenceManager& m_pm;
+  PresenceManager& m_pm;
 
   // results variables/aggregations that sit outside of an individual Presence
   std::vector<uint64_t> casesPerDay; // day 0 = initial values, day 1 = end of first day of simulation
   std::vector<uint64_t> recoveredPerDay;
   
-  std::random_device rd;  // Will be used to obtain a seed for the random number engine
-  std::mt19937 gen; // Standard mersenne_twister_engine seeded with rd()
-  std::uniform_int_distribution<int64_t> distrib;
+  bool m_verbose;
+  bool m_placeAtRandom;
+  CounterRng m_rng; // Keyed by the seed
+  std::unique_ptr<TickExecutor> m_executor;
+  std::vector<uint32_t> m_moveX; // Destination of each presence this tick
+  std::vector<uint32_t> m_moveY;
+  std::vector<uint64_t> m_active; // Presences whose infection state may change this tick
+
+  std::string m_checkpointFile;
+  uint64_t m_ticksPerCheckpoint;
 };
 
 } // end namespace
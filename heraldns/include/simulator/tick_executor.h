@@ -0,0 +1,53 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef TICK_EXECUTOR_H
+#define TICK_EXECUTOR_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace heraldns {
+namespace simulator {
+
+/**
+ * Runs each phase of a simulation tick over ranges of presence ids on a fixed pool of threads.
+ * The calling thread is thread 0, so a single thread executor starts no threads at all.
+ */
+class TickExecutor {
+public:
+  // 0 = one per hardware thread
+  TickExecutor(unsigned int threads);
+  TickExecutor(const TickExecutor&) = delete;
+  TickExecutor& operator=(const TickExecutor&) = delete;
+  ~TickExecutor();
+
+  unsigned int threads() const;
+
+  // Splits [0,count) into chunks of chunkSize that idle threads take in turn, balancing
+  // uneven work. For phases where each id's result does not depend on which thread ran it.
+  void forEachChunk(uint64_t count, uint64_t chunkSize, const std::function<void(uint64_t from, uint64_t to)>& fn);
+
+private:
+  void run(const std::function<void(unsigned int thread)>& job);
+  void work(unsigned int thread);
+
+  std::vector<std::thread> m_workers;
+  std::mutex m_lock;
+  std::condition_variable m_start;
+  std::condition_variable m_done;
+  const std::function<void(unsigned int thread)>* m_job; // current job, under m_lock
+  uint64_t m_generation; // incremented per job
+  unsigned int m_running; // workers yet to finish the current job
+  bool m_stopping;
+};
+
+} // end namespace
+} // end namespace
+
+#endif
@@ -7,6 +7,8 @@
 #define BASIC_TRANSMISSION_H
 
 #include "../providers/transmission.h"
+#include "../datatypes/neighbourhood.h"
+#include "../datatypes/timer_wheel.h"
 
 #include <cstdint>
 #include <memory>
@@ -17,22 +19,49 @@ namespace transmission {
 
 using namespace heraldns::providers;
 
+/**
+ * Ill presences recover ticksToRecover ticks after falling ill, and are immune until
+ * ticksForImmunity ticks after falling ill. Well presences fall ill after enough
+ * exposure in one tick to ill presences within 8 metres.
+ *
+ * Recovery and loss of immunity are scheduled on a TimerWheel when a presence falls ill
+ * or recovers, and exposure is only determined for well presences near an ill one, so
+ * the work per tick is proportional to the ill presences and their neighbours rather
+ * than the population.
+ */
 class BasicTransmissionModelProvider : public TransmissionModelProvider {
 public:
-  BasicTransmissionModelProvider(const PresenceManager& pm, std::shared_ptr<Grid> grid,
+  BasicTransmissionModelProvider(PresenceManager& pm, std::shared_ptr<Grid> grid,
     uint64_t ticksToRecover, uint64_t ticksForImmunity, uint64_t initialInfections);
   ~BasicTransmissionModelProvider() = default;
 
-  void initialiseInfectionState(std::shared_ptr<Presence> presence) override;
-  void determineInfectionState(std::shared_ptr<Presence> presence, double minutesPassed, uint64_t tick) override;
+  void initialiseInfectionState(uint64_t presence) override;
+  void determineInfectionState(uint64_t presence, double minutesPassed, uint64_t tick) override;
+  bool activePresences(uint64_t tick, std::vector<uint64_t>& active) override;
+
+  std::vector<uint64_t> checkpointState() const override;
+  bool restoreState(const std::vector<uint64_t>& state) override;
 
 private:
-  const PresenceManager& m_pm;
+  PresenceManager& m_pm;
   std::shared_ptr<Grid> m_grid;
+  Neighbourhood m_neighbourhood; // within 8 metres
   uint64_t m_ticksToRecover;
   uint64_t m_ticksForImmunity;
   uint64_t m_initialInfections;
   uint64_t m_assignedInfections;
+
+  void rebuild(uint64_t tick); // from the presences' states, at the start of a run or after a restore
+  void fellIll(uint64_t id);
+  void recovered(uint64_t id);
+
+  TimerWheel m_transitions; // Ill to Recovered, and Recovered to Well
+  std::vector<uint64_t> m_ill;
+  std::vector<uint32_t> m_illIndex; // index in m_ill, per presence
+  std::vector<uint8_t> m_exposed; // already active this tick, per presence
+  std::vector<uint64_t> m_active; // last tick's active presences
+  std::vector<State> m_activeStates; // and their states before it
+  uint64_t m_nextTick; // tick expected by activePresences, else it rebuilds
 };
 
 } // end namespace
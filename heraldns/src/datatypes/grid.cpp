@@ -4,6 +4,7 @@
 
 #include "../../heraldns.h"
 
+#include <algorithm>
 #include <iostream>
 #include <random>
 
@@ -19,22 +20,10 @@ Cell::Cell(uint64_t x, uint64_t y)
   ;
 }
 
-void
-Cell::movedIn(uint64_t arrival)
+Cell::Cell(uint64_t x, uint64_t y, std::vector<uint64_t> present)
+  : xPos(x), yPos(y), m_present(std::move(present))
 {
-  m_present.push_back(arrival);
-}
-
-void
-Cell::movedOut(uint64_t leaver)
-{
-  auto result = std::find(m_present.begin(), m_present.end(), leaver);
-  if (result != m_present.end()) {
-    m_present.erase(result);
-    
-    //std::swap(*result, m_present.back());
-    //m_present.pop_back();
-  }
+  ;
 }
 
 uint64_t
@@ -59,33 +48,93 @@ Cell::present() const
 
 
 
-Grid::Grid(std::uint64_t width,std::uint64_t height, double cellSeparationMetres)
-  : m_width(width), m_height(height), m_cells(), m_separation(cellSeparationMetres)
-{
-  // add new cell instances
-  uint64_t cellCount = width * height;
-  m_cells.reserve(cellCount);
-  for (uint64_t y = 0;y < height;y++) {
-    for (uint64_t x = 0;x < width;x++) {
-      m_cells.push_back(std::make_shared<Cell>(x,y));
+CellIndex::CellIndex()
+  : m_start(), m_ids()
+{
+  ;
+}
+
+void
+CellIndex::rebuild(const PresenceManager& pm, const Grid& grid)
+{
+  const uint64_t count = pm.size();
+  m_start.assign((grid.tiles() * Grid::TileCells) + 1, 0);
+  // count per cell, shifted by one so the prefix sum gives each cell's start
+  for (uint64_t id = 0;id < count;id++) {
+    if (pm.placed(id)) {
+      m_start[grid.key(pm.x(id), pm.y(id)) + 1]++;
     }
   }
+  for (uint64_t cell = 1;cell < m_start.size();cell++) {
+    m_start[cell] += m_start[cell - 1];
+  }
+  m_ids.resize(m_start.back());
+  // place in id order, using the cell's start as its next free slot then shifting back
+  for (uint64_t id = 0;id < count;id++) {
+    if (pm.placed(id)) {
+      m_ids[m_start[grid.key(pm.x(id), pm.y(id))]++] = (uint32_t)id;
+    }
+  }
+  for (uint64_t cell = m_start.size() - 1;cell > 0;cell--) {
+    m_start[cell] = m_start[cell - 1];
+  }
+  m_start[0] = 0;
+}
+
+
+
+
+
+Grid::Grid(std::uint64_t width,std::uint64_t height, double cellSeparationMetres)
+  : m_width(width), m_height(height), m_separation(cellSeparationMetres),
+    m_tilesWide((width + TileSide - 1) / TileSide),
+    m_tiles(m_tilesWide * ((height + TileSide - 1) / TileSide), NoTile),
+    m_cells(), m_arena(), m_free(33), m_index()
+{
+  // tiles are created as presences move in
 }
 
 void
-Grid::randomisePositions(const PresenceManager& pm) const
+Grid::randomisePositions(PresenceManager& pm)
 {
   std::random_device rd;  //Will be used to obtain a seed for the random number engine
-  std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
-  std::uniform_int_distribution<std::size_t> distrib(0, m_cells.size() - 1);
+  randomisePositions(pm, ((uint64_t)rd() << 32) | rd());
+}
+
+void
+Grid::randomisePositions(PresenceManager& pm, uint64_t seed)
+{
+  std::mt19937_64 gen(seed);
+  std::uniform_int_distribution<uint64_t> distrib(0, (m_width * m_height) - 1);
 
   for (uint64_t id = 0;id < pm.size();id++) {
-    auto actor = pm.get(id);
-    const std::shared_ptr<Cell>& pos = m_cells[distrib(gen)];
-    actor->moveTo(pos);
+    uint64_t index = distrib(gen);
+    moveTo(pm, id, index % m_width, index / m_width);
   }
 }
 
+void
+Grid::moveTo(PresenceManager& pm, uint64_t id, uint64_t x, uint64_t y)
+{
+  if (pm.placed(id)) {
+    if (pm.x(id) == x && pm.y(id) == y) {
+      return;
+    }
+    // O(1): the presence's index in its cell is kept with its position, and the last
+    // presence in the cell takes its place
+    Occupancy& from = occupancy(pm.x(id), pm.y(id));
+    uint32_t index = pm.m_cellIndex[id];
+    uint32_t moved = m_arena[from.offset + from.count - 1];
+    m_arena[from.offset + index] = moved;
+    pm.m_cellIndex[moved] = index;
+    if (0 == --from.count) {
+      release(from);
+    }
+  }
+  pm.place(id, (uint32_t)x, (uint32_t)y);
+  pm.m_cellIndex[id] = add(id, x, y);
+}
+
 double
 Grid::separation() const
 {
@@ -95,7 +144,13 @@ Grid::separation() const
 std::shared_ptr<Cell> 
 Grid::cell(uint64_t x, uint64_t y) const
 {
-  return m_cells[x + (y * m_width)];
+  std::vector<uint64_t> present;
+  const uint32_t slot = tile(x / TileSide, y / TileSide);
+  if (NoTile != slot) {
+    const Occupancy& cell = m_cells[key(x, y)];
+    present.assign(m_arena.begin() + cell.offset, m_arena.begin() + cell.offset + cell.count);
+  }
+  return std::make_shared<Cell>(x, y, std::move(present));
 }
 
 
@@ -121,5 +176,108 @@ Grid:: distance(const std::shared_ptr<Cell>& c1, const std::shared_ptr<Cell>& c2
 }
 
 
+uint64_t
+Grid::tiles() const
+{
+  return m_cells.size() / TileCells;
+}
+
+bool
+Grid::restore(PresenceManager& pm)
+{
+  std::fill(m_tiles.begin(), m_tiles.end(), NoTile);
+  m_cells.clear();
+  m_arena.clear();
+  for (auto& free : m_free) {
+    free.clear();
+  }
+  // Moving in by ascending cell index reproduces each cell's order
+  std::vector<uint64_t> ids;
+  for (uint64_t id = 0;id < pm.size();id++) {
+    if (pm.placed(id)) {
+      if (pm.x(id) >= m_width || pm.y(id) >= m_height) {
+        return false;
+      }
+      ids.push_back(id);
+    }
+  }
+  std::stable_sort(ids.begin(), ids.end(), [&pm] (uint64_t a, uint64_t b) {
+    return pm.m_cellIndex[a] < pm.m_cellIndex[b];
+  });
+  for (uint64_t id : ids) {
+    if (add(id, pm.x(id), pm.y(id)) != pm.m_cellIndex[id]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void
+Grid::reindex(const PresenceManager& pm)
+{
+  m_index.rebuild(pm, *this);
+}
+
+const CellIndex&
+Grid::index() const
+{
+  return m_index;
+}
+
+// PRIVATE METHODS
+
+Grid::Occupancy&
+Grid::occupancy(uint64_t x, uint64_t y)
+{
+  uint32_t& slot = m_tiles[(x / TileSide) + ((y / TileSide) * m_tilesWide)];
+  if (NoTile == slot) {
+    slot = (uint32_t)tiles();
+    m_cells.resize(m_cells.size() + TileCells, Occupancy{0, 0, 0});
+  }
+  return m_cells[key(x, y)];
+}
+
+uint32_t
+Grid::add(uint64_t id, uint64_t x, uint64_t y)
+{
+  Occupancy& cell = occupancy(x, y);
+  if (cell.count == cell.capacity) {
+    // Move to a block twice the size
+    std::size_t size = 0;
+    while (((uint32_t)1 << size) <= cell.capacity) {
+      size++;
+    }
+    uint32_t offset;
+    if (m_free[size].empty()) {
+      offset = (uint32_t)m_arena.size();
+      m_arena.resize(m_arena.size() + ((std::size_t)1 << size));
+    } else {
+      offset = m_free[size].back();
+      m_free[size].pop_back();
+    }
+    std::copy(m_arena.begin() + cell.offset, m_arena.begin() + cell.offset + cell.count, m_arena.begin() + offset);
+    release(cell);
+    cell.offset = offset;
+    cell.capacity = (uint32_t)1 << size;
+  }
+  m_arena[cell.offset + cell.count] = (uint32_t)id;
+  return cell.count++;
+}
+
+void
+Grid::release(Occupancy& cell)
+{
+  if (0 == cell.capacity) {
+    return;
+  }
+  std::size_t size = 0;
+  while (((uint32_t)1 << size) < cell.capacity) {
+    size++;
+  }
+  m_free[size].push_back(cell.offset);
+  cell.capacity = 0;
+}
+
+
 }
 }
\ No newline at end of file
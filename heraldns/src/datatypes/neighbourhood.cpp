@@ -0,0 +1,42 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include "../../heraldns.h"
+
+#include <cmath>
+
+namespace heraldns {
+namespace datatype {
+
+Neighbourhood::Neighbourhood(const Grid& grid, double radiusMetres)
+  : m_radius((uint64_t)std::ceil(radiusMetres / grid.separation())),
+    m_side((2 * (int64_t)m_radius) + 1),
+    m_weights(m_side * m_side)
+{
+  // TODO Check cell is definitely in range (we cover a box, radius is a circle)
+  const int64_t r = (int64_t)m_radius;
+  const double separationSquared = grid.separation() * grid.separation();
+  for (int64_t dy = -r;dy <= r;dy++) {
+    for (int64_t dx = -r;dx <= r;dx++) {
+      double distanceSquared = separationSquared * ((dx * dx) + (dy * dy));
+      m_weights[((dy + r) * m_side) + (dx + r)] = 1.0 / std::max(1.0, distanceSquared);
+    }
+  }
+}
+
+uint64_t
+Neighbourhood::radius() const
+{
+  return m_radius;
+}
+
+double
+Neighbourhood::weight(int64_t dx, int64_t dy) const
+{
+  const int64_t r = (int64_t)m_radius;
+  return m_weights[((dy + r) * m_side) + (dx + r)];
+}
+
+}
+}
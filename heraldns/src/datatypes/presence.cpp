@@ -4,8 +4,7 @@
 
 #include "../../heraldns.h"
 
-#include <iostream>
-#include <random>
+#include <algorithm>
 
 using namespace heraldns;
 
@@ -13,192 +12,89 @@ namespace heraldns {
 namespace datatype {
 
 
-Presence::Presence(std::uint64_t id)
-  : m_id(id), m_currentRisk(0), m_newRisk(0), m_flightiness(0.0),
-    m_position(), m_state(State::Well), m_transmissionModelScore(0.0), m_newTransmissionModelScore(0.0),
-    m_lastFellIll(0), m_lastRecovered(0), m_hasEverBeenIll(false), m_highestRiskScore(0.0),
-    m_currentTransmittedRisk(0), m_newTransmittedRisk(0)
+PresenceManager::PresenceManager(uint64_t count)
+  : m_x(count, Unplaced), m_y(count, Unplaced), m_cellIndex(count, 0),
+    m_state(count, State::Well), m_newState(count, State::Well),
+    m_currentRisk(count, 0.0), m_newRisk(count, 0.0),
+    m_currentTransmittedRisk(count, 0.0), m_newTransmittedRisk(count, 0.0),
+    m_transmissionModelScore(count, 0.0), m_newTransmissionModelScore(count, 0.0),
+    m_flightiness(count, 0.0),
+    m_lastFellIll(count, 0), m_lastRecovered(count, 0),
+    m_hasEverBeenIll(count, 0), m_highestRiskScore(count, 0.0)
 {
   ;
 }
 
-std::shared_ptr<Cell>
-Presence::position() const
+uint64_t
+PresenceManager::size() const
 {
-  return *m_position;
+  return m_state.size();
 }
 
 void
-Presence::moveTo(std::shared_ptr<Cell> newPlace)
-{
-  if (m_position) {
-    (*m_position)->movedOut(m_id); // TODO verify this does what we think
+PresenceManager::newState(uint64_t id, State newState, uint64_t atTick)
+{
+  State current = m_state[id];
+  if (current == State::Well && newState == State::Ill) {
+    m_lastFellIll[id] = atTick;
+    m_hasEverBeenIll[id] = 1;
+  } else if (current == State::Ill && newState == State::Recovered) {
+    m_lastRecovered[id] = atTick;
+    m_newTransmittedRisk[id] = 0.0;
+    m_newTransmissionModelScore[id] = 0.0; // reset and try to become ill again!
   }
-  m_position = newPlace;
-  newPlace->movedIn(m_id);
-}
-
-double
-Presence::risk() const
-{
-  return m_currentRisk;
-}
-
-// Calculated Risk Score using the current formula
-double
-Presence::newRisk()
-{
-  return m_newRisk;
-}
-
-void
-Presence::newRisk(double newRisk)
-{
-  m_newRisk = newRisk;
-}
-
-// Calculated transmission risk number using the current formula
-
-// Cumulative risk-minutes exposed to
-void
-Presence::newTransmittedRisk(double riskMinutes)
-{
-  m_newTransmittedRisk = riskMinutes;
-}
-
-double
-Presence::newTransmittedRisk() const
-{
-  return m_newTransmittedRisk;
-}
-
-double
-Presence::transmittedRisk() const
-{
-  return m_currentTransmittedRisk;
-}
-
-// Person-specific functions
-void
-Presence::flightiness(double flightiness)
-{
-  m_flightiness = flightiness;
-}
-
-double
-Presence::flightiness()
-{
-  return m_flightiness;
+  // m_state changed at commitChanges() only
+  m_newState[id] = newState;
 }
 
 void
-Presence::commitChanges()
+PresenceManager::commitChanges(uint64_t id)
 {
-  m_currentRisk = m_newRisk;
-  m_newRisk = 0.0;
+  m_currentRisk[id] = m_newRisk[id];
+  m_newRisk[id] = 0.0;
   // set newRisk to 0
   // If the caller needs it to be the same as currentRisk then it can do this
   // but if we do that here then it is impossible for a caller to tell.
-  m_currentTransmittedRisk = m_newTransmittedRisk;
+  m_currentTransmittedRisk[id] = m_newTransmittedRisk[id];
   // We know transmitted amount from previous ticks always degrades over time, so don't reset it here
-  m_state = m_newState;
-  if (m_currentRisk > m_highestRiskScore) {
-    m_highestRiskScore = m_currentRisk;
-  }
-}
-
-State
-Presence::state() const
-{
-  return m_state;
-}
-
-void
-Presence::newState(State newState, uint64_t atTick)
-{
-  if (m_state == State::Well && newState == State::Ill) {
-    m_lastFellIll = atTick;
-    m_hasEverBeenIll = true;
-  } else if (m_state == State::Ill && newState == State::Recovered) {
-    m_lastRecovered = atTick;
-    m_newTransmittedRisk = 0.0;
-    m_newTransmissionModelScore = 0.0; // reset and try to become ill again!
+  m_state[id] = m_newState[id];
+  if (m_currentRisk[id] > m_highestRiskScore[id]) {
+    m_highestRiskScore[id] = m_currentRisk[id];
   }
-  // m_state changed at commitChanges() only
-  m_newState = newState;
-}
-
-uint64_t
-Presence::id() const
-{
-  return m_id;
-}
-
-uint64_t
-Presence::lastFellIll() const
-{
-  return m_lastFellIll;
-}
-
-bool
-Presence::hasEverBeenIll() const
-{
-  return m_hasEverBeenIll;
-}
-
-uint64_t
-Presence::lastRecovered() const
-{
-  return m_lastRecovered;
-}
-
-double
-Presence::highestRiskScore() const
-{
-  return m_highestRiskScore;
-}
-
-
-double
-Presence::transmissionModelScore() const
-{
-  return m_transmissionModelScore;
-}
-
-double
-Presence::newTransmissionModelScore() const
-{
-  return m_newTransmissionModelScore;
 }
 
 void
-Presence::newTransmissionModelScore(double riskMinutes)
-{
-  m_newTransmissionModelScore = riskMinutes;
-}
-
-
-
-
-PresenceManager::PresenceManager(uint64_t count)
-  : actors()
+PresenceManager::commitChanges()
 {
-  actors.reserve(count);
+  // One loop per array pair, so each is a simple (vectorisable) copy
+  const uint64_t count = size();
   for (uint64_t id = 0;id < count;id++) {
-    actors.push_back(std::make_shared<Presence>(id));
+    if (m_newRisk[id] > m_highestRiskScore[id]) {
+      m_highestRiskScore[id] = m_newRisk[id];
+    }
   }
-}
-
-uint64_t
-PresenceManager::size() const
-{
-  return actors.size();
-}
-
-std::shared_ptr<Presence>
-PresenceManager::get(uint64_t id) const
-{
-  return actors[id];
+  m_currentRisk.swap(m_newRisk);
+  std::fill(m_newRisk.begin(), m_newRisk.end(), 0.0);
+  std::copy(m_newTransmittedRisk.begin(), m_newTransmittedRisk.end(), m_currentTransmittedRisk.begin());
+  std::copy(m_newState.begin(), m_newState.end(), m_state.begin());
+}
+
+std::vector<PresenceManager::Column>
+PresenceManager::columns()
+{
+  auto column = [] (const char* name, auto& values) {
+    return Column{name, values.data(), values.size() * sizeof(values[0])};
+  };
+  return {
+    column("x", m_x), column("y", m_y), column("cellIndex", m_cellIndex),
+    column("state", m_state), column("newState", m_newState),
+    column("currentRisk", m_currentRisk), column("newRisk", m_newRisk),
+    column("transmittedRisk", m_currentTransmittedRisk), column("newTransmittedRisk", m_newTransmittedRisk),
+    column("modelScore", m_transmissionModelScore), column("newModelScore", m_newTransmissionModelScore),
+    column("flightiness", m_flightiness),
+    column("lastFellIll", m_lastFellIll), column("lastRecovered", m_lastRecovered),
+    column("hasEverBeenIll", m_hasEverBeenIll), column("highestRiskScore", m_highestRiskScore)
+  };
 }
 
 
@@ -0,0 +1,64 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include "../../heraldns.h"
+
+#include <algorithm>
+
+namespace heraldns {
+namespace datatype {
+
+TimerWheel::TimerWheel(uint64_t slots)
+  : m_slots(std::max<uint64_t>(1, slots)), m_size(0)
+{
+  ;
+}
+
+uint64_t
+TimerWheel::slots() const
+{
+  return m_slots.size();
+}
+
+uint64_t
+TimerWheel::size() const
+{
+  return m_size;
+}
+
+void
+TimerWheel::clear()
+{
+  for (auto& slot : m_slots) {
+    slot.clear();
+  }
+  m_size = 0;
+}
+
+void
+TimerWheel::schedule(uint64_t tick, uint64_t id)
+{
+  m_slots[tick % m_slots.size()].push_back(Timer{tick, id});
+  m_size++;
+}
+
+void
+TimerWheel::take(uint64_t tick, std::vector<uint64_t>& due)
+{
+  std::vector<Timer>& slot = m_slots[tick % m_slots.size()];
+  // keep later turns' timers in order at the front
+  std::size_t kept = 0;
+  for (std::size_t i = 0;i < slot.size();i++) {
+    if (slot[i].tick <= tick) {
+      due.push_back(slot[i].id);
+    } else {
+      slot[kept++] = slot[i];
+    }
+  }
+  m_size -= slot.size() - kept;
+  slot.resize(kept);
+}
+
+}
+}
@@ -0,0 +1,174 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include "../../heraldns.h"
+
+#include <array>
+#include <filesystem>
+
+namespace heraldns {
+namespace intermediate {
+
+using namespace heraldns;
+using namespace heraldns::datatype;
+
+StreamingResults::StreamingResults(std::string outputFolder, uint64_t ticksPerSnapshot)
+  : m_outputFolder(outputFolder), m_ticksPerSnapshot(ticksPerSnapshot), m_minutes(0.0), m_nextSnapshot(0),
+    m_ticksFile(), m_daysFile(), m_presencesFile(), m_nextDay(0), m_failed(false),
+    m_lock(), m_queued(), m_dequeued(), m_queue(), m_free(), m_closing(false), m_writer()
+{
+  std::error_code ec;
+  std::filesystem::create_directories(m_outputFolder, ec);
+  const std::filesystem::path folder(m_outputFolder);
+  m_ticksFile.open(folder / "ticks.csv");
+  m_daysFile.open(folder / "days.csv");
+  if (m_ticksPerSnapshot > 0) {
+    m_presencesFile.open(folder / "presences.bin", std::ios::binary);
+  }
+  if (ec || !m_ticksFile || !m_daysFile || (m_ticksPerSnapshot > 0 && !m_presencesFile)) {
+    // No writer thread, so every result is ignored and close() fails
+    m_failed = true;
+    return;
+  }
+  m_ticksFile << "tick,minutes,well,ill,recovered,dead,everIll\n";
+  m_daysFile << "day,well,ill,recovered,dead,everIll\n";
+  if (m_ticksPerSnapshot > 0) {
+    const uint32_t version = 1;
+    m_presencesFile.write("HNSP", 4);
+    m_presencesFile.write((const char*)&version, sizeof(version));
+  }
+  m_writer = std::thread([this] { write(); });
+}
+
+StreamingResults::~StreamingResults()
+{
+  close();
+}
+
+void
+StreamingResults::intermediateResults(uint64_t, uint64_t,
+  const PresenceManager& pm,
+  double minutesPassed, uint64_t ticksComplete)
+{
+  if (!m_writer.joinable()) {
+    return;
+  }
+  std::unique_ptr<Frame> frame;
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (!m_free.empty()) {
+      frame = std::move(m_free.back());
+      m_free.pop_back();
+    }
+  }
+  if (!frame) {
+    frame = std::make_unique<Frame>();
+  }
+
+  // Copy only what the background thread needs, as pm changes on the next tick
+  m_minutes += minutesPassed;
+  const uint64_t count = pm.size();
+  frame->tick = ticksComplete;
+  frame->minutes = m_minutes;
+  frame->state.resize(count);
+  frame->everIll.resize(count);
+  for (uint64_t id = 0;id < count;id++) {
+    frame->state[id] = (uint8_t)pm.state(id);
+    frame->everIll[id] = pm.hasEverBeenIll(id);
+  }
+  frame->snapshot = m_ticksPerSnapshot > 0 && ticksComplete >= m_nextSnapshot;
+  if (frame->snapshot) {
+    m_nextSnapshot = (ticksComplete / m_ticksPerSnapshot + 1) * m_ticksPerSnapshot;
+    frame->x.resize(count);
+    frame->y.resize(count);
+    frame->risk.resize(count);
+    for (uint64_t id = 0;id < count;id++) {
+      frame->x[id] = pm.x(id);
+      frame->y[id] = pm.y(id);
+      frame->risk[id] = pm.risk(id);
+    }
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_dequeued.wait(lock, [this] { return m_queue.size() < MaxQueuedFrames; });
+    m_queue.push_back(std::move(frame));
+  }
+  m_queued.notify_one();
+}
+
+bool
+StreamingResults::close() noexcept
+{
+  if (m_writer.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_closing = true;
+    }
+    m_queued.notify_one();
+    m_writer.join();
+  }
+  for (std::ofstream* file : {&m_ticksFile, &m_daysFile, &m_presencesFile}) {
+    if (file->is_open()) {
+      file->close();
+      m_failed = m_failed || !*file;
+    }
+  }
+  return !m_failed;
+}
+
+// PRIVATE METHODS
+
+void
+StreamingResults::write()
+{
+  std::unique_lock<std::mutex> lock(m_lock);
+  while (true) {
+    m_queued.wait(lock, [this] { return m_closing || !m_queue.empty(); });
+    if (m_queue.empty()) {
+      return; // closing, and everything written
+    }
+    std::unique_ptr<Frame> frame = std::move(m_queue.front());
+    m_queue.pop_front();
+    lock.unlock();
+    m_dequeued.notify_one();
+    write(*frame);
+    lock.lock();
+    m_free.push_back(std::move(frame));
+  }
+}
+
+void
+StreamingResults::write(const Frame& frame)
+{
+  std::array<uint64_t,4> inState{0, 0, 0, 0}; // by State
+  uint64_t everIll = 0;
+  for (std::size_t id = 0;id < frame.state.size();id++) {
+    inState[frame.state[id]]++;
+    everIll += frame.everIll[id];
+  }
+  m_ticksFile << frame.tick << "," << frame.minutes << "," << inState[0] << "," << inState[1] << ","
+              << inState[2] << "," << inState[3] << "," << everIll << "\n";
+
+  const uint64_t day = (uint64_t)frame.minutes / (60 * 24);
+  if (day >= m_nextDay) {
+    m_daysFile << day << "," << inState[0] << "," << inState[1] << ","
+               << inState[2] << "," << inState[3] << "," << everIll << "\n";
+    m_nextDay = day + 1;
+  }
+
+  if (frame.snapshot) {
+    const uint64_t count = frame.state.size();
+    m_presencesFile.write((const char*)&frame.tick, sizeof(frame.tick));
+    m_presencesFile.write((const char*)&count, sizeof(count));
+    m_presencesFile.write((const char*)frame.x.data(), count * sizeof(uint32_t));
+    m_presencesFile.write((const char*)frame.y.data(), count * sizeof(uint32_t));
+    m_presencesFile.write((const char*)frame.state.data(), count);
+    m_presencesFile.write((const char*)frame.risk.data(), count * sizeof(double));
+  }
+  m_failed = m_failed || !m_ticksFile || !m_daysFile || (frame.snapshot && !m_presencesFile);
+}
+
+}
+}
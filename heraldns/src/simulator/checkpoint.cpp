@@ -0,0 +1,208 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include "../../heraldns.h"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace heraldns {
+namespace simulator {
+
+namespace {
+
+const char Magic[4] = {'H', 'N', 'S', 'C'};
+const uint32_t Version = 1;
+const uint64_t HeaderBytes = 4 + 4 + 8;
+const uint64_t DirectoryEntryBytes = Checkpoint::NameLength + 8 + 8;
+
+uint64_t aligned(uint64_t offset)
+{
+  return (offset + Checkpoint::Alignment - 1) / Checkpoint::Alignment * Checkpoint::Alignment;
+}
+
+// Waits for a written file's contents to reach the disk. returns success = true
+bool syncFile(const std::string& path)
+{
+  std::FILE* file = std::fopen(path.c_str(), "r+b");
+  if (nullptr == file) {
+    return false;
+  }
+#ifdef _WIN32
+  const bool synced = 0 == _commit(_fileno(file));
+#else
+  const bool synced = 0 == fsync(fileno(file));
+#endif
+  std::fclose(file);
+  return synced;
+}
+
+// Waits for a directory's entries (E.g. a new or renamed file) to reach the disk. Not
+// possible on Windows, where the rename itself is relied upon. returns success = true
+bool syncDirectory(const std::filesystem::path& directory)
+{
+#ifdef _WIN32
+  return true;
+#else
+  int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0) {
+    return false;
+  }
+  const bool synced = 0 == fsync(fd);
+  ::close(fd);
+  return synced;
+#endif
+}
+
+}
+
+void
+Checkpoint::add(const std::string& name, const void* data, uint64_t bytes)
+{
+  m_columns.push_back(Column{name.substr(0, NameLength - 1), data, 0, bytes});
+}
+
+bool
+Checkpoint::write(const std::string& path) noexcept
+{
+  try {
+    uint64_t offset = HeaderBytes + (m_columns.size() * DirectoryEntryBytes);
+    for (auto& column : m_columns) {
+      column.offset = aligned(offset);
+      offset = column.offset + column.bytes;
+    }
+
+    const std::string temporary = path + ".tmp";
+    {
+      std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+      const uint64_t count = m_columns.size();
+      out.write(Magic, sizeof(Magic));
+      out.write((const char*)&Version, sizeof(Version));
+      out.write((const char*)&count, sizeof(count));
+      for (auto& column : m_columns) {
+        std::array<char,NameLength> name{};
+        std::memcpy(name.data(), column.name.data(), column.name.size());
+        out.write(name.data(), name.size());
+        out.write((const char*)&column.offset, sizeof(column.offset));
+        out.write((const char*)&column.bytes, sizeof(column.bytes));
+      }
+      const std::array<char,Alignment> padding{};
+      for (auto& column : m_columns) {
+        out.write(padding.data(), column.offset - (uint64_t)out.tellp());
+        out.write((const char*)column.data, column.bytes);
+      }
+      out.close();
+      if (!out) {
+        return false;
+      }
+    }
+    // The rename must not reach the disk before the data it points to
+    const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+    if (!syncFile(temporary) || !syncDirectory(directory)) {
+      return false;
+    }
+    std::filesystem::rename(temporary, path);
+    if (!syncDirectory(directory)) {
+      return false;
+    }
+    m_fileSize = offset;
+    return true;
+  } catch (...) {
+    return false;
+  }
+}
+
+bool
+Checkpoint::open(const std::string& path) noexcept
+{
+  try {
+    m_columns.clear();
+    m_in.close();
+    m_in.clear();
+    m_in.open(path, std::ios::binary);
+    char magic[4];
+    uint32_t version = 0;
+    uint64_t count = 0;
+    m_in.read(magic, sizeof(magic));
+    m_in.read((char*)&version, sizeof(version));
+    m_in.read((char*)&count, sizeof(count));
+    if (!m_in || 0 != std::memcmp(magic, Magic, sizeof(Magic)) || Version != version) {
+      return false;
+    }
+    m_fileSize = std::filesystem::file_size(path);
+    for (uint64_t c = 0;c < count;c++) {
+      std::array<char,NameLength> name{};
+      Column column{"", nullptr, 0, 0};
+      m_in.read(name.data(), name.size());
+      m_in.read((char*)&column.offset, sizeof(column.offset));
+      m_in.read((char*)&column.bytes, sizeof(column.bytes));
+      if (!m_in || 0 != name.back() || column.offset > m_fileSize || column.bytes > m_fileSize - column.offset) {
+        m_columns.clear();
+        return false;
+      }
+      column.name = name.data();
+      m_columns.push_back(column);
+    }
+    return true;
+  } catch (...) {
+    m_columns.clear();
+    return false;
+  }
+}
+
+bool
+Checkpoint::has(const std::string& name) const
+{
+  return nullptr != find(name);
+}
+
+uint64_t
+Checkpoint::bytes(const std::string& name) const
+{
+  const Column* column = find(name);
+  return nullptr == column ? 0 : column->bytes;
+}
+
+bool
+Checkpoint::read(const std::string& name, void* data, uint64_t bytes) noexcept
+{
+  const Column* column = find(name);
+  if (nullptr == column || column->bytes != bytes) {
+    return false;
+  }
+  m_in.seekg(column->offset);
+  m_in.read((char*)data, bytes);
+  return (bool)m_in;
+}
+
+uint64_t
+Checkpoint::fileSize() const
+{
+  return m_fileSize;
+}
+
+// PRIVATE METHODS
+
+const Checkpoint::Column*
+Checkpoint::find(const std::string& name) const
+{
+  for (auto& column : m_columns) {
+    if (column.name == name) {
+      return &column;
+    }
+  }
+  return nullptr;
+}
+
+}
+}
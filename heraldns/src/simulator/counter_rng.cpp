@@ -0,0 +1,33 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include "../../heraldns.h"
+
+namespace heraldns {
+namespace simulator {
+
+CounterRng::CounterRng(uint64_t seed)
+  : m_key{(uint32_t)seed, (uint32_t)(seed >> 32)}
+{
+  ;
+}
+
+uint64_t
+CounterRng::seed() const
+{
+  return ((uint64_t)m_key[1] << 32) | m_key[0];
+}
+
+void
+CounterRng::steps(uint64_t tick, uint64_t from, uint64_t to, int8_t* dx, int8_t* dy) const
+{
+  for (uint64_t id = from;id < to;id++) {
+    const Block random = block(id, tick);
+    dx[id - from] = step(random[0]);
+    dy[id - from] = step(random[1]);
+  }
+}
+
+}
+}
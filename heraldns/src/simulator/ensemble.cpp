@@ -0,0 +1,347 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include "../../heraldns.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <thread>
+
+using namespace heraldns::datatype;
+using namespace heraldns::mixing;
+using namespace heraldns::transmission;
+
+namespace heraldns {
+namespace simulator {
+
+namespace {
+
+std::string trim(const std::string& text)
+{
+  auto first = text.find_first_not_of(" \t\r");
+  if (std::string::npos == first) {
+    return "";
+  }
+  return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+}
+
+// throws std::invalid_argument / std::out_of_range if not wholly a number
+uint64_t unsignedValue(const std::string& text)
+{
+  std::size_t used = 0;
+  if (!text.empty() && '-' == text[0]) {
+    throw std::invalid_argument(text);
+  }
+  uint64_t value = std::stoull(text, &used);
+  if (used != text.size()) {
+    throw std::invalid_argument(text);
+  }
+  return value;
+}
+
+double doubleValue(const std::string& text)
+{
+  std::size_t used = 0;
+  double value = std::stod(text, &used);
+  if (used != text.size()) {
+    throw std::invalid_argument(text);
+  }
+  return value;
+}
+
+using Setter = std::function<void(ScenarioSettings&, const std::string&)>;
+
+const std::map<std::string,Setter>& scenarioSetters()
+{
+  static const std::map<std::string,Setter> setters{
+    {"presences", [] (ScenarioSettings& s, const std::string& v) { s.presences = unsignedValue(v); }},
+    {"width", [] (ScenarioSettings& s, const std::string& v) { s.width = unsignedValue(v); }},
+    {"height", [] (ScenarioSettings& s, const std::string& v) { s.height = unsignedValue(v); }},
+    {"separation", [] (ScenarioSettings& s, const std::string& v) { s.separation = doubleValue(v); }},
+    {"initialInfections", [] (ScenarioSettings& s, const std::string& v) { s.initialInfections = unsignedValue(v); }},
+    {"initialRisk", [] (ScenarioSettings& s, const std::string& v) { s.initialRisk = doubleValue(v); }},
+    {"riskDropOffPerDay", [] (ScenarioSettings& s, const std::string& v) { s.riskDropOffPerDay = doubleValue(v); }},
+    {"recoveryDays", [] (ScenarioSettings& s, const std::string& v) { s.recoveryDays = unsignedValue(v); }},
+    {"immunityDays", [] (ScenarioSettings& s, const std::string& v) { s.immunityDays = unsignedValue(v); }},
+    {"days", [] (ScenarioSettings& s, const std::string& v) { s.days = unsignedValue(v); }},
+    {"secondsPerTick", [] (ScenarioSettings& s, const std::string& v) { s.secondsPerTick = unsignedValue(v); }}
+  };
+  return setters;
+}
+
+}
+
+bool
+EnsembleSettings::read(std::istream& in, EnsembleSettings& settings, std::string& error)
+{
+  // swept names and values, in the order read
+  std::vector<std::pair<std::string,std::vector<std::string>>> sweep;
+  std::string line;
+  uint64_t lineNumber = 0;
+  while (std::getline(in, line)) {
+    lineNumber++;
+    line = trim(line);
+    if (line.empty() || '#' == line[0]) {
+      continue;
+    }
+    auto equals = line.find('=');
+    if (std::string::npos == equals) {
+      error = "line " + std::to_string(lineNumber) + ": expected name = value";
+      return false;
+    }
+    std::string name = trim(line.substr(0, equals));
+    std::string value = trim(line.substr(equals + 1));
+    try {
+      if ("replicates" == name) {
+        settings.replicates = unsignedValue(value);
+      } else if ("seed" == name) {
+        settings.seed = unsignedValue(value);
+      } else if ("threads" == name) {
+        settings.threads = (unsigned int)unsignedValue(value);
+      } else if ("output" == name) {
+        settings.output = value;
+      } else if (scenarioSetters().count(name) > 0) {
+        std::vector<std::string> values;
+        std::istringstream list(value);
+        std::string item;
+        while (std::getline(list, item, ',')) {
+          item = trim(item);
+          ScenarioSettings check;
+          scenarioSetters().at(name)(check, item); // throws if invalid
+          values.push_back(item);
+        }
+        if (values.empty()) {
+          throw std::invalid_argument(value);
+        }
+        sweep.emplace_back(name, values);
+      } else {
+        error = "line " + std::to_string(lineNumber) + ": unknown setting " + name;
+        return false;
+      }
+    } catch (const std::logic_error&) { // invalid_argument, out_of_range
+      error = "line " + std::to_string(lineNumber) + ": invalid value for " + name + ": " + value;
+      return false;
+    }
+  }
+  if (0 == settings.replicates) {
+    error = "replicates must be at least 1";
+    return false;
+  }
+
+  // Every combination, the first name read varying slowest
+  std::vector<ScenarioSettings> scenarios{ScenarioSettings()};
+  for (auto& named : sweep) {
+    std::vector<ScenarioSettings> combined;
+    for (auto& scenario : scenarios) {
+      for (auto& value : named.second) {
+        ScenarioSettings next = scenario;
+        scenarioSetters().at(named.first)(next, value);
+        combined.push_back(next);
+      }
+    }
+    scenarios.swap(combined);
+  }
+  for (auto& scenario : scenarios) {
+    if (0 == scenario.width || 0 == scenario.height || scenario.separation <= 0 || 0 == scenario.secondsPerTick) {
+      error = "width, height, separation and secondsPerTick must be more than 0";
+      return false;
+    }
+    if (scenario.secondsPerTick > 24 * 60 * 60) {
+      error = "secondsPerTick must be at most 86400 (one day)";
+      return false;
+    }
+  }
+  settings.scenarios = scenarios;
+  return true;
+}
+
+
+
+Ensemble::Ensemble(EnsembleSettings settings)
+  : m_settings(settings), m_results(), m_lock(), m_replicatesFile(), m_summaryFile()
+{
+  if (m_settings.scenarios.empty()) {
+    m_settings.scenarios.emplace_back();
+  }
+}
+
+bool
+Ensemble::run() noexcept
+{
+  try {
+    std::error_code ec;
+    std::filesystem::create_directories(m_settings.output, ec);
+    std::filesystem::path folder(m_settings.output);
+    std::ofstream scenariosFile(folder / "scenarios.csv", std::ios::trunc);
+    m_replicatesFile.open(folder / "replicates.csv", std::ios::trunc);
+    m_summaryFile.open(folder / "summary.csv", std::ios::trunc);
+    if (!scenariosFile || !m_replicatesFile || !m_summaryFile) {
+      return false;
+    }
+
+    scenariosFile << "scenario,presences,width,height,separation,initialInfections,initialRisk,riskDropOffPerDay,"
+                  << "recoveryDays,immunityDays,days,secondsPerTick,replicates" << std::endl;
+    for (std::size_t i = 0;i < m_settings.scenarios.size();i++) {
+      const ScenarioSettings& s = m_settings.scenarios[i];
+      scenariosFile << i << "," << s.presences << "," << s.width << "," << s.height << "," << s.separation << ","
+                    << s.initialInfections << "," << s.initialRisk << "," << s.riskDropOffPerDay << ","
+                    << s.recoveryDays << "," << s.immunityDays << "," << s.days << "," << s.secondsPerTick << ","
+                    << m_settings.replicates << std::endl;
+    }
+    m_replicatesFile << "scenario,replicate,seed,day,cases,recovered" << std::endl;
+    m_summaryFile << "scenario,day,cases_mean,cases_low,cases_high,recovered_mean,recovered_low,recovered_high" << std::endl;
+
+    m_results.clear();
+    m_results.resize(m_settings.scenarios.size());
+    for (auto& results : m_results) {
+      results.cases.resize(m_settings.replicates);
+      results.recovered.resize(m_settings.replicates);
+    }
+
+    // Replicates are taken in turn, so each scenario's complete as early as possible
+    const uint64_t jobs = m_settings.scenarios.size() * m_settings.replicates;
+    unsigned int threads = m_settings.threads;
+    if (0 == threads) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = (unsigned int)std::min<uint64_t>(threads, jobs);
+    std::atomic<uint64_t> next(0);
+    std::atomic<bool> failed(false);
+    auto work = [this, &next, &failed, jobs] {
+      for (uint64_t job = next++;job < jobs && !failed;job = next++) {
+        uint64_t scenario = job / m_settings.replicates;
+        uint64_t replicate = job % m_settings.replicates;
+        try {
+          auto series = runReplicate(m_settings.scenarios[scenario], seed(scenario, replicate));
+          completed(scenario, replicate, series);
+        } catch (...) {
+          failed = true;
+        }
+      }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1;t < threads;t++) {
+      workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker : workers) {
+      worker.join();
+    }
+    m_replicatesFile.close();
+    m_summaryFile.close();
+    return !failed && m_replicatesFile && m_summaryFile;
+  } catch (...) {
+    return false;
+  }
+}
+
+uint64_t
+Ensemble::seed(uint64_t scenario, uint64_t replicate) const
+{
+  CounterRng::Block block = CounterRng(m_settings.seed).block(replicate, scenario);
+  return ((uint64_t)block[1] << 32) | block[0];
+}
+
+const std::vector<DailyBand>&
+Ensemble::cases(uint64_t scenario) const
+{
+  return m_results[scenario].casesBands;
+}
+
+const std::vector<DailyBand>&
+Ensemble::recovered(uint64_t scenario) const
+{
+  return m_results[scenario].recoveredBands;
+}
+
+std::pair<std::vector<uint64_t>,std::vector<uint64_t>>
+Ensemble::runReplicate(const ScenarioSettings& scenario, uint64_t seed)
+{
+  PresenceManager pm(scenario.presences);
+  std::shared_ptr<Grid> grid = std::make_shared<Grid>(scenario.width, scenario.height, scenario.separation);
+  std::shared_ptr<DirectMixingScoreProvider> scoring = std::make_shared<DirectMixingScoreProvider>(
+    pm, grid, scenario.initialRisk, scenario.riskDropOffPerDay);
+  // Rounded as Simulation rounds a run's length, so periods match their days when a tick does not divide a day
+  const double ticksPerDay = (60.0 / scenario.secondsPerTick) * 60 * 24;
+  std::shared_ptr<BasicTransmissionModelProvider> transmission = std::make_shared<BasicTransmissionModelProvider>(
+    pm, grid, (uint64_t)std::ceil(scenario.recoveryDays * ticksPerDay),
+    (uint64_t)std::ceil(scenario.immunityDays * ticksPerDay), scenario.initialInfections);
+
+  // Replicates run in parallel, so each runs on one thread
+  Simulation sim(grid, pm, scoring, transmission);
+  sim.seed(seed);
+  sim.threads(1);
+  sim.verbose(false);
+  sim.runToCompletion(scenario.days, scenario.secondsPerTick);
+  return {sim.dailyCases(), sim.dailyRecovered()};
+}
+
+std::vector<DailyBand>
+Ensemble::bands(const std::vector<std::vector<uint64_t>>& series)
+{
+  std::vector<DailyBand> result;
+  if (series.empty()) {
+    return result;
+  }
+  std::size_t days = series.front().size();
+  for (auto& one : series) {
+    days = std::min(days, one.size());
+  }
+  const double n = (double)series.size();
+  for (std::size_t day = 0;day < days;day++) {
+    double sum = 0.0;
+    for (auto& one : series) {
+      sum += one[day];
+    }
+    const double mean = sum / n;
+    double squares = 0.0;
+    for (auto& one : series) {
+      squares += (one[day] - mean) * (one[day] - mean);
+    }
+    // normal approximation, with the sample standard deviation
+    const double halfWidth = series.size() > 1 ? 1.96 * std::sqrt(squares / (n - 1)) / std::sqrt(n) : 0.0;
+    result.push_back(DailyBand{mean, mean - halfWidth, mean + halfWidth});
+  }
+  return result;
+}
+
+// PRIVATE METHODS
+
+void
+Ensemble::completed(uint64_t scenario, uint64_t replicate, std::pair<std::vector<uint64_t>,std::vector<uint64_t>>& series)
+{
+  std::lock_guard<std::mutex> guard(m_lock);
+  const uint64_t replicateSeed = seed(scenario, replicate);
+  for (std::size_t day = 0;day < series.first.size() && day < series.second.size();day++) {
+    m_replicatesFile << scenario << "," << replicate << "," << replicateSeed << "," << day << ","
+                     << series.first[day] << "," << series.second[day] << "\n";
+  }
+  m_replicatesFile.flush();
+
+  ScenarioResults& results = m_results[scenario];
+  results.cases[replicate].swap(series.first);
+  results.recovered[replicate].swap(series.second);
+  if (++results.completed < m_settings.replicates) {
+    return;
+  }
+  results.casesBands = bands(results.cases);
+  results.recoveredBands = bands(results.recovered);
+  results.cases.clear();
+  results.recovered.clear();
+  for (std::size_t day = 0;day < results.casesBands.size();day++) {
+    const DailyBand& c = results.casesBands[day];
+    const DailyBand& r = results.recoveredBands[day];
+    m_summaryFile << scenario << "," << day << "," << c.mean << "," << c.low << "," << c.high << ","
+                  << r.mean << "," << r.low << "," << r.high << "\n";
+  }
+  m_summaryFile.flush();
+}
+
+} // end namespace
+} // end namespace
@@ -5,7 +5,14 @@
 #include <iostream>
 #include "../../heraldns.h"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
 
 using namespace heraldns;
 using namespace heraldns::simulator;
@@ -16,15 +23,76 @@ using namespace heraldns::transmission;
 namespace heraldns {
 namespace simulator {
 
-Simulation::Simulation(std::shared_ptr<Grid> grid, const PresenceManager& pm,
+namespace {
+
+// Exchanges two byte ranges a block at a time, without copying either whole range
+void swapBytes(char* a, char* b, uint64_t bytes)
+{
+  std::array<char,4096> block;
+  for (uint64_t offset = 0;offset < bytes;offset += block.size()) {
+    const uint64_t n = std::min<uint64_t>(block.size(), bytes - offset);
+    std::memcpy(block.data(), a + offset, n);
+    std::memcpy(a + offset, b + offset, n);
+    std::memcpy(b + offset, block.data(), n);
+  }
+}
+
+}
+
+Simulation::Simulation(std::shared_ptr<Grid> grid, PresenceManager& pm,
              std::shared_ptr<SocialMixingScoreProvider> scoring,
              std::shared_ptr<TransmissionModelProvider> transmission)
  : m_grid(grid), m_pm(pm), 
    scoreProvider(scoring), modelProvider(transmission),
    maxTicks(0), minutesPerTick(1.0), currentTick(0), today(0), casesPerDay(0), recoveredPerDay(0),
-   rd(), gen(rd()), distrib(-1,1)
+   m_verbose(true), m_placeAtRandom(true), m_rng(0), m_executor(std::make_unique<TickExecutor>(1)), m_moveX(), m_moveY(), m_active(),
+   m_checkpointFile(), m_ticksPerCheckpoint(0)
+{
+  std::random_device rd;
+  m_rng = CounterRng(((uint64_t)rd() << 32) | rd());
+}
+
+void
+Simulation::seed(uint64_t seed)
+{
+  m_rng = CounterRng(seed);
+}
+
+void
+Simulation::threads(unsigned int threads)
+{
+  m_executor = std::make_unique<TickExecutor>(threads);
+}
+
+void
+Simulation::verbose(bool verbose)
+{
+  m_verbose = verbose;
+}
+
+void
+Simulation::placeAtRandom(bool placeAtRandom)
+{
+  m_placeAtRandom = placeAtRandom;
+}
+
+void
+Simulation::checkpoints(std::string checkpointFile, uint64_t ticksPerCheckpoint)
+{
+  m_checkpointFile = checkpointFile;
+  m_ticksPerCheckpoint = ticksPerCheckpoint;
+}
+
+const std::vector<uint64_t>&
+Simulation::dailyCases() const
+{
+  return casesPerDay;
+}
+
+const std::vector<uint64_t>&
+Simulation::dailyRecovered() const
 {
-  ;
+  return recoveredPerDay;
 }
 
 
@@ -32,9 +100,7 @@ void
 Simulation::runToCompletion(uint64_t days, uint64_t secondsPerTick)
 {
   reset(days, secondsPerTick);
-  for (uint64_t ticks = 0;ticks < maxTicks;ticks++) {
-    tick();
-  }
+  run();
 }
 
 void
@@ -42,21 +108,65 @@ Simulation::runToCompletion(uint64_t days, uint64_t secondsPerTick,
   std::shared_ptr<IntermediateResultsListener> callback, uint64_t ticksPerCallback) 
 {
   reset(days, secondsPerTick);
-  uint64_t lastCbTicks = 0;
-  // NOTE: index 0 is the initial state, NOT the state after the first tick
-  for (uint64_t ticks = 0;ticks <= maxTicks;ticks++) {
-    if (0 == (ticks % ticksPerCallback)) {
-      callback->intermediateResults(casesPerDay[today],recoveredPerDay[today],m_pm,
-        currentTick == 0 ? 0 : ticksPerCallback * minutesPerTick,
-        currentTick);
-      lastCbTicks = ticks;
-    }
-    tick();
+  run(callback, ticksPerCallback);
+}
+
+bool
+Simulation::resume(std::string checkpointFile)
+{
+  if (!restore(checkpointFile)) {
+    return false;
   }
-  // don't forget final callback
-  callback->intermediateResults(casesPerDay[today],recoveredPerDay[today],m_pm,
-     (maxTicks - lastCbTicks)*minutesPerTick,
-    maxTicks);
+  run();
+  return true;
+}
+
+bool
+Simulation::resume(std::string checkpointFile,
+  std::shared_ptr<IntermediateResultsListener> callback, uint64_t ticksPerCallback)
+{
+  if (!restore(checkpointFile)) {
+    return false;
+  }
+  run(callback, ticksPerCallback);
+  return true;
+}
+
+bool
+Simulation::writeCheckpoint(std::string checkpointFile) noexcept
+{
+  auto started = std::chrono::steady_clock::now();
+  double minutes = minutesPerTick;
+  uint64_t minutesBits;
+  std::memcpy(&minutesBits, &minutes, sizeof(minutesBits));
+  const std::array<uint64_t,8> settings{m_pm.size(), m_grid->width(), m_grid->height(),
+    maxTicks, currentTick, today, m_rng.seed(), minutesBits};
+  Checkpoint checkpoint;
+  checkpoint.add("simulation", settings.data(), sizeof(settings));
+  for (auto& column : m_pm.columns()) {
+    checkpoint.add(column.name, column.data, column.bytes);
+  }
+  checkpoint.add("casesPerDay", casesPerDay.data(), casesPerDay.size() * sizeof(uint64_t));
+  checkpoint.add("recoveredPerDay", recoveredPerDay.data(), recoveredPerDay.size() * sizeof(uint64_t));
+  std::vector<uint64_t> mixing;
+  std::vector<uint64_t> transmission;
+  try {
+    mixing = scoreProvider->checkpointState();
+    transmission = modelProvider->checkpointState();
+  } catch (...) {
+    return false;
+  }
+  checkpoint.add("mixing", mixing.data(), mixing.size() * sizeof(uint64_t));
+  checkpoint.add("transmission", transmission.data(), transmission.size() * sizeof(uint64_t));
+  if (!checkpoint.write(checkpointFile)) {
+    return false;
+  }
+  if (m_verbose) {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "CHECKPOINT: tick " << currentTick << ", " << checkpoint.fileSize() << " bytes written in "
+              << seconds << "s" << std::endl;
+  }
+  return true;
 }
 
 bool
@@ -64,17 +174,26 @@ Simulation::writeStandardResults(std::string outputFolder) noexcept
 {
   // TODO settings
 
+  // per day
+  std::error_code ec;
+  std::filesystem::create_directories(outputFolder, ec);
+  std::ofstream daily(std::filesystem::path(outputFolder) / "daily.csv");
+  daily << "day,cases,recovered\n";
+  for (std::size_t day = 0;day < casesPerDay.size();day++) {
+    daily << day << "," << casesPerDay[day] << "," << recoveredPerDay[day] << "\n";
+  }
+  daily.close();
+
   // final state
   uint64_t totalInfectedEver = 0;
   double totalHighestRiskScoreIll = 0.0;
   double totalHighestRiskScoreNotIll = 0.0;
   for (uint64_t id = 0;id < m_pm.size();id++) {
-    auto p = m_pm.get(id);
-    if (p->hasEverBeenIll()) {
+    if (m_pm.hasEverBeenIll(id)) {
       totalInfectedEver++;
-      totalHighestRiskScoreIll += p->highestRiskScore();
+      totalHighestRiskScoreIll += m_pm.highestRiskScore(id);
     } else {
-      totalHighestRiskScoreNotIll += p->highestRiskScore();
+      totalHighestRiskScoreNotIll += m_pm.highestRiskScore(id);
     }
   }
   double pctNotIll = 0.0;
@@ -95,41 +214,160 @@ Simulation::writeStandardResults(std::string outputFolder) noexcept
     std::cout << "  Avg risk score for those who did not fall ill: " << totalHighestRiskScoreNotIll / (m_pm.size() - totalInfectedEver)
               << std::endl;
   }
-  return true;
+  return !ec && daily;
 }
 
 // PRIVATE METHODS
 
+bool
+Simulation::restore(std::string checkpointFile) noexcept
+{
+  try {
+    Checkpoint checkpoint;
+    std::array<uint64_t,8> settings{};
+    if (!checkpoint.open(checkpointFile) || !checkpoint.read("simulation", settings.data(), sizeof(settings))) {
+      return false;
+    }
+    if (settings[0] != m_pm.size() || settings[1] != m_grid->width() || settings[2] != m_grid->height()) {
+      return false;
+    }
+    // Read everything before changing anything, so a failed restore leaves the simulation as it was
+    auto columns = m_pm.columns();
+    std::vector<std::vector<char>> restored(columns.size());
+    for (std::size_t c = 0;c < columns.size();c++) {
+      restored[c].resize(columns[c].bytes);
+      if (!checkpoint.has(columns[c].name) || checkpoint.bytes(columns[c].name) != columns[c].bytes ||
+          !checkpoint.read(columns[c].name, restored[c].data(), columns[c].bytes)) {
+        return false;
+      }
+    }
+    auto readValues = [&checkpoint] (const char* name, std::vector<uint64_t>& values) {
+      if (!checkpoint.has(name) || 0 != checkpoint.bytes(name) % sizeof(uint64_t)) {
+        return false;
+      }
+      values.resize(checkpoint.bytes(name) / sizeof(uint64_t));
+      return checkpoint.read(name, values.data(), values.size() * sizeof(uint64_t));
+    };
+    std::vector<uint64_t> cases, recovered, mixing, transmission;
+    if (!readValues("casesPerDay", cases) || !readValues("recoveredPerDay", recovered) ||
+        !readValues("mixing", mixing) || !readValues("transmission", transmission) ||
+        settings[5] >= cases.size() || settings[5] >= recovered.size()) {
+      return false;
+    }
+
+    // Swap the restored columns in. The grid and providers may still reject them, so keep
+    // what they replace (now in restored) until they have accepted them.
+    auto swapColumns = [&columns, &restored] () {
+      for (std::size_t c = 0;c < columns.size();c++) {
+        swapBytes(restored[c].data(), (char*)columns[c].data, columns[c].bytes);
+      }
+    };
+    swapColumns();
+    const std::vector<uint64_t> previousMixing = scoreProvider->checkpointState();
+    const std::vector<uint64_t> previousTransmission = modelProvider->checkpointState();
+    if (!m_grid->restore(m_pm) || !scoreProvider->restoreState(mixing) || !modelProvider->restoreState(transmission)) {
+      swapColumns();
+      m_grid->restore(m_pm);
+      m_grid->reindex(m_pm);
+      scoreProvider->restoreState(previousMixing);
+      modelProvider->restoreState(previousTransmission);
+      return false;
+    }
+    m_grid->reindex(m_pm);
+    casesPerDay.swap(cases);
+    recoveredPerDay.swap(recovered);
+
+    maxTicks = settings[3];
+    currentTick = settings[4];
+    today = settings[5];
+    m_rng = CounterRng(settings[6]);
+    std::memcpy(&minutesPerTick, &settings[7], sizeof(minutesPerTick));
+    m_moveX.resize(m_pm.size());
+    m_moveY.resize(m_pm.size());
+    if (m_verbose) {
+      std::cout << "RESUMING: tick " << currentTick << " of " << maxTicks << std::endl;
+    }
+    return true;
+  } catch (...) {
+    return false;
+  }
+}
+
+void
+Simulation::run()
+{
+  while (currentTick < maxTicks) {
+    tick();
+  }
+}
+
+void
+Simulation::run(std::shared_ptr<IntermediateResultsListener> callback, uint64_t ticksPerCallback)
+{
+  // Zero even when resumed, so the first callback's minutes passed are those since the start
+  uint64_t lastCbTicks = 0;
+  // NOTE: the first callback is the state before the first tick run
+  while (currentTick < maxTicks) {
+    if (0 == (currentTick % ticksPerCallback)) {
+      callback->intermediateResults(casesPerDay[today],recoveredPerDay[today],m_pm,
+        (currentTick - lastCbTicks) * minutesPerTick,
+        currentTick);
+      lastCbTicks = currentTick;
+    }
+    tick();
+  }
+  // don't forget final callback
+  callback->intermediateResults(casesPerDay[today],recoveredPerDay[today],m_pm,
+     (maxTicks - lastCbTicks)*minutesPerTick,
+    maxTicks);
+}
+
 void
 Simulation::reset(uint64_t days, uint64_t secondsPerTick)
 {
   currentTick = 0;
   today = 0;
   maxTicks = (uint64_t)std::ceil(days * ((60.0 / secondsPerTick) * 60 * 24));
-  std::cout << "SETTING: maxTicks = " << maxTicks << std::endl;
+  minutesPerTick = secondsPerTick / 60.0;
+  if (m_verbose) {
+    std::cout << "SETTING: maxTicks = " << maxTicks << std::endl;
+  }
   
+  m_moveX.resize(m_pm.size());
+  m_moveY.resize(m_pm.size());
+
   // now place them
-  m_grid->randomisePositions(m_pm);
+  if (m_placeAtRandom) {
+    m_grid->randomisePositions(m_pm, m_rng.seed());
+  } else {
+    std::mt19937_64 gen(m_rng.seed());
+    std::uniform_int_distribution<uint64_t> distrib(0, (m_grid->width() * m_grid->height()) - 1);
+    for (uint64_t id = 0;id < m_pm.size();id++) {
+      if (!m_pm.placed(id)) {
+        uint64_t index = distrib(gen);
+        m_grid->moveTo(m_pm, id, index % m_grid->width(), index / m_grid->width());
+      }
+    }
+  }
+  m_grid->reindex(m_pm);
 
   // now initialise risk
-  std::cout << "Infecting... ";
   for (uint64_t id = 0;id < m_pm.size();id++) {
-    std::shared_ptr<Presence> p = m_pm.get(id);
-    scoreProvider->initialiseRiskScore(p);
-    modelProvider->initialiseInfectionState(p);
-    p->commitChanges();
+    scoreProvider->initialiseRiskScore(id);
+    modelProvider->initialiseInfectionState(id);
   }
-  std::cout << std::endl;
+  m_pm.commitChanges();
 
   // sanity check - ensure right number of people are infected
   uint64_t infectedCheck = 0;
   for (uint64_t id = 0;id < m_pm.size();id++) {
-    std::shared_ptr<Presence> p = m_pm.get(id);
-    if (p->state() == State::Ill) {
+    if (m_pm.state(id) == State::Ill) {
       infectedCheck++;
     }
   }
-  std::cout << "CHECK: Infected - count: " << infectedCheck << std::endl;
+  if (m_verbose) {
+    std::cout << "CHECK: Infected - count: " << infectedCheck << std::endl;
+  }
 
   casesPerDay.clear();
   recoveredPerDay.clear();
@@ -140,42 +378,51 @@ Simulation::reset(uint64_t days, uint64_t secondsPerTick)
 void
 Simulation::tick()
 {
-  if (0 == currentTick % 100) {
+  if (m_verbose && 0 == currentTick % 100) {
     std::cout << "Current Tick: " << currentTick << std::endl;
   }
   // calculate any movements in position
-  for (uint64_t id = 0;id < m_pm.size();id++) {
-    auto actor = m_pm.get(id);
-    uint64_t newX = actor->position()->x() + distrib(gen);
-    uint64_t newY = actor->position()->y() + distrib(gen);
-    if (newX < 0) {
-      newX = 0;
-    } else if (newX >= m_grid->width()) {
-      newX = m_grid->width() - 1;
+  const uint64_t count = m_pm.size();
+  const int64_t width = (int64_t)m_grid->width();
+  const int64_t height = (int64_t)m_grid->height();
+  m_executor->forEachChunk(count, ChunkSize, [this, width, height] (uint64_t from, uint64_t to) {
+    int8_t dx[ChunkSize];
+    int8_t dy[ChunkSize];
+    m_rng.steps(currentTick, from, to, dx, dy);
+    for (uint64_t id = from;id < to;id++) {
+      // signed, so a move off the low edge is clamped to 0
+      m_moveX[id] = (uint32_t)std::clamp<int64_t>((int64_t)m_pm.x(id) + dx[id - from], 0, width - 1);
+      m_moveY[id] = (uint32_t)std::clamp<int64_t>((int64_t)m_pm.y(id) + dy[id - from], 0, height - 1);
     }
-    if (newY < 0) {
-      newY = 0;
-    } else if (newY >= m_grid->height()) {
-      newY = m_grid->height() - 1;
-    }
-    actor->moveTo(m_grid->cell(newX,newY));
+  });
+  // Cells are shared, so move in id order on this thread. This keeps each cell's presences in the same order every run.
+  for (uint64_t id = 0;id < count;id++) {
+    m_grid->moveTo(m_pm, id, m_moveX[id], m_moveY[id]);
   }
+  m_grid->reindex(m_pm);
 
   // calculate new social mixing risk score
-  for (uint64_t id = 0;id < m_pm.size();id++) {
-    auto actor = m_pm.get(id);
-    scoreProvider->calculateNewRiskScore(actor,minutesPerTick);
-  }
-  // calculate actual medical state
-  for (uint64_t id = 0;id < m_pm.size();id++) {
-    auto actor = m_pm.get(id);
-    modelProvider->determineInfectionState(actor,minutesPerTick, currentTick);
+  m_executor->forEachChunk(count, ChunkSize, [this] (uint64_t from, uint64_t to) {
+    for (uint64_t id = from;id < to;id++) {
+      scoreProvider->calculateNewRiskScore(id,minutesPerTick);
+    }
+  });
+  // calculate actual medical state, of only those presences whose state may change if the model knows
+  if (modelProvider->activePresences(currentTick, m_active)) {
+    m_executor->forEachChunk(m_active.size(), ChunkSize, [this] (uint64_t from, uint64_t to) {
+      for (uint64_t i = from;i < to;i++) {
+        modelProvider->determineInfectionState(m_active[i],minutesPerTick, currentTick);
+      }
+    });
+  } else {
+    m_executor->forEachChunk(count, ChunkSize, [this] (uint64_t from, uint64_t to) {
+      for (uint64_t id = from;id < to;id++) {
+        modelProvider->determineInfectionState(id,minutesPerTick, currentTick);
+      }
+    });
   }
   // Commit new risk score (two step process in case of nearby over more than 1 grid square)
-  for (uint64_t id = 0;id < m_pm.size();id++) {
-    auto actor = m_pm.get(id);
-    actor->commitChanges();
-  }
+  m_pm.commitChanges();
   // increment tick
   currentTick++;
   uint64_t newToday = (uint64_t)(currentTick * minutesPerTick) / (60 * 24);
@@ -183,9 +430,8 @@ Simulation::tick()
     // recalculate cases
     uint64_t liveCases = 0;
     uint64_t liveRecovered = 0;
-    for (uint64_t id = 0;id < m_pm.size();id++) {
-      auto actor = m_pm.get(id);
-      switch (actor->state()) {
+    for (uint64_t id = 0;id < count;id++) {
+      switch (m_pm.state(id)) {
         case State::Ill:
           liveCases++;
           break;
@@ -196,10 +442,19 @@ Simulation::tick()
           break;
       }
     }
-    casesPerDay.push_back(liveCases);
-    recoveredPerDay.push_back(liveRecovered);
+    // A tick longer than a day crosses several, each ending in the same state
+    while (casesPerDay.size() <= newToday) {
+      casesPerDay.push_back(liveCases);
+      recoveredPerDay.push_back(liveRecovered);
+    }
   }
   today = newToday;
+
+  if (m_ticksPerCheckpoint > 0 && 0 == currentTick % m_ticksPerCheckpoint && currentTick < maxTicks) {
+    if (!writeCheckpoint(m_checkpointFile)) {
+      std::cerr << "Could not write checkpoint " << m_checkpointFile << std::endl;
+    }
+  }
 }
 
 
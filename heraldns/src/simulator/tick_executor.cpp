@@ -0,0 +1,104 @@
+//  Copyright 2021 Herald Project Contributors
+//  SPDX-License-Identifier: Apache-2.0
+//
+
+#include "../../heraldns.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace heraldns {
+namespace simulator {
+
+TickExecutor::TickExecutor(unsigned int threads)
+  : m_workers(), m_lock(), m_start(), m_done(),
+    m_job(nullptr), m_generation(0), m_running(0), m_stopping(false)
+{
+  if (0 == threads) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (unsigned int t = 1;t < threads;t++) {
+    m_workers.emplace_back(&TickExecutor::work, this, t);
+  }
+}
+
+TickExecutor::~TickExecutor()
+{
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_stopping = true;
+  }
+  m_start.notify_all();
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+}
+
+unsigned int
+TickExecutor::threads() const
+{
+  return (unsigned int)m_workers.size() + 1;
+}
+
+void
+TickExecutor::forEachChunk(uint64_t count, uint64_t chunkSize, const std::function<void(uint64_t from, uint64_t to)>& fn)
+{
+  std::atomic<uint64_t> next(0);
+  run([&fn, &next, count, chunkSize] (unsigned int) {
+    for (uint64_t from = next.fetch_add(chunkSize);from < count;from = next.fetch_add(chunkSize)) {
+      fn(from, std::min(count, from + chunkSize));
+    }
+  });
+}
+
+// PRIVATE METHODS
+
+void
+TickExecutor::run(const std::function<void(unsigned int thread)>& job)
+{
+  if (m_workers.empty()) {
+    job(0);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_job = &job;
+    m_running = (unsigned int)m_workers.size();
+    m_generation++;
+  }
+  m_start.notify_all();
+  job(0);
+  std::unique_lock<std::mutex> guard(m_lock);
+  m_done.wait(guard, [this] { return 0 == m_running; });
+  m_job = nullptr;
+}
+
+void
+TickExecutor::work(unsigned int thread)
+{
+  uint64_t seen = 0;
+  while (true) {
+    const std::function<void(unsigned int thread)>* job;
+    {
+      std::unique_lock<std::mutex> guard(m_lock);
+      m_start.wait(guard, [this, seen] { return m_stopping || m_generation != seen; });
+      if (m_stopping) {
+        return;
+      }
+      seen = m_generation;
+      job = m_job;
+    }
+    (*job)(thread);
+    bool last;
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      last = (0 == --m_running);
+    }
+    if (last) {
+      m_done.notify_one();
+    }
+  }
+}
+
+} // end namespace
+} // end namespace
@@ -2,9 +2,11 @@
 //  SPDX-License-Identifier: Apache-2.0
 //
 
-#include <iostream>
 #include "../../heraldns.h"
 
+#include <algorithm>
+#include <limits>
+
 using namespace heraldns;
 using namespace heraldns::datatype;
 using namespace heraldns::transmission;
@@ -13,87 +15,176 @@ namespace heraldns {
 namespace transmission {
 
 
-BasicTransmissionModelProvider::BasicTransmissionModelProvider(const PresenceManager& pm, std::shared_ptr<Grid> grid,
+BasicTransmissionModelProvider::BasicTransmissionModelProvider(PresenceManager& pm, std::shared_ptr<Grid> grid,
   uint64_t ticksToRecover, uint64_t ticksForImmunity, uint64_t initialInfections)
   : m_pm(pm),
     m_grid(grid),
+    m_neighbourhood(*grid, 8.0),
     m_ticksToRecover(ticksToRecover),
     m_ticksForImmunity(ticksForImmunity),
     m_initialInfections(initialInfections),
-    m_assignedInfections(0)
+    m_assignedInfections(0),
+    // one slot per tick of the longest delay, capped at 65536 slots. Longer timers wait in their slot for later turns
+    m_transitions(std::min<uint64_t>(std::max(ticksToRecover, ticksForImmunity) + 2, 1 << 16)),
+    m_ill(),
+    m_illIndex(pm.size(), 0),
+    m_exposed(pm.size(), 0),
+    m_active(),
+    m_activeStates(),
+    m_nextTick(std::numeric_limits<uint64_t>::max())
 {
   ;
 }
 
 void
-BasicTransmissionModelProvider::initialiseInfectionState(std::shared_ptr<Presence> presence)
+BasicTransmissionModelProvider::initialiseInfectionState(uint64_t presence)
 {
   if (m_assignedInfections < m_initialInfections) {
-    presence->newState(State::Ill, 0);
+    m_pm.newState(presence, State::Ill, 0);
     m_assignedInfections++;
-    std::cout << "I";
   } else {
-    presence->newState(State::Well, 0);
+    m_pm.newState(presence, State::Well, 0);
   }
 }
 
 void
 BasicTransmissionModelProvider::determineInfectionState(
-  std::shared_ptr<Presence> presence, double minutesPassed, uint64_t tick)
+  uint64_t presence, double minutesPassed, uint64_t tick)
 {
   // first check to see if we've been recovered for long enough to fall ill again (90 days for now)
-  State currentState = presence->state();
-  // first, check if we still have immunity (short lived)
-  if (currentState == State::Recovered && presence->lastFellIll() + m_ticksForImmunity >= tick) {
+  State currentState = m_pm.state(presence);
+  // first, check if our immunity (short lived) has run out
+  if (currentState == State::Recovered && m_pm.lastFellIll(presence) + m_ticksForImmunity < tick) {
     currentState = State::Well;
-  } else if (currentState == State::Ill && presence->lastFellIll() + m_ticksToRecover >= tick) {
+  } else if (currentState == State::Ill && m_pm.lastFellIll(presence) + m_ticksToRecover < tick) {
     // now, check if we're still ill and have recovered (we don't do deaths yet)
     currentState = State::Recovered;
   }
   
-  std::shared_ptr<Cell> cell = presence->position();
-  // Determine max distance for nearby cells (within infection risk range)
-  uint64_t x = cell->x();
-  uint64_t y = cell->y();
-  // calculate out to 8 metres
-  uint64_t radius = (uint64_t)std::ceil(8.0 / m_grid->separation());
-  uint64_t minX = x - radius;
-  if (minX < 0) minX = 0;
-  uint64_t minY = y - radius;
-  if (minY < 0) minY = 0;
-  uint64_t maxX = x + radius;
-  if (maxX > m_grid->width() - 1) maxX = m_grid->width() - 1;
-  uint64_t maxY = y + radius;
-  if (maxY > m_grid->height() - 1) maxY = m_grid->height() - 1;
-  // For each cell
-  double distance;
-
-  double oxfordRiskScore = presence->transmissionModelScore();
-
-  for (uint64_t cx = minX;cx <= maxX;cx++) {
-    for (uint64_t cy = minY;cy <= maxY;cy++) {
-      // TODO Check cell is definitely in range (we loop over a box, radius is a circle)
-      
-      // If so, for each presence in the cell
-      auto cell = m_grid->cell(cx,cy);
-      for (auto pOtherId : cell->present()) {
-        std::shared_ptr<Presence> pOther = m_pm.get(pOtherId);
-        if (pOtherId != presence->id() && pOther->state() == State::Ill) {
-          distance = m_grid->distance(cell, presence->position());
-          oxfordRiskScore += minutesPassed * 
-            4.0 * // See risk-model-approximations for 4.0 coefficient explanation
-            (distance <= 1.0 ? 1.0 : 1.0 / pow(distance, 2.0))
-          ; // TODO change to actual oxford risk model formula
-        }
+  // Exposure to every ill presence within 8 metres, which only matters to the well
+  double oxfordRiskScore = m_pm.transmissionModelScore(presence);
+  if (currentState == State::Well) {
+    m_neighbourhood.forEach(*m_grid, m_pm, presence, [this, &oxfordRiskScore, minutesPassed] (uint64_t pOtherId, double weight) {
+      if (m_pm.state(pOtherId) == State::Ill) {
+        oxfordRiskScore += minutesPassed * 
+          4.0 * // See risk-model-approximations for 4.0 coefficient explanation
+          weight
+        ; // TODO change to actual oxford risk model formula
       }
-    }
+    });
   }
-  presence->newTransmissionModelScore(oxfordRiskScore);
+  m_pm.newTransmissionModelScore(presence, oxfordRiskScore);
   // Has this person *actually* fallen ill?
   if (currentState == State::Well && oxfordRiskScore > 60) { // number for above if 15m @ 2m (4 * inv dist sq)
-    presence->newState(State::Ill, tick);
+    m_pm.newState(presence, State::Ill, tick);
+  } else {
+    m_pm.newState(presence, currentState, tick);
+  }
+}
+
+bool
+BasicTransmissionModelProvider::activePresences(uint64_t tick, std::vector<uint64_t>& active)
+{
+  if (0 == tick || tick != m_nextTick) {
+    rebuild(tick);
   } else {
-    presence->newState(currentState, tick);
+    // Last tick's changes, now committed
+    for (std::size_t i = 0;i < m_active.size();i++) {
+      const uint64_t id = m_active[i];
+      const State now = m_pm.state(id);
+      if (now == m_activeStates[i]) {
+        continue;
+      }
+      if (m_activeStates[i] == State::Ill) {
+        recovered(id);
+      }
+      if (now == State::Ill) {
+        fellIll(id);
+      }
+    }
+  }
+  m_nextTick = tick + 1;
+
+  active.clear();
+  m_transitions.take(tick, active);
+  // Only the well near the ill may fall ill. The neighbourhood is symmetric, so they are the
+  // presences in the ill presences' neighbourhoods.
+  const std::size_t firstExposed = active.size();
+  for (uint64_t ill : m_ill) {
+    m_neighbourhood.forEach(*m_grid, m_pm, ill, [this, &active] (uint64_t other, double) {
+      if (0 == m_exposed[other] && m_pm.state(other) == State::Well) {
+        m_exposed[other] = 1;
+        active.push_back(other);
+      }
+    });
+  }
+  for (std::size_t i = firstExposed;i < active.size();i++) {
+    m_exposed[active[i]] = 0;
+  }
+
+  m_active = active;
+  m_activeStates.resize(active.size());
+  for (std::size_t i = 0;i < active.size();i++) {
+    m_activeStates[i] = m_pm.state(active[i]);
+  }
+  return true;
+}
+
+std::vector<uint64_t>
+BasicTransmissionModelProvider::checkpointState() const
+{
+  return {m_assignedInfections};
+}
+
+bool
+BasicTransmissionModelProvider::restoreState(const std::vector<uint64_t>& state)
+{
+  if (1 != state.size()) {
+    return false;
+  }
+  m_assignedInfections = state[0];
+  m_nextTick = std::numeric_limits<uint64_t>::max(); // rebuild from the restored presences
+  return true;
+}
+
+// PRIVATE METHODS
+
+void
+BasicTransmissionModelProvider::rebuild(uint64_t tick)
+{
+  m_nextTick = tick;
+  m_transitions.clear();
+  m_ill.clear();
+  m_active.clear();
+  m_activeStates.clear();
+  for (uint64_t id = 0;id < m_pm.size();id++) {
+    if (m_pm.state(id) == State::Ill) {
+      fellIll(id);
+    } else if (m_pm.state(id) == State::Recovered) {
+      m_transitions.schedule(std::max(tick, m_pm.lastFellIll(id) + m_ticksForImmunity + 1), id);
+    }
+  }
+}
+
+void
+BasicTransmissionModelProvider::fellIll(uint64_t id)
+{
+  m_illIndex[id] = (uint32_t)m_ill.size();
+  m_ill.push_back(id);
+  // the first tick determineInfectionState recovers it
+  m_transitions.schedule(std::max(m_nextTick, m_pm.lastFellIll(id) + m_ticksToRecover + 1), id);
+}
+
+void
+BasicTransmissionModelProvider::recovered(uint64_t id)
+{
+  // swap remove, as Cell::movedOut
+  const uint32_t index = m_illIndex[id];
+  m_ill[index] = m_ill.back();
+  m_illIndex[m_ill[index]] = index;
+  m_ill.pop_back();
+  if (m_pm.state(id) == State::Recovered) {
+    m_transitions.schedule(std::max(m_nextTick, m_pm.lastFellIll(id) + m_ticksForImmunity + 1), id);
   }
 }
 